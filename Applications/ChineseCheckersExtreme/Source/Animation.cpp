@@ -215,6 +215,9 @@ LaunchMarbleTask::LaunchMarbleTask()
 
 	this->rigidBody->SetLinearMomentum(initialVelocity * totalMass);
 
+	// The marble is small and flies fast, so don't let it tunnel through the board when it lands.
+	this->rigidBody->SetContinuousCollisionDetection(true);
+
 	double spinTorque = 5000.0;
 	Vector3 torque = Vector3::YAxis().Cross(delta).Normalized() * spinTorque;
 	this->rigidBody->AddTransientTorque(torque);
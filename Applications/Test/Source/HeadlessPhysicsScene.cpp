@@ -0,0 +1,79 @@
+#include "HeadlessPhysicsScene.h"
+
+using namespace Thebe;
+
+HeadlessPhysicsScene::HeadlessPhysicsScene()
+{
+}
+
+/*virtual*/ HeadlessPhysicsScene::~HeadlessPhysicsScene()
+{
+	this->Shutdown();
+}
+
+bool HeadlessPhysicsScene::Setup()
+{
+	this->graphicsEngine.Set(new GraphicsEngine());
+	if (!this->graphicsEngine->AddAssetFolder("Applications/CollisionLab/Assets"))
+		return false;
+
+	if (!this->graphicsEngine->AddAssetFolder("Applications/PhysicsLab/Assets"))
+		return false;
+
+	AxisAlignedBoundingBox worldBox;
+	worldBox.minCorner.SetComponents(-1000.0, -1000.0, -1000.0);
+	worldBox.maxCorner.SetComponents(1000.0, 1000.0, 1000.0);
+	this->graphicsEngine->GetCollisionSystem()->SetWorldBox(worldBox);
+
+	return true;
+}
+
+void HeadlessPhysicsScene::Shutdown()
+{
+	for (auto& physicsObject : this->physicsObjectArray)
+		physicsObject->Shutdown();
+
+	this->physicsObjectArray.clear();
+	this->graphicsEngine = nullptr;
+}
+
+bool HeadlessPhysicsScene::AddGroundSlab(const Vector3& topCenter)
+{
+	// The slab is a unit thick.
+	return this->AddObject("PhysicsObjects/GroundSlab.rigid_body", topCenter - Vector3(0.0, 0.5, 0.0));
+}
+
+bool HeadlessPhysicsScene::AddBox(const Vector3& center)
+{
+	return this->AddObject("PhysicsObjects/Cube.rigid_body", center);
+}
+
+bool HeadlessPhysicsScene::AddObject(const char* physicsObjectPath, const Vector3& position)
+{
+	// Every object is loaded afresh, since a cached one would just be the same object all over again.
+	Reference<PhysicsObject> physicsObject;
+	if (!this->graphicsEngine->LoadEnginePartFromFile(physicsObjectPath, physicsObject, THEBE_LOAD_FLAG_DONT_CHECK_CACHE | THEBE_LOAD_FLAG_DONT_CACHE_PART) || !physicsObject.Get())
+		return false;
+
+	Transform objectToWorld;
+	objectToWorld.SetIdentity();
+	objectToWorld.translation = position;
+	physicsObject->SetObjectToWorld(objectToWorld);
+	this->physicsObjectArray.push_back(physicsObject);
+	return true;
+}
+
+CollisionSystem* HeadlessPhysicsScene::GetCollisionSystem()
+{
+	return this->graphicsEngine->GetCollisionSystem();
+}
+
+PhysicsSystem* HeadlessPhysicsScene::GetPhysicsSystem()
+{
+	return this->graphicsEngine->GetPhysicsSystem();
+}
+
+const std::vector<Reference<PhysicsObject>>& HeadlessPhysicsScene::GetPhysicsObjectArray() const
+{
+	return this->physicsObjectArray;
+}
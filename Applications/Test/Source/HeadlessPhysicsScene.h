@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Thebe/GraphicsEngine.h"
+#include "Thebe/EngineParts/PhysicsObject.h"
+#include <vector>
+
+/**
+ * This is a graphics engine that is never set up, so there's no window or device, for tests that only want
+ * its collision and physics systems, along with the objects the tests put in them.  The world box reaches
+ * a thousand units from the origin in every direction.
+ */
+class HeadlessPhysicsScene
+{
+public:
+	HeadlessPhysicsScene();
+	virtual ~HeadlessPhysicsScene();
+
+	bool Setup();
+	void Shutdown();
+
+	/**
+	 * Add a stationary slab, forty units across, with the middle of its top face at the given point.
+	 */
+	bool AddGroundSlab(const Thebe::Vector3& topCenter);
+
+	/**
+	 * Add a box, two units on a side, centered at the given point.
+	 */
+	bool AddBox(const Thebe::Vector3& center);
+
+	Thebe::CollisionSystem* GetCollisionSystem();
+	Thebe::PhysicsSystem* GetPhysicsSystem();
+
+	/**
+	 * These are all the objects added so far, in the order they were added.
+	 */
+	const std::vector<Thebe::Reference<Thebe::PhysicsObject>>& GetPhysicsObjectArray() const;
+
+private:
+	bool AddObject(const char* physicsObjectPath, const Thebe::Vector3& position);
+
+	Thebe::Reference<Thebe::GraphicsEngine> graphicsEngine;
+	std::vector<Thebe::Reference<Thebe::PhysicsObject>> physicsObjectArray;
+};
@@ -1,6 +1,8 @@
 #include "Main.h"
 #include "TestApplication.h"
 #include "TestAVLTree.h"
+#include "TestBoxStack.h"
+#include "TestPhysicsThreads.h"
 #include "Thebe/Log.h"
 
 _Use_decl_annotations_
@@ -16,6 +18,14 @@ int WINAPI WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR cmdLine, in
 	TestAVLTree();
 #endif
 
+#if false
+	TestBoxStack();
+#endif
+
+#if false
+	TestPhysicsThreads();
+#endif
+
 	TestApplication app;
 
 	int exitCode = 0;
@@ -0,0 +1,69 @@
+#include "TestBoxStack.h"
+#include "HeadlessPhysicsScene.h"
+#include "Thebe/Utilities/Clock.h"
+#include "Thebe/Log.h"
+#include <vector>
+
+void TestBoxStack()
+{
+	using namespace Thebe;
+
+	constexpr int numBoxes = 20;
+	constexpr int numSteps = 600;
+	constexpr double timeStepSeconds = 1.0 / 60.0;
+
+	HeadlessPhysicsScene scene;
+	if (!scene.Setup() || !scene.AddGroundSlab(Vector3(0.0, 0.0, 0.0)))
+		return;
+
+	CollisionSystem* collisionSystem = scene.GetCollisionSystem();
+	PhysicsSystem* physicsSystem = scene.GetPhysicsSystem();
+	const std::vector<Reference<PhysicsObject>>& physicsObjectArray = scene.GetPhysicsObjectArray();
+
+	// The boxes are two units on a side, and each starts out just touching the one below it.
+	for (int i = 0; i < numBoxes; i++)
+		if (!scene.AddBox(Vector3(0.0, 1.0 + 2.0 * double(i), 0.0)))
+			break;
+
+	if ((int)physicsObjectArray.size() == numBoxes + 1)
+	{
+		const PhysicsObject* topBox = physicsObjectArray.back().Get();
+		Vector3 startPosition = topBox->GetObjectToWorld().translation;
+
+		Clock clock;
+		double totalStepTimeMilliseconds = 0.0;
+		double totalIterationTimeMicroseconds = 0.0;
+		int numSolvedSteps = 0;
+		int asleepStep = -1;
+
+		for (int i = 0; i < numSteps && asleepStep < 0; i++)
+		{
+			clock.GetCurrentTimeMilliseconds(true);
+			physicsSystem->StepSimulation(timeStepSeconds, collisionSystem);
+			totalStepTimeMilliseconds += clock.GetCurrentTimeMilliseconds();
+
+			const PhysicsSystem::ContactSolverStats& stats = physicsSystem->GetContactSolverStats();
+			if (stats.numIterations > 0 && stats.numConstraints > 0)
+			{
+				totalIterationTimeMicroseconds += 1000.0 * stats.solveTimeMilliseconds / double(stats.numIterations);
+				numSolvedSteps++;
+			}
+
+			if (physicsSystem->GetIslandStats().numAwakeObjects == 0)
+				asleepStep = i;
+		}
+
+		int numStepsTaken = (asleepStep >= 0) ? (asleepStep + 1) : numSteps;
+		Vector3 delta = topBox->GetObjectToWorld().translation - startPosition;
+		double sidewaysDrift = Vector3(delta.x, 0.0, delta.z).Length();
+		bool stood = sidewaysDrift < 0.5 && -delta.y < 0.5;
+
+		THEBE_LOG("Box stack: %d boxes, %d solver iterations, %d thread(s), %d steps of %.1f ms.", numBoxes, physicsSystem->GetContactSolverIterations(), physicsSystem->GetThreadCount(), numStepsTaken, timeStepSeconds * 1000.0);
+		THEBE_LOG("Box stack: The stack %s.  The top box drifted %.4f sideways and sank %.4f.", stood ? "stood" : "fell", sidewaysDrift, -delta.y);
+		if (asleepStep >= 0)
+			THEBE_LOG("Box stack: Everything was asleep after %.2f seconds.", double(asleepStep + 1) * timeStepSeconds);
+		else
+			THEBE_LOG("Box stack: Something was still awake after %.2f seconds.", double(numSteps) * timeStepSeconds);
+		THEBE_LOG("Box stack: %.3f ms per step, %.2f us per solver iteration.", totalStepTimeMilliseconds / double(numStepsTaken), (numSolvedSteps > 0) ? (totalIterationTimeMicroseconds / double(numSolvedSteps)) : 0.0);
+	}
+}
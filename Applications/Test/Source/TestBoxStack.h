@@ -0,0 +1,7 @@
+#pragma once
+
+/**
+ * Stack boxes on the ground and let them settle, with no window, logging how well the stack
+ * stood and what each pass of the contact solver cost.
+ */
+void TestBoxStack();
@@ -0,0 +1,102 @@
+#include "TestPhysicsThreads.h"
+#include "HeadlessPhysicsScene.h"
+#include "Thebe/Utilities/Clock.h"
+#include "Thebe/Log.h"
+#include <vector>
+#include <thread>
+
+using namespace Thebe;
+
+namespace
+{
+	/**
+	 * Run 50 piles of 40 boxes each, 2000 boxes in all, for the given number of steps on the given number of threads, giving back
+	 * the average time per step, and where each box ended up.  Each run starts from scratch, so runs can be compared.
+	 */
+	bool RunBoxPiles(int threadCount, int numSteps, double& stepTimeMilliseconds, std::vector<Vector3>& positionArray)
+	{
+		constexpr int numPilesAcross = 10;
+		constexpr int numPilesDeep = 5;
+		constexpr int numLayersPerPile = 10;
+		constexpr double pileSpacing = 6.0;
+		constexpr double timeStepSeconds = 1.0 / 60.0;
+
+		// The piles are laid out over two slabs, side by side, since there isn't room for them all on one.
+		HeadlessPhysicsScene scene;
+		if (!scene.Setup() || !scene.AddGroundSlab(Vector3(-20.0, 0.0, 0.0)) || !scene.AddGroundSlab(Vector3(20.0, 0.0, 0.0)))
+			return false;
+
+		CollisionSystem* collisionSystem = scene.GetCollisionSystem();
+		PhysicsSystem* physicsSystem = scene.GetPhysicsSystem();
+
+		// Nothing may sleep, or we'd only be timing the first few seconds.
+		physicsSystem->SetSleepEnabled(false);
+		if (!physicsSystem->SetThreadCount(threadCount))
+			return false;
+
+		// Each pile is two boxes by two boxes by ten high, and the boxes are two units on a side, so there are two units between
+		// neighboring piles, and each pile is an island of its own.
+		for (int i = 0; i < numPilesAcross; i++)
+		{
+			for (int j = 0; j < numPilesDeep; j++)
+			{
+				Vector3 pileCenter(pileSpacing * (double(i) - double(numPilesAcross - 1) / 2.0), 0.0, pileSpacing * (double(j) - double(numPilesDeep - 1) / 2.0));
+				for (int k = 0; k < numLayersPerPile; k++)
+					for (int l = 0; l < 4; l++)
+						if (!scene.AddBox(pileCenter + Vector3((l & 1) ? 1.0 : -1.0, 1.0 + 2.0 * double(k), (l & 2) ? 1.0 : -1.0)))
+							return false;
+			}
+		}
+
+		Clock clock;
+		clock.GetCurrentTimeMilliseconds(true);
+		for (int i = 0; i < numSteps; i++)
+			physicsSystem->StepSimulation(timeStepSeconds, collisionSystem);
+		stepTimeMilliseconds = clock.GetCurrentTimeMilliseconds() / double(numSteps);
+
+		positionArray.clear();
+		for (const auto& physicsObject : scene.GetPhysicsObjectArray())
+			positionArray.push_back(physicsObject->GetObjectToWorld().translation);
+
+		return true;
+	}
+}
+
+void TestPhysicsThreads()
+{
+	constexpr int numSteps = 300;
+
+	std::vector<int> threadCountArray{ 1, 2, 4 };
+	int coreCount = THEBE_MAX(int(std::thread::hardware_concurrency()), 1);
+	if (coreCount != 1 && coreCount != 2 && coreCount != 4)
+		threadCountArray.push_back(coreCount);
+
+	double baseStepTimeMilliseconds = 0.0;
+	std::vector<Vector3> basePositionArray;
+
+	for (int threadCount : threadCountArray)
+	{
+		double stepTimeMilliseconds = 0.0;
+		std::vector<Vector3> positionArray;
+		if (!RunBoxPiles(threadCount, numSteps, stepTimeMilliseconds, positionArray))
+		{
+			THEBE_LOG("Physics threads: Failed to run the scene on %d thread(s).", threadCount);
+			return;
+		}
+
+		// The results of a step aren't supposed to depend on the number of threads at all.
+		double largestDifference = 0.0;
+		if (basePositionArray.size() == 0)
+		{
+			baseStepTimeMilliseconds = stepTimeMilliseconds;
+			basePositionArray = positionArray;
+		}
+		else
+		{
+			for (int i = 0; i < (int)positionArray.size(); i++)
+				largestDifference = THEBE_MAX(largestDifference, (positionArray[i] - basePositionArray[i]).Length());
+		}
+
+		THEBE_LOG("Physics threads: %d thread(s), %.3f ms per step, %.2fx speed-up, results differ by %g.", threadCount, stepTimeMilliseconds, baseStepTimeMilliseconds / stepTimeMilliseconds, largestDifference);
+	}
+}
@@ -15,6 +15,7 @@
 #include <wx/busyinfo.h>
 #include <wx/textdlg.h>
 #include <wx/choicdlg.h>
+#include <wx/tokenzr.h>
 #include <filesystem>
 
 GraphicsToolFrame::GraphicsToolFrame(const wxPoint& pos, const wxSize& size) : wxFrame(nullptr, wxID_ANY, "Thebe Graphics Tool", pos, size), timer(this, ID_Timer)
@@ -207,7 +208,7 @@ void GraphicsToolFrame::OnBuildRigidBody(wxCommandEvent& event)
 	if (inputFileDialog.ShowModal() != wxID_OK)
 		return;
 
-	wxTextEntryDialog meshNameDialog(this, "Specify mesh name.", "Mesh Name");
+	wxTextEntryDialog meshNameDialog(this, "Specify mesh name.  (Separate several names with commas to build one body of several hulls.)", "Mesh Name");
 	if (meshNameDialog.ShowModal() != wxID_OK)
 		return;
 
@@ -221,7 +222,13 @@ void GraphicsToolFrame::OnBuildRigidBody(wxCommandEvent& event)
 	}
 
 	RBDBuilder rbdBuilder;
-	rbdBuilder.SetDesiredMeshName(aiString((const char*)meshNameDialog.GetValue().c_str()));
+	wxStringTokenizer meshNameTokenizer(meshNameDialog.GetValue(), ",");
+	while (meshNameTokenizer.HasMoreTokens())
+	{
+		wxString meshName = meshNameTokenizer.GetNextToken().Trim(true).Trim(false);
+		if (!meshName.IsEmpty())
+			rbdBuilder.AddDesiredMeshName(aiString((const char*)meshName.c_str()));
+	}
 
 	if (wxMessageBox("Will the physics object remain stationary?", "Stationary?", wxYES_NO | wxICON_QUESTION, this) == wxYES)
 		rbdBuilder.SetStationary(true);
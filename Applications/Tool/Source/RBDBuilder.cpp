@@ -1,6 +1,7 @@
 #include "RBDBuilder.h"
 #include "Thebe/EngineParts/RigidBody.h"
 #include "Thebe/EngineParts/CollisionObject.h"
+#include "Thebe/Math/GJKCompoundShape.h"
 #include "Thebe/Log.h"
 #include <assimp/postprocess.h>
 
@@ -36,37 +37,41 @@ bool RBDBuilder::BuildRigidBody(const std::filesystem::path& inputSceneFile, con
 		return false;
 	}
 
-	const aiMesh* desiredInputMesh = nullptr;
-	Thebe::Transform meshToWorld;
-
-	THEBE_LOG("Looking for desired mesh: %s", this->desiredMeshName.C_Str());
-	if (!this->FindMeshForRigidBody(inputScene->mRootNode, Thebe::Transform::Identity(), desiredInputMesh, meshToWorld))
+	if (this->desiredMeshNameArray.size() == 0)
 	{
-		THEBE_LOG("Failed to find mesh \"%s\".", this->desiredMeshName.C_Str());
+		THEBE_LOG("No mesh name given.");
 		return false;
 	}
 
-	THEBE_LOG("Found it!  Processing mesh...");
-	std::vector<Thebe::Vector3> vertexArray;
-	for (unsigned int i = 0; i < desiredInputMesh->mNumVertices; i++)
-	{
-		Thebe::Vector3 vertex = this->MakeVector(desiredInputMesh->mVertices[i]);
-		vertex = meshToWorld.TransformPoint(vertex);
-		vertexArray.push_back(vertex);
-	}
-
 	Thebe::Reference<Thebe::CollisionObject> collisionObject(new Thebe::CollisionObject());
 	collisionObject->SetGraphicsEngine(wxGetApp().GetGraphicsEngine());
 
-	auto convexHull = new Thebe::GJKConvexHull();
-	collisionObject->SetShape(convexHull);
-	if (!convexHull->hull.GenerateConvexHull(vertexArray))
+	if (this->desiredMeshNameArray.size() == 1)
 	{
-		THEBE_LOG("Failed to generate convex hull!");
-		return false;
-	}
+		Thebe::GJKConvexHull* convexHull = this->BuildConvexHull(this->desiredMeshNameArray[0]);
+		if (!convexHull)
+			return false;
 
-	convexHull->hull.SimplifyFaces(true);
+		collisionObject->SetShape(convexHull);
+	}
+	else
+	{
+		// The hulls are all built in the space of the scene, so they go into the compound as they are.
+		auto compoundShape = new Thebe::GJKCompoundShape();
+		collisionObject->SetShape(compoundShape);
+		for (const aiString& meshName : this->desiredMeshNameArray)
+		{
+			Thebe::GJKConvexHull* convexHull = this->BuildConvexHull(meshName);
+			if (!convexHull)
+				return false;
+
+			if (!compoundShape->AddChild(convexHull, Thebe::Transform::Identity()))
+			{
+				THEBE_LOG("Failed to add hull of mesh \"%s\" to compound shape!", meshName.C_Str());
+				return false;
+			}
+		}
+	}
 
 	Thebe::Reference<Thebe::RigidBody> rigidBody(new Thebe::RigidBody());
 	rigidBody->SetCollisionObject(collisionObject.Get());
@@ -78,7 +83,7 @@ bool RBDBuilder::BuildRigidBody(const std::filesystem::path& inputSceneFile, con
 
 	rigidBody->SetStationary(this->stationary);
 
-	std::string name = this->NoSpaces(std::string(this->desiredMeshName.C_Str()));
+	std::string name = this->NoSpaces(std::string(this->desiredMeshNameArray[0].C_Str()));
 
 	rigidBody->SetName(name + "_RigidBody");
 	collisionObject->SetName(name + "_Collision");
@@ -103,7 +108,40 @@ bool RBDBuilder::BuildRigidBody(const std::filesystem::path& inputSceneFile, con
 	return true;
 }
 
-bool RBDBuilder::FindMeshForRigidBody(const aiNode* parentNode, const Thebe::Transform& parentToWorld, const aiMesh*& desiredInputMesh, Thebe::Transform& meshToWorld)
+Thebe::GJKConvexHull* RBDBuilder::BuildConvexHull(const aiString& meshName)
+{
+	const aiMesh* desiredInputMesh = nullptr;
+	Thebe::Transform meshToWorld;
+
+	THEBE_LOG("Looking for desired mesh: %s", meshName.C_Str());
+	if (!this->FindMeshForRigidBody(this->importer.GetScene()->mRootNode, Thebe::Transform::Identity(), meshName, desiredInputMesh, meshToWorld))
+	{
+		THEBE_LOG("Failed to find mesh \"%s\".", meshName.C_Str());
+		return nullptr;
+	}
+
+	THEBE_LOG("Found it!  Processing mesh...");
+	std::vector<Thebe::Vector3> vertexArray;
+	for (unsigned int i = 0; i < desiredInputMesh->mNumVertices; i++)
+	{
+		Thebe::Vector3 vertex = this->MakeVector(desiredInputMesh->mVertices[i]);
+		vertex = meshToWorld.TransformPoint(vertex);
+		vertexArray.push_back(vertex);
+	}
+
+	auto convexHull = new Thebe::GJKConvexHull();
+	if (!convexHull->hull.GenerateConvexHull(vertexArray))
+	{
+		THEBE_LOG("Failed to generate convex hull!");
+		delete convexHull;
+		return nullptr;
+	}
+
+	convexHull->GenerateAdjacency();
+	return convexHull;
+}
+
+bool RBDBuilder::FindMeshForRigidBody(const aiNode* parentNode, const Thebe::Transform& parentToWorld, const aiString& meshName, const aiMesh*& desiredInputMesh, Thebe::Transform& meshToWorld)
 {
 	Thebe::Transform nodeToParent = this->MakeTransform(parentNode->mTransformation);
 	Thebe::Transform nodeToWorld = parentToWorld * nodeToParent;
@@ -111,7 +149,7 @@ bool RBDBuilder::FindMeshForRigidBody(const aiNode* parentNode, const Thebe::Tra
 	for (unsigned int i = 0; i < parentNode->mNumMeshes; i++)
 	{
 		const aiMesh* inputMesh = this->importer.GetScene()->mMeshes[parentNode->mMeshes[i]];
-		if (inputMesh->mName == this->desiredMeshName)
+		if (inputMesh->mName == meshName)
 		{
 			meshToWorld = nodeToWorld;
 			desiredInputMesh = inputMesh;
@@ -122,7 +160,7 @@ bool RBDBuilder::FindMeshForRigidBody(const aiNode* parentNode, const Thebe::Tra
 	for (unsigned int i = 0; i < parentNode->mNumChildren; i++)
 	{
 		const aiNode* childNode = parentNode->mChildren[i];
-		if (this->FindMeshForRigidBody(childNode, nodeToWorld, desiredInputMesh, meshToWorld))
+		if (this->FindMeshForRigidBody(childNode, nodeToWorld, meshName, desiredInputMesh, meshToWorld))
 			return true;
 	}
 
@@ -131,5 +169,11 @@ bool RBDBuilder::FindMeshForRigidBody(const aiNode* parentNode, const Thebe::Tra
 
 void RBDBuilder::SetDesiredMeshName(const aiString& desiredMeshName)
 {
-	this->desiredMeshName = desiredMeshName;
+	this->desiredMeshNameArray.clear();
+	this->desiredMeshNameArray.push_back(desiredMeshName);
+}
+
+void RBDBuilder::AddDesiredMeshName(const aiString& desiredMeshName)
+{
+	this->desiredMeshNameArray.push_back(desiredMeshName);
 }
\ No newline at end of file
@@ -14,13 +14,21 @@ public:
 	bool BuildRigidBody(const std::filesystem::path& inputSceneFile, const std::filesystem::path& outputAssetsFolder);
 
 	void SetDesiredMeshName(const aiString& desiredMeshName);
+
+	/**
+	 * Each desired mesh becomes a convex hull.  If there is more than one, the
+	 * body is given a compound shape, with one child per hull.
+	 */
+	void AddDesiredMeshName(const aiString& desiredMeshName);
+
 	void SetStationary(bool stationary);
 
 private:
 
-	bool FindMeshForRigidBody(const aiNode* parentNode, const Thebe::Transform& parentToWorld, const aiMesh*& desiredInputMesh, Thebe::Transform& meshToWorld);
+	bool FindMeshForRigidBody(const aiNode* parentNode, const Thebe::Transform& parentToWorld, const aiString& meshName, const aiMesh*& desiredInputMesh, Thebe::Transform& meshToWorld);
+	Thebe::GJKConvexHull* BuildConvexHull(const aiString& meshName);
 
 	Assimp::Importer importer;
-	aiString desiredMeshName;
+	std::vector<aiString> desiredMeshNameArray;
 	bool stationary;
 };
\ No newline at end of file
@@ -24,180 +24,277 @@ const AxisAlignedBoundingBox& BVHTree::GetWorldBox() const
 	return this->worldBox;
 }
 
-bool BVHTree::AddObject(BVHObject* object)
+void BVHTree::SetPairFilter(PairFilter pairFilter)
+{
+	this->pairFilter = pairFilter;
+}
+
+bool BVHTree::ShouldPair(const BVHObject* objectA, const BVHObject* objectB) const
+{
+	if (objectA->atRest && objectB->atRest)
+		return false;
+
+	if (!objectA->CanPairWith(objectB))
+		return false;
+
+	if (this->pairFilter && !this->pairFilter(objectA, objectB))
+		return false;
+
+	return true;
+}
+
+void BVHTree::SetPairCallbacks(PairCallback pairAddedCallback, PairCallback pairRemovedCallback)
+{
+	this->pairAddedCallback = pairAddedCallback;
+	this->pairRemovedCallback = pairRemovedCallback;
+}
+
+/*virtual*/ void BVHTree::CastRays(std::span<const Ray> rayArray, std::span<RayHit> rayHitArray)
+{
+	THEBE_ASSERT(rayHitArray.size() >= rayArray.size());
+
+	for (size_t i = 0; i < rayArray.size(); i++)
+	{
+		const Ray& ray = rayArray[i];
+		RayHit& rayHit = rayHitArray[i];
+
+		rayHit.alpha = 0.0;
+		rayHit.object = this->FindNearestObjectHitByRay(ray, rayHit.alpha, rayHit.unitSurfaceNormal);
+	}
+}
+
+bool BVHTree::OwnsObject(const BVHObject* object) const
+{
+	return object->tree == this;
+}
+
+void BVHTree::SetObjectTree(BVHObject* object, BVHTree* tree)
+{
+	object->tree = tree;
+}
+
+//---------------------------------------- SplitBoxBVHTree ----------------------------------------
+
+SplitBoxBVHTree::SplitBoxBVHTree()
+{
+}
+
+/*virtual*/ SplitBoxBVHTree::~SplitBoxBVHTree()
+{
+	this->RemoveAllObjects();
+}
+
+/*virtual*/ bool SplitBoxBVHTree::AddObject(BVHObject* object)
 {
 	if (!object)
 		return false;
 
-	Reference<BVHNode> node;
-	if (object->GetNode(node))
+	if (object->IsInBVH())
 	{
 		THEBE_LOG("Given object is already in a tree.");
 		return false;
 	}
 
-	if (!this->rootNode.Get())
+	if (this->nodeArray.size() == 0)
 	{
-		this->rootNode.Set(new BVHNode());
-		this->rootNode->worldBox = this->worldBox;
+		this->nodeArray.push_back(Node());
+		this->nodeArray[0].worldBox = this->worldBox;
 	}
 
-	object->SetNode(this->rootNode);
+	this->SetObjectTree(object, this);
+	object->proxyIndex = 0;
 	
-	return object->UpdateBVHLocation();
+	return this->UpdateObject(object, false);
 }
 
-bool BVHTree::RemoveObject(BVHObject* object)
+/*virtual*/ bool SplitBoxBVHTree::RemoveObject(BVHObject* object)
 {
 	if (!object)
 		return false;
 
-	Reference<BVHNode> node;
-	if (!object->GetNode(node))
-	{
-		THEBE_LOG("Given object is not in a tree.");
-		return false;
-	}
-
-	if (node->treeHandle != this->GetHandle())
+	if (!this->OwnsObject(object))
 	{
 		THEBE_LOG("Given object is not in this tree.");
 		return false;
 	}
 
-	node->RemoveObject(object);
-	object->SetNode(nullptr);
+	if (object->proxyIndex != -1)
+		this->RemoveObjectFromNode(object->proxyIndex, object);
+
+	object->proxyIndex = -1;
+	this->SetObjectTree(object, nullptr);
 
 	return true;
 }
 
-void BVHTree::RemoveAllObjects()
+/*virtual*/ void SplitBoxBVHTree::RemoveAllObjects()
 {
-	this->rootNode = nullptr;
+	for (Node& node : this->nodeArray)
+	{
+		for (auto& object : node.objectArray)
+		{
+			this->SetObjectTree(object, nullptr);
+			object->proxyIndex = -1;
+		}
+	}
+
+	this->nodeArray.clear();
 }
 
-BVHObject* BVHTree::FindNearestObjectHitByRay(const Ray& ray, Vector3& unitSurfaceNormal)
+/*virtual*/ bool SplitBoxBVHTree::UpdateObject(BVHObject* object, bool allowCuts)
 {
-	if (!this->rootNode.Get())
-		return nullptr;
+	if (!this->OwnsObject(object) || object->proxyIndex == -1)
+		return false;
 
-	if (!ray.CastAgainst(this->rootNode->GetWorldBox(), this->rootNode->rayHitInterval))
-		return nullptr;
+	// Keep the object alive while it's out of the tree.
+	Reference<BVHObject> objectRef(object);
 
-	return this->rootNode->FindNearestObjectHitByRay(ray, unitSurfaceNormal);
-}
+	int nodeIndex = object->proxyIndex;
+	this->RemoveObjectFromNode(nodeIndex, object);
+	object->proxyIndex = -1;
 
-void BVHTree::FindObjects(const AxisAlignedBoundingBox& worldBox, std::list<BVHObject*>& objectList)
-{
-	objectList.clear();
-	if (!this->rootNode.Get())
-		return;
+	AxisAlignedBoundingBox worldBoundingBox = object->GetWorldBoundingBox();
 
-	std::list<BVHNode*> queue;
-	queue.push_back(this->rootNode.Get());
-	while (queue.size() > 0)
+	while (nodeIndex != -1)
+	{
+		if (!this->nodeArray[nodeIndex].worldBox.ContainsBox(worldBoundingBox))
+			nodeIndex = this->nodeArray[nodeIndex].parentIndex;
+		else
+			break;
+	}
+	
+	if (nodeIndex == -1)
 	{
-		BVHNode* node = *queue.begin();
-		queue.pop_front();
+		this->SetObjectTree(object, nullptr);
+		return false;
+	}
 
-		AxisAlignedBoundingBox box;
-		if (!box.Intersect(worldBox, node->worldBox))
-			continue;
+	bool wentDeeper = false;
+	while (true)
+	{
+		// Note that growing the node array invalidates any references into it, so we only hold indices here.
+		if (this->nodeArray[nodeIndex].IsLeaf())
+		{
+			int childIndexA = (int)this->nodeArray.size();
+			int childIndexB = childIndexA + 1;
 
-		for (auto object : node->objectList)
-			if (box.Intersect(worldBox, object->GetWorldBoundingBox()))
-				objectList.push_back(object);
+			this->nodeArray.resize(this->nodeArray.size() + 2);
 
-		for (auto& childNode : node->childNodeArray)
-			queue.push_back(childNode.Get());
-	}
-}
+			Node& node = this->nodeArray[nodeIndex];
+			node.worldBox.Split(this->nodeArray[childIndexA].worldBox, this->nodeArray[childIndexB].worldBox);
+			node.childIndex[0] = childIndexA;
+			node.childIndex[1] = childIndexB;
 
-void BVHTree::GatherStats(Stats& stats) const
-{
-	stats.numNodes = 0;
-	stats.numObjects = 0;
-	stats.maxDepth = 0;
+			this->nodeArray[childIndexA].parentIndex = nodeIndex;
+			this->nodeArray[childIndexB].parentIndex = nodeIndex;
+		}
+		
+		wentDeeper = false;
+		for (int childIndex : this->nodeArray[nodeIndex].childIndex)
+		{
+			if (this->nodeArray[childIndex].worldBox.ContainsBox(worldBoundingBox))
+			{
+				nodeIndex = childIndex;
+				wentDeeper = true;
+				break;
+			}
+		}
 
-	if (this->rootNode)
-		this->rootNode->GatherStats(stats, 1);
-}
+		if (wentDeeper)
+			continue;
 
-//---------------------------------------- BVHNode ----------------------------------------
+		if (!allowCuts)
+			break;
 
-BVHNode::BVHNode()
-{
-	this->parentNode = nullptr;
-	this->treeHandle = THEBE_INVALID_REF_HANDLE;
-}
+		int childIndexArray[2] = { this->nodeArray[nodeIndex].childIndex[0], this->nodeArray[nodeIndex].childIndex[1] };
+		for (int childIndex : childIndexArray)
+		{
+			Reference<BVHObject> newObject;
+			if (object->Cut(this->nodeArray[childIndex].worldBox, newObject))
+			{
+				this->SetObjectTree(newObject, this);
+				newObject->proxyIndex = childIndex;
+				if (!this->UpdateObject(newObject, true))
+					return false;
+			}
+		}
 
-/*virtual*/ BVHNode::~BVHNode()
-{
-	this->childNodeArray.clear();
-}
+		this->SetObjectTree(object, nullptr);
+		return true;
+	}
 
-RefHandle BVHNode::GetTreeHandle() const
-{
-	return this->treeHandle;
-}
+	this->AddObjectToNode(nodeIndex, object);
+	object->proxyIndex = nodeIndex;
 
-const AxisAlignedBoundingBox& BVHNode::GetWorldBox() const
-{
-	return this->worldBox;
+	return true;
 }
 
-void BVHNode::GatherStats(BVHTree::Stats& stats, int depth) const
+void SplitBoxBVHTree::AddObjectToNode(int nodeIndex, BVHObject* object)
 {
-	stats.numNodes++;
-	stats.numObjects += this->objectList.size();
-
-	if (depth > stats.maxDepth)
-		stats.maxDepth = depth;
-
-	for (const auto& childNode : this->childNodeArray)
-		childNode->GatherStats(stats, depth + 1);
+	this->nodeArray[nodeIndex].objectArray.push_back(object);
 }
 
-void BVHNode::RemoveObject(BVHObject* object)
+void SplitBoxBVHTree::RemoveObjectFromNode(int nodeIndex, BVHObject* object)
 {
-	for (std::list<Reference<BVHObject>>::iterator iter = this->objectList.begin(); iter != this->objectList.end(); iter++)
+	// The order of objects within a node doesn't matter, so we can just swap the last one into the hole.
+	std::vector<Reference<BVHObject>>& objectArray = this->nodeArray[nodeIndex].objectArray;
+	for (int i = 0; i < (int)objectArray.size(); i++)
 	{
-		if ((*iter).Get() == object)
+		if (objectArray[i].Get() == object)
 		{
-			this->objectList.erase(iter);
+			if (i != (int)objectArray.size() - 1)
+				objectArray[i] = objectArray.back();
+
+			objectArray.pop_back();
 			break;
 		}
 	}
 }
 
-void BVHNode::AddObject(BVHObject* object)
+/*virtual*/ BVHObject* SplitBoxBVHTree::FindNearestObjectHitByRay(const Ray& ray, double& alpha, Vector3& unitSurfaceNormal)
 {
-	this->objectList.push_back(object);
+	if (this->nodeArray.size() == 0)
+		return nullptr;
+
+	if (!ray.CastAgainst(this->nodeArray[0].worldBox, this->nodeArray[0].rayHitInterval))
+		return nullptr;
+
+	BVHObject* nearestHitObject = this->FindNearestObjectHitByRay(0, ray, unitSurfaceNormal);
+	if (nearestHitObject)
+		alpha = nearestHitObject->rayObjectHitDistance;
+
+	return nearestHitObject;
 }
 
-BVHObject* BVHNode::FindNearestObjectHitByRay(const Ray& ray, Vector3& unitSurfaceNormal)
+BVHObject* SplitBoxBVHTree::FindNearestObjectHitByRay(int nodeIndex, const Ray& ray, Vector3& unitSurfaceNormal)
 {
 	// Here we operate on the principles that 1) we already know that the given ray hits or originates
 	// in this node's box/space, and 2) that this node's children form a pair-wise disjoint set of boxes.
+	Node& node = this->nodeArray[nodeIndex];
 
 	// First, gather the child nodes hit by or containing the origin of the given ray.
-	std::vector<BVHNode*> hitChildNodeArray;
-	for (BVHNode* node : this->childNodeArray)
-		if (ray.CastAgainst(node->GetWorldBox(), node->rayHitInterval))
-			hitChildNodeArray.push_back(node);
+	int hitChildIndexArray[2];
+	int numHitChildren = 0;
+	if (!node.IsLeaf())
+	{
+		for (int childIndex : node.childIndex)
+		{
+			Node& childNode = this->nodeArray[childIndex];
+			if (ray.CastAgainst(childNode.worldBox, childNode.rayHitInterval))
+				hitChildIndexArray[numHitChildren++] = childIndex;
+		}
+	}
 
 	// Next, sort the sub-spaces by nearest to farthest hit.
-	std::sort(hitChildNodeArray.begin(), hitChildNodeArray.end(), [](const BVHNode* nodeA, const BVHNode* nodeB) -> bool
-		{
-			return nodeA->rayHitInterval.A < nodeB->rayHitInterval.A;
-		});
+	if (numHitChildren == 2 && this->nodeArray[hitChildIndexArray[1]].rayHitInterval.A < this->nodeArray[hitChildIndexArray[0]].rayHitInterval.A)
+		std::swap(hitChildIndexArray[0], hitChildIndexArray[1]);
 
 	// Now process the nodes in the sorted order.  By virtue of the order, if we get a hit,
 	// this allows us to early-out of the loop, there-by culling branches of the tree.
 	BVHObject* nearestHitObject = nullptr;
-	for (BVHNode* node : hitChildNodeArray)
+	for (int i = 0; i < numHitChildren; i++)
 	{
-		nearestHitObject = node->FindNearestObjectHitByRay(ray, unitSurfaceNormal);
+		nearestHitObject = this->FindNearestObjectHitByRay(hitChildIndexArray[i], ray, unitSurfaceNormal);
 		if (nearestHitObject)
 			break;
 	}
@@ -206,7 +303,7 @@ BVHObject* BVHNode::FindNearestObjectHitByRay(const Ray& ray, Vector3& unitSurfa
 	// to cast a ray against an actual object, gather the objects in this
 	// node's space who's bounds are hit and sort them nearest to farthest.
 	std::vector<BVHObject*> hitObjectBoundsArray;
-	for (BVHObject* object : this->objectList)
+	for (BVHObject* object : node.objectArray)
 		if (ray.CastAgainst(object->GetWorldBoundingBox(), object->rayBoundsHitInterval))
 			hitObjectBoundsArray.push_back(object);
 	std::sort(hitObjectBoundsArray.begin(), hitObjectBoundsArray.end(), [](const BVHObject* objectA, const BVHObject* objectB) -> bool
@@ -236,115 +333,255 @@ BVHObject* BVHNode::FindNearestObjectHitByRay(const Ray& ray, Vector3& unitSurfa
 	return nearestHitObject;
 }
 
-//---------------------------------------- BVHObject ----------------------------------------
+/*virtual*/ void SplitBoxBVHTree::FindObjects(const AxisAlignedBoundingBox& worldBox, std::list<BVHObject*>& objectList) const
+{
+	objectList.clear();
+	if (this->nodeArray.size() == 0)
+		return;
 
-BVHObject::BVHObject()
+	// Note that the stack is local, rather than our member stack, so that queries can be made from several threads at once.
+	std::vector<int> nodeStack;
+	nodeStack.reserve(64);
+	nodeStack.push_back(0);
+	while (nodeStack.size() > 0)
+	{
+		const Node& node = this->nodeArray[nodeStack.back()];
+		nodeStack.pop_back();
+
+		AxisAlignedBoundingBox box;
+		if (!box.Intersect(worldBox, node.worldBox))
+			continue;
+
+		for (const BVHObject* object : node.objectArray)
+			if (box.Intersect(worldBox, object->GetWorldBoundingBox()))
+				objectList.push_back(const_cast<BVHObject*>(object));
+
+		if (!node.IsLeaf())
+			for (int childIndex : node.childIndex)
+				nodeStack.push_back(childIndex);
+	}
+}
+
+/*virtual*/ void SplitBoxBVHTree::FindObjects(const AxisAlignedBoundingBox& worldBox, std::vector<BVHObject*>& objectArray, const ObjectFilter& objectFilter) const
 {
-	this->nodeHandle = THEBE_INVALID_REF_HANDLE;
-	this->rayObjectHitDistance = 0.0;
+	objectArray.clear();
+	if (this->nodeArray.size() == 0)
+		return;
+
+	std::vector<int> nodeStack;
+	nodeStack.reserve(64);
+	nodeStack.push_back(0);
+	while (nodeStack.size() > 0)
+	{
+		const Node& node = this->nodeArray[nodeStack.back()];
+		nodeStack.pop_back();
+
+		AxisAlignedBoundingBox box;
+		if (!box.Intersect(worldBox, node.worldBox))
+			continue;
+
+		for (const BVHObject* object : node.objectArray)
+			if (box.Intersect(worldBox, object->GetWorldBoundingBox()) && (!objectFilter || objectFilter(object)))
+				objectArray.push_back(const_cast<BVHObject*>(object));
+
+		if (!node.IsLeaf())
+			for (int childIndex : node.childIndex)
+				nodeStack.push_back(childIndex);
+	}
 }
 
-/*virtual*/ BVHObject::~BVHObject()
+/*virtual*/ void SplitBoxBVHTree::FindObjectsHitByRay(const Ray& ray, std::vector<BVHObject*>& objectArray) const
 {
+	objectArray.clear();
+	if (this->nodeArray.size() == 0)
+		return;
+
+	std::vector<int> nodeStack;
+	nodeStack.reserve(64);
+	nodeStack.push_back(0);
+	while (nodeStack.size() > 0)
+	{
+		const Node& node = this->nodeArray[nodeStack.back()];
+		nodeStack.pop_back();
+
+		Interval interval;
+		if (!ray.CastAgainst(node.worldBox, interval))
+			continue;
+
+		for (const BVHObject* object : node.objectArray)
+			if (ray.CastAgainst(object->GetWorldBoundingBox(), interval))
+				objectArray.push_back(const_cast<BVHObject*>(object));
+
+		if (!node.IsLeaf())
+			for (int childIndex : node.childIndex)
+				nodeStack.push_back(childIndex);
+	}
 }
 
-/*virtual*/ bool BVHObject::Cut(const AxisAlignedBoundingBox& box, Reference<BVHObject>& newObject)
+/*virtual*/ void SplitBoxBVHTree::FindAllOverlappingPairs(std::vector<ObjectPair>& pairArray)
 {
-	return false;
+	pairArray.clear();
+	if (this->nodeArray.size() == 0)
+		return;
+
+	// An object can only overlap objects in its own node or in the sub-tree below its node,
+	// because every node's box contains all the boxes of its descendants.  So if each object
+	// only looks at its own node and below, then every overlapping pair is found exactly once.
+	AxisAlignedBoundingBox box;
+	this->nodeQueue.clear();
+	this->nodeQueue.push_back(0);
+	while (this->nodeQueue.size() > 0)
+	{
+		Node& node = this->nodeArray[this->nodeQueue.back()];
+		this->nodeQueue.pop_back();
+
+		if (!node.IsLeaf())
+			for (int childIndex : node.childIndex)
+				this->nodeQueue.push_back(childIndex);
+
+		for (int i = 0; i < (int)node.objectArray.size(); i++)
+		{
+			BVHObject* objectA = node.objectArray[i];
+			AxisAlignedBoundingBox boxA = objectA->GetWorldBoundingBox();
+
+			for (int j = i + 1; j < (int)node.objectArray.size(); j++)
+			{
+				BVHObject* objectB = node.objectArray[j];
+				if (box.Intersect(boxA, objectB->GetWorldBoundingBox()) && this->ShouldPair(objectA, objectB))
+					pairArray.push_back(ObjectPair{ objectA, objectB });
+			}
+
+			if (node.IsLeaf())
+				continue;
+
+			this->nodeStack.clear();
+			for (int childIndex : node.childIndex)
+				this->nodeStack.push_back(childIndex);
+
+			while (this->nodeStack.size() > 0)
+			{
+				Node& subNode = this->nodeArray[this->nodeStack.back()];
+				this->nodeStack.pop_back();
+
+				if (!box.Intersect(boxA, subNode.worldBox))
+					continue;
+
+				for (BVHObject* objectB : subNode.objectArray)
+					if (box.Intersect(boxA, objectB->GetWorldBoundingBox()) && this->ShouldPair(objectA, objectB))
+						pairArray.push_back(ObjectPair{ objectA, objectB });
+
+				if (!subNode.IsLeaf())
+					for (int childIndex : subNode.childIndex)
+						this->nodeStack.push_back(childIndex);
+			}
+		}
+	}
 }
 
-bool BVHObject::GetNode(Reference<BVHNode>& node)
+/*virtual*/ void SplitBoxBVHTree::GatherStats(Stats& stats) const
 {
-	Reference<ReferenceCounted> ref;
-	if (!HandleManager::Get()->GetObjectFromHandle(this->nodeHandle, ref))
-		return false;
+	stats.numNodes = 0;
+	stats.numObjects = 0;
+	stats.maxDepth = 0;
 
-	node.SafeSet(ref);
-	return node.Get() != nullptr;
+	if (this->nodeArray.size() > 0)
+		this->GatherStats(0, stats, 1);
 }
 
-void BVHObject::SetNode(BVHNode* node)
+void SplitBoxBVHTree::GatherStats(int nodeIndex, Stats& stats, int depth) const
 {
-	this->nodeHandle = node ? node->GetHandle() : THEBE_INVALID_REF_HANDLE;
+	const Node& node = this->nodeArray[nodeIndex];
+
+	stats.numNodes++;
+	stats.numObjects += (int)node.objectArray.size();
+
+	if (depth > stats.maxDepth)
+		stats.maxDepth = depth;
+
+	if (!node.IsLeaf())
+		for (int childIndex : node.childIndex)
+			this->GatherStats(childIndex, stats, depth + 1);
 }
 
-bool BVHObject::IsInBVH() const
+//---------------------------------------- SplitBoxBVHTree::Node ----------------------------------------
+
+SplitBoxBVHTree::Node::Node()
 {
-	return this->nodeHandle != THEBE_INVALID_REF_HANDLE;
+	this->parentIndex = -1;
+	this->childIndex[0] = -1;
+	this->childIndex[1] = -1;
 }
 
-bool BVHObject::UpdateBVHLocation(bool allowCuts /*= false*/)
+bool SplitBoxBVHTree::Node::IsLeaf() const
 {
-	Reference<BVHNode> node;
-	if (!this->GetNode(node))
-		return false;
+	return this->childIndex[0] == -1;
+}
+
+//---------------------------------------- BVHObject ----------------------------------------
 
-	node->RemoveObject(this);
-	this->SetNode(nullptr);
+BVHObject::BVHObject()
+{
+	this->tree = nullptr;
+	this->proxyIndex = -1;
+	this->rayObjectHitDistance = 0.0;
+	this->categoryBits = THEBE_ALL_CATEGORY_BITS;
+	this->maskBits = THEBE_ALL_CATEGORY_BITS;
+	this->atRest = false;
+}
 
-	AxisAlignedBoundingBox worldBoundingBox = this->GetWorldBoundingBox();
+/*virtual*/ BVHObject::~BVHObject()
+{
+}
 
-	while (node.Get())
-	{
-		if (!node->worldBox.ContainsBox(worldBoundingBox))
-			node = node->parentNode;
-		else
-			break;
-	}
-	
-	if (!node.Get())
-		return false;
+void BVHObject::SetCategoryBits(uint32_t categoryBits)
+{
+	this->categoryBits = categoryBits;
+}
 
-	bool wentDeeper = false;
-	while (true)
-	{
-		if (node->childNodeArray.size() == 0)
-		{
-			auto nodeA = new BVHNode();
-			auto nodeB = new BVHNode();
+uint32_t BVHObject::GetCategoryBits() const
+{
+	return this->categoryBits;
+}
 
-			node->worldBox.Split(nodeA->worldBox, nodeB->worldBox);
+void BVHObject::SetMaskBits(uint32_t maskBits)
+{
+	this->maskBits = maskBits;
+}
 
-			node->childNodeArray.push_back(nodeA);
-			node->childNodeArray.push_back(nodeB);
+uint32_t BVHObject::GetMaskBits() const
+{
+	return this->maskBits;
+}
 
-			nodeA->parentNode = node.Get();
-			nodeB->parentNode = node.Get();
-		}
-		
-		wentDeeper = false;
-		for (auto& childNode : node->childNodeArray)
-		{
-			if (childNode->worldBox.ContainsBox(worldBoundingBox))
-			{
-				node = childNode;
-				wentDeeper = true;
-				break;
-			}
-		}
+bool BVHObject::CanPairWith(const BVHObject* object) const
+{
+	return (this->categoryBits & object->maskBits) != 0 && (object->categoryBits & this->maskBits) != 0;
+}
 
-		if (wentDeeper)
-			continue;
+void BVHObject::SetAtRest(bool atRest)
+{
+	this->atRest = atRest;
+}
 
-		if (!allowCuts)
-			break;
+bool BVHObject::IsAtRest() const
+{
+	return this->atRest;
+}
 
-		for (auto& childNode : node->childNodeArray)
-		{
-			Reference<BVHObject> newObject;
-			if (this->Cut(childNode->worldBox, newObject))
-			{
-				newObject->SetNode(childNode);
-				if (!newObject->UpdateBVHLocation(true))
-					return false;
-			}
-		}
+/*virtual*/ bool BVHObject::Cut(const AxisAlignedBoundingBox& box, Reference<BVHObject>& newObject)
+{
+	return false;
+}
 
-		return true;
-	}
+bool BVHObject::IsInBVH() const
+{
+	return this->tree != nullptr;
+}
 
-	node->AddObject(this);
-	this->SetNode(node);
+bool BVHObject::UpdateBVHLocation(bool allowCuts /*= false*/)
+{
+	if (!this->tree)
+		return false;
 
-	return true;
+	return this->tree->UpdateObject(this, allowCuts);
 }
\ No newline at end of file
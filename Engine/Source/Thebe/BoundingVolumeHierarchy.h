@@ -4,10 +4,13 @@
 #include "Thebe/Math/Transform.h"
 #include "Thebe/Math/Ray.h"
 #include "Thebe/Reference.h"
+#include <functional>
+#include <span>
+
+#define THEBE_ALL_CATEGORY_BITS		0xFFFFFFFF
 
 namespace Thebe
 {
-	class BVHNode;
 	class BVHObject;
 
 	/**
@@ -15,6 +18,12 @@ namespace Thebe
 	 * Its primary use is to spatially partition a bunch of objects
 	 * in space to accelerate the task of termining what objects, if
 	 * any, overlap a given bounding box.
+	 * 
+	 * This class only defines the interface of such a tree.  See
+	 * @ref SplitBoxBVHTree and @ref DynamicBVHTree for implementations.
+	 * In either case, objects are required to stay within the world box
+	 * of the tree.  An object that leaves the world box is removed from
+	 * the tree, and @ref BVHObject::UpdateBVHLocation returns false.
 	 */
 	class THEBE_API BVHTree : public ReferenceCounted
 	{
@@ -25,11 +34,119 @@ namespace Thebe
 		void SetWorldBox(const AxisAlignedBoundingBox& worldBox);
 		const AxisAlignedBoundingBox& GetWorldBox() const;
 
-		bool AddObject(BVHObject* object);
-		bool RemoveObject(BVHObject* object);
-		void RemoveAllObjects();
-		void FindObjects(const AxisAlignedBoundingBox& worldBox, std::list<BVHObject*>& objectList);
-		BVHObject* FindNearestObjectHitByRay(const Ray& ray, Vector3& unitSurfaceNormal);
+		/**
+		 * Insert the given object into this tree.  The object must not already be in a tree.
+		 */
+		virtual bool AddObject(BVHObject* object) = 0;
+
+		/**
+		 * Remove the given object from this tree.  The object must be in this tree.
+		 */
+		virtual bool RemoveObject(BVHObject* object) = 0;
+
+		/**
+		 * Remove all objects from this tree.
+		 */
+		virtual void RemoveAllObjects() = 0;
+
+		/**
+		 * Re-locate the given object within this tree after its world bounding box has changed.
+		 * This is what @ref BVHObject::UpdateBVHLocation calls.  If false is returned, then
+		 * the object is no longer in the tree.
+		 */
+		virtual bool UpdateObject(BVHObject* object, bool allowCuts) = 0;
+
+		/**
+		 * Find all objects in this tree whose bounding boxes overlap the given box.
+		 * This doesn't modify the tree, so it may be called from any number of threads
+		 * at once, as long as no thread is modifying the tree meanwhile.
+		 */
+		virtual void FindObjects(const AxisAlignedBoundingBox& worldBox, std::list<BVHObject*>& objectList) const = 0;
+
+		typedef std::function<bool(const BVHObject* object)> ObjectFilter;
+
+		/**
+		 * Find all objects in this tree whose bounding boxes overlap the given box, and which the given filter
+		 * accepts.  The filter is checked as the tree is traversed, as each overlapping object is reached, so
+		 * rejected objects are never gathered at all.  This has the same thread-safety guarantees as the other
+		 * @ref FindObjects, as long as the filter does.
+		 *
+		 * @param[out] objectArray This is cleared and then populated with the objects found, in no particular order.
+		 * @param[in] objectFilter Return false from this to have the given object left out.  If null, nothing is left out.
+		 */
+		virtual void FindObjects(const AxisAlignedBoundingBox& worldBox, std::vector<BVHObject*>& objectArray, const ObjectFilter& objectFilter) const = 0;
+
+		/**
+		 * Find all objects in this tree whose bounding boxes are hit by the given ray.
+		 * Unlike @ref FindNearestObjectHitByRay, the ray is not cast against the objects
+		 * themselves, and the tree is not modified, so this may be called from any number
+		 * of threads at once, as long as no thread is modifying the tree meanwhile.
+		 *
+		 * @param[out] objectArray This is cleared and then populated with the objects found, in no particular order.
+		 */
+		virtual void FindObjectsHitByRay(const Ray& ray, std::vector<BVHObject*>& objectArray) const = 0;
+
+		/**
+		 * Find the object nearest the origin of the given ray among those the ray hits, if any.
+		 *
+		 * @param[out] alpha This is set to the distance along the ray to the hit, if any; left alone, if no object is hit.
+		 * @param[out] unitSurfaceNormal This is set to the surface normal of the object at the hit, if any; left alone, if no object is hit.
+		 */
+		virtual BVHObject* FindNearestObjectHitByRay(const Ray& ray, double& alpha, Vector3& unitSurfaceNormal) = 0;
+
+		struct RayHit
+		{
+			BVHObject* object;			///< This is the nearest object hit by the ray, or null if the ray hits nothing.
+			double alpha;				///< This is the distance along the ray to the hit, if any.
+			Vector3 unitSurfaceNormal;	///< This is the surface normal of the object at the hit, if any.
+		};
+
+		/**
+		 * Cast many rays at once, finding for each the nearest object it hits, exactly as
+		 * @ref FindNearestObjectHitByRay would.  Implementations may trace neighboring rays
+		 * together as a packet, so rays that start near one another and point in similar
+		 * directions (e.g., those through neighboring pixels) should be neighbors in the given array.
+		 * The base implementation here just casts the rays one at a time.
+		 *
+		 * @param[in] rayArray These are the rays to cast.
+		 * @param[out] rayHitArray The result for each ray is written here at the same index as the ray.  This must be at least as big as the ray array.
+		 */
+		virtual void CastRays(std::span<const Ray> rayArray, std::span<RayHit> rayHitArray);
+
+		struct ObjectPair
+		{
+			BVHObject* objectA;
+			BVHObject* objectB;
+		};
+
+		/**
+		 * Find all pairs of objects in this tree whose bounding boxes overlap one another.
+		 * Each such pair is reported exactly once, and in no particular order.  Pairs are
+		 * left out if the objects' category and mask bits say they don't pair (see
+		 * @ref BVHObject::CanPairWith) or if the pair filter rejects them.  This is
+		 * checked as the tree is traversed, so rejected pairs cost next to nothing.
+		 * 
+		 * @param[out] pairArray This is cleared and then populated with the overlapping pairs.
+		 */
+		virtual void FindAllOverlappingPairs(std::vector<ObjectPair>& pairArray) = 0;
+
+		typedef std::function<bool(const BVHObject* objectA, const BVHObject* objectB)> PairFilter;
+
+		/**
+		 * Set a function to be called on each pair of overlapping objects that passes the category
+		 * and mask bits check before it is reported by @ref FindAllOverlappingPairs.  Return false
+		 * from it to have the pair left out.  Pass null to remove the filter.
+		 */
+		void SetPairFilter(PairFilter pairFilter);
+
+		typedef std::function<void(BVHObject* objectA, BVHObject* objectB)> PairCallback;
+
+		/**
+		 * Implementations that maintain a persistent set of overlapping pairs, such
+		 * as @ref SweepAndPrune, call these whenever a pair begins or ends overlapping.
+		 * Other implementations never call them.
+		 */
+		void SetPairCallbacks(PairCallback pairAddedCallback, PairCallback pairRemovedCallback);
 
 		struct Stats
 		{
@@ -38,43 +155,80 @@ namespace Thebe
 			int maxDepth;
 		};
 
-		void GatherStats(Stats& stats) const;
+		virtual void GatherStats(Stats& stats) const = 0;
+
+	protected:
+		/**
+		 * Tell us if the given object is currently a member of this tree.
+		 */
+		bool OwnsObject(const BVHObject* object) const;
+
+		/**
+		 * Make the given object a member of this tree, or no tree at all.
+		 */
+		void SetObjectTree(BVHObject* object, BVHTree* tree);
+
+		/**
+		 * Tell us if the given pair of objects should be reported by @ref FindAllOverlappingPairs.  Pairs of objects at rest never are.
+		 */
+		bool ShouldPair(const BVHObject* objectA, const BVHObject* objectB) const;
 
-	private:
-		Reference<BVHNode> rootNode;
 		AxisAlignedBoundingBox worldBox;
+		PairFilter pairFilter;
+		PairCallback pairAddedCallback;
+		PairCallback pairRemovedCallback;
 	};
 
 	/**
-	 * These are the nodes of the BVH.
+	 * This tree recursively splits the world box in half, pushing each object
+	 * as deep into the tree as it will go while still fitting in a node's box.
+	 * Objects that straddle a split plane get stuck at the higher node.  This
+	 * works well enough for static or sparse scenes.
+	 *
+	 * All nodes live in a contiguous pool and refer to one another by index.
+	 * Nodes are never freed individually (the split boxes are fixed), so an
+	 * object just remembers the index of the node it's in.
 	 */
-	class THEBE_API BVHNode : public ReferenceCounted
+	class THEBE_API SplitBoxBVHTree : public BVHTree
 	{
-		friend class BVHTree;
-		friend class BVHObject;
-
 	public:
-		BVHNode();
-		virtual ~BVHNode();
+		SplitBoxBVHTree();
+		virtual ~SplitBoxBVHTree();
 
-		RefHandle GetTreeHandle() const;
-		const AxisAlignedBoundingBox& GetWorldBox() const;
+		virtual bool AddObject(BVHObject* object) override;
+		virtual bool RemoveObject(BVHObject* object) override;
+		virtual void RemoveAllObjects() override;
+		virtual bool UpdateObject(BVHObject* object, bool allowCuts) override;
+		virtual void FindObjects(const AxisAlignedBoundingBox& worldBox, std::list<BVHObject*>& objectList) const override;
+		virtual void FindObjects(const AxisAlignedBoundingBox& worldBox, std::vector<BVHObject*>& objectArray, const ObjectFilter& objectFilter) const override;
+		virtual void FindObjectsHitByRay(const Ray& ray, std::vector<BVHObject*>& objectArray) const override;
+		virtual BVHObject* FindNearestObjectHitByRay(const Ray& ray, double& alpha, Vector3& unitSurfaceNormal) override;
+		virtual void FindAllOverlappingPairs(std::vector<ObjectPair>& pairArray) override;
+		virtual void GatherStats(Stats& stats) const override;
 
-		void RemoveObject(BVHObject* object);
-		void AddObject(BVHObject* object);
+	private:
 
-		BVHObject* FindNearestObjectHitByRay(const Ray& ray, Vector3& unitSurfaceNormal);
+		struct Node
+		{
+			Node();
 
-		Interval rayHitInterval;
+			bool IsLeaf() const;
 
-		void GatherStats(BVHTree::Stats& stats, int depth) const;
+			AxisAlignedBoundingBox worldBox;
+			std::vector<Reference<BVHObject>> objectArray;
+			int parentIndex;
+			int childIndex[2];
+			Interval rayHitInterval;
+		};
 
-	private:
-		std::list<Reference<BVHObject>> objectList;
-		BVHNode* parentNode;
-		std::vector<Reference<BVHNode>> childNodeArray;
-		RefHandle treeHandle;
-		AxisAlignedBoundingBox worldBox;
+		void AddObjectToNode(int nodeIndex, BVHObject* object);
+		void RemoveObjectFromNode(int nodeIndex, BVHObject* object);
+		BVHObject* FindNearestObjectHitByRay(int nodeIndex, const Ray& ray, Vector3& unitSurfaceNormal);
+		void GatherStats(int nodeIndex, Stats& stats, int depth) const;
+
+		std::vector<Node> nodeArray;
+		std::vector<int> nodeQueue;
+		std::vector<int> nodeStack;
 	};
 
 	/**
@@ -83,7 +237,9 @@ namespace Thebe
 	class THEBE_API BVHObject : virtual public ReferenceCounted
 	{
 		friend class BVHTree;
-		friend class BVHNode;
+		friend class SplitBoxBVHTree;
+		friend class DynamicBVHTree;
+		friend class SweepAndPrune;
 
 	public:
 		BVHObject();
@@ -114,6 +270,7 @@ namespace Thebe
 		 * 
 		 * If this object is static, cutting it into peices so that it
 		 * can be pushed deeper into the tree may improve query performance.
+		 * Only the @ref SplitBoxBVHTree makes use of cuts.
 		 */
 		bool UpdateBVHLocation(bool allowCuts = false);
 
@@ -133,13 +290,40 @@ namespace Thebe
 		 */
 		virtual bool RayCast(const Ray& ray, double& alpha, Vector3& unitSurfaceNormal) const = 0;
 
-	private:
+		/**
+		 * These say which categories (or layers) this object is in.  By default, an object is in all of them.
+		 */
+		void SetCategoryBits(uint32_t categoryBits);
+		uint32_t GetCategoryBits() const;
 
-		bool GetNode(Reference<BVHNode>& node);
-		void SetNode(BVHNode* Node);
+		/**
+		 * These say which categories of objects this object can pair with.  By default, it can pair with all of them.
+		 */
+		void SetMaskBits(uint32_t maskBits);
+		uint32_t GetMaskBits() const;
+
+		/**
+		 * Tell us if this object and the given object can pair with one another, which they
+		 * can if and only if each is in a category that the other can pair with.
+		 */
+		bool CanPairWith(const BVHObject* object) const;
+
+		/**
+		 * Two objects at rest can't come to overlap one another, so pairs of such objects are never
+		 * reported by @ref BVHTree::FindAllOverlappingPairs.  It's up to whatever moves the objects
+		 * to say which ones it won't be moving.  By default, an object isn't at rest.
+		 */
+		void SetAtRest(bool atRest);
+		bool IsAtRest() const;
+
+	private:
 
-		RefHandle nodeHandle;
+		BVHTree* tree;		///< This is the tree we're in, if any.  It's not a reference, because the tree clears it before we could ever out-live the tree.
+		int proxyIndex;		///< Trees that keep their own per-object records (e.g., leaves or nodes) can store the index of that record here.
 		double rayObjectHitDistance;
 		Interval rayBoundsHitInterval;
+		uint32_t categoryBits;
+		uint32_t maskBits;
+		bool atRest;
 	};
 }
\ No newline at end of file
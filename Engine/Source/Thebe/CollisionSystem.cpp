@@ -1,25 +1,60 @@
 #include "Thebe/CollisionSystem.h"
+#include "Thebe/DynamicBoundingVolumeHierarchy.h"
+#include "Thebe/SweepAndPrune.h"
 #include "Thebe/EngineParts/CollisionObject.h"
 #include "Thebe/EngineParts/DynamicLineRenderer.h"
 #include "Thebe/Log.h"
 #include "Thebe/Profiler.h"
 #include "Thebe/ImGuiManager.h"
+#include "Thebe/Utilities/WorkerPool.h"
+#include "Thebe/Math/TriangleMeshShape.h"
+#include "Thebe/Math/GJKCompoundShape.h"
+#include <algorithm>
 
 using namespace Thebe;
 
 //--------------------------------- CollisionSystem ---------------------------------
 
-CollisionSystem::CollisionSystem()
+CollisionSystem::CollisionSystem(BroadphaseType broadphaseType /*= BroadphaseType::DYNAMIC_AABB_TREE*/)
 {
-	this->boxTree.Set(new BVHTree());
+	this->broadphaseType = broadphaseType;
+
+	switch (broadphaseType)
+	{
+		case BroadphaseType::SPLIT_BOX_TREE:
+			this->boxTree.Set(new SplitBoxBVHTree());
+			break;
+		case BroadphaseType::SWEEP_AND_PRUNE:
+			this->boxTree.Set(new SweepAndPrune());
+			break;
+		case BroadphaseType::DYNAMIC_AABB_TREE:
+		default:
+			this->boxTree.Set(new DynamicBVHTree());
+			break;
+	}
+
+	this->boxTree->SetPairCallbacks(
+		[this](BVHObject* objectA, BVHObject* objectB) { this->HandlePairAdded(objectA, objectB); },
+		[this](BVHObject* objectA, BVHObject* objectB) { this->HandlePairRemoved(objectA, objectB); });
+
+	this->queryNumber = 0;
 	this->collisionWindowCookie = 0;
+	this->narrowphaseBufferArray.resize(1);
 }
 
 /*virtual*/ CollisionSystem::~CollisionSystem()
 {
+	if (this->workerPool)
+		this->workerPool->Shutdown();
+
 	this->boxTree = nullptr;
 }
 
+CollisionSystem::BroadphaseType CollisionSystem::GetBroadphaseType() const
+{
+	return this->broadphaseType;
+}
+
 void CollisionSystem::SetWorldBox(const AxisAlignedBoundingBox& worldBox)
 {
 	this->boxTree->SetWorldBox(worldBox);
@@ -71,6 +106,11 @@ bool CollisionSystem::UntrackObject(CollisionObject* collisionObject)
 
 	this->collisionObjectMap.erase(collisionObject->GetHandle());
 
+	// Don't let the cache keep the object alive, nor hold on to records that can never be found again.
+	this->collisionCacheMap.RemoveIf([collisionObject](const Collision* collision) {
+		return collision->objectA.Get() == collisionObject || collision->objectB.Get() == collisionObject;
+	});
+
 	return true;
 }
 
@@ -78,6 +118,80 @@ void CollisionSystem::UntrackAllObjects()
 {
 	this->collisionObjectMap.clear();
 	this->boxTree->RemoveAllObjects();
+	this->collisionCacheMap.Clear();
+}
+
+bool CollisionSystem::SetNarrowphaseThreadCount(int threadCount)
+{
+	if (threadCount < 1)
+	{
+		THEBE_LOG("Narrow phase thread count must be at least one, not %d.", threadCount);
+		return false;
+	}
+
+	if (threadCount == this->GetNarrowphaseThreadCount())
+		return true;
+
+	if (threadCount == 1)
+		this->workerPool.reset();
+	else
+	{
+		if (!this->workerPool)
+			this->workerPool = std::make_unique<WorkerPool>();
+
+		if (!this->workerPool->Startup(threadCount))
+		{
+			THEBE_LOG("Failed to start narrow phase worker pool with %d threads.", threadCount);
+			this->workerPool.reset();
+			this->narrowphaseBufferArray.resize(1);
+			return false;
+		}
+	}
+
+	this->narrowphaseBufferArray.resize(threadCount);
+	return true;
+}
+
+int CollisionSystem::GetNarrowphaseThreadCount() const
+{
+	return this->workerPool ? this->workerPool->GetNumThreads() : 1;
+}
+
+WorkerPool* CollisionSystem::GetWorkerPool()
+{
+	return this->workerPool.get();
+}
+
+bool CollisionSystem::HasPersistentPairs() const
+{
+	return this->broadphaseType == BroadphaseType::SWEEP_AND_PRUNE;
+}
+
+void CollisionSystem::HandlePairAdded(BVHObject* objectA, BVHObject* objectB)
+{
+	auto collisionObjectA = dynamic_cast<CollisionObject*>(objectA);
+	auto collisionObjectB = dynamic_cast<CollisionObject*>(objectB);
+	if (!collisionObjectA || !collisionObjectB)
+		return;
+
+	// The narrow phase is deferred until the pair is actually queried.
+	Reference<Collision> collision(new Collision());
+	collision->objectA = collisionObjectA;
+	collision->objectB = collisionObjectB;
+
+	uint64_t key = PairCache::MakeKey(collisionObjectA, collisionObjectB);
+	this->collisionCacheMap.Insert(key, collision);
+}
+
+void CollisionSystem::HandlePairRemoved(BVHObject* objectA, BVHObject* objectB)
+{
+	auto collisionObjectA = dynamic_cast<CollisionObject*>(objectA);
+	auto collisionObjectB = dynamic_cast<CollisionObject*>(objectB);
+	if (!collisionObjectA || !collisionObjectB)
+		return;
+
+	uint64_t key = PairCache::MakeKey(collisionObjectA, collisionObjectB);
+	this->collisionCacheMap.Remove(key);
 }
 
 bool CollisionSystem::RayCast(const Ray& ray, CollisionObject*& collisionObject, Vector3& unitSurfaceNormal)
@@ -87,89 +201,724 @@ bool CollisionSystem::RayCast(const Ray& ray, CollisionObject*& collisionObject,
 	if (!this->boxTree.Get())
 		return false;
 
-	collisionObject = dynamic_cast<CollisionObject*>(this->boxTree->FindNearestObjectHitByRay(ray, unitSurfaceNormal));
+	double alpha = 0.0;
+	collisionObject = dynamic_cast<CollisionObject*>(this->boxTree->FindNearestObjectHitByRay(ray, alpha, unitSurfaceNormal));
 
 	return collisionObject != nullptr;
 }
 
+bool CollisionSystem::RayCastAll(const Ray& ray, std::vector<RayCastHit>& rayCastHitArray, const QueryFilter& queryFilter /*= QueryFilter()*/) const
+{
+	rayCastHitArray.clear();
+
+	if (!this->boxTree.Get())
+		return false;
+
+	std::vector<BVHObject*> objectArray;
+	this->boxTree->FindObjectsHitByRay(ray, objectArray);
+
+	for (BVHObject* object : objectArray)
+	{
+		if (!this->PassesQueryFilter(object, queryFilter))
+			continue;
+
+		auto collisionObject = static_cast<CollisionObject*>(object);
+
+		RayCastHit rayCastHit;
+		rayCastHit.collisionObject = collisionObject;
+		if (collisionObject->RayCast(ray, rayCastHit.alpha, rayCastHit.unitSurfaceNormal))
+			rayCastHitArray.push_back(rayCastHit);
+	}
+
+	std::sort(rayCastHitArray.begin(), rayCastHitArray.end(), [](const RayCastHit& hitA, const RayCastHit& hitB) {
+		return hitA.alpha < hitB.alpha;
+	});
+
+	return rayCastHitArray.size() > 0;
+}
+
+/*static*/ bool CollisionSystem::MakeQueryParts(const GJKShape* shape, std::vector<GJKTransformedShape>& partArray)
+{
+	partArray.clear();
+
+	if (dynamic_cast<const TriangleMeshShape*>(shape))
+	{
+		THEBE_LOG("Triangle meshes can't be used to query the collision system.");
+		return false;
+	}
+
+	auto compoundShape = dynamic_cast<const GJKCompoundShape*>(shape);
+	if (compoundShape)
+	{
+		partArray.resize(compoundShape->GetNumChildren());
+		for (int i = 0; i < compoundShape->GetNumChildren(); i++)
+		{
+			const GJKCompoundShape::Child& child = compoundShape->GetChild(i);
+			partArray[i].SetShape(child.shape, child.childToObject);
+		}
+	}
+	else
+	{
+		partArray.resize(1);
+		partArray[0].SetShape(shape, Transform());
+	}
+
+	return true;
+}
+
+bool CollisionSystem::OverlapShape(const GJKShape* shape, const Transform& objectToWorld, std::vector<CollisionObject*>& collisionObjectArray, const QueryFilter& queryFilter /*= QueryFilter()*/) const
+{
+	collisionObjectArray.clear();
+
+	if (!shape || !this->boxTree.Get())
+		return false;
+
+	std::vector<GJKTransformedShape> partArray;
+	if (!MakeQueryParts(shape, partArray) || partArray.size() == 0)
+		return false;
+
+	AxisAlignedBoundingBox worldBox;
+	for (int i = 0; i < (signed)partArray.size(); i++)
+	{
+		partArray[i].SetObjectToWorld(objectToWorld);
+		if (i == 0)
+			worldBox = partArray[i].GetWorldBoundingBox();
+		else
+			worldBox.Expand(partArray[i].GetWorldBoundingBox());
+	}
+
+	std::vector<BVHObject*> objectArray;
+	this->FindFilteredObjects(worldBox, queryFilter, objectArray);
+
+	for (BVHObject* object : objectArray)
+	{
+		auto collisionObject = static_cast<CollisionObject*>(object);
+
+		for (const GJKTransformedShape& part : partArray)
+		{
+			if (ShapesIntersect(&part, collisionObject->GetShape()))
+			{
+				collisionObjectArray.push_back(collisionObject);
+				break;
+			}
+		}
+	}
+
+	return collisionObjectArray.size() > 0;
+}
+
+bool CollisionSystem::SweepShape(const GJKShape* shape, const Transform& startObjectToWorld, const Transform& endObjectToWorld, SweepHit& sweepHit, const QueryFilter& queryFilter /*= QueryFilter()*/) const
+{
+	if (!shape)
+		return false;
+
+	std::vector<GJKTransformedShape> partArray;
+	if (!MakeQueryParts(shape, partArray))
+		return false;
+
+	double boundingRadius = CalcBoundingRadius(shape);
+
+	// We know nothing of how round the shape is, so assume the worst about how fast turning can bring its surface closer to things.
+	// The parts all turn about the origin of the whole shape, so this bounds each of them as well.
+	SweptMotion motion;
+	motion.SetFromTransforms(startObjectToWorld, endObjectToWorld);
+	motion.rotationalRadius = boundingRadius;
+	motion.tolerance = THEBE_MAX(1e-3 * boundingRadius, 1e-6);
+
+	std::vector<BVHObject*> objectArray;
+	this->FindFilteredObjects(motion.CalcSweptBox(boundingRadius), queryFilter, objectArray);
+
+	bool hitFound = false;
+
+	for (BVHObject* object : objectArray)
+	{
+		auto collisionObject = static_cast<CollisionObject*>(object);
+
+		for (GJKTransformedShape& part : partArray)
+		{
+			double timeOfImpact = 0.0;
+			Vector3 unitSurfaceNormal;
+
+			part.SetObjectToWorld(startObjectToWorld);
+			if (ShapesIntersect(&part, collisionObject->GetShape()))
+			{
+				unitSurfaceNormal = -motion.linearDelta;
+				if (!unitSurfaceNormal.Normalize())
+					unitSurfaceNormal.SetComponents(0.0, 0.0, 0.0);
+			}
+			else if (!CalculateTimeOfImpact(&part, motion, collisionObject->GetShape(), timeOfImpact, unitSurfaceNormal))
+				continue;
+
+			if (!hitFound || timeOfImpact < sweepHit.timeOfImpact)
+			{
+				sweepHit.collisionObject = collisionObject;
+				sweepHit.timeOfImpact = timeOfImpact;
+				sweepHit.unitSurfaceNormal = unitSurfaceNormal;
+				hitFound = true;
+			}
+		}
+	}
+
+	return hitFound;
+}
+
+/*static*/ bool CollisionSystem::CalculateTimeOfImpact(GJKShape* shape, const SweptMotion& motion, const GJKShape* obstacleShape, double& timeOfImpact, Vector3& unitSurfaceNormal)
+{
+	auto meshShape = dynamic_cast<const TriangleMeshShape*>(obstacleShape);
+	if (meshShape)
+	{
+		std::vector<int> triangleArray;
+		meshShape->FindTriangles(motion.CalcSweptBox(CalcBoundingRadius(shape)), triangleArray);
+
+		Vector3 startCenter = motion.startObjectToWorld.TransformPoint(shape->CalcGeometricCenter());
+		bool impactFound = false;
+		GJKTriangle triangle;
+		for (int i : triangleArray)
+		{
+			meshShape->GetTriangle(i, triangle);
+
+			// Triangles are one-sided, so there's nothing to hit coming at one from behind.
+			if (triangle.GetWorldPlane().SignedDistanceTo(startCenter) < 0.0)
+				continue;
+
+			double triangleTimeOfImpact = 0.0;
+			Vector3 triangleSurfaceNormal;
+			if (CalculateTimeOfImpact(shape, motion, &triangle, triangleTimeOfImpact, triangleSurfaceNormal) && (!impactFound || triangleTimeOfImpact < timeOfImpact))
+			{
+				timeOfImpact = triangleTimeOfImpact;
+				unitSurfaceNormal = triangleSurfaceNormal;
+				impactFound = true;
+			}
+		}
+
+		return impactFound;
+	}
+
+	constexpr int maxIterations = 64;
+
+	GJKSimplex simplex;
+	Vector3 unitNormal(0.0, 0.0, 0.0);
+	double alpha = 0.0;
+	for (int i = 0; i < maxIterations; i++)
+	{
+		shape->SetObjectToWorld(motion.Evaluate(alpha));
+
+		Vector3 closestPoint, closestObstaclePoint;
+		double distance = 0.0;
+		bool disjoint = CalculateDistance(shape, obstacleShape, closestPoint, closestObstaclePoint, distance, &simplex);
+		if (disjoint && distance > 0.0)
+			unitNormal = (closestObstaclePoint - closestPoint) / distance;
+
+		if (!disjoint || distance <= motion.tolerance)
+		{
+			if (i == 0)
+				return false;
+
+			timeOfImpact = alpha;
+			unitSurfaceNormal = -unitNormal;
+			return true;
+		}
+
+		// The distance can shrink no faster than this over the course of the motion, so we can safely advance by the distance over this rate.
+		double approachBound = motion.linearDelta.Dot(unitNormal) + motion.rotationAngle * motion.rotationalRadius;
+		if (approachBound <= 0.0)
+			return false;
+
+		alpha += (distance - motion.tolerance / 2.0) / approachBound;
+		if (alpha >= 1.0)
+			return false;
+	}
+
+	// We're not converging, but we know we're clear up to here, so stopping here is safe.
+	timeOfImpact = alpha;
+	unitSurfaceNormal = -unitNormal;
+	return true;
+}
+
+void CollisionSystem::FindObjectsInBox(const AxisAlignedBoundingBox& worldBox, std::vector<CollisionObject*>& collisionObjectArray, const QueryFilter& queryFilter /*= QueryFilter()*/) const
+{
+	collisionObjectArray.clear();
+
+	std::vector<BVHObject*> objectArray;
+	this->FindFilteredObjects(worldBox, queryFilter, objectArray);
+
+	for (BVHObject* object : objectArray)
+		collisionObjectArray.push_back(static_cast<CollisionObject*>(object));
+}
+
+bool CollisionSystem::PassesQueryFilter(const BVHObject* object, const QueryFilter& queryFilter) const
+{
+	auto collisionObject = dynamic_cast<const CollisionObject*>(object);
+	if (!collisionObject)
+		return false;
+
+	if (!queryFilter.queryObject)
+		return (queryFilter.categoryBits & collisionObject->GetMaskBits()) != 0 && (collisionObject->GetCategoryBits() & queryFilter.maskBits) != 0;
+
+	if (collisionObject == queryFilter.queryObject || !queryFilter.queryObject->CanPairWith(collisionObject))
+		return false;
+
+	return !this->pairFilter || this->pairFilter(queryFilter.queryObject, collisionObject);
+}
+
+void CollisionSystem::FindFilteredObjects(const AxisAlignedBoundingBox& worldBox, const QueryFilter& queryFilter, std::vector<BVHObject*>& objectArray) const
+{
+	objectArray.clear();
+
+	if (!this->boxTree.Get())
+		return;
+
+	this->boxTree->FindObjects(worldBox, objectArray, [this, &queryFilter](const BVHObject* object) -> bool
+		{
+			return this->PassesQueryFilter(object, queryFilter);
+		});
+}
+
 void CollisionSystem::FindAllCollisions(CollisionObject* collisionObject, std::vector<Reference<Collision>>& collisionArray)
 {
 	collisionArray.clear();
 
-	// Peform the broad phase of collision detection.
-	std::list<BVHObject*> objectList;
+	this->queryNumber++;
+
+	// Peform the broad phase of collision detection.  Objects the given one doesn't pair with are skipped as the tree is traversed.
 	AxisAlignedBoundingBox worldBoundingBox = collisionObject->GetWorldBoundingBox();
 	{
 		THEBE_PROFILE_BLOCK(BVHSearch);
-		this->boxTree->FindObjects(worldBoundingBox, objectList);
+		this->FindFilteredObjects(worldBoundingBox, QueryFilter(collisionObject), this->foundObjectArray);
 	}
 
+	this->candidateArray.clear();
+	for (BVHObject* object : this->foundObjectArray)
+		this->candidateArray.push_back(NarrowphaseCandidate{ collisionObject, static_cast<CollisionObject*>(object) });
+
 	// Now perform the narrow phase of collision detection.
-	for (auto object : objectList)
+	this->RunNarrowphase(collisionArray);
+
+	// A query like this one doesn't visit every pair, so a pair not found this time may well be found by the next query of another object.
+	// Evict only records that have gone unused for a while, and spread the cost of doing so across queries.  The age limit is in queries,
+	// so it scales with the number of objects, which is about how many queries it takes to look at every object once.
+	if (!this->HasPersistentPairs())
+	{
+		uint64_t maxAge = THEBE_MAX(uint64_t(64), 2 * uint64_t(this->collisionObjectMap.size()));
+		size_t numSlots = 2 * this->candidateArray.size() + 16;
+		this->collisionCacheMap.RemoveIfIncrementally([this, maxAge](const Collision* collision) {
+			return this->queryNumber - collision->lastQueryNumber > maxAge;
+		}, numSlots);
+	}
+}
+
+void CollisionSystem::SetPairFilter(PairFilter pairFilter)
+{
+	this->pairFilter = pairFilter;
+
+	if (!pairFilter)
+		this->boxTree->SetPairFilter(nullptr);
+	else
+	{
+		this->boxTree->SetPairFilter([pairFilter](const BVHObject* objectA, const BVHObject* objectB) -> bool
+			{
+				auto collisionObjectA = dynamic_cast<const CollisionObject*>(objectA);
+				auto collisionObjectB = dynamic_cast<const CollisionObject*>(objectB);
+				if (!collisionObjectA || !collisionObjectB)
+					return true;
+
+				return pairFilter(collisionObjectA, collisionObjectB);
+			});
+	}
+}
+
+void CollisionSystem::FindAllOverlappingPairs(std::vector<Reference<Collision>>& collisionArray, PairFilter pairFilter /*= nullptr*/)
+{
+	collisionArray.clear();
+
+	this->queryNumber++;
+
+	// Peform the broad phase of collision detection.
+	{
+		THEBE_PROFILE_BLOCK(BVHPairSearch);
+		this->boxTree->FindAllOverlappingPairs(this->objectPairArray);
+	}
+
+	// The filter is the caller's, so we don't presume it safe to call from other threads.
+	this->candidateArray.clear();
+	for (const BVHTree::ObjectPair& objectPair : this->objectPairArray)
 	{
-		auto otherCollisionObject = dynamic_cast<CollisionObject*>(object);
-		if (otherCollisionObject == collisionObject)
+		auto collisionObjectA = dynamic_cast<CollisionObject*>(objectPair.objectA);
+		auto collisionObjectB = dynamic_cast<CollisionObject*>(objectPair.objectB);
+		if (!collisionObjectA || !collisionObjectB)
+			continue;
+
+		if (pairFilter && !pairFilter(collisionObjectA, collisionObjectB))
 			continue;
 
-		Reference<Collision> collision;
+		this->candidateArray.push_back(NarrowphaseCandidate{ collisionObjectA, collisionObjectB });
+	}
+
+	// Now perform the narrow phase of collision detection.
+	this->RunNarrowphase(collisionArray);
 
-		std::string key = this->MakeCollisionCacheKey(collisionObject, otherCollisionObject);
-		auto pair = this->collisionCacheMap.find(key);
-		if (pair != this->collisionCacheMap.end())
+	// Forget about pairs that the broad phase no longer finds.  Those maintained by the broad phase are forgotten through the pair callbacks.
+	if (!this->HasPersistentPairs())
+	{
+		THEBE_PROFILE_BLOCK(CollisionCacheEviction);
+		this->collisionCacheMap.RemoveIf([this](const Collision* collision) { return collision->lastQueryNumber != this->queryNumber; });
+	}
+}
+
+void CollisionSystem::RunNarrowphase(std::vector<Reference<Collision>>& collisionArray)
+{
+	THEBE_PROFILE_BLOCK(NarrowPhase);
+
+	for (auto& resultArray : this->narrowphaseBufferArray)
+		resultArray.clear();
+
+	// Each candidate is a distinct pair, so no two threads ever touch the same collision record.
+	// Note that the profiler isn't thread-safe, so nothing called from here may use it.
+	auto rangeFunction = [this](int beginIndex, int endIndex, int threadIndex)
+	{
+		std::vector<NarrowphaseResult>& resultArray = this->narrowphaseBufferArray[threadIndex];
+		for (int i = beginIndex; i < endIndex; i++)
+			this->ProcessCandidate(i, resultArray);
+	};
+
+	constexpr int batchSize = 32;
+	int numCandidates = (int)this->candidateArray.size();
+	if (this->workerPool)
+		this->workerPool->ParallelFor(numCandidates, batchSize, rangeFunction);
+	else
+		rangeFunction(0, numCandidates, 0);
+
+	// Which thread got which candidate varies from run to run, so put everything back in candidate order before touching the cache.
+	std::vector<NarrowphaseResult>& mergedArray = this->narrowphaseBufferArray[0];
+	for (int i = 1; i < (int)this->narrowphaseBufferArray.size(); i++)
+	{
+		std::vector<NarrowphaseResult>& resultArray = this->narrowphaseBufferArray[i];
+		for (NarrowphaseResult& result : resultArray)
+			mergedArray.push_back(std::move(result));
+		resultArray.clear();
+	}
+
+	std::sort(mergedArray.begin(), mergedArray.end(), [](const NarrowphaseResult& resultA, const NarrowphaseResult& resultB) {
+		return resultA.candidateIndex < resultB.candidateIndex;
+	});
+
+	for (NarrowphaseResult& result : mergedArray)
+	{
+		if (result.isNew && !this->HasPersistentPairs())
 		{
-			collision = pair->second;
-			if (!collision->StillValid())
-			{
-				this->collisionCacheMap.erase(pair);
-				collision = nullptr;
-				pair = this->collisionCacheMap.end();
-			}
+			uint64_t key = PairCache::MakeKey(result.collision->objectA, result.collision->objectB);
+			this->collisionCacheMap.Insert(key, result.collision);
+		}
+
+		if (result.inCollision)
+			collisionArray.push_back(result.collision);
+	}
+
+	mergedArray.clear();
+}
+
+void CollisionSystem::ProcessCandidate(int candidateIndex, std::vector<NarrowphaseResult>& resultArray)
+{
+	const NarrowphaseCandidate& candidate = this->candidateArray[candidateIndex];
+
+	bool isNew = false;
+
+	uint64_t key = PairCache::MakeKey(candidate.objectA, candidate.objectB);
+	Reference<Collision> collision(this->collisionCacheMap.Find(key));
+	if (!collision)
+	{
+		collision.Set(new Collision());
+		collision->objectA = candidate.objectA;
+		collision->objectB = candidate.objectB;
+		isNew = true;
+	}
+
+	collision->lastQueryNumber = this->queryNumber;
+
+	// Note that the record is updated in place, rather than replaced, so that what was learned about the pair last time isn't lost.
+	bool inCollision = collision->StillValid() ? collision->inCollision : this->CalculateCollision(collision);
+
+	if (isNew || inCollision)
+		resultArray.push_back(NarrowphaseResult{ candidateIndex, collision, isNew, inCollision });
+}
+
+bool CollisionSystem::CalculateCollision(Collision* collision)
+{
+	const GJKShape* shapeA = collision->objectA->GetShape();
+	const GJKShape* shapeB = collision->objectB->GetShape();
+
+	collision->validMoveCountA = collision->objectA->GetMoveCount();
+	collision->validMoveCountB = collision->objectB->GetMoveCount();
+	collision->calculated = true;
+
+	if (dynamic_cast<const GJKCompoundShape*>(shapeA) || dynamic_cast<const GJKCompoundShape*>(shapeB))
+		return this->CalculateCompoundCollision(collision);
+
+	if (dynamic_cast<const TriangleMeshShape*>(shapeA) || dynamic_cast<const TriangleMeshShape*>(shapeB))
+		return this->CalculateMeshCollision(collision);
+
+	if (collision->separatingAxis.SquareLength() > 0.0)
+	{
+		Vector3 supportPoint = GJKSimplex::CalcSupportPoint(shapeA, shapeB, collision->separatingAxis);
+		if (supportPoint.Dot(collision->separatingAxis) < 0.0)
+		{
+			collision->inCollision = false;
+			return false;
 		}
+	}
+
+	collision->inCollision = GJKShape::Intersect(shapeA, shapeB, &collision->simplex);
+
+	if (collision->inCollision)
+	{
+		collision->separatingAxis.SetComponents(0.0, 0.0, 0.0);
+		GJKShape::Penetration(shapeA, shapeB, collision->simplex, collision->separationDelta);
+	}
+	else
+	{
+		// The direction from the final simplex toward the origin is usually an axis that separates the objects.
+		// If it's not, then we'll find out next time and just fall back to GJK.
+		Vector3 closestPoint = collision->simplex.CalcClosestPoint();
+		if (closestPoint.SquareLength() > THEBE_SMALL_EPS)
+			collision->separatingAxis = -closestPoint.Normalized();
+		else
+			collision->separatingAxis.SetComponents(0.0, 0.0, 0.0);
+	}
+
+	return collision->inCollision;
+}
+
+bool CollisionSystem::CalculateMeshCollision(Collision* collision)
+{
+	auto meshShapeA = dynamic_cast<const TriangleMeshShape*>(collision->objectA->GetShape());
+	auto meshShapeB = dynamic_cast<const TriangleMeshShape*>(collision->objectB->GetShape());
+
+	collision->inCollision = false;
+	collision->separatingAxis.SetComponents(0.0, 0.0, 0.0);
+
+	// Meshes are static, so there's never any need to push two of them apart.
+	if (meshShapeA && meshShapeB)
+		return false;
+
+	const TriangleMeshShape* meshShape = meshShapeA ? meshShapeA : meshShapeB;
+	const CollisionObject* otherObject = meshShapeA ? collision->objectB.Get() : collision->objectA.Get();
+
+	Vector3 unitNormal;
+	double depth = 0.0;
+	if (!CalculateMeshPenetration(meshShape, otherObject->GetShape(), otherObject->GetWorldBoundingBox(), unitNormal, depth))
+		return false;
+
+	// The separation delta moves object A, and the triangle normal points away from the mesh.
+	collision->separationDelta = meshShapeA ? (-unitNormal * depth) : (unitNormal * depth);
+	collision->inCollision = true;
+	return true;
+}
+
+bool CollisionSystem::CalculateCompoundCollision(Collision* collision)
+{
+	const GJKShape* shapeA = collision->objectA->GetShape();
+	const GJKShape* shapeB = collision->objectB->GetShape();
+	auto compoundShapeA = dynamic_cast<const GJKCompoundShape*>(shapeA);
+	auto compoundShapeB = dynamic_cast<const GJKCompoundShape*>(shapeB);
+
+	collision->inCollision = false;
+	collision->separatingAxis.SetComponents(0.0, 0.0, 0.0);
+	collision->childCollisionArray.clear();
+
+	// A part of A need only be tested against the parts of B that its own box overlaps.
+	thread_local std::vector<int> childArrayA, childArrayB;
+	if (compoundShapeA)
+		compoundShapeA->FindChildren(collision->objectB->GetWorldBoundingBox(), childArrayA);
+	else
+		childArrayA.assign(1, -1);
+
+	double largestSquareDepth = -1.0;
+	for (int i : childArrayA)
+	{
+		const GJKShape* partA = (i < 0) ? shapeA : compoundShapeA->GetChild(i).shape;
+		if (compoundShapeB)
+			compoundShapeB->FindChildren((i < 0) ? collision->objectA->GetWorldBoundingBox() : partA->GetWorldBoundingBox(), childArrayB);
+		else
+			childArrayB.assign(1, -1);
 
-		if (!collision.Get())
+		for (int j : childArrayB)
 		{
-			std::unique_ptr<GJKSimplex> simplex;
+			const GJKShape* partB = (j < 0) ? shapeB : compoundShapeB->GetChild(j).shape;
 
-			bool intersect = false;
-			{
-				THEBE_PROFILE_BLOCK(GJKIntersect);
-				intersect = GJKShape::Intersect(collisionObject->GetShape(), otherCollisionObject->GetShape(), &simplex);
-			}
+			Collision::ChildCollision childCollision{ i, j, partA, partB, Vector3(0.0, 0.0, 0.0) };
+			if (!CalculatePartCollision(partA, partB, childCollision.separationDelta))
+				continue;
 
-			if (intersect)
+			collision->childCollisionArray.push_back(childCollision);
+
+			double squareDepth = childCollision.separationDelta.SquareLength();
+			if (squareDepth > largestSquareDepth)
 			{
-				collision.Set(new Collision());
-				collision->validFrameA = collisionObject->GetFrameWhenLastMoved();
-				collision->validFrameB = otherCollisionObject->GetFrameWhenLastMoved();
-				collision->objectA = collisionObject;
-				collision->objectB = otherCollisionObject;
-				
-				{
-					THEBE_PROFILE_BLOCK(PenetrationCalc);
-					GJKShape::Penetration(collisionObject->GetShape(), otherCollisionObject->GetShape(), simplex, collision->separationDelta);
-				}
+				largestSquareDepth = squareDepth;
+				collision->separationDelta = childCollision.separationDelta;
 			}
 		}
+	}
+
+	collision->inCollision = (collision->childCollisionArray.size() > 0);
+	return collision->inCollision;
+}
+
+/*static*/ bool CollisionSystem::CalculatePartCollision(const GJKShape* shapeA, const GJKShape* shapeB, Vector3& separationDelta)
+{
+	auto meshShapeA = dynamic_cast<const TriangleMeshShape*>(shapeA);
+	auto meshShapeB = dynamic_cast<const TriangleMeshShape*>(shapeB);
+
+	if (meshShapeA && meshShapeB)
+		return false;
+
+	if (meshShapeA || meshShapeB)
+	{
+		const TriangleMeshShape* meshShape = meshShapeA ? meshShapeA : meshShapeB;
+		const GJKShape* otherShape = meshShapeA ? shapeB : shapeA;
+
+		Vector3 unitNormal;
+		double depth = 0.0;
+		if (!CalculateMeshPenetration(meshShape, otherShape, otherShape->GetWorldBoundingBox(), unitNormal, depth))
+			return false;
+
+		separationDelta = meshShapeA ? (-unitNormal * depth) : (unitNormal * depth);
+		return true;
+	}
+
+	GJKSimplex simplex;
+	if (!GJKShape::Intersect(shapeA, shapeB, &simplex))
+		return false;
+
+	if (!GJKShape::Penetration(shapeA, shapeB, simplex, separationDelta))
+		separationDelta.SetComponents(0.0, 0.0, 0.0);
+
+	return true;
+}
+
+/*static*/ bool CollisionSystem::CalculateMeshPenetration(const TriangleMeshShape* meshShape, const GJKShape* shape, const AxisAlignedBoundingBox& worldBox, Vector3& unitNormal, double& depth)
+{
+	thread_local std::vector<int> triangleArray;
+	meshShape->FindTriangles(worldBox, triangleArray);
+
+	Vector3 center = shape->GetObjectToWorld().TransformPoint(shape->CalcGeometricCenter());
+	bool triangleFound = false;
+	GJKTriangle triangle;
+	for (int i : triangleArray)
+	{
+		meshShape->GetTriangle(i, triangle);
+
+		// Triangles are one-sided, so a shape is never pushed through the back of one.  Measuring penetration along
+		// the face normal, rather than with EPA, also keeps shapes from catching on the seams between triangles.
+		Plane plane = triangle.GetWorldPlane();
+		if (!plane.IsValid() || plane.SignedDistanceTo(center) < 0.0)
+			continue;
+
+		if (!GJKShape::Intersect(shape, &triangle))
+			continue;
 
-		if (collision.Get())
+		double triangleDepth = -plane.SignedDistanceTo(shape->FurthestPoint(-plane.unitNormal));
+		if (!triangleFound || triangleDepth > depth)
 		{
-			collisionArray.push_back(collision);
+			depth = THEBE_MAX(triangleDepth, 0.0);
+			unitNormal = plane.unitNormal;
+			triangleFound = true;
+		}
+	}
 
-			if (pair == this->collisionCacheMap.end())
-				this->collisionCacheMap.insert(std::pair(key, collision));
+	return triangleFound;
+}
+
+/*static*/ bool CollisionSystem::ShapesIntersect(const GJKShape* shape, const GJKShape* obstacleShape)
+{
+	// Compounds intersect whatever any of their parts intersect.  Note that the child arrays can't be
+	// shared with those of the mesh below, because we may come back through here for each part.
+	auto compoundShape = dynamic_cast<const GJKCompoundShape*>(shape);
+	auto compoundObstacleShape = dynamic_cast<const GJKCompoundShape*>(obstacleShape);
+	if (compoundShape || compoundObstacleShape)
+	{
+		std::vector<int> childArray;
+		if (compoundShape)
+		{
+			compoundShape->FindChildren(obstacleShape->GetWorldBoundingBox(), childArray);
+			for (int i : childArray)
+				if (ShapesIntersect(compoundShape->GetChild(i).shape, obstacleShape))
+					return true;
+		}
+		else
+		{
+			compoundObstacleShape->FindChildren(shape->GetWorldBoundingBox(), childArray);
+			for (int i : childArray)
+				if (ShapesIntersect(shape, compoundObstacleShape->GetChild(i).shape))
+					return true;
 		}
+
+		return false;
+	}
+
+	auto meshShape = dynamic_cast<const TriangleMeshShape*>(obstacleShape);
+	if (!meshShape)
+		return GJKShape::Intersect(shape, obstacleShape);
+
+	thread_local std::vector<int> triangleArray;
+	meshShape->FindTriangles(shape->GetWorldBoundingBox(), triangleArray);
+
+	GJKTriangle triangle;
+	for (int i : triangleArray)
+	{
+		meshShape->GetTriangle(i, triangle);
+		if (GJKShape::Intersect(shape, &triangle))
+			return true;
 	}
+
+	return false;
 }
 
-std::string CollisionSystem::MakeCollisionCacheKey(const CollisionObject* objectA, const CollisionObject* objectB)
+/*static*/ bool CollisionSystem::CalculateDistance(const GJKShape* shape, const GJKShape* obstacleShape, Vector3& closestPoint, Vector3& closestObstaclePoint, double& distance, GJKSimplex* cachedSimplex)
 {
-	RefHandle handleA = objectA->GetHandle();
-	RefHandle handleB = objectB->GetHandle();
+	auto compoundShape = dynamic_cast<const GJKCompoundShape*>(shape);
+	auto compoundObstacleShape = dynamic_cast<const GJKCompoundShape*>(obstacleShape);
+	if (!compoundShape && !compoundObstacleShape)
+		return GJKShape::Distance(shape, obstacleShape, closestPoint, closestObstaclePoint, distance, cachedSimplex);
 
-	if (handleA < handleB)
-		return std::format("{}_{}", handleA, handleB);
-	else
-		return std::format("{}_{}", handleB, handleA);
+	// Compounds are small, so we just visit every pair of parts.  A simplex of one pair is no good for warm-starting another.
+	int numParts = compoundShape ? compoundShape->GetNumChildren() : 1;
+	int numObstacleParts = compoundObstacleShape ? compoundObstacleShape->GetNumChildren() : 1;
+	bool distanceFound = false;
+	for (int i = 0; i < numParts; i++)
+	{
+		const GJKShape* part = compoundShape ? compoundShape->GetChild(i).shape : shape;
+		for (int j = 0; j < numObstacleParts; j++)
+		{
+			const GJKShape* obstaclePart = compoundObstacleShape ? compoundObstacleShape->GetChild(j).shape : obstacleShape;
+
+			Vector3 partClosestPoint, obstaclePartClosestPoint;
+			double partDistance = 0.0;
+			if (!GJKShape::Distance(part, obstaclePart, partClosestPoint, obstaclePartClosestPoint, partDistance))
+				return false;
+
+			if (!distanceFound || partDistance < distance)
+			{
+				closestPoint = partClosestPoint;
+				closestObstaclePoint = obstaclePartClosestPoint;
+				distance = partDistance;
+				distanceFound = true;
+			}
+		}
+	}
+
+	return distanceFound;
+}
+
+/*static*/ double CollisionSystem::CalcBoundingRadius(const GJKShape* shape)
+{
+	// The shape turns about its object-space origin, so the farthest corner of its object-space box bounds it as it does.
+	AxisAlignedBoundingBox objectBoundingBox = shape->GetObjectBoundingBox();
+	Vector3 farthestCorner(
+		THEBE_MAX(::fabs(objectBoundingBox.minCorner.x), ::fabs(objectBoundingBox.maxCorner.x)),
+		THEBE_MAX(::fabs(objectBoundingBox.minCorner.y), ::fabs(objectBoundingBox.maxCorner.y)),
+		THEBE_MAX(::fabs(objectBoundingBox.minCorner.z), ::fabs(objectBoundingBox.maxCorner.z)));
+	return farthestCorner.Length();
 }
 
 void CollisionSystem::DebugDraw(DynamicLineRenderer* lineRenderer) const
@@ -209,18 +958,39 @@ void CollisionSystem::ShowImGuiCollisionWindow()
 		ImGui::LabelText("BVH Num Objects", "%d", stats.numObjects);
 		ImGui::LabelText("BVH Max Depth", "%d", stats.maxDepth);
 		ImGui::LabelText("Coll. Obj. Map Size", "%d", this->collisionObjectMap.size());
-		ImGui::LabelText("Coll. Cache Map Size", "%d", this->collisionCacheMap.size());
+		ImGui::LabelText("Coll. Cache Map Size", "%d", int(this->collisionCacheMap.GetSize()));
+		ImGui::LabelText("Coll. Cache Map Capacity", "%d", int(this->collisionCacheMap.GetCapacity()));
 	}
 
 	ImGui::End();
 }
 
+//--------------------------------- CollisionSystem::QueryFilter ---------------------------------
+
+CollisionSystem::QueryFilter::QueryFilter(uint32_t maskBits /*= THEBE_ALL_CATEGORY_BITS*/, uint32_t categoryBits /*= THEBE_ALL_CATEGORY_BITS*/)
+{
+	this->categoryBits = categoryBits;
+	this->maskBits = maskBits;
+	this->queryObject = nullptr;
+}
+
+CollisionSystem::QueryFilter::QueryFilter(const CollisionObject* queryObject)
+{
+	this->categoryBits = THEBE_ALL_CATEGORY_BITS;
+	this->maskBits = THEBE_ALL_CATEGORY_BITS;
+	this->queryObject = queryObject;
+}
+
 //--------------------------------- CollisionSystem::Collision ---------------------------------
 
 CollisionSystem::Collision::Collision()
 {
-	this->validFrameA = -1;
-	this->validFrameB = -1;
+	this->validMoveCountA = 0;
+	this->validMoveCountB = 0;
+	this->calculated = false;
+	this->inCollision = false;
+	this->separatingAxis.SetComponents(0.0, 0.0, 0.0);
+	this->lastQueryNumber = 0;
 }
 
 /*virtual*/ CollisionSystem::Collision::~Collision()
@@ -229,11 +999,284 @@ CollisionSystem::Collision::Collision()
 
 bool CollisionSystem::Collision::StillValid() const
 {
-	if (this->validFrameA != this->objectA->GetFrameWhenLastMoved())
+	if (!this->calculated)
 		return false;
 
-	if (this->validFrameB != this->objectB->GetFrameWhenLastMoved())
+	if (this->validMoveCountA != this->objectA->GetMoveCount())
+		return false;
+
+	if (this->validMoveCountB != this->objectB->GetMoveCount())
 		return false;
 
 	return true;
+}
+//--------------------------------- CollisionSystem::PairCache ---------------------------------
+
+CollisionSystem::PairCache::PairCache()
+{
+	this->numEntries = 0;
+	this->sweepCursor = 0;
+}
+
+/*virtual*/ CollisionSystem::PairCache::~PairCache()
+{
+}
+
+/*static*/ uint64_t CollisionSystem::PairCache::MakeKey(const CollisionObject* objectA, const CollisionObject* objectB)
+{
+	uint64_t handleA = objectA->GetHandle();
+	uint64_t handleB = objectB->GetHandle();
+
+	if (handleA < handleB)
+		return (handleA << 32) | handleB;
+	else
+		return (handleB << 32) | handleA;
+}
+
+size_t CollisionSystem::PairCache::GetHomeSlot(uint64_t key) const
+{
+	// Handles are handed out sequentially, so mix up the bits before using them to pick a slot.
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+
+	return size_t(key) & (this->slotArray.size() - 1);
+}
+
+CollisionSystem::Collision* CollisionSystem::PairCache::Find(uint64_t key) const
+{
+	if (this->numEntries == 0)
+		return nullptr;
+
+	size_t mask = this->slotArray.size() - 1;
+	for (size_t i = this->GetHomeSlot(key); this->slotArray[i].key != 0; i = (i + 1) & mask)
+		if (this->slotArray[i].key == key)
+			return const_cast<Collision*>(this->slotArray[i].collision.Get());
+
+	return nullptr;
+}
+
+bool CollisionSystem::PairCache::Insert(uint64_t key, Collision* collision)
+{
+	if (key == 0 || !collision)
+		return false;
+
+	// Keep the table at most half full so that probe runs stay short.
+	if (2 * (this->numEntries + 1) > this->slotArray.size())
+		this->Rehash(THEBE_MAX(size_t(64), 2 * this->slotArray.size()));
+
+	size_t mask = this->slotArray.size() - 1;
+	size_t i = this->GetHomeSlot(key);
+	while (this->slotArray[i].key != 0)
+	{
+		if (this->slotArray[i].key == key)
+			return false;
+
+		i = (i + 1) & mask;
+	}
+
+	this->slotArray[i].key = key;
+	this->slotArray[i].collision.Set(collision);
+	this->numEntries++;
+	return true;
+}
+
+bool CollisionSystem::PairCache::Remove(uint64_t key)
+{
+	if (this->numEntries == 0)
+		return false;
+
+	size_t mask = this->slotArray.size() - 1;
+	for (size_t i = this->GetHomeSlot(key); this->slotArray[i].key != 0; i = (i + 1) & mask)
+	{
+		if (this->slotArray[i].key == key)
+		{
+			this->RemoveAt(i);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void CollisionSystem::PairCache::RemoveAt(size_t i)
+{
+	size_t mask = this->slotArray.size() - 1;
+
+	this->slotArray[i].key = 0;
+	this->slotArray[i].collision.Reset();
+	this->numEntries--;
+
+	// Close the gap by pulling back any entry further along the run that would no longer be reachable from its home slot.
+	size_t j = i;
+	while (true)
+	{
+		j = (j + 1) & mask;
+		if (this->slotArray[j].key == 0)
+			break;
+
+		size_t k = this->GetHomeSlot(this->slotArray[j].key);
+		bool reachable = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+		if (reachable)
+			continue;
+
+		this->slotArray[i].key = this->slotArray[j].key;
+		this->slotArray[i].collision = this->slotArray[j].collision;
+		this->slotArray[j].key = 0;
+		this->slotArray[j].collision.Reset();
+		i = j;
+	}
+}
+
+void CollisionSystem::PairCache::Clear()
+{
+	this->slotArray.clear();
+	this->numEntries = 0;
+	this->sweepCursor = 0;
+}
+
+void CollisionSystem::PairCache::RemoveIf(Predicate predicate)
+{
+	// When an entry is removed, another may be shifted into its slot, so look at the same slot again.
+	size_t i = 0;
+	while (i < this->slotArray.size())
+	{
+		const Slot& slot = this->slotArray[i];
+		if (slot.key != 0 && predicate(slot.collision.Get()))
+			this->RemoveAt(i);
+		else
+			i++;
+	}
+
+	this->ShrinkIfSparse();
+}
+
+void CollisionSystem::PairCache::RemoveIfIncrementally(Predicate predicate, size_t numSlots)
+{
+	if (this->slotArray.size() == 0)
+		return;
+
+	numSlots = THEBE_MIN(numSlots, this->slotArray.size());
+	size_t mask = this->slotArray.size() - 1;
+	size_t i = this->sweepCursor & mask;
+	for (size_t j = 0; j < numSlots; j++)
+	{
+		const Slot& slot = this->slotArray[i];
+		if (slot.key != 0 && predicate(slot.collision.Get()))
+			this->RemoveAt(i);
+		else
+			i = (i + 1) & mask;
+	}
+
+	this->sweepCursor = i;
+	this->ShrinkIfSparse();
+}
+
+void CollisionSystem::PairCache::ShrinkIfSparse()
+{
+	// Shrink only well below the load at which we grow, so that we don't flip back and forth.
+	size_t newCapacity = this->slotArray.size();
+	while (newCapacity > 64 && 8 * this->numEntries < newCapacity)
+		newCapacity /= 2;
+
+	if (newCapacity != this->slotArray.size())
+		this->Rehash(newCapacity);
+}
+
+void CollisionSystem::PairCache::Rehash(size_t newCapacity)
+{
+	std::vector<Slot> oldSlotArray;
+	oldSlotArray.swap(this->slotArray);
+
+	Slot emptySlot;
+	emptySlot.key = 0;
+	this->slotArray.resize(newCapacity, emptySlot);
+	this->numEntries = 0;
+	this->sweepCursor = 0;
+
+	size_t mask = newCapacity - 1;
+	for (const Slot& slot : oldSlotArray)
+	{
+		if (slot.key == 0)
+			continue;
+
+		size_t i = this->GetHomeSlot(slot.key);
+		while (this->slotArray[i].key != 0)
+			i = (i + 1) & mask;
+
+		this->slotArray[i].key = slot.key;
+		this->slotArray[i].collision = slot.collision;
+		this->numEntries++;
+	}
+}
+
+size_t CollisionSystem::PairCache::GetSize() const
+{
+	return this->numEntries;
+}
+
+size_t CollisionSystem::PairCache::GetCapacity() const
+{
+	return this->slotArray.size();
+}
+
+//--------------------------------- CollisionSystem::SweptMotion ---------------------------------
+
+void CollisionSystem::SweptMotion::SetFromTransforms(const Transform& startObjectToWorld, const Transform& endObjectToWorld)
+{
+	this->startObjectToWorld = startObjectToWorld;
+	this->linearDelta = endObjectToWorld.translation - startObjectToWorld.translation;
+
+	Matrix3x3 rotation = endObjectToWorld.matrix * startObjectToWorld.matrix.Transposed();
+	rotation.GetToAxisAngle(this->unitRotationAxis, this->rotationAngle);
+
+	// Always turn the short way around.
+	if (this->rotationAngle > THEBE_PI)
+	{
+		this->rotationAngle = 2.0 * THEBE_PI - this->rotationAngle;
+		this->unitRotationAxis = -this->unitRotationAxis;
+	}
+
+	if (!(this->rotationAngle > THEBE_SMALL_EPS) || !this->unitRotationAxis.Normalize())
+	{
+		this->rotationAngle = 0.0;
+		this->unitRotationAxis.SetComponents(0.0, 1.0, 0.0);
+	}
+
+	this->rotationalRadius = 0.0;
+	this->tolerance = 0.0;
+}
+
+Transform CollisionSystem::SweptMotion::Evaluate(double alpha) const
+{
+	Transform objectToWorld;
+	objectToWorld.translation = this->startObjectToWorld.translation + this->linearDelta * alpha;
+
+	if (this->rotationAngle == 0.0)
+		objectToWorld.matrix = this->startObjectToWorld.matrix;
+	else
+	{
+		Matrix3x3 rotation;
+		rotation.SetFromAxisAngle(this->unitRotationAxis, this->rotationAngle * alpha);
+		objectToWorld.matrix = rotation * this->startObjectToWorld.matrix;
+	}
+
+	return objectToWorld;
+}
+
+AxisAlignedBoundingBox CollisionSystem::SweptMotion::CalcSweptBox(double boundingRadius) const
+{
+	Vector3 startCenter = this->startObjectToWorld.translation;
+	Vector3 endCenter = startCenter + this->linearDelta;
+	Vector3 radiusDelta(boundingRadius, boundingRadius, boundingRadius);
+
+	AxisAlignedBoundingBox sweptBox;
+	sweptBox.MakeReadyForExpansion();
+	sweptBox.Expand(startCenter - radiusDelta);
+	sweptBox.Expand(startCenter + radiusDelta);
+	sweptBox.Expand(endCenter - radiusDelta);
+	sweptBox.Expand(endCenter + radiusDelta);
+	return sweptBox;
 }
\ No newline at end of file
@@ -3,12 +3,18 @@
 #include "Thebe/Common.h"
 #include "Thebe/BoundingVolumeHierarchy.h"
 #include "Thebe/Math/Ray.h"
+#include "Thebe/Math/GJKAlgorithm.h"
 #include <map>
+#include <functional>
+#include <memory>
 
 namespace Thebe
 {
 	class CollisionObject;
 	class DynamicLineRenderer;
+	class WorkerPool;
+	class TriangleMeshShape;
+	class GJKCompoundShape;
 
 	/**
 	 * This is a basic system for keeping track of various shapes in
@@ -25,9 +31,22 @@ namespace Thebe
 	class THEBE_API CollisionSystem
 	{
 	public:
-		CollisionSystem();
+		/**
+		 * These are the choices of data-structure used to perform the broad
+		 * phase of collision detection.
+		 */
+		enum BroadphaseType
+		{
+			SPLIT_BOX_TREE,			///< Use a @ref SplitBoxBVHTree, which recursively divides the world box.
+			DYNAMIC_AABB_TREE,		///< Use a @ref DynamicBVHTree, which is better suited to many moving objects.
+			SWEEP_AND_PRUNE			///< Use a @ref SweepAndPrune, which is best suited to many objects that barely move.
+		};
+
+		CollisionSystem(BroadphaseType broadphaseType = BroadphaseType::DYNAMIC_AABB_TREE);
 		virtual ~CollisionSystem();
 
+		BroadphaseType GetBroadphaseType() const;
+
 		bool TrackObject(CollisionObject* collisionObject);
 		bool UntrackObject(CollisionObject* collisionObject);
 		void UntrackAllObjects();
@@ -44,10 +63,145 @@ namespace Thebe
 		 */
 		bool RayCast(const Ray& ray, CollisionObject*& collisionObject, Vector3& unitSurfaceNormal);
 
+		/**
+		 * This says which collision objects a query considers.  It's checked just as a pair of objects is (see
+		 * @ref BVHObject::CanPairWith), as though the query were made by an object with the given category and
+		 * mask bits.  If an object is given instead, the query is made on its behalf: its own bits are used, it's
+		 * never found itself, and the filter given to @ref SetPairFilter is applied to it and each object found.
+		 */
+		struct QueryFilter
+		{
+			QueryFilter(uint32_t maskBits = THEBE_ALL_CATEGORY_BITS, uint32_t categoryBits = THEBE_ALL_CATEGORY_BITS);
+			explicit QueryFilter(const CollisionObject* queryObject);
+
+			uint32_t categoryBits;
+			uint32_t maskBits;
+			const CollisionObject* queryObject;
+		};
+
+		/**
+		 * Find all collision objects whose world bounding boxes overlap the given box, and which the given filter accepts.
+		 * This is only the broad phase; the objects themselves need not overlap the box.
+		 */
+		void FindObjectsInBox(const AxisAlignedBoundingBox& worldBox, std::vector<CollisionObject*>& collisionObjectArray, const QueryFilter& queryFilter = QueryFilter()) const;
+
+		/**
+		 * These are hits reported by @ref RayCastAll.
+		 */
+		struct RayCastHit
+		{
+			CollisionObject* collisionObject;
+			double alpha;					///< This is the distance along the ray to the hit.
+			Vector3 unitSurfaceNormal;		///< This is the surface normal of the object at the hit.
+		};
+
+		/**
+		 * Cast a ray against all collision objects in the system, and report every object hit.
+		 * This changes nothing in the system, so it may be called from any number of threads at
+		 * once, as long as no thread is adding, removing or moving objects meanwhile.
+		 *
+		 * @param[in] ray This is the ray to cast.
+		 * @param[out] rayCastHitArray This is cleared and then populated with one hit per object hit, sorted from nearest to farthest.
+		 * @param[in] queryFilter Only objects this accepts are considered.  Given just mask bits, only objects in at least one of those categories are.
+		 * @return True is returned if and only if at least one object was hit.
+		 */
+		bool RayCastAll(const Ray& ray, std::vector<RayCastHit>& rayCastHitArray, const QueryFilter& queryFilter = QueryFilter()) const;
+
+		/**
+		 * Find all collision objects overlapping the given shape, as if it were at the given place.
+		 * Nothing in the system is changed, not even the given shape, which is tested by way of stand-ins
+		 * (see @ref GJKTransformedShape), so this may be called from any number of threads at once, even
+		 * with the same shape, or that of a tracked object, as long as no thread is adding, removing or
+		 * moving objects meanwhile.
+		 *
+		 * @param[in] shape This is the shape to test for overlap.  It may be a @ref GJKCompoundShape, but not a @ref TriangleMeshShape.
+		 * @param[in] objectToWorld This is where to place the shape for the test.
+		 * @param[out] collisionObjectArray This is cleared and then populated with the overlapping objects, in no particular order.
+		 * @param[in] queryFilter Only objects this accepts are considered.  Given just mask bits, only objects in at least one of those categories are.
+		 * @return True is returned if and only if the shape overlaps at least one object.
+		 */
+		bool OverlapShape(const GJKShape* shape, const Transform& objectToWorld, std::vector<CollisionObject*>& collisionObjectArray, const QueryFilter& queryFilter = QueryFilter()) const;
+
+		/**
+		 * These are hits reported by @ref SweepShape.
+		 */
+		struct SweepHit
+		{
+			CollisionObject* collisionObject;
+			double timeOfImpact;			///< This is how far (from zero to one) through the sweep that the shape first touches the object.
+			Vector3 unitSurfaceNormal;		///< This is the surface normal of the object where the shape first touches it.
+		};
+
+		/**
+		 * Sweep the given shape from one place to another, and find the first collision object it touches
+		 * along the way.  The shape moves at a constant linear velocity and turns at a constant angular velocity
+		 * from start to finish.  Objects the shape already overlaps at the start are hit at a time of zero, with
+		 * a normal opposing the motion.  This has the same thread-safety guarantees as @ref OverlapShape.
+		 *
+		 * @param[in] shape This is the shape to sweep.  It may be a @ref GJKCompoundShape, but not a @ref TriangleMeshShape.
+		 * @param[in] startObjectToWorld This is where the shape starts.
+		 * @param[in] endObjectToWorld This is where the shape ends.
+		 * @param[out] sweepHit This is set to the first hit, if any; left alone, otherwise.
+		 * @param[in] queryFilter Only objects this accepts are considered.  Given just mask bits, only objects in at least one of those categories are.
+		 * @return True is returned if and only if the shape touches an object somewhere along the sweep.
+		 */
+		bool SweepShape(const GJKShape* shape, const Transform& startObjectToWorld, const Transform& endObjectToWorld, SweepHit& sweepHit, const QueryFilter& queryFilter = QueryFilter()) const;
+
+		/**
+		 * This describes the motion of a shape as a constant linear velocity and a
+		 * constant angular velocity about the origin of its object space.
+		 */
+		struct SweptMotion
+		{
+			/**
+			 * Set up the motion to go from the first given transform to the second.
+			 * The radii and tolerance are left for the caller to set.
+			 */
+			void SetFromTransforms(const Transform& startObjectToWorld, const Transform& endObjectToWorld);
+
+			/**
+			 * Return the shape's object-to-world transform at the given fraction of the way through the motion.
+			 */
+			Transform Evaluate(double alpha) const;
+
+			/**
+			 * Return a world-space box bounding everywhere a shape with the given bounding radius
+			 * (about its object-space origin) goes over the course of the motion.
+			 */
+			AxisAlignedBoundingBox CalcSweptBox(double boundingRadius) const;
+
+			Transform startObjectToWorld;
+			Vector3 linearDelta;				///< This is how far the object-space origin moves over the whole motion.
+			Vector3 unitRotationAxis;
+			double rotationAngle;				///< This is how far the shape turns about the rotation axis over the whole motion.
+			double rotationalRadius;			///< No point of the surface moves faster toward anything, due to rotation, than this times the angular speed.
+			double tolerance;					///< Distances closer than this count as contact.
+		};
+
+		/**
+		 * Use conservative advancement to find the fraction of the given motion at which the given shape first
+		 * touches the given obstacle, which is assumed not to move.  False is returned if they never touch, or
+		 * if they already touch at the start of the motion.  Note that the given shape is moved along the motion,
+		 * and is left wherever it stops.  If the obstacle is a @ref TriangleMeshShape, the shape is swept against
+		 * each triangle near its path that it approaches from the front, and the first impact is found.
+		 *
+		 * @param[out] timeOfImpact This is set to the fraction of the way through the motion at which the shape touches the obstacle.
+		 * @param[out] unitSurfaceNormal This is set to the surface normal of the obstacle where the shape touches it.
+		 */
+		static bool CalculateTimeOfImpact(GJKShape* shape, const SweptMotion& motion, const GJKShape* obstacleShape, double& timeOfImpact, Vector3& unitSurfaceNormal);
+
 		/**
 		 * The main feature of the collision system is to produce instances
 		 * of this class upon which the application can act to move, separate,
 		 * or otherwise acknowledge overlaps of, collision objects.
+		 * 
+		 * With the @ref BroadphaseType::SWEEP_AND_PRUNE broad phase, an instance
+		 * of this class is created when a pair of objects begins overlapping in
+		 * the broad phase, and destroyed when they stop overlapping.  Otherwise,
+		 * one is created when a pair is first found by the broad phase, and then
+		 * destroyed when a pass of @ref FindAllOverlappingPairs no longer finds it.
+		 * Either way, the instance persists across frames whether or not the objects
+		 * collide, so that the narrow phase can pick up where it left off last frame.
 		 */
 		class Collision : public ReferenceCounted
 		{
@@ -72,20 +226,118 @@ namespace Thebe
 			 */
 			Vector3 separationDelta;
 
+			/**
+			 * This is a pair of parts of the two objects that collide.  A part is a child of
+			 * a @ref GJKCompoundShape, or the whole shape of an object that isn't a compound.
+			 */
+			struct ChildCollision
+			{
+				int childA;						///< This is the index of the child of objectA's compound, or -1 if objectA isn't a compound.
+				int childB;						///< This is the index of the child of objectB's compound, or -1 if objectB isn't a compound.
+				const GJKShape* shapeA;			///< This is the part of objectA in collision.
+				const GJKShape* shapeB;			///< This is the part of objectB in collision.
+				Vector3 separationDelta;		///< This separates just these two parts, in the same sense as the separation delta of the whole collision.
+			};
+
+			/**
+			 * If either object is a compound, then this lists every pair of parts in collision, and the separation
+			 * delta of the whole collision is that of the deepest pair.  Otherwise, this is empty.
+			 */
+			std::vector<ChildCollision> childCollisionArray;
+
 		private:
 			/**
-			 * 
+			 * These are the move counts of the objects as of the last time the narrow phase was performed.
+			 */
+			uint64_t validMoveCountA;
+			uint64_t validMoveCountB;
+
+			/**
+			 * This is whether the narrow phase has ever been performed for this pair.
+			 */
+			bool calculated;
+
+			/**
+			 * This is whether the objects were found to collide when last the narrow phase was performed.
+			 */
+			bool inCollision;
+
+			/**
+			 * If non-zero, this is a unit-length axis that separated the objects when last the narrow phase
+			 * was performed.  More precisely, projected onto this axis, all of objectB was behind all of objectA.
+			 * Objects that were separated often still are, and this can be checked with just one support point.
+			 */
+			Vector3 separatingAxis;
+
+			/**
+			 * This is the final simplex of the last run of GJK on this pair, used to warm-start the next run.
+			 */
+			GJKSimplex simplex;
+
+			/**
+			 * This is the value of @ref CollisionSystem::queryNumber when this pair was last found by the broad phase.
 			 */
-			uint64_t validFrameA;
-			uint64_t validFrameB;
+			uint64_t lastQueryNumber;
 		};
 
 		/**
 		 * As quickly as possible, find all collisions with which the given
-		 * collision object is involved.
+		 * collision object is involved.  Objects whose category and mask bits
+		 * say they don't pair with the given object (see @ref BVHObject::CanPairWith),
+		 * or that are rejected by the filter given to @ref SetPairFilter, are skipped.
 		 */
 		void FindAllCollisions(CollisionObject* collisionObject, std::vector<Reference<Collision>>& collisionArray);
 
+		/**
+		 * This is called for each candidate pair of objects before any narrow-phase
+		 * work is done on them.  Return false to have the pair ignored.
+		 */
+		typedef std::function<bool(const CollisionObject* objectA, const CollisionObject* objectB)> PairFilter;
+
+		/**
+		 * Set a filter to be applied to every candidate pair found by @ref FindAllCollisions
+		 * and @ref FindAllOverlappingPairs, in addition to the category and mask bits check.
+		 * This is applied by the broad phase as it traverses its tree, so rejected pairs never
+		 * get as far as the narrow phase.  It is always called from the thread doing the query.
+		 * Pass null to remove the filter.
+		 */
+		void SetPairFilter(PairFilter pairFilter);
+
+		/**
+		 * As quickly as possible, find all collisions between all pairs of tracked objects.
+		 * This is much cheaper than calling @ref FindAllCollisions for every object, because
+		 * the broad phase enumerates every candidate pair exactly once in a single traversal
+		 * of the tree, and so the narrow phase is also only done once per pair.
+		 * 
+		 * @param[out] collisionArray This is cleared and then populated with one collision per pair of colliding objects.
+		 * @param[in] pairFilter If given, this is used to skip candidate pairs that are of no interest to the caller, in addition to the filter given to @ref SetPairFilter.
+		 */
+		void FindAllOverlappingPairs(std::vector<Reference<Collision>>& collisionArray, PairFilter pairFilter = nullptr);
+
+		/**
+		 * Set the number of threads, including the calling thread, across which
+		 * the narrow phase of collision detection is split.  The default is one,
+		 * which keeps everything on the calling thread.  Note that the results
+		 * of @ref FindAllCollisions and @ref FindAllOverlappingPairs do not
+		 * depend on this number; only how long they take to produce does.
+		 * The physics system shares these threads, and sets this number
+		 * through @ref PhysicsSystem::SetThreadCount.
+		 */
+		bool SetNarrowphaseThreadCount(int threadCount);
+
+		/**
+		 * Get the number of threads across which the narrow phase is split.
+		 */
+		int GetNarrowphaseThreadCount() const;
+
+		/**
+		 * Get the pool of threads the narrow phase runs on, so that others can run
+		 * their own loops on it instead of starting threads of their own.  This is
+		 * null if there's only the calling thread.  The pool mustn't be used while
+		 * any of our own queries are running.
+		 */
+		WorkerPool* GetWorkerPool();
+
 		void DebugDraw(DynamicLineRenderer* lineRenderer) const;
 
 		void RegisterWithImGuiManager();
@@ -96,11 +348,185 @@ namespace Thebe
 
 		void ShowImGuiCollisionWindow();
 
-		std::string MakeCollisionCacheKey(const CollisionObject* objectA, const CollisionObject* objectB);
+		/**
+		 * This maps pairs of collision objects to their collision records.  It is a flat,
+		 * open-addressing hash table with linear probing, keyed by the packed handles of
+		 * the two objects, so that a look-up costs no allocation and is typically a single
+		 * cache miss.  Removal shifts the rest of the probe run back, rather than leaving
+		 * tombstones, and the table shrinks again as it empties.  Look-ups may be made
+		 * from any number of threads at once, so long as no thread is modifying the table.
+		 */
+		class PairCache
+		{
+		public:
+			PairCache();
+			virtual ~PairCache();
+
+			/**
+			 * Make the key for the given pair of objects.  The order of the objects does not matter.
+			 */
+			static uint64_t MakeKey(const CollisionObject* objectA, const CollisionObject* objectB);
+
+			Collision* Find(uint64_t key) const;
+			bool Insert(uint64_t key, Collision* collision);
+			bool Remove(uint64_t key);
+			void Clear();
+
+			typedef std::function<bool(const Collision* collision)> Predicate;
+
+			/**
+			 * Remove every entry for which the given predicate returns true.
+			 */
+			void RemoveIf(Predicate predicate);
+
+			/**
+			 * Visit the given number of slots, picking up where the last call left off,
+			 * and remove every entry found for which the given predicate returns true.
+			 * This lets the cost of eviction be spread out over many calls.
+			 */
+			void RemoveIfIncrementally(Predicate predicate, size_t numSlots);
+
+			size_t GetSize() const;
+			size_t GetCapacity() const;
+
+		private:
+			struct Slot
+			{
+				uint64_t key;		///< This is zero for an empty slot, because handles are never zero.
+				Reference<Collision> collision;
+			};
+
+			size_t GetHomeSlot(uint64_t key) const;
+			void RemoveAt(size_t i);
+			void Rehash(size_t newCapacity);
+			void ShrinkIfSparse();
+
+			std::vector<Slot> slotArray;
+			size_t numEntries;
+			size_t sweepCursor;
+		};
+
+		/**
+		 * This is a pair of objects found by the broad phase that is yet to go through the narrow phase.
+		 */
+		struct NarrowphaseCandidate
+		{
+			CollisionObject* objectA;
+			CollisionObject* objectB;
+		};
+
+		/**
+		 * This is what a thread of the narrow phase found out about a candidate that is of any interest to the merge.
+		 */
+		struct NarrowphaseResult
+		{
+			int candidateIndex;
+			Reference<Collision> collision;
+			bool isNew;
+			bool inCollision;
+		};
+
+		/**
+		 * Perform the narrow phase of collision detection for all pairs in @ref candidateArray,
+		 * and then populate the given array with the colliding ones, in candidate order.
+		 * Any thread of the stage only reads the cache, and records what it finds in its own
+		 * buffer.  The buffers are then merged back into the cache on the calling thread.
+		 */
+		void RunNarrowphase(std::vector<Reference<Collision>>& collisionArray);
+
+		/**
+		 * Perform the narrow phase of collision detection for the given candidate, re-using
+		 * a cached result if possible.  This may be called on any thread of the narrow phase.
+		 */
+		void ProcessCandidate(int candidateIndex, std::vector<NarrowphaseResult>& resultArray);
+
+		/**
+		 * Perform the narrow phase of collision detection for the pair of objects in the given collision.
+		 */
+		bool CalculateCollision(Collision* collision);
+
+		/**
+		 * This is the narrow phase for pairs in which one of the objects is a @ref TriangleMeshShape.
+		 * The other object is tested against only the triangles its bounding box overlaps.
+		 */
+		bool CalculateMeshCollision(Collision* collision);
+
+		/**
+		 * Of the triangles of the given mesh that the given convex shape overlaps and is in front of, find the one
+		 * the shape sinks deepest into, measured along the triangle's normal.  Only triangles whose boxes overlap
+		 * the given world box (which should bound the shape) are considered.
+		 *
+		 * @param[out] unitNormal This is set to the normal of the triangle found, if any.
+		 * @param[out] depth This is set to how far the shape must move along the normal to clear the triangle's plane.
+		 * @return True is returned if and only if such a triangle is found.
+		 */
+		static bool CalculateMeshPenetration(const TriangleMeshShape* meshShape, const GJKShape* shape, const AxisAlignedBoundingBox& worldBox, Vector3& unitNormal, double& depth);
+
+		/**
+		 * This is the narrow phase for pairs in which either object is a @ref GJKCompoundShape.  Only the pairs
+		 * of parts whose boxes overlap are tested, and each pair found in collision is recorded in the collision.
+		 */
+		bool CalculateCompoundCollision(Collision* collision);
+
+		/**
+		 * Calculate the separation delta of the given pair of convex parts, either of which may also be a
+		 * @ref TriangleMeshShape.  False is returned if they don't collide.
+		 */
+		static bool CalculatePartCollision(const GJKShape* shapeA, const GJKShape* shapeB, Vector3& separationDelta);
+
+		/**
+		 * Tell us if the given shapes intersect, where the second may be a @ref TriangleMeshShape,
+		 * and where either may be a @ref GJKCompoundShape.
+		 */
+		static bool ShapesIntersect(const GJKShape* shape, const GJKShape* obstacleShape);
+
+		/**
+		 * This is just like @ref GJKShape::Distance, except that either shape may be a @ref GJKCompoundShape,
+		 * in which case the distance is that between the nearest parts.  The simplex is only used when neither is.
+		 */
+		static bool CalculateDistance(const GJKShape* shape, const GJKShape* obstacleShape, Vector3& closestPoint, Vector3& closestObstaclePoint, double& distance, GJKSimplex* cachedSimplex);
+
+		/**
+		 * Return the radius of a sphere about the object-space origin of the given shape that bounds it.
+		 */
+		static double CalcBoundingRadius(const GJKShape* shape);
+
+		/**
+		 * Set up a stand-in for each convex part of the given shape, for a query to place and test in its stead.
+		 * False is returned, and nothing set up, if the shape is a @ref TriangleMeshShape.
+		 */
+		static bool MakeQueryParts(const GJKShape* shape, std::vector<GJKTransformedShape>& partArray);
+
+		/**
+		 * Tell us if the given object is one the given query filter accepts.  Only collision objects are ever accepted.
+		 */
+		bool PassesQueryFilter(const BVHObject* object, const QueryFilter& queryFilter) const;
+
+		/**
+		 * Find all objects of the broad phase whose boxes overlap the given box, and which the given filter accepts.
+		 * The filter is checked as the tree is traversed.  The tree isn't changed, so this may be called from any thread.
+		 */
+		void FindFilteredObjects(const AxisAlignedBoundingBox& worldBox, const QueryFilter& queryFilter, std::vector<BVHObject*>& objectArray) const;
+
+		/**
+		 * Tell us if collision records are maintained by the broad phase through the pair callbacks.
+		 */
+		bool HasPersistentPairs() const;
+
+		void HandlePairAdded(BVHObject* objectA, BVHObject* objectB);
+		void HandlePairRemoved(BVHObject* objectA, BVHObject* objectB);
 
 		Reference<BVHTree> boxTree;
+		BroadphaseType broadphaseType;
 		std::unordered_map<RefHandle, Reference<CollisionObject>> collisionObjectMap;
-		std::unordered_map<std::string, Reference<Collision>> collisionCacheMap;
+		PairCache collisionCacheMap;
+		std::vector<BVHTree::ObjectPair> objectPairArray;
+		std::vector<BVHObject*> foundObjectArray;
+		std::vector<NarrowphaseCandidate> candidateArray;
+		std::vector<std::vector<NarrowphaseResult>> narrowphaseBufferArray;
+		std::unique_ptr<WorkerPool> workerPool;
+		PairFilter pairFilter;
+		uint64_t queryNumber;
 		int collisionWindowCookie;
 	};
 }
\ No newline at end of file
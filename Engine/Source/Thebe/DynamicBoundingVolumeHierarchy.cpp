@@ -0,0 +1,1026 @@
+#include "Thebe/DynamicBoundingVolumeHierarchy.h"
+#include "Thebe/Log.h"
+#include <limits>
+#include <immintrin.h>
+
+using namespace Thebe;
+
+//---------------------------------------- DynamicBVHTree ----------------------------------------
+
+DynamicBVHTree::DynamicBVHTree()
+{
+	this->rootIndex = -1;
+	this->freeIndex = -1;
+	this->numLeaves = 0;
+	this->fatMargin = 0.1;
+	this->flatNodesDirty = true;
+}
+
+/*virtual*/ DynamicBVHTree::~DynamicBVHTree()
+{
+	this->RemoveAllObjects();
+}
+
+void DynamicBVHTree::SetFatMargin(double fatMargin)
+{
+	this->fatMargin = THEBE_MAX(fatMargin, 0.0);
+}
+
+double DynamicBVHTree::GetFatMargin() const
+{
+	return this->fatMargin;
+}
+
+/*virtual*/ bool DynamicBVHTree::AddObject(BVHObject* object)
+{
+	if (!object)
+		return false;
+
+	if (object->IsInBVH())
+	{
+		THEBE_LOG("Given object is already in a tree.");
+		return false;
+	}
+
+	AxisAlignedBoundingBox objectBox = object->GetWorldBoundingBox();
+	if (!this->worldBox.ContainsBox(objectBox))
+		return false;
+
+	int leafIndex = this->AllocateNode();
+	Node& leaf = this->nodeArray[leafIndex];
+	leaf.height = 0;
+	leaf.object = object;
+	leaf.objectBox = objectBox;
+	leaf.box = this->MakeFatBox(objectBox);
+	this->InsertLeaf(leafIndex);
+	this->numLeaves++;
+
+	this->SetObjectTree(object, this);
+	object->proxyIndex = leafIndex;
+
+	return true;
+}
+
+/*virtual*/ bool DynamicBVHTree::RemoveObject(BVHObject* object)
+{
+	if (!object)
+		return false;
+
+	if (!this->OwnsObject(object))
+	{
+		THEBE_LOG("Given object is not in this tree.");
+		return false;
+	}
+
+	int leafIndex = object->proxyIndex;
+	this->RemoveLeaf(leafIndex);
+	this->FreeNode(leafIndex);
+	this->numLeaves--;
+
+	this->SetObjectTree(object, nullptr);
+	object->proxyIndex = -1;
+
+	return true;
+}
+
+/*virtual*/ void DynamicBVHTree::RemoveAllObjects()
+{
+	for (Node& node : this->nodeArray)
+	{
+		if (node.object.Get())
+		{
+			this->SetObjectTree(node.object, nullptr);
+			node.object->proxyIndex = -1;
+		}
+	}
+
+	this->nodeArray.clear();
+	this->rootIndex = -1;
+	this->freeIndex = -1;
+	this->numLeaves = 0;
+	this->flatNodesDirty = true;
+}
+
+/*virtual*/ bool DynamicBVHTree::UpdateObject(BVHObject* object, bool /*allowCuts*/)
+{
+	if (!this->OwnsObject(object))
+		return false;
+
+	int leafIndex = object->proxyIndex;
+	AxisAlignedBoundingBox objectBox = object->GetWorldBoundingBox();
+
+	if (!this->worldBox.ContainsBox(objectBox))
+	{
+		this->RemoveObject(object);
+		return false;
+	}
+
+	Node& leaf = this->nodeArray[leafIndex];
+	leaf.objectBox = objectBox;
+
+	// Most of the time a moving object is still inside its fat box, and there is nothing more to do.
+	if (leaf.box.ContainsBox(objectBox))
+		return true;
+
+	this->RemoveLeaf(leafIndex);
+	this->nodeArray[leafIndex].box = this->MakeFatBox(objectBox);
+	this->InsertLeaf(leafIndex);
+
+	return true;
+}
+
+/*virtual*/ void DynamicBVHTree::FindObjects(const AxisAlignedBoundingBox& worldBox, std::list<BVHObject*>& objectList) const
+{
+	objectList.clear();
+	if (this->rootIndex == -1)
+		return;
+
+	std::vector<int> nodeStack;
+	nodeStack.reserve(64);
+	nodeStack.push_back(this->rootIndex);
+	while (nodeStack.size() > 0)
+	{
+		const Node& node = this->nodeArray[nodeStack.back()];
+		nodeStack.pop_back();
+
+		if (!Overlaps(node.box, worldBox))
+			continue;
+
+		if (node.IsLeaf())
+		{
+			if (Overlaps(node.objectBox, worldBox))
+				objectList.push_back(const_cast<BVHObject*>(node.object.Get()));
+		}
+		else
+		{
+			nodeStack.push_back(node.childIndex[0]);
+			nodeStack.push_back(node.childIndex[1]);
+		}
+	}
+}
+
+/*virtual*/ void DynamicBVHTree::FindObjects(const AxisAlignedBoundingBox& worldBox, std::vector<BVHObject*>& objectArray, const ObjectFilter& objectFilter) const
+{
+	objectArray.clear();
+	if (this->rootIndex == -1)
+		return;
+
+	std::vector<int> nodeStack;
+	nodeStack.reserve(64);
+	nodeStack.push_back(this->rootIndex);
+	while (nodeStack.size() > 0)
+	{
+		const Node& node = this->nodeArray[nodeStack.back()];
+		nodeStack.pop_back();
+
+		if (!Overlaps(node.box, worldBox))
+			continue;
+
+		if (node.IsLeaf())
+		{
+			if (Overlaps(node.objectBox, worldBox) && (!objectFilter || objectFilter(node.object.Get())))
+				objectArray.push_back(const_cast<BVHObject*>(node.object.Get()));
+		}
+		else
+		{
+			nodeStack.push_back(node.childIndex[0]);
+			nodeStack.push_back(node.childIndex[1]);
+		}
+	}
+}
+
+/*virtual*/ void DynamicBVHTree::FindObjectsHitByRay(const Ray& ray, std::vector<BVHObject*>& objectArray) const
+{
+	objectArray.clear();
+	if (this->rootIndex == -1)
+		return;
+
+	// Note that the flat nodes used by the other ray casts are rebuilt on demand, so we steer clear of them here.
+	std::vector<int> nodeStack;
+	nodeStack.reserve(64);
+	nodeStack.push_back(this->rootIndex);
+	while (nodeStack.size() > 0)
+	{
+		const Node& node = this->nodeArray[nodeStack.back()];
+		nodeStack.pop_back();
+
+		Interval interval;
+		if (!ray.CastAgainst(node.box, interval))
+			continue;
+
+		if (node.IsLeaf())
+		{
+			if (ray.CastAgainst(node.objectBox, interval))
+				objectArray.push_back(const_cast<BVHObject*>(node.object.Get()));
+		}
+		else
+		{
+			nodeStack.push_back(node.childIndex[0]);
+			nodeStack.push_back(node.childIndex[1]);
+		}
+	}
+}
+
+/*virtual*/ BVHObject* DynamicBVHTree::FindNearestObjectHitByRay(const Ray& ray, double& alpha, Vector3& unitSurfaceNormal)
+{
+	if (this->rootIndex == -1)
+		return nullptr;
+
+	// See the note in CastRays about the height of the tree.
+	if (this->nodeArray[this->rootIndex].height + 2 > maxRayStackDepth)
+		return this->FindNearestObjectHitByRayOnHeap(ray, alpha, unitSurfaceNormal);
+
+	this->UpdateFlatNodes();
+
+	RayHit rayHit;
+	this->CastSingleRay(ray, rayHit);
+	if (rayHit.object)
+	{
+		alpha = rayHit.alpha;
+		unitSurfaceNormal = rayHit.unitSurfaceNormal;
+	}
+
+	return rayHit.object;
+}
+
+/*virtual*/ void DynamicBVHTree::CastRays(std::span<const Ray> rayArray, std::span<RayHit> rayHitArray)
+{
+	THEBE_ASSERT(rayHitArray.size() >= rayArray.size());
+
+	if (this->rootIndex == -1)
+	{
+		for (size_t i = 0; i < rayArray.size(); i++)
+			rayHitArray[i].object = nullptr;
+
+		return;
+	}
+
+	// The traversal stacks are fixed-size, which is plenty for any reasonably balanced tree.
+	// If the tree is somehow taller than that, just fall back on the slow path.
+	if (this->nodeArray[this->rootIndex].height + 2 > maxRayStackDepth)
+	{
+		BVHTree::CastRays(rayArray, rayHitArray);
+		return;
+	}
+
+	this->UpdateFlatNodes();
+
+	size_t i = 0;
+	for (; i + 4 <= rayArray.size(); i += 4)
+		this->CastRayPacket(&rayArray[i], &rayHitArray[i], 4);
+
+	if (i + 1 < rayArray.size())
+		this->CastRayPacket(&rayArray[i], &rayHitArray[i], int(rayArray.size() - i));
+	else if (i < rayArray.size())
+		this->CastSingleRay(rayArray[i], rayHitArray[i]);
+}
+
+void DynamicBVHTree::UpdateFlatNodes()
+{
+	if (!this->flatNodesDirty.load(std::memory_order_acquire))
+		return;
+
+	std::lock_guard<std::mutex> lock(this->flatNodeMutex);
+
+	if (!this->flatNodesDirty.load(std::memory_order_relaxed))
+		return;
+
+	this->flatNodeArray.clear();
+	this->flatNodeArray.reserve(2 * this->numLeaves);
+
+	if (this->rootIndex != -1)
+	{
+		struct Entry
+		{
+			int nodeIndex;
+			int parentFlatIndex;	///< If not -1, we're the second child of this flat node.
+		};
+
+		std::vector<Entry> nodeStack;
+		nodeStack.reserve(64);
+		nodeStack.push_back(Entry{ this->rootIndex, -1 });
+		while (nodeStack.size() > 0)
+		{
+			Entry entry = nodeStack.back();
+			nodeStack.pop_back();
+
+			int flatIndex = (int)this->flatNodeArray.size();
+			if (entry.parentFlatIndex != -1)
+				this->flatNodeArray[entry.parentFlatIndex].secondChildIndex = flatIndex;
+
+			const Node& node = this->nodeArray[entry.nodeIndex];
+
+			FlatNode flatNode;
+			flatNode.minCorner[0] = node.box.minCorner.x;
+			flatNode.minCorner[1] = node.box.minCorner.y;
+			flatNode.minCorner[2] = node.box.minCorner.z;
+			flatNode.maxCorner[0] = node.box.maxCorner.x;
+			flatNode.maxCorner[1] = node.box.maxCorner.y;
+			flatNode.maxCorner[2] = node.box.maxCorner.z;
+			flatNode.secondChildIndex = -1;
+			flatNode.leafIndex = node.IsLeaf() ? entry.nodeIndex : -1;
+			flatNode.splitAxis = 0;
+
+			if (!node.IsLeaf())
+			{
+				// Order the children along the axis that best separates their centers.
+				Vector3 delta = this->nodeArray[node.childIndex[1]].box.GetCenter() - this->nodeArray[node.childIndex[0]].box.GetCenter();
+				double component[3] = { delta.x, delta.y, delta.z };
+				for (int k = 1; k < 3; k++)
+					if (::fabs(component[k]) > ::fabs(component[flatNode.splitAxis]))
+						flatNode.splitAxis = k;
+
+				int firstChildIndex = node.childIndex[0];
+				int secondChildIndex = node.childIndex[1];
+				if (component[flatNode.splitAxis] < 0.0)
+					std::swap(firstChildIndex, secondChildIndex);
+
+				nodeStack.push_back(Entry{ secondChildIndex, flatIndex });
+				nodeStack.push_back(Entry{ firstChildIndex, -1 });
+			}
+
+			this->flatNodeArray.push_back(flatNode);
+		}
+	}
+
+	this->flatNodesDirty.store(false, std::memory_order_release);
+}
+
+void DynamicBVHTree::CastSingleRay(const Ray& ray, RayHit& rayHit)
+{
+	rayHit.object = nullptr;
+	rayHit.alpha = std::numeric_limits<double>::max();
+
+	if (this->flatNodeArray.size() == 0)
+		return;
+
+	double origin[3], inverseDirection[3];
+	MakeRayArrays(ray, origin, inverseDirection);
+
+	struct Entry
+	{
+		int flatIndex;
+		double alpha;
+	};
+
+	double entryAlpha = 0.0;
+	const FlatNode& rootNode = this->flatNodeArray[0];
+	if (!SlabTest(origin, inverseDirection, rootNode.minCorner, rootNode.maxCorner, rayHit.alpha, entryAlpha))
+		return;
+
+	Entry nodeStack[maxRayStackDepth];
+	int stackSize = 0;
+	nodeStack[stackSize++] = Entry{ 0, entryAlpha };
+	while (stackSize > 0)
+	{
+		Entry entry = nodeStack[--stackSize];
+
+		// Cull anything that can't possibly beat the hit we already have.
+		if (entry.alpha > rayHit.alpha)
+			continue;
+
+		const FlatNode& flatNode = this->flatNodeArray[entry.flatIndex];
+		if (flatNode.leafIndex != -1)
+		{
+			this->CastRayAgainstLeaf(flatNode.leafIndex, ray, origin, inverseDirection, rayHit);
+			continue;
+		}
+
+		// Push the farther child first so that the nearer one is visited first.
+		Entry childEntry[2];
+		int numChildEntries = 0;
+		int childIndexArray[2] = { entry.flatIndex + 1, flatNode.secondChildIndex };
+		for (int childIndex : childIndexArray)
+		{
+			const FlatNode& childNode = this->flatNodeArray[childIndex];
+			if (SlabTest(origin, inverseDirection, childNode.minCorner, childNode.maxCorner, rayHit.alpha, entryAlpha))
+				childEntry[numChildEntries++] = Entry{ childIndex, entryAlpha };
+		}
+
+		if (numChildEntries == 2 && childEntry[0].alpha < childEntry[1].alpha)
+			std::swap(childEntry[0], childEntry[1]);
+
+		for (int i = 0; i < numChildEntries; i++)
+			nodeStack[stackSize++] = childEntry[i];
+	}
+
+	if (!rayHit.object)
+		rayHit.alpha = 0.0;
+}
+
+BVHObject* DynamicBVHTree::FindNearestObjectHitByRayOnHeap(const Ray& ray, double& alpha, Vector3& unitSurfaceNormal)
+{
+	// This walks the tree itself, rather than the flat nodes, and keeps its stack on the heap, so it works however tall the tree is.
+	struct Entry
+	{
+		int nodeIndex;
+		double alpha;
+	};
+
+	Interval interval;
+	if (!ray.CastAgainst(this->nodeArray[this->rootIndex].box, interval))
+		return nullptr;
+
+	BVHObject* nearestHitObject = nullptr;
+	double nearestAlpha = std::numeric_limits<double>::max();
+
+	std::vector<Entry> nodeStack;
+	nodeStack.reserve(64);
+	nodeStack.push_back(Entry{ this->rootIndex, interval.A });
+	while (nodeStack.size() > 0)
+	{
+		Entry entry = nodeStack.back();
+		nodeStack.pop_back();
+
+		// Cull anything that can't possibly beat the hit we already have.
+		if (entry.alpha > nearestAlpha)
+			continue;
+
+		Node& node = this->nodeArray[entry.nodeIndex];
+		if (node.IsLeaf())
+		{
+			if (!ray.CastAgainst(node.objectBox, interval) || interval.A > nearestAlpha)
+				continue;
+
+			double tentativeAlpha = 0.0;
+			Vector3 tentativeSurfaceNormal;
+			if (node.object->RayCast(ray, tentativeAlpha, tentativeSurfaceNormal) && tentativeAlpha < nearestAlpha)
+			{
+				nearestAlpha = tentativeAlpha;
+				nearestHitObject = node.object.Get();
+				unitSurfaceNormal = tentativeSurfaceNormal;
+			}
+
+			continue;
+		}
+
+		// Push the farther child first so that the nearer one is visited first.
+		Entry childEntry[2];
+		int numChildEntries = 0;
+		for (int i = 0; i < 2; i++)
+			if (ray.CastAgainst(this->nodeArray[node.childIndex[i]].box, interval))
+				childEntry[numChildEntries++] = Entry{ node.childIndex[i], interval.A };
+
+		if (numChildEntries == 2 && childEntry[0].alpha < childEntry[1].alpha)
+			std::swap(childEntry[0], childEntry[1]);
+
+		for (int i = 0; i < numChildEntries; i++)
+			nodeStack.push_back(childEntry[i]);
+	}
+
+	if (nearestHitObject)
+		alpha = nearestAlpha;
+
+	return nearestHitObject;
+}
+
+void DynamicBVHTree::CastRayPacket(const Ray* rayArray, RayHit* rayHitArray, int numRays)
+{
+	THEBE_ASSERT(0 < numRays && numRays <= 4);
+
+	// Unused lanes get a nearest-hit distance below zero so that they never hit anything.
+	RayPacket packet;
+	double origin[4][3], inverseDirection[4][3];
+	double directionSum[3] = { 0.0, 0.0, 0.0 };
+	for (int i = 0; i < 4; i++)
+	{
+		if (i < numRays)
+		{
+			MakeRayArrays(rayArray[i], origin[i], inverseDirection[i]);
+			packet.nearestAlpha[i] = std::numeric_limits<double>::max();
+			rayHitArray[i].object = nullptr;
+			directionSum[0] += rayArray[i].unitDirection.x;
+			directionSum[1] += rayArray[i].unitDirection.y;
+			directionSum[2] += rayArray[i].unitDirection.z;
+		}
+		else
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				origin[i][k] = 0.0;
+				inverseDirection[i][k] = 1.0;
+			}
+
+			packet.nearestAlpha[i] = -1.0;
+		}
+
+		for (int k = 0; k < 3; k++)
+		{
+			packet.origin[k][i] = origin[i][k];
+			packet.inverseDirection[k][i] = inverseDirection[i][k];
+		}
+	}
+
+	// Each node is visited front-to-back with respect to the average direction of the packet.
+	int nodeStack[maxRayStackDepth];
+	int stackSize = 0;
+	nodeStack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		int flatIndex = nodeStack[--stackSize];
+		const FlatNode& flatNode = this->flatNodeArray[flatIndex];
+
+		int hitMask = SlabTestPacket(packet, flatNode);
+		if (hitMask == 0)
+			continue;
+
+		if (flatNode.leafIndex != -1)
+		{
+			for (int i = 0; i < numRays; i++)
+			{
+				if ((hitMask & (1 << i)) == 0)
+					continue;
+
+				RayHit& rayHit = rayHitArray[i];
+				rayHit.alpha = packet.nearestAlpha[i];
+				if (this->CastRayAgainstLeaf(flatNode.leafIndex, rayArray[i], origin[i], inverseDirection[i], rayHit))
+					packet.nearestAlpha[i] = rayHit.alpha;
+			}
+
+			continue;
+		}
+
+		if (directionSum[flatNode.splitAxis] >= 0.0)
+		{
+			nodeStack[stackSize++] = flatNode.secondChildIndex;
+			nodeStack[stackSize++] = flatIndex + 1;
+		}
+		else
+		{
+			nodeStack[stackSize++] = flatIndex + 1;
+			nodeStack[stackSize++] = flatNode.secondChildIndex;
+		}
+	}
+
+	for (int i = 0; i < numRays; i++)
+	{
+		if (rayHitArray[i].object)
+			rayHitArray[i].alpha = packet.nearestAlpha[i];
+		else
+			rayHitArray[i].alpha = 0.0;
+	}
+}
+
+bool DynamicBVHTree::CastRayAgainstLeaf(int leafIndex, const Ray& ray, const double* origin, const double* inverseDirection, RayHit& rayHit) const
+{
+	// The flat nodes hold the fat boxes, so check the tight box of the object before bothering with the object itself.
+	const Node& leaf = this->nodeArray[leafIndex];
+	double minCorner[3] = { leaf.objectBox.minCorner.x, leaf.objectBox.minCorner.y, leaf.objectBox.minCorner.z };
+	double maxCorner[3] = { leaf.objectBox.maxCorner.x, leaf.objectBox.maxCorner.y, leaf.objectBox.maxCorner.z };
+	double entryAlpha = 0.0;
+	if (!SlabTest(origin, inverseDirection, minCorner, maxCorner, rayHit.alpha, entryAlpha))
+		return false;
+
+	double alpha = 0.0;
+	Vector3 unitSurfaceNormal;
+	if (!leaf.object->RayCast(ray, alpha, unitSurfaceNormal) || alpha >= rayHit.alpha)
+		return false;
+
+	rayHit.object = const_cast<BVHObject*>(leaf.object.Get());
+	rayHit.alpha = alpha;
+	rayHit.unitSurfaceNormal = unitSurfaceNormal;
+	return true;
+}
+
+/*static*/ void DynamicBVHTree::MakeRayArrays(const Ray& ray, double* origin, double* inverseDirection)
+{
+	origin[0] = ray.origin.x;
+	origin[1] = ray.origin.y;
+	origin[2] = ray.origin.z;
+
+	// A zero direction component would give us 0 * inf = NaN in the slab test when the ray
+	// origin is in the plane of a slab, so we use a huge, but finite, inverse instead.
+	double direction[3] = { ray.unitDirection.x, ray.unitDirection.y, ray.unitDirection.z };
+	for (int k = 0; k < 3; k++)
+	{
+		if (direction[k] != 0.0)
+			inverseDirection[k] = 1.0 / direction[k];
+		else
+			inverseDirection[k] = ::copysign(1e300, direction[k]);
+	}
+}
+
+/*static*/ bool DynamicBVHTree::SlabTest(const double* origin, const double* inverseDirection, const double* minCorner, const double* maxCorner, double maxAlpha, double& entryAlpha)
+{
+	double exitAlpha = maxAlpha;
+	entryAlpha = 0.0;
+
+	for (int k = 0; k < 3; k++)
+	{
+		double alphaA = (minCorner[k] - origin[k]) * inverseDirection[k];
+		double alphaB = (maxCorner[k] - origin[k]) * inverseDirection[k];
+
+		entryAlpha = THEBE_MAX(entryAlpha, THEBE_MIN(alphaA, alphaB));
+		exitAlpha = THEBE_MIN(exitAlpha, THEBE_MAX(alphaA, alphaB));
+	}
+
+	return entryAlpha <= exitAlpha;
+}
+
+/*static*/ int DynamicBVHTree::SlabTestPacket(const RayPacket& packet, const FlatNode& flatNode)
+{
+	// This is the same as the single-ray slab test, but for four rays at once.
+	// Bit i of the returned mask is set if and only if ray i hits the given node
+	// somewhere before its nearest hit so far.
+
+#if defined(__AVX__)
+	__m256d entryAlpha = _mm256_setzero_pd();
+	__m256d exitAlpha = _mm256_load_pd(packet.nearestAlpha);
+
+	for (int k = 0; k < 3; k++)
+	{
+		__m256d origin = _mm256_load_pd(packet.origin[k]);
+		__m256d inverseDirection = _mm256_load_pd(packet.inverseDirection[k]);
+		__m256d alphaA = _mm256_mul_pd(_mm256_sub_pd(_mm256_set1_pd(flatNode.minCorner[k]), origin), inverseDirection);
+		__m256d alphaB = _mm256_mul_pd(_mm256_sub_pd(_mm256_set1_pd(flatNode.maxCorner[k]), origin), inverseDirection);
+		entryAlpha = _mm256_max_pd(entryAlpha, _mm256_min_pd(alphaA, alphaB));
+		exitAlpha = _mm256_min_pd(exitAlpha, _mm256_max_pd(alphaA, alphaB));
+	}
+
+	return _mm256_movemask_pd(_mm256_cmp_pd(entryAlpha, exitAlpha, _CMP_LE_OQ));
+#else
+	__m128d entryAlpha[2] = { _mm_setzero_pd(), _mm_setzero_pd() };
+	__m128d exitAlpha[2] = { _mm_load_pd(&packet.nearestAlpha[0]), _mm_load_pd(&packet.nearestAlpha[2]) };
+
+	for (int k = 0; k < 3; k++)
+	{
+		__m128d minCorner = _mm_set1_pd(flatNode.minCorner[k]);
+		__m128d maxCorner = _mm_set1_pd(flatNode.maxCorner[k]);
+
+		for (int j = 0; j < 2; j++)
+		{
+			__m128d origin = _mm_load_pd(&packet.origin[k][2 * j]);
+			__m128d inverseDirection = _mm_load_pd(&packet.inverseDirection[k][2 * j]);
+			__m128d alphaA = _mm_mul_pd(_mm_sub_pd(minCorner, origin), inverseDirection);
+			__m128d alphaB = _mm_mul_pd(_mm_sub_pd(maxCorner, origin), inverseDirection);
+			entryAlpha[j] = _mm_max_pd(entryAlpha[j], _mm_min_pd(alphaA, alphaB));
+			exitAlpha[j] = _mm_min_pd(exitAlpha[j], _mm_max_pd(alphaA, alphaB));
+		}
+	}
+
+	return _mm_movemask_pd(_mm_cmple_pd(entryAlpha[0], exitAlpha[0])) | (_mm_movemask_pd(_mm_cmple_pd(entryAlpha[1], exitAlpha[1])) << 2);
+#endif
+}
+
+/*virtual*/ void DynamicBVHTree::FindAllOverlappingPairs(std::vector<ObjectPair>& pairArray)
+{
+	pairArray.clear();
+	if (this->rootIndex == -1)
+		return;
+
+	// Traverse the tree against itself.  A pair of identical nodes means we must look for
+	// overlaps within that sub-tree, which amounts to looking within each child and then
+	// across the two children.  A pair of distinct nodes means we look for overlaps between
+	// the two sub-trees, which can only happen where their boxes overlap.  Since distinct
+	// leaves are only ever paired once in this scheme, each object pair is reported once.
+	this->nodePairStack.clear();
+	this->nodePairStack.push_back(NodePair{ this->rootIndex, this->rootIndex });
+	while (this->nodePairStack.size() > 0)
+	{
+		NodePair nodePair = this->nodePairStack.back();
+		this->nodePairStack.pop_back();
+
+		const Node& nodeA = this->nodeArray[nodePair.nodeIndexA];
+		const Node& nodeB = this->nodeArray[nodePair.nodeIndexB];
+
+		if (nodePair.nodeIndexA == nodePair.nodeIndexB)
+		{
+			if (nodeA.IsLeaf())
+				continue;
+
+			this->nodePairStack.push_back(NodePair{ nodeA.childIndex[0], nodeA.childIndex[0] });
+			this->nodePairStack.push_back(NodePair{ nodeA.childIndex[1], nodeA.childIndex[1] });
+			this->nodePairStack.push_back(NodePair{ nodeA.childIndex[0], nodeA.childIndex[1] });
+			continue;
+		}
+
+		if (!Overlaps(nodeA.box, nodeB.box))
+			continue;
+
+		if (nodeA.IsLeaf() && nodeB.IsLeaf())
+		{
+			if (Overlaps(nodeA.objectBox, nodeB.objectBox) && this->ShouldPair(nodeA.object.Get(), nodeB.object.Get()))
+				pairArray.push_back(ObjectPair{ const_cast<BVHObject*>(nodeA.object.Get()), const_cast<BVHObject*>(nodeB.object.Get()) });
+
+			continue;
+		}
+
+		// Descend into the larger of the two nodes.
+		if (nodeB.IsLeaf() || (!nodeA.IsLeaf() && nodeA.box.GetSurfaceArea() >= nodeB.box.GetSurfaceArea()))
+		{
+			this->nodePairStack.push_back(NodePair{ nodeA.childIndex[0], nodePair.nodeIndexB });
+			this->nodePairStack.push_back(NodePair{ nodeA.childIndex[1], nodePair.nodeIndexB });
+		}
+		else
+		{
+			this->nodePairStack.push_back(NodePair{ nodePair.nodeIndexA, nodeB.childIndex[0] });
+			this->nodePairStack.push_back(NodePair{ nodePair.nodeIndexA, nodeB.childIndex[1] });
+		}
+	}
+}
+
+/*virtual*/ void DynamicBVHTree::GatherStats(Stats& stats) const
+{
+	stats.numNodes = 0;
+	stats.numObjects = this->numLeaves;
+	stats.maxDepth = 0;
+
+	for (const Node& node : this->nodeArray)
+		if (node.height >= 0)
+			stats.numNodes++;
+
+	if (this->rootIndex != -1)
+		stats.maxDepth = this->nodeArray[this->rootIndex].height + 1;
+}
+
+int DynamicBVHTree::AllocateNode()
+{
+	if (this->freeIndex == -1)
+	{
+		this->nodeArray.push_back(Node());
+		return int(this->nodeArray.size()) - 1;
+	}
+
+	int i = this->freeIndex;
+	Node& node = this->nodeArray[i];
+	this->freeIndex = node.nextFreeIndex;
+	node.nextFreeIndex = -1;
+	node.parentIndex = -1;
+	node.childIndex[0] = -1;
+	node.childIndex[1] = -1;
+	node.height = 0;
+	return i;
+}
+
+void DynamicBVHTree::FreeNode(int i)
+{
+	Node& node = this->nodeArray[i];
+	node.object = nullptr;
+	node.parentIndex = -1;
+	node.childIndex[0] = -1;
+	node.childIndex[1] = -1;
+	node.height = -1;
+	node.nextFreeIndex = this->freeIndex;
+	this->freeIndex = i;
+}
+
+void DynamicBVHTree::InsertLeaf(int leafIndex)
+{
+	this->flatNodesDirty = true;
+
+	if (this->rootIndex == -1)
+	{
+		this->rootIndex = leafIndex;
+		this->nodeArray[leafIndex].parentIndex = -1;
+		return;
+	}
+
+	// Descend the tree looking for the best sibling of the new leaf.  The cost of a
+	// choice is the surface area of the new parent node plus the increase in surface
+	// area inherited by all the ancestors that must grow to contain the new leaf.
+	AxisAlignedBoundingBox leafBox = this->nodeArray[leafIndex].box;
+	int i = this->rootIndex;
+	while (!this->nodeArray[i].IsLeaf())
+	{
+		const Node& node = this->nodeArray[i];
+
+		double area = node.box.GetSurfaceArea();
+		double combinedArea = Union(node.box, leafBox).GetSurfaceArea();
+
+		double cost = 2.0 * combinedArea;
+		double inheritanceCost = 2.0 * (combinedArea - area);
+
+		double childCost[2];
+		for (int j = 0; j < 2; j++)
+		{
+			const Node& child = this->nodeArray[node.childIndex[j]];
+			double unionArea = Union(child.box, leafBox).GetSurfaceArea();
+			if (child.IsLeaf())
+				childCost[j] = unionArea + inheritanceCost;
+			else
+				childCost[j] = (unionArea - child.box.GetSurfaceArea()) + inheritanceCost;
+		}
+
+		if (cost < childCost[0] && cost < childCost[1])
+			break;
+
+		i = (childCost[0] < childCost[1]) ? node.childIndex[0] : node.childIndex[1];
+	}
+
+	int siblingIndex = i;
+
+	// Note that we must be careful not to hold references into the node array across this allocation.
+	int newParentIndex = this->AllocateNode();
+	int oldParentIndex = this->nodeArray[siblingIndex].parentIndex;
+
+	Node& newParent = this->nodeArray[newParentIndex];
+	newParent.parentIndex = oldParentIndex;
+	newParent.box = Union(leafBox, this->nodeArray[siblingIndex].box);
+	newParent.height = this->nodeArray[siblingIndex].height + 1;
+	newParent.childIndex[0] = siblingIndex;
+	newParent.childIndex[1] = leafIndex;
+
+	this->nodeArray[siblingIndex].parentIndex = newParentIndex;
+	this->nodeArray[leafIndex].parentIndex = newParentIndex;
+
+	if (oldParentIndex == -1)
+		this->rootIndex = newParentIndex;
+	else
+	{
+		Node& oldParent = this->nodeArray[oldParentIndex];
+		if (oldParent.childIndex[0] == siblingIndex)
+			oldParent.childIndex[0] = newParentIndex;
+		else
+			oldParent.childIndex[1] = newParentIndex;
+	}
+
+	this->Refit(newParentIndex);
+}
+
+void DynamicBVHTree::RemoveLeaf(int leafIndex)
+{
+	this->flatNodesDirty = true;
+
+	if (leafIndex == this->rootIndex)
+	{
+		this->rootIndex = -1;
+		return;
+	}
+
+	int parentIndex = this->nodeArray[leafIndex].parentIndex;
+	const Node& parent = this->nodeArray[parentIndex];
+	int grandParentIndex = parent.parentIndex;
+	int siblingIndex = (parent.childIndex[0] == leafIndex) ? parent.childIndex[1] : parent.childIndex[0];
+
+	if (grandParentIndex == -1)
+	{
+		this->rootIndex = siblingIndex;
+		this->nodeArray[siblingIndex].parentIndex = -1;
+		this->FreeNode(parentIndex);
+	}
+	else
+	{
+		Node& grandParent = this->nodeArray[grandParentIndex];
+		if (grandParent.childIndex[0] == parentIndex)
+			grandParent.childIndex[0] = siblingIndex;
+		else
+			grandParent.childIndex[1] = siblingIndex;
+
+		this->nodeArray[siblingIndex].parentIndex = grandParentIndex;
+		this->FreeNode(parentIndex);
+
+		this->Refit(grandParentIndex);
+	}
+
+	this->nodeArray[leafIndex].parentIndex = -1;
+}
+
+void DynamicBVHTree::Refit(int i)
+{
+	// Walk back up the tree, re-balancing and re-fitting boxes as we go.
+	while (i != -1)
+	{
+		i = this->Balance(i);
+
+		Node& node = this->nodeArray[i];
+		const Node& childA = this->nodeArray[node.childIndex[0]];
+		const Node& childB = this->nodeArray[node.childIndex[1]];
+
+		node.height = 1 + THEBE_MAX(childA.height, childB.height);
+		node.box = Union(childA.box, childB.box);
+
+		i = node.parentIndex;
+	}
+}
+
+int DynamicBVHTree::Balance(int iA)
+{
+	/*
+	 * If node A is out of balance, rotate its taller child (C or B) up into its place.
+	 *
+	 *        A
+	 *      /   \
+	 *     B     C
+	 *          / \
+	 *         F   G
+	 */
+	Node& A = this->nodeArray[iA];
+	if (A.IsLeaf() || A.height < 2)
+		return iA;
+
+	int iB = A.childIndex[0];
+	int iC = A.childIndex[1];
+	Node& B = this->nodeArray[iB];
+	Node& C = this->nodeArray[iC];
+
+	int balance = C.height - B.height;
+
+	auto rotateUp = [this, &A, iA](Node& X, int iX, Node& other, int slotOfX) -> int
+		{
+			int iF = X.childIndex[0];
+			int iG = X.childIndex[1];
+			Node& F = this->nodeArray[iF];
+			Node& G = this->nodeArray[iG];
+
+			// Swap A and X.
+			X.childIndex[0] = iA;
+			X.parentIndex = A.parentIndex;
+			A.parentIndex = iX;
+
+			if (X.parentIndex == -1)
+				this->rootIndex = iX;
+			else
+			{
+				Node& parent = this->nodeArray[X.parentIndex];
+				if (parent.childIndex[0] == iA)
+					parent.childIndex[0] = iX;
+				else
+					parent.childIndex[1] = iX;
+			}
+
+			// Keep the taller grand-child up with X and hand the shorter one down to A.
+			int iKeep = iF, iGive = iG;
+			if (F.height < G.height)
+			{
+				iKeep = iG;
+				iGive = iF;
+			}
+
+			Node& keep = this->nodeArray[iKeep];
+			Node& give = this->nodeArray[iGive];
+
+			X.childIndex[1] = iKeep;
+			A.childIndex[slotOfX] = iGive;
+			give.parentIndex = iA;
+
+			A.box = Union(other.box, give.box);
+			X.box = Union(A.box, keep.box);
+
+			A.height = 1 + THEBE_MAX(other.height, give.height);
+			X.height = 1 + THEBE_MAX(A.height, keep.height);
+
+			return iX;
+		};
+
+	if (balance > 1)
+		return rotateUp(C, iC, B, 1);
+
+	if (balance < -1)
+		return rotateUp(B, iB, C, 0);
+
+	return iA;
+}
+
+AxisAlignedBoundingBox DynamicBVHTree::MakeFatBox(const AxisAlignedBoundingBox& objectBox) const
+{
+	AxisAlignedBoundingBox fatBox;
+	Vector3 delta(this->fatMargin, this->fatMargin, this->fatMargin);
+	fatBox.minCorner = objectBox.minCorner - delta;
+	fatBox.maxCorner = objectBox.maxCorner + delta;
+	return fatBox;
+}
+
+/*static*/ AxisAlignedBoundingBox DynamicBVHTree::Union(const AxisAlignedBoundingBox& boxA, const AxisAlignedBoundingBox& boxB)
+{
+	AxisAlignedBoundingBox box;
+
+	box.minCorner.x = THEBE_MIN(boxA.minCorner.x, boxB.minCorner.x);
+	box.minCorner.y = THEBE_MIN(boxA.minCorner.y, boxB.minCorner.y);
+	box.minCorner.z = THEBE_MIN(boxA.minCorner.z, boxB.minCorner.z);
+
+	box.maxCorner.x = THEBE_MAX(boxA.maxCorner.x, boxB.maxCorner.x);
+	box.maxCorner.y = THEBE_MAX(boxA.maxCorner.y, boxB.maxCorner.y);
+	box.maxCorner.z = THEBE_MAX(boxA.maxCorner.z, boxB.maxCorner.z);
+
+	return box;
+}
+
+/*static*/ bool DynamicBVHTree::Overlaps(const AxisAlignedBoundingBox& boxA, const AxisAlignedBoundingBox& boxB)
+{
+	if (boxA.maxCorner.x < boxB.minCorner.x || boxB.maxCorner.x < boxA.minCorner.x)
+		return false;
+
+	if (boxA.maxCorner.y < boxB.minCorner.y || boxB.maxCorner.y < boxA.minCorner.y)
+		return false;
+
+	if (boxA.maxCorner.z < boxB.minCorner.z || boxB.maxCorner.z < boxA.minCorner.z)
+		return false;
+
+	return true;
+}
+
+//---------------------------------------- DynamicBVHTree::Node ----------------------------------------
+
+DynamicBVHTree::Node::Node()
+{
+	this->parentIndex = -1;
+	this->childIndex[0] = -1;
+	this->childIndex[1] = -1;
+	this->height = 0;
+	this->nextFreeIndex = -1;
+}
+
+bool DynamicBVHTree::Node::IsLeaf() const
+{
+	return this->childIndex[0] == -1;
+}
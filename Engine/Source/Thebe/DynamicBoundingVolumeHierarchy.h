@@ -0,0 +1,135 @@
+#pragma once
+
+#include "Thebe/BoundingVolumeHierarchy.h"
+#include <atomic>
+#include <mutex>
+
+namespace Thebe
+{
+	/**
+	 * This is a dynamic AABB tree.  Unlike the @ref SplitBoxBVHTree, the node boxes
+	 * here are not a fixed subdivision of the world box.  Rather, every object gets its
+	 * own leaf, and every internal node tightly bounds its two children.  Leaves store
+	 * a fattened version of their object's box so that small motions of an object do
+	 * not require any change to the tree at all.  When an object does leave its fat box,
+	 * its leaf is removed and re-inserted, which costs O(log N) refits on the way back up
+	 * to the root.  Insertion chooses a sibling using the surface area heuristic (SAH),
+	 * and tree rotations are applied during refits to keep the tree balanced.
+	 *
+	 * All nodes live in a contiguous pool and refer to one another by index.
+	 *
+	 * For ray casting, a compact copy of the tree is kept in depth-first order (see
+	 * @ref CastRays), rebuilt lazily the first time rays are cast after the tree changes.
+	 */
+	class THEBE_API DynamicBVHTree : public BVHTree
+	{
+	public:
+		DynamicBVHTree();
+		virtual ~DynamicBVHTree();
+
+		virtual bool AddObject(BVHObject* object) override;
+		virtual bool RemoveObject(BVHObject* object) override;
+		virtual void RemoveAllObjects() override;
+		virtual bool UpdateObject(BVHObject* object, bool allowCuts) override;
+		virtual void FindObjects(const AxisAlignedBoundingBox& worldBox, std::list<BVHObject*>& objectList) const override;
+		virtual void FindObjects(const AxisAlignedBoundingBox& worldBox, std::vector<BVHObject*>& objectArray, const ObjectFilter& objectFilter) const override;
+		virtual void FindObjectsHitByRay(const Ray& ray, std::vector<BVHObject*>& objectArray) const override;
+		virtual BVHObject* FindNearestObjectHitByRay(const Ray& ray, double& alpha, Vector3& unitSurfaceNormal) override;
+		virtual void FindAllOverlappingPairs(std::vector<ObjectPair>& pairArray) override;
+		virtual void GatherStats(Stats& stats) const override;
+
+		/**
+		 * Rays are traced in packets of four, with the slab tests of all four rays against
+		 * a node done at once using SIMD instructions (AVX if enabled at compile time, SSE2
+		 * otherwise.)  A packet descends into a node if any of its rays hits the node, so
+		 * packets work best when their rays are coherent.  Two or three left-over rays make up a final
+		 * packet with its unused lanes masked off, and a single left-over ray takes the single-ray path.
+		 */
+		virtual void CastRays(std::span<const Ray> rayArray, std::span<RayHit> rayHitArray) override;
+
+		/**
+		 * Set the amount by which leaf boxes are grown on every side beyond the tight
+		 * bounds of their object.  Larger margins mean fewer re-insertions of moving
+		 * objects, but also more false-positives when querying the tree.
+		 */
+		void SetFatMargin(double fatMargin);
+		double GetFatMargin() const;
+
+	private:
+
+		struct Node
+		{
+			Node();
+
+			bool IsLeaf() const;
+
+			AxisAlignedBoundingBox box;				///< For leaves, this is the fattened box of the object; otherwise, the union of the child boxes.
+			AxisAlignedBoundingBox objectBox;		///< For leaves, this is the tight box of the object as of its last update.
+			Reference<BVHObject> object;
+			int parentIndex;
+			int childIndex[2];
+			int height;								///< Leaves have height zero; free nodes have height -1.
+			int nextFreeIndex;
+		};
+
+		int AllocateNode();
+		void FreeNode(int i);
+		void InsertLeaf(int leafIndex);
+		void RemoveLeaf(int leafIndex);
+		void Refit(int i);
+		int Balance(int i);
+		AxisAlignedBoundingBox MakeFatBox(const AxisAlignedBoundingBox& objectBox) const;
+
+		static AxisAlignedBoundingBox Union(const AxisAlignedBoundingBox& boxA, const AxisAlignedBoundingBox& boxB);
+		static bool Overlaps(const AxisAlignedBoundingBox& boxA, const AxisAlignedBoundingBox& boxB);
+
+		struct NodePair
+		{
+			int nodeIndexA;
+			int nodeIndexB;
+		};
+
+		/**
+		 * This is a node of the tree as laid out for ray casting.  The first child of a
+		 * node immediately follows it in the array, so only the second child's index is stored.
+		 * Children are ordered along the split axis so that rays can visit the nearer one first.
+		 */
+		struct alignas(64) FlatNode
+		{
+			double minCorner[3];
+			double maxCorner[3];
+			int secondChildIndex;		///< This is -1 for leaves.
+			int leafIndex;				///< For leaves, this is the index of the leaf in the node array; -1, otherwise.
+			int splitAxis;				///< This is the axis along which the first child comes before the second.
+		};
+
+		struct RayPacket
+		{
+			alignas(32) double origin[3][4];
+			alignas(32) double inverseDirection[3][4];
+			alignas(32) double nearestAlpha[4];
+		};
+
+		static constexpr int maxRayStackDepth = 128;
+
+		void UpdateFlatNodes();
+		void CastRayPacket(const Ray* rayArray, RayHit* rayHitArray, int numRays);
+		void CastSingleRay(const Ray& ray, RayHit& rayHit);
+		BVHObject* FindNearestObjectHitByRayOnHeap(const Ray& ray, double& alpha, Vector3& unitSurfaceNormal);
+		bool CastRayAgainstLeaf(int leafIndex, const Ray& ray, const double* origin, const double* inverseDirection, RayHit& rayHit) const;
+
+		static int SlabTestPacket(const RayPacket& packet, const FlatNode& flatNode);
+		static bool SlabTest(const double* origin, const double* inverseDirection, const double* minCorner, const double* maxCorner, double maxAlpha, double& entryAlpha);
+		static void MakeRayArrays(const Ray& ray, double* origin, double* inverseDirection);
+
+		std::vector<Node> nodeArray;
+		std::vector<NodePair> nodePairStack;
+		std::vector<FlatNode> flatNodeArray;
+		std::atomic<bool> flatNodesDirty;
+		std::mutex flatNodeMutex;
+		int rootIndex;
+		int freeIndex;
+		int numLeaves;
+		double fatMargin;
+	};
+}
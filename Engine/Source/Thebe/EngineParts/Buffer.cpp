@@ -551,7 +551,7 @@ UINT64 Buffer::GetBytesPerPixel()
 	Reference<VertexBuffer>& vertexBuffer)
 {
 	PolygonMesh polygonMesh;
-	if (!polygonMesh.GenerateConvexHull(pointArray))
+	if (!polygonMesh.GenerateConvexHull(pointArray, false))
 		return false;
 
 	const std::vector<PolygonMesh::Polygon>& polygonArray = polygonMesh.GetPolygonArray();
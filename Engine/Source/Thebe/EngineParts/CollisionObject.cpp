@@ -2,6 +2,8 @@
 #include "Thebe/EngineParts/DynamicLineRenderer.h"
 #include "Thebe/EngineParts/Space.h"
 #include "Thebe/Utilities/JsonHelper.h"
+#include "Thebe/Math/TriangleMeshShape.h"
+#include "Thebe/Math/GJKCompoundShape.h"
 #include "Thebe/GraphicsEngine.h"
 #include "Thebe/Log.h"
 
@@ -12,10 +14,11 @@ using namespace Thebe;
 CollisionObject::CollisionObject()
 {
 	this->shape = nullptr;
-	this->frameWhenLastMoved = -1;
+	this->moveCount = 0;
 	this->color.SetComponents(1.0, 1.0, 1.0);
 	this->userData = 0;
 	this->physicsData = 0;
+	this->worldCacheValid = false;
 }
 
 /*virtual*/ CollisionObject::~CollisionObject()
@@ -46,6 +49,7 @@ CollisionObject::CollisionObject()
 	}
 
 	this->objectSpaceGeometricCenter = this->shape->CalcGeometricCenter();
+	this->InvalidateWorldCache();
 
 	return true;
 }
@@ -58,6 +62,7 @@ CollisionObject::CollisionObject()
 
 	this->edgeSet.clear();
 	this->objectSpacePlaneArray.clear();
+	this->InvalidateWorldCache();
 
 	EnginePart::Shutdown();
 }
@@ -68,8 +73,7 @@ void CollisionObject::SetObjectToWorld(const Transform& objectToWorld)
 	if (this->GetGraphicsEngine(graphicsEngine))
 	{
 		this->shape->SetObjectToWorld(objectToWorld);
-		
-		this->frameWhenLastMoved = graphicsEngine->GetFrameCount();
+		this->InvalidateWorldCache();
 
 		if (this->IsInBVH() && !this->UpdateBVHLocation())
 		{
@@ -82,11 +86,16 @@ void CollisionObject::SetObjectToWorld(const Transform& objectToWorld)
 			graphicsEngine->GetCollisionSystem()->UntrackObject(this);
 		}
 
-		if (this->targetSpace.Get())
-		{
-			// For now, we're assuming the parent transform is identity.
-			this->targetSpace->SetChildToParentTransform(objectToWorld * this->targetSpaceRelativeTransform);
-		}
+		this->UpdateTargetSpace(objectToWorld);
+	}
+}
+
+void CollisionObject::UpdateTargetSpace(const Transform& objectToWorld)
+{
+	if (this->targetSpace.Get())
+	{
+		// For now, we're assuming the parent transform is identity.
+		this->targetSpace->SetChildToParentTransform(objectToWorld * this->targetSpaceRelativeTransform);
 	}
 }
 
@@ -115,15 +124,16 @@ uintptr_t CollisionObject::GetPhysicsData() const
 	return this->physicsData;
 }
 
-UINT64 CollisionObject::GetFrameWhenLastMoved() const
+UINT64 CollisionObject::GetMoveCount() const
 {
-	return this->frameWhenLastMoved;
+	return this->moveCount;
 }
 
 void CollisionObject::SetShape(GJKShape* shape)
 {
 	delete this->shape;
 	this->shape = shape;
+	this->InvalidateWorldCache();
 }
 
 GJKShape* CollisionObject::GetShape()
@@ -160,6 +170,8 @@ const GJKShape* CollisionObject::GetShape() const
 	auto polyhedronValue = dynamic_cast<const JsonString*>(rootValue->GetValue("polyhedron"));
 	auto hullVerticesValue = dynamic_cast<const JsonArray*>(rootValue->GetValue("hull_vertices"));
 	auto polygonMeshValue = dynamic_cast<const JsonObject*>(rootValue->GetValue("polygon_mesh"));
+	auto triangleMeshValue = dynamic_cast<const JsonObject*>(rootValue->GetValue("triangle_mesh"));
+	auto compoundValue = dynamic_cast<const JsonArray*>(rootValue->GetValue("compound"));
 
 	if (polyhedronValue)
 	{
@@ -225,6 +237,59 @@ const GJKShape* CollisionObject::GetShape() const
 			THEBE_LOG("Failed to load collision object's polygon mesh.");
 			return false;
 		}
+
+		convexHull->GenerateAdjacency();
+	}
+	else if (triangleMeshValue)
+	{
+		PolygonMesh polygonMesh;
+		if (!polygonMesh.FromJson(triangleMeshValue))
+		{
+			THEBE_LOG("Failed to load collision object's triangle mesh.");
+			return false;
+		}
+
+		auto triangleMesh = new TriangleMeshShape();
+		this->shape = triangleMesh;
+		if (!triangleMesh->SetFromPolygonMesh(polygonMesh))
+		{
+			THEBE_LOG("Failed to build triangle mesh shape.");
+			return false;
+		}
+	}
+	else if (compoundValue)
+	{
+		auto compoundShape = new GJKCompoundShape();
+		this->shape = compoundShape;
+		for (UINT i = 0; i < compoundValue->GetSize(); i++)
+		{
+			auto childValue = dynamic_cast<const JsonObject*>(compoundValue->GetValue(i));
+			if (!childValue)
+			{
+				THEBE_LOG("Compound child %d is not a JSON object.", i);
+				return false;
+			}
+
+			auto convexHull = new GJKConvexHull();
+			if (!convexHull->hull.FromJson(childValue->GetValue("polygon_mesh")))
+			{
+				THEBE_LOG("Failed to load polygon mesh of compound child %d.", i);
+				delete convexHull;
+				return false;
+			}
+
+			convexHull->GenerateAdjacency();
+
+			Transform childToObject;
+			if (!JsonHelper::TransformFromJsonValue(childValue->GetValue("child_to_object"), childToObject))
+				childToObject.SetIdentity();
+
+			if (!compoundShape->AddChild(convexHull, childToObject))
+			{
+				THEBE_LOG("Failed to add compound child %d.", i);
+				return false;
+			}
+		}
 	}
 
 	if(vertexArray.size() > 0)
@@ -244,7 +309,7 @@ const GJKShape* CollisionObject::GetShape() const
 			return false;
 		}
 
-		convexHull->hull.SimplifyFaces(true);
+		convexHull->GenerateAdjacency();
 	}
 
 	if (!this->shape)
@@ -261,6 +326,13 @@ const GJKShape* CollisionObject::GetShape() const
 	}
 
 	this->shape->SetObjectToWorld(objectToWorld);
+	this->InvalidateWorldCache();
+
+	auto categoryBitsValue = dynamic_cast<const JsonInt*>(rootValue->GetValue("category_bits"));
+	this->SetCategoryBits(categoryBitsValue ? uint32_t(categoryBitsValue->GetValue()) : THEBE_ALL_CATEGORY_BITS);
+
+	auto maskBitsValue = dynamic_cast<const JsonInt*>(rootValue->GetValue("mask_bits"));
+	this->SetMaskBits(maskBitsValue ? uint32_t(maskBitsValue->GetValue()) : THEBE_ALL_CATEGORY_BITS);
 
 	return true;
 }
@@ -325,7 +397,45 @@ void CollisionObject::GenerateVertices(const Vector3& vertexBase, uint32_t axisF
 		rootValue->SetValue("polygon_mesh", hullValue.release());
 	}
 
+	auto triangleMesh = dynamic_cast<const TriangleMeshShape*>(this->shape);
+	if (triangleMesh)
+	{
+		std::unique_ptr<ParseParty::JsonValue> meshValue;
+		if (!triangleMesh->GetPolygonMesh().ToJson(meshValue))
+			return false;
+
+		rootValue->SetValue("triangle_mesh", meshValue.release());
+	}
+
+	auto compoundShape = dynamic_cast<const GJKCompoundShape*>(this->shape);
+	if (compoundShape)
+	{
+		auto compoundValue = new JsonArray();
+		rootValue->SetValue("compound", compoundValue);
+		for (int i = 0; i < compoundShape->GetNumChildren(); i++)
+		{
+			const GJKCompoundShape::Child& child = compoundShape->GetChild(i);
+			auto childHull = dynamic_cast<const GJKConvexHull*>(child.shape);
+			if (!childHull)
+			{
+				THEBE_LOG("Only hull children of compound shapes can be dumped.");
+				return false;
+			}
+
+			std::unique_ptr<ParseParty::JsonValue> hullValue;
+			if (!childHull->hull.ToJson(hullValue))
+				return false;
+
+			auto childValue = new JsonObject();
+			childValue->SetValue("polygon_mesh", hullValue.release());
+			childValue->SetValue("child_to_object", JsonHelper::TransformToJsonValue(child.childToObject));
+			compoundValue->PushValue(childValue);
+		}
+	}
+
 	rootValue->SetValue("object_to_world", JsonHelper::TransformToJsonValue(this->shape->GetObjectToWorld()));
+	rootValue->SetValue("category_bits", new JsonInt(this->GetCategoryBits()));
+	rootValue->SetValue("mask_bits", new JsonInt(this->GetMaskBits()));
 
 	return true;
 }
@@ -335,7 +445,72 @@ void CollisionObject::GenerateVertices(const Vector3& vertexBase, uint32_t axisF
 	if (!this->shape)
 		return false;
 
-	return this->shape->RayCast(ray, alpha, unitSurfaceNormal);
+	auto convexHull = dynamic_cast<const GJKConvexHull*>(this->shape);
+	if (!convexHull)
+		return this->shape->RayCast(ray, alpha, unitSurfaceNormal);
+
+	// Being convex, the hull is the intersection of the back half-spaces of its face planes,
+	// so the ray enters the hull at the last plane it crosses going in, and leaves it at the first
+	// plane it crosses going out.  This doesn't need anything but the cached world planes.
+	const std::vector<Plane>& planeArray = this->GetWorldPlaneArray();
+	if (planeArray.size() == 0)
+		return false;
+
+	double entryAlpha = 0.0;
+	double exitAlpha = std::numeric_limits<double>::max();
+	const Plane* entryPlane = nullptr;
+	const Plane* exitPlane = nullptr;
+
+	for (const Plane& plane : planeArray)
+	{
+		double distance = plane.SignedDistanceTo(ray.origin);
+		double denominator = plane.unitNormal.Dot(ray.unitDirection);
+
+		if (denominator == 0.0)
+		{
+			if (distance > 0.0)
+				return false;
+
+			continue;
+		}
+
+		double planeAlpha = -distance / denominator;
+
+		if (denominator < 0.0)
+		{
+			if (planeAlpha > entryAlpha)
+			{
+				entryAlpha = planeAlpha;
+				entryPlane = &plane;
+			}
+		}
+		else
+		{
+			if (planeAlpha < exitAlpha)
+			{
+				exitAlpha = planeAlpha;
+				exitPlane = &plane;
+			}
+		}
+
+		if (entryAlpha > exitAlpha)
+			return false;
+	}
+
+	if (entryPlane)
+	{
+		alpha = entryAlpha;
+		unitSurfaceNormal = entryPlane->unitNormal;
+		return true;
+	}
+
+	// The ray starts inside the hull, in which case we report where it leaves, facing back along the ray.
+	if (!exitPlane)
+		return false;
+
+	alpha = exitAlpha;
+	unitSurfaceNormal = -exitPlane->unitNormal;
+	return true;
 }
 
 void CollisionObject::DebugDraw(DynamicLineRenderer* lineRenderer) const
@@ -343,12 +518,44 @@ void CollisionObject::DebugDraw(DynamicLineRenderer* lineRenderer) const
 	auto convexHull = dynamic_cast<const GJKConvexHull*>(this->shape);
 	if (convexHull)
 	{
+		const std::vector<Vector3>& vertexArray = this->GetWorldVertexArray();
 		for (const auto& edge : this->edgeSet)
+			lineRenderer->AddLine(vertexArray[edge.i], vertexArray[edge.j], &this->color, &this->color);
+	}
+
+	auto triangleMesh = dynamic_cast<const TriangleMeshShape*>(this->shape);
+	if (triangleMesh)
+	{
+		GJKTriangle triangle;
+		for (int i = 0; i < triangleMesh->GetNumTriangles(); i++)
 		{
-			Vector3 vertexA = this->shape->GetObjectToWorld().TransformPoint(convexHull->hull.GetVertex(edge.i));
-			Vector3 vertexB = this->shape->GetObjectToWorld().TransformPoint(convexHull->hull.GetVertex(edge.j));
+			triangleMesh->GetTriangle(i, triangle);
 
-			lineRenderer->AddLine(vertexA, vertexB, &this->color, &this->color);
+			Vector3 worldVertex[3];
+			for (int j = 0; j < 3; j++)
+				worldVertex[j] = triangle.GetObjectToWorld().TransformPoint(triangle.vertex[j]);
+
+			for (int j = 0; j < 3; j++)
+				lineRenderer->AddLine(worldVertex[j], worldVertex[(j + 1) % 3], &this->color, &this->color);
+		}
+	}
+
+	auto compoundShape = dynamic_cast<const GJKCompoundShape*>(this->shape);
+	if (compoundShape)
+	{
+		for (int i = 0; i < compoundShape->GetNumChildren(); i++)
+		{
+			const GJKCompoundShape::Child& child = compoundShape->GetChild(i);
+			auto childHull = dynamic_cast<const GJKConvexHull*>(child.shape);
+			if (!childHull)
+				continue;
+
+			for (const auto& edge : child.edgeSet)
+			{
+				Vector3 worldVertexA = childHull->GetWorldVertex(edge.i);
+				Vector3 worldVertexB = childHull->GetWorldVertex(edge.j);
+				lineRenderer->AddLine(worldVertexA, worldVertexB, &this->color, &this->color);
+			}
 		}
 	}
 }
@@ -360,7 +567,8 @@ void CollisionObject::SetDebugColor(const Vector3& color)
 
 /*virtual*/ AxisAlignedBoundingBox CollisionObject::GetWorldBoundingBox() const
 {
-	return this->shape->GetWorldBoundingBox();
+	this->UpdateWorldCache();
+	return this->worldBoundingBox;
 }
 
 void CollisionObject::SetTargetSpace(Space* targetSpace, const Transform& targetSpaceRelativeTransform)
@@ -392,14 +600,69 @@ Vector3 CollisionObject::GetWorldGeometricCenter() const
 	return this->GetObjectToWorld().TransformPoint(this->objectSpaceGeometricCenter);
 }
 
-bool CollisionObject::PointOnOrBehindAllWorldPlanes(const Vector3& point) const
+const std::vector<Vector3>& CollisionObject::GetWorldVertexArray() const
+{
+	this->UpdateWorldCache();
+	return this->worldVertexArray;
+}
+
+const std::vector<Plane>& CollisionObject::GetWorldPlaneArray() const
 {
-	for (const Plane& objectPlane : this->objectSpacePlaneArray)
+	this->UpdateWorldCache();
+	return this->worldPlaneArray;
+}
+
+void CollisionObject::InvalidateWorldCache()
+{
+	this->moveCount++;
+	this->worldCacheValid.store(false, std::memory_order_release);
+}
+
+void CollisionObject::UpdateWorldCache() const
+{
+	if (this->worldCacheValid.load(std::memory_order_acquire))
+		return;
+
+	std::lock_guard<std::mutex> lock(this->worldCacheMutex);
+
+	if (this->worldCacheValid.load(std::memory_order_relaxed))
+		return;
+
+	this->worldVertexArray.clear();
+	this->worldPlaneArray.clear();
+
+	if (this->shape)
 	{
-		Plane worldPlane = this->GetObjectToWorld().TransformPlane(objectPlane);
+		const Transform& objectToWorld = this->shape->GetObjectToWorld();
+
+		auto convexHull = dynamic_cast<const GJKConvexHull*>(this->shape);
+		if (!convexHull)
+			this->worldBoundingBox = this->shape->GetWorldBoundingBox();
+		else
+		{
+			this->worldBoundingBox.MakeReadyForExpansion();
+			this->worldVertexArray.reserve(convexHull->hull.GetNumVertices());
+			for (const Vector3& objectVertex : convexHull->hull.GetVertexArray())
+			{
+				Vector3 worldVertex = objectToWorld.TransformPoint(objectVertex);
+				this->worldVertexArray.push_back(worldVertex);
+				this->worldBoundingBox.Expand(worldVertex);
+			}
+		}
+
+		this->worldPlaneArray.reserve(this->objectSpacePlaneArray.size());
+		for (const Plane& objectPlane : this->objectSpacePlaneArray)
+			this->worldPlaneArray.push_back(objectToWorld.TransformPlane(objectPlane));
+	}
+
+	this->worldCacheValid.store(true, std::memory_order_release);
+}
+
+bool CollisionObject::PointOnOrBehindAllWorldPlanes(const Vector3& point) const
+{
+	for (const Plane& worldPlane : this->GetWorldPlaneArray())
 		if (worldPlane.GetSide(point) == Plane::FRONT)
 			return false;
-	}
 
 	return true;
 }
@@ -408,10 +671,8 @@ bool CollisionObject::FindWorldPlaneNearestToPoint(const Vector3& point, Plane&
 {
 	double smallestDistance = std::numeric_limits<double>::max();
 
-	for (int i = 0; i < (int)this->objectSpacePlaneArray.size(); i++)
+	for (const Plane& worldPlane : this->GetWorldPlaneArray())
 	{
-		const Plane& objectPlane = this->objectSpacePlaneArray[i];
-		Plane worldPlane = this->GetObjectToWorld().TransformPlane(objectPlane);
 		double distance = ::fabs(worldPlane.SignedDistanceTo(point));
 		if (distance < smallestDistance)
 		{
@@ -6,6 +6,8 @@
 #include "Thebe/Math/GJKAlgorithm.h"
 #include "Thebe/Math/PolygonMesh.h"
 #include "Thebe/Math/Graph.h"
+#include <atomic>
+#include <mutex>
 
 namespace Thebe
 {
@@ -39,7 +41,12 @@ namespace Thebe
 
 		void DebugDraw(DynamicLineRenderer* lineRenderer) const;
 
-		UINT64 GetFrameWhenLastMoved() const;
+		/**
+		 * This counts the times the object has been moved or reshaped, so that anything calculated from where
+		 * the object is can tell whether it's stale.  Unlike the frame count, it changes on every step of the
+		 * simulation, however many of them are taken in a frame, and whether or not anything is being rendered.
+		 */
+		UINT64 GetMoveCount() const;
 
 		void SetShape(GJKShape* shape);
 		GJKShape* GetShape();
@@ -50,10 +57,30 @@ namespace Thebe
 		void SetTargetSpace(Space* targetSpace, const Transform& targetSpaceRelativeTransform);
 		Space* GetTargetSpace(Transform* targetSpaceRelativeTransform = nullptr);
 
+		/**
+		 * Place our target space, if any, as if this object were at the given place, without actually moving the object.
+		 * Moving the object does this for where it moves to, but this lets what's rendered be somewhere else, such as part
+		 * way between where the object was at the start and end of a step of the simulation.
+		 */
+		void UpdateTargetSpace(const Transform& objectToWorld);
+
 		const std::set<Graph::UnorderedEdge, Graph::UnorderedEdge>& GetEdgeSet() const;
 		const std::vector<Plane>& GetObjectSpacePlaneArray() const;
 		Vector3 GetWorldGeometricCenter() const;
 
+		/**
+		 * These are the vertices of our convex hull (if that's our shape) in world space.
+		 * Like the other world-space caches, this is calculated on demand and then re-used
+		 * until the object is moved again.
+		 */
+		const std::vector<Vector3>& GetWorldVertexArray() const;
+
+		/**
+		 * These are the face planes of our convex hull (if that's our shape) in world space,
+		 * one per polygon of the hull, in the same order as the object-space planes.
+		 */
+		const std::vector<Plane>& GetWorldPlaneArray() const;
+
 		bool PointOnOrBehindAllWorldPlanes(const Vector3& point) const;
 		bool FindWorldPlaneNearestToPoint(const Vector3& point, Plane& foundWorldPlane) const;
 
@@ -62,9 +89,11 @@ namespace Thebe
 	private:
 
 		void GenerateVertices(const Vector3& vertexBase, uint32_t axisFlags, std::vector<Vector3>& vertexArray);
+		void InvalidateWorldCache();
+		void UpdateWorldCache() const;
 
 		GJKShape* shape;
-		UINT64 frameWhenLastMoved;
+		UINT64 moveCount;
 		std::set<Graph::UnorderedEdge, Graph::UnorderedEdge> edgeSet;
 		std::vector<Plane> objectSpacePlaneArray;
 		Vector3 objectSpaceGeometricCenter;
@@ -73,6 +102,15 @@ namespace Thebe
 		uintptr_t physicsData;
 		Reference<Space> targetSpace;
 		Transform targetSpaceRelativeTransform;
+
+		// These are derived from the shape and its object-to-world transform.  Many threads may
+		// ask for them at once (e.g., during the narrow-phase), so the first to find them stale
+		// fills them in under the lock, and the rest just wait for it.
+		mutable std::vector<Vector3> worldVertexArray;
+		mutable std::vector<Plane> worldPlaneArray;
+		mutable AxisAlignedBoundingBox worldBoundingBox;
+		mutable std::atomic<bool> worldCacheValid;
+		mutable std::mutex worldCacheMutex;
 	};
 
 	/**
@@ -132,6 +132,8 @@ FloppyBody::FloppyBody()
 
 /*virtual*/ void FloppyBody::SetObjectToWorld(const Transform& objectToWorld)
 {
+	this->WakeUp();
+
 	auto convexHull = dynamic_cast<GJKConvexHull*>(this->collisionObject->GetShape());
 	if (convexHull)
 	{
@@ -436,6 +438,16 @@ bool FloppyBody::RespondToCollisionContact(const Plane& contactPlane)
 	return totalMass;
 }
 
+/*virtual*/ double FloppyBody::GetKineticEnergy() const
+{
+	double kineticEnergy = 0.0;
+
+	for (const PointMass& pointMass : this->pointMassArray)
+		kineticEnergy += 0.5 * pointMass.mass * pointMass.velocity.Dot(pointMass.velocity);
+
+	return kineticEnergy;
+}
+
 /*virtual*/ void FloppyBody::ZeroMomentum()
 {
 	for (PointMass& pointMass : this->pointMassArray)
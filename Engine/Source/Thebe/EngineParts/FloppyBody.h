@@ -24,6 +24,7 @@ namespace Thebe
 		virtual void IntegrateMotionUnconstrained(double timeStepSeconds) override;
 		virtual Vector3 GetCenterOfMass() const override;
 		virtual double GetTotalMass() const override;
+		virtual double GetKineticEnergy() const override;
 		virtual void DebugDraw(DynamicLineRenderer* lineRenderer) const override;
 		virtual void SetObjectToWorld(const Transform& objectToWorld) override;
 		virtual Transform GetObjectToWorld() const override;
@@ -10,6 +10,9 @@ PhysicsObject::PhysicsObject()
 	this->stationary = false;
 	this->frozen = false;
 	this->separationResolved = true;
+	this->asleep = false;
+	this->calmStepCount = 0;
+	this->sleepingIslandNumber = 0;
 }
 
 /*virtual*/ PhysicsObject::~PhysicsObject()
@@ -39,6 +42,7 @@ PhysicsObject::PhysicsObject()
 	}
 
 	this->collisionObject->SetPhysicsData(this->GetHandle());
+	this->UpdateAtRest();
 
 	return true;
 }
@@ -171,6 +175,7 @@ void PhysicsObject::ApplyContactForce(const ContactForce& contactForce)
 void PhysicsObject::SetStationary(bool stationary)
 {
 	this->stationary = stationary;
+	this->UpdateAtRest();
 }
 
 bool PhysicsObject::IsStationary() const
@@ -181,6 +186,7 @@ bool PhysicsObject::IsStationary() const
 void PhysicsObject::SetFrozen(bool frozen)
 {
 	this->frozen = frozen;
+	this->UpdateAtRest();
 }
 
 bool PhysicsObject::IsFrozen() const
@@ -188,6 +194,34 @@ bool PhysicsObject::IsFrozen() const
 	return this->frozen;
 }
 
+bool PhysicsObject::IsAsleep() const
+{
+	return this->asleep;
+}
+
+void PhysicsObject::WakeUp()
+{
+	if (!this->asleep)
+		return;
+
+	Reference<GraphicsEngine> graphicsEngine;
+	if (this->GetGraphicsEngine(graphicsEngine))
+		graphicsEngine->GetPhysicsSystem()->WakeObject(this);
+	else
+	{
+		this->asleep = false;
+		this->calmStepCount = 0;
+		this->sleepingIslandNumber = 0;
+		this->UpdateAtRest();
+	}
+}
+
+void PhysicsObject::UpdateAtRest()
+{
+	if (this->collisionObject.Get())
+		this->collisionObject->SetAtRest(this->stationary || this->frozen || this->asleep);
+}
+
 void PhysicsObject::SetTotalSeparation(const Vector3& totalSeparation)
 {
 	this->totalSeparation = totalSeparation;
@@ -211,6 +245,7 @@ bool PhysicsObject::GetSeparationResolved() const
 void PhysicsObject::SetCollisionObject(CollisionObject* collisionObject)
 {
 	this->collisionObject = collisionObject;
+	this->UpdateAtRest();
 }
 
 CollisionObject* PhysicsObject::GetCollisionObject()
@@ -230,6 +265,7 @@ void PhysicsObject::SetCollisionObjectPath(const std::filesystem::path& collisio
 
 /*virtual*/ void PhysicsObject::SetObjectToWorld(const Transform& objectToWorld)
 {
+	this->WakeUp();
 	this->collisionObject->SetObjectToWorld(objectToWorld);
 }
 
@@ -238,8 +274,20 @@ void PhysicsObject::SetCollisionObjectPath(const std::filesystem::path& collisio
 	return this->collisionObject->GetObjectToWorld();
 }
 
+const Transform& PhysicsObject::GetPreviousObjectToWorld() const
+{
+	return this->previousObjectToWorld;
+}
+
+const Transform& PhysicsObject::GetRenderObjectToWorld() const
+{
+	return this->renderObjectToWorld;
+}
+
 void PhysicsObject::SetExternalForce(const std::string& name, const Vector3& force)
 {
+	this->WakeUp();
+
 	auto pair = this->externalForceMap.find(name);
 	if (pair != this->externalForceMap.end())
 		this->externalForceMap.erase(pair);
@@ -258,6 +306,8 @@ Vector3 PhysicsObject::GetExternalForce(const std::string& name) const
 
 void PhysicsObject::SetExternalTorque(const std::string& name, const Vector3& torque)
 {
+	this->WakeUp();
+
 	auto pair = this->externalTorqueMap.find(name);
 	if (pair != this->externalTorqueMap.end())
 		this->externalTorqueMap.erase(pair);
@@ -276,6 +326,8 @@ Vector3 PhysicsObject::GetExternalTorque(const std::string& name) const
 
 void PhysicsObject::SetExternalContactForce(const std::string& name, const ContactForce& contactForce)
 {
+	this->WakeUp();
+
 	auto pair = this->externalContactForceMap.find(name);
 	if (pair != this->externalContactForceMap.end())
 		this->externalContactForceMap.erase(pair);
@@ -295,16 +347,19 @@ bool PhysicsObject::GetExternalContactForce(const std::string& name, ContactForc
 
 void PhysicsObject::AddTransientContactForce(const ContactForce& contactForce)
 {
+	this->WakeUp();
 	this->transientContactForceList.push_back(contactForce);
 }
 
 void PhysicsObject::AddTransientForce(const Vector3& transientForce)
 {
+	this->WakeUp();
 	this->transientForceList.push_back(transientForce);
 }
 
 void PhysicsObject::AddTransientTorque(const Vector3& transientTorque)
 {
+	this->WakeUp();
 	this->transientTorqueList.push_back(transientTorque);
 }
 
@@ -15,6 +15,8 @@ namespace Thebe
 	 */
 	class THEBE_API PhysicsObject : public EnginePart
 	{
+		friend class PhysicsSystem;
+
 	public:
 		PhysicsObject();
 		virtual ~PhysicsObject();
@@ -51,6 +53,11 @@ namespace Thebe
 		 */
 		virtual double GetTotalMass() const = 0;
 
+		/**
+		 * Return the kinetic energy of this object, linear and rotational together.
+		 */
+		virtual double GetKineticEnergy() const = 0;
+
 		/**
 		 * Return a unit-length vector in the direction this object is moving.
 		 */
@@ -69,12 +76,38 @@ namespace Thebe
 		virtual void SetObjectToWorld(const Transform& objectToWorld);
 		virtual Transform GetObjectToWorld() const;
 
+		/**
+		 * This is where the object was at the start of the last step of the simulation it took part in.
+		 */
+		const Transform& GetPreviousObjectToWorld() const;
+
+		/**
+		 * This is where the object should be drawn.  With a fixed time step (see @ref PhysicsSystem::SetFixedTimeStep),
+		 * it's part way between where the object was at the start and end of the last step, by the fraction of a
+		 * step of time left over; otherwise, it's where the object is.  The physics system keeps the target space of
+		 * the object's collision object, if any, here too.
+		 */
+		const Transform& GetRenderObjectToWorld() const;
+
 		void SetStationary(bool stationary);
 		bool IsStationary() const;
 
 		void SetFrozen(bool frozen);
 		bool IsFrozen() const;
 
+		/**
+		 * Sleeping objects are left out of the simulation entirely until something disturbs them.
+		 * The physics system puts whole islands of objects in contact to sleep at once, once they've
+		 * come to rest.  See @ref PhysicsSystem::SetSleepThresholds.
+		 */
+		bool IsAsleep() const;
+
+		/**
+		 * Wake this object, along with the rest of the island it was put to sleep with.  Applying
+		 * a force or torque to the object, or moving it, does this automatically.
+		 */
+		void WakeUp();
+
 		void SetCollisionObject(CollisionObject* collisionObject);
 		CollisionObject* GetCollisionObject();
 		const CollisionObject* GetCollisionObject() const;
@@ -113,6 +146,11 @@ namespace Thebe
 
 		void ApplyContactForce(const ContactForce& contactForce);
 
+		/**
+		 * Let the broad phase know whether this object can move, so that it can skip pairs of objects that can't.  See @ref BVHObject::SetAtRest.
+		 */
+		void UpdateAtRest();
+
 		std::map<std::string, Vector3> externalForceMap;
 		std::map<std::string, Vector3> externalTorqueMap;
 		std::map<std::string, ContactForce> externalContactForceMap;
@@ -131,5 +169,12 @@ namespace Thebe
 
 		Vector3 totalSeparation;
 		bool separationResolved;
+
+		Transform previousObjectToWorld;
+		Transform renderObjectToWorld;
+
+		bool asleep;
+		int calmStepCount;				///< This is how many steps in a row the island of this object has been at rest.
+		uint32_t sleepingIslandNumber;	///< While asleep, this identifies the island this object was put to sleep with.
 	};
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "Thebe/EngineParts/RigidBody.h"
 #include "Thebe/Utilities/JsonHelper.h"
+#include "Thebe/Math/GJKCompoundShape.h"
 #include "Thebe/GraphicsEngine.h"
 #include "Thebe/Log.h"
 
@@ -8,6 +9,7 @@ using namespace Thebe;
 RigidBody::RigidBody()
 {
 	this->totalMass = 0.0;
+	this->continuousCollisionDetection = false;
 	this->linearMomentum.SetComponents(0.0, 0.0, 0.0);
 	this->angularMomentum.SetComponents(0.0, 0.0, 0.0);
 
@@ -72,6 +74,9 @@ RigidBody::RigidBody()
 	if (totalMassValue)
 		this->totalMass = totalMassValue->GetValue();
 
+	auto continuousCollisionDetectionValue = dynamic_cast<const JsonBool*>(rootValue->GetValue("continuous_collision_detection"));
+	this->continuousCollisionDetection = continuousCollisionDetectionValue ? continuousCollisionDetectionValue->GetValue() : false;
+
 	if (JsonHelper::MatrixFromJsonValue(rootValue->GetValue("object_space_inertia_tensor"), this->objectSpaceInertiaTensor))
 	{
 		if (!this->objectSpaceInertiaTensorInverse.Invert(this->objectSpaceInertiaTensor))
@@ -97,6 +102,7 @@ RigidBody::RigidBody()
 
 	rootValue->SetValue("total_mass", new JsonFloat(this->totalMass));
 	rootValue->SetValue("object_space_inertia_tensor", JsonHelper::MatrixToJsonValue(this->objectSpaceInertiaTensor));
+	rootValue->SetValue("continuous_collision_detection", new JsonBool(this->continuousCollisionDetection));
 
 	return true;
 }
@@ -107,7 +113,12 @@ bool RigidBody::CalculateRigidBodyCharacteristics(std::function<double(const Vec
 	AxisAlignedBoundingBox objectBoundingBox = shape->GetObjectBoundingBox();
 	
 	GJKConvexHull::PointContainmentCache pointContainmentCache;
-	void* cache = dynamic_cast<GJKConvexHull*>(shape) ? &pointContainmentCache : nullptr;
+	GJKCompoundShape::PointContainmentCache compoundPointContainmentCache;
+	void* cache = nullptr;
+	if (dynamic_cast<GJKConvexHull*>(shape))
+		cache = &pointContainmentCache;
+	else if (dynamic_cast<GJKCompoundShape*>(shape))
+		cache = &compoundPointContainmentCache;
 
 	this->totalMass = 0.0;
 	double voxelExtent = 0.05;
@@ -132,6 +143,7 @@ bool RigidBody::CalculateRigidBodyCharacteristics(std::function<double(const Vec
 		for (uint32_t j = 0; j < 3; j++)
 			this->objectSpaceInertiaTensor.ele[i][j] = 0.0;
 
+	// The children of a compound are only moved about within it by the shift, so their caches are still good.
 	pointContainmentCache.planeArray.clear();
 	objectBoundingBox.Integrate([this, &densityFunction, shape, cache](const AxisAlignedBoundingBox& voxel)
 		{
@@ -193,6 +205,11 @@ Vector3 RigidBody::GetAngularVelocity() const
 	return this->totalMass;
 }
 
+/*virtual*/ double RigidBody::GetKineticEnergy() const
+{
+	return 0.5 * (this->linearMomentum.Dot(this->GetLinearVelocity()) + this->angularMomentum.Dot(this->GetAngularVelocity()));
+}
+
 const Vector3& RigidBody::GetLinearMomentum() const
 {
 	return this->linearMomentum;
@@ -200,6 +217,7 @@ const Vector3& RigidBody::GetLinearMomentum() const
 
 void RigidBody::SetLinearMomentum(const Vector3& linearMomentum)
 {
+	this->WakeUp();
 	this->linearMomentum = linearMomentum;
 }
 
@@ -210,9 +228,49 @@ const Vector3& RigidBody::GetAngularMomentum() const
 
 void RigidBody::SetAngularMomentum(const Vector3& angularMomentum)
 {
+	this->WakeUp();
 	this->angularMomentum = angularMomentum;
 }
 
+void RigidBody::SetContinuousCollisionDetection(bool continuousCollisionDetection)
+{
+	this->continuousCollisionDetection = continuousCollisionDetection;
+}
+
+bool RigidBody::GetContinuousCollisionDetection() const
+{
+	return this->continuousCollisionDetection;
+}
+
+double RigidBody::GetBoundingRadius() const
+{
+	// The object-space origin is the center of mass, so the farthest corner of the object-space box bounds the body.
+	AxisAlignedBoundingBox objectBoundingBox = this->collisionObject->GetShape()->GetObjectBoundingBox();
+	Vector3 farthestCorner(
+		THEBE_MAX(::fabs(objectBoundingBox.minCorner.x), ::fabs(objectBoundingBox.maxCorner.x)),
+		THEBE_MAX(::fabs(objectBoundingBox.minCorner.y), ::fabs(objectBoundingBox.maxCorner.y)),
+		THEBE_MAX(::fabs(objectBoundingBox.minCorner.z), ::fabs(objectBoundingBox.maxCorner.z)));
+	return farthestCorner.Length();
+}
+
+double RigidBody::GetInscribedRadius() const
+{
+	auto sphere = dynamic_cast<const GJKSphere*>(this->collisionObject->GetShape());
+	if (sphere)
+		return THEBE_MAX(sphere->radius - sphere->center.Length(), 0.0);
+
+	const std::vector<Plane>& worldPlaneArray = this->collisionObject->GetWorldPlaneArray();
+	if (worldPlaneArray.size() == 0)
+		return 0.0;
+
+	Vector3 centerOfMass = this->GetCenterOfMass();
+	double inscribedRadius = std::numeric_limits<double>::max();
+	for (const Plane& worldPlane : worldPlaneArray)
+		inscribedRadius = THEBE_MIN(inscribedRadius, -worldPlane.SignedDistanceTo(centerOfMass));
+
+	return THEBE_MAX(inscribedRadius, 0.0);
+}
+
 /*virtual*/ void RigidBody::ZeroMomentum()
 {
 	this->linearMomentum.SetComponents(0.0, 0.0, 0.0);
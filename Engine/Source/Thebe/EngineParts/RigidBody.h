@@ -11,6 +11,8 @@ namespace Thebe
 	 */
 	class THEBE_API RigidBody : public PhysicsObject
 	{
+		friend class RigidBodyWorld;
+
 	public:
 		RigidBody();
 		virtual ~RigidBody();
@@ -23,6 +25,7 @@ namespace Thebe
 		virtual void ZeroMomentum() override;
 		virtual Vector3 GetCenterOfMass() const override;
 		virtual double GetTotalMass() const override;
+		virtual double GetKineticEnergy() const override;
 		virtual Vector3 GetLinearMotionDirection() const override;
 		virtual Vector3 GetAngularMotionDirection() const override;
 
@@ -38,6 +41,27 @@ namespace Thebe
 		const Vector3& GetAngularMomentum() const;
 		void SetAngularMomentum(const Vector3& angularMomentum);
 
+		/**
+		 * Opt this body into continuous collision detection.  When it moves far enough in
+		 * one step of the simulation to possibly pass through something, its motion over
+		 * that step is swept against its surroundings, and then clamped at the first time
+		 * of impact, so that the contact is caught and resolved rather than tunneled through.
+		 * This is meant for small, fast bodies, and costs nothing for bodies that don't move fast.
+		 */
+		void SetContinuousCollisionDetection(bool continuousCollisionDetection);
+		bool GetContinuousCollisionDetection() const;
+
+		/**
+		 * Return the radius of a sphere about the center of mass that bounds this body.
+		 */
+		double GetBoundingRadius() const;
+
+		/**
+		 * Return the radius of the largest sphere about the center of mass that fits inside this body.
+		 * Zero is returned for shapes where we don't know how to find it.
+		 */
+		double GetInscribedRadius() const;
+
 		bool CalculateRigidBodyCharacteristics(std::function<double(const Vector3&)> densityFunction = [](const Vector3) -> double { return 1.0; });
 
 	private:
@@ -48,5 +72,6 @@ namespace Thebe
 		double totalMass;
 		Matrix3x3 objectSpaceInertiaTensor;
 		Matrix3x3 objectSpaceInertiaTensorInverse;
+		bool continuousCollisionDetection;
 	};
 }
\ No newline at end of file
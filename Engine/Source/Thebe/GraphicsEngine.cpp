@@ -58,7 +58,7 @@ namespace std
 
 using namespace Thebe;
 
-GraphicsEngine::GraphicsEngine() : audioSystem(&this->eventSystem)
+GraphicsEngine::GraphicsEngine() : physicsSystem(&this->collisionSystem), audioSystem(&this->eventSystem)
 {
 	this->frameCount = 0L;
 	this->deltaTimeSeconds = 0.0;
@@ -441,6 +441,13 @@ double AxisAlignedBoundingBox::GetVolume() const
 	return width * height * depth;
 }
 
+double AxisAlignedBoundingBox::GetSurfaceArea() const
+{
+	double width = 0.0, height = 0.0, depth = 0.0;
+	this->GetDimensions(width, height, depth);
+	return 2.0 * (width * height + height * depth + depth * width);
+}
+
 void AxisAlignedBoundingBox::GetToSphere(Vector3& center, double& radius) const
 {
 	center = this->GetCenter();
@@ -211,6 +211,11 @@ namespace Thebe
 		 */
 		double GetVolume() const;
 
+		/**
+		 * Return the surface area of this AABB.
+		 */
+		double GetSurfaceArea() const;
+
 		/**
 		 * Calculate and return the tightest sphere containing this AABB.
 		 * 
@@ -4,6 +4,7 @@
 #include "Thebe/Math/Function.h"
 #include "Thebe/Log.h"
 #include <format>
+#include <algorithm>
 
 using namespace Thebe;
 
@@ -17,8 +18,15 @@ GJKShape::GJKShape()
 {
 }
 
-/*static*/ bool GJKShape::Intersect(const GJKShape* shapeA, const GJKShape* shapeB, std::unique_ptr<GJKSimplex>* finalSimplex /*= nullptr*/)
+/*static*/ bool GJKShape::Intersect(const GJKShape* shapeA, const GJKShape* shapeB, GJKSimplex* cachedSimplex /*= nullptr*/)
 {
+	GJKSimplex simplex;
+	if (cachedSimplex)
+	{
+		simplex = *cachedSimplex;
+		cachedSimplex->Clear();
+	}
+
 	if (!shapeA || !shapeB)
 		return false;
 
@@ -45,52 +53,54 @@ GJKShape::GJKShape()
 	int simplexCount = 0;
 #endif //GJK_RENDER_DEBUG
 
-	Vector3 centerA = shapeA->GetObjectToWorld().TransformPoint(shapeA->CalcGeometricCenter());
-	Vector3 centerB = shapeB->GetObjectToWorld().TransformPoint(shapeB->CalcGeometricCenter());
+	simplex.Resample(shapeA, shapeB);
 
-	Vector3 unitDirection = (centerB - centerA).Normalized();
+	if (simplex.numVertices == 0)
+	{
+		Vector3 centerA = shapeA->GetObjectToWorld().TransformPoint(shapeA->CalcGeometricCenter());
+		Vector3 centerB = shapeB->GetObjectToWorld().TransformPoint(shapeB->CalcGeometricCenter());
 
-	auto pointSimplex = new GJKPointSimplex();
-	pointSimplex->point = GJKSimplex::CalcSupportPoint(shapeA, shapeB, unitDirection);
+		Vector3 unitDirection = centerB - centerA;
+		if (unitDirection.SquareLength() <= THEBE_SMALL_EPS)
+			unitDirection = Vector3::XAxis();
+		else
+			unitDirection = unitDirection.Normalized();
+
+		simplex.AddVertex(GJKSimplex::CalcSupportVertex(shapeA, shapeB, unitDirection));
+	}
 
+	// Each iteration finds the point of the simplex nearest the origin, and then
+	// tries to get closer to the origin by adding a support point in that direction.
 	bool intersectionOccurs = false;
-	std::unique_ptr<GJKSimplex> simplex(pointSimplex);
-	while (simplex.get())
+	constexpr int maxIterations = 64;
+	for (int i = 0; i < maxIterations; i++)
 	{
+		Vector3 closestPoint = simplex.ReduceToClosestPoint();
+
 #if defined GJK_RENDER_DEBUG
 		if (client.get())
-			simplex->DebugDraw(client.get(), simplexCount++);
+			simplex.DebugDraw(client.get(), simplexCount++);
 #endif //GJK_RENDER_DEBUG
 
-		if (simplex->ContainsOrigin(THEBE_MEDIUM_EPS))
+		double squareDistance = closestPoint.SquareLength();
+		if (simplex.numVertices == 4 || squareDistance <= THEBE_MEDIUM_EPS * THEBE_MEDIUM_EPS)
 		{
-			if (finalSimplex)
-				finalSimplex->reset(simplex.release());
-
 			intersectionOccurs = true;
 			break;
 		}
 
-		std::unique_ptr<GJKSimplex> facet;
-		if (simplex->GetDimension() < 3)
-			facet.reset(simplex.release());
-		else
-			facet.reset(simplex->FindFacetNearestOrigin());
+		Vector3 unitDirection = -closestPoint / ::sqrt(squareDistance);
+		GJKSimplex::Vertex vertex = GJKSimplex::CalcSupportVertex(shapeA, shapeB, unitDirection);
 
-		THEBE_ASSERT(facet.get() != nullptr);
-		if (facet.get() == nullptr)
+		// If we can't get past the origin in its direction, then the origin is not in the Minkowski difference.
+		if (vertex.point.Dot(unitDirection) < 0.0)
 			break;
 
-		Vector3 unitDirection = facet->CalcFacetNorm();
-		Vector3 supportPoint = GJKSimplex::CalcSupportPoint(shapeA, shapeB, unitDirection);
-		double dot = supportPoint.Dot(unitDirection);
-		if (dot < 0.0)
+		// If we can't make any progress toward the origin, then we have converged.
+		if (simplex.HasVertex(vertex.point, THEBE_SMALL_EPS))
 			break;
 
-		simplex.reset(facet->ExtendSimplexWithPoint(supportPoint));
-		THEBE_ASSERT(simplex.get() != nullptr);
-		if (simplex.get() == nullptr)
-			break;
+		simplex.AddVertex(vertex);
 	}
 
 #if defined GJK_RENDER_DEBUG
@@ -98,72 +108,146 @@ GJKShape::GJKShape()
 		client->Shutdown();
 #endif //GKK_RENDER_DEBUG
 
+	if (cachedSimplex)
+		*cachedSimplex = simplex;
+
 	return intersectionOccurs;
 }
 
-/*static*/ bool GJKShape::Penetration(const GJKShape* shapeA, const GJKShape* shapeB, std::unique_ptr<GJKSimplex>& simplex, Vector3& separationDelta)
+/*static*/ bool GJKShape::Penetration(const GJKShape* shapeA, const GJKShape* shapeB, const GJKSimplex& simplex, Vector3& separationDelta)
 {
 	separationDelta.SetComponents(0.0, 0.0, 0.0);
 
-	if (!simplex.get())
+	if (simplex.numVertices == 0)
 		return false;
 
 	if (!shapeA || !shapeB)
 		return false;
 
-	GJKTetrahedronSimplex* tetrahedron = nullptr;
-	while (true)
+	// EPA needs to start with a tetrahedron of non-zero volume containing the origin.
+	GJKSimplex tetrahedron = simplex;
+	if (!tetrahedron.ExpandToTetrahedron(shapeA, shapeB))
+		return false;
+
+	// The polytope is kept per-thread, because it's too big to comfortably put on the stack.
+	thread_local GJKExpandingPolytope polytope;
+	if (!polytope.Initialize(tetrahedron))
+		return false;
+
+	// Note that we only partially expand the tetrahedron to fill the entire Minkowski space.
+	// We don't have to fill the entire space before we know what the penetration delta is.
+	if (!polytope.Expand(shapeA, shapeB))
+		return false;
+
+	separationDelta = polytope.GetUnitNormal() * polytope.GetDistance();
+	return true;
+}
+
+/*static*/ bool GJKShape::Distance(const GJKShape* shapeA, const GJKShape* shapeB, Vector3& closestA, Vector3& closestB, double& distance, GJKSimplex* cachedSimplex /*= nullptr*/)
+{
+	distance = 0.0;
+
+	if (!shapeA || !shapeB)
+		return false;
+
+	// Spheres are treated here as points with a margin.  This is because the algorithm
+	// converges slowly on curved surfaces, but instantly on points.  We just account for
+	// the radii at the end.
+	auto sphereA = dynamic_cast<const GJKSphere*>(shapeA);
+	auto sphereB = dynamic_cast<const GJKSphere*>(shapeB);
+	double marginA = sphereA ? sphereA->radius : 0.0;
+	double marginB = sphereB ? sphereB->radius : 0.0;
+	Vector3 centerA = sphereA ? sphereA->GetObjectToWorld().TransformPoint(sphereA->center) : Vector3::Zero();
+	Vector3 centerB = sphereB ? sphereB->GetObjectToWorld().TransformPoint(sphereB->center) : Vector3::Zero();
+
+	auto calcSupportVertex = [=](const Vector3& unitDirection) -> GJKSimplex::Vertex
+		{
+			GJKSimplex::Vertex vertex;
+			vertex.pointA = sphereA ? centerA : shapeA->FurthestPoint(-unitDirection);
+			vertex.pointB = sphereB ? centerB : shapeB->FurthestPoint(unitDirection);
+			vertex.point = vertex.pointB - vertex.pointA;
+			return vertex;
+		};
+
+	GJKSimplex simplex;
+
+	// The shapes have probably moved since the cached simplex was made, so its vertices are stale.
+	// However, the directions in which they were found are likely still good, so re-query those.
+	if (cachedSimplex)
 	{
-		tetrahedron = dynamic_cast<GJKTetrahedronSimplex*>(simplex.get());
-		if (tetrahedron)
-			break;
+		for (int i = 0; i < cachedSimplex->numVertices; i++)
+		{
+			const Vector3& point = cachedSimplex->vertex[i].point;
+			if (point.SquareLength() <= THEBE_SMALL_EPS)
+				continue;
 
-		Vector3 unitDirection = simplex->CalcFacetNorm();
-		Vector3 supportPoint = GJKSimplex::CalcSupportPoint(shapeA, shapeB, unitDirection);
-		simplex.reset(simplex->ExtendSimplexWithPoint(supportPoint));
-		if (!simplex.get())
-			return false;
+			GJKSimplex::Vertex vertex = calcSupportVertex(point.Normalized());
+			if (!simplex.HasVertex(vertex.point, THEBE_SMALL_EPS))
+				simplex.AddVertex(vertex);
+		}
 	}
 
-	ExpandingPolytopeAlgorithm epa;
-	ExpandingPolytopeAlgorithm::TypedTriangleFactory<GJKTriangleForEPA> triangleFactory(1024);
-	GJKPointSupplierForEPA pointSupplier(shapeA, shapeB, &epa);
+	if (simplex.numVertices == 0)
+	{
+		Vector3 unitDirection = shapeB->GetObjectToWorld().TransformPoint(shapeB->CalcGeometricCenter()) - shapeA->GetObjectToWorld().TransformPoint(shapeA->CalcGeometricCenter());
+		if (unitDirection.SquareLength() <= THEBE_SMALL_EPS)
+			unitDirection = Vector3::XAxis();
+		else
+			unitDirection = unitDirection.Normalized();
 
-	epa.vertexArray.push_back(tetrahedron->vertex[0]);
-	epa.vertexArray.push_back(tetrahedron->vertex[1]);
-	epa.vertexArray.push_back(tetrahedron->vertex[2]);
-	epa.vertexArray.push_back(tetrahedron->vertex[3]);
+		simplex.AddVertex(calcSupportVertex(unitDirection));
+	}
 
-	for (int i = 0; i < 4; i++)
+	bool intersectionOccurs = false;
+	Vector3 closestPoint;
+	constexpr int maxIterations = 64;
+	for (int i = 0; i < maxIterations; i++)
 	{
-		int vertices[3];
-		int k = 0;
-		for (int j = 0; j < 4; j++)
-			if (j != i)
-				vertices[k++] = j;
+		closestPoint = simplex.ReduceToClosestPoint();
 
-		auto triangle = (GJKTriangleForEPA*)triangleFactory.AllocTriangle(vertices[0], vertices[1], vertices[2]);
-		Plane trianglePlane = triangle->MakePlane(epa.vertexArray);
-		if (trianglePlane.GetSide(epa.vertexArray[i], epa.planeThickness) != Plane::Side::BACK)
+		double squareDistance = closestPoint.SquareLength();
+		if (simplex.numVertices == 4 || squareDistance <= THEBE_MEDIUM_EPS * THEBE_MEDIUM_EPS)
 		{
-			auto reverseTriangle = (GJKTriangleForEPA*)triangle->Reversed(&triangleFactory);
-			triangleFactory.FreeTriangle(triangle);
-			triangle = reverseTriangle;
+			intersectionOccurs = true;
+			break;
 		}
 
-		epa.triangleList.push_back(triangle);
+		Vector3 unitDirection = -closestPoint / ::sqrt(squareDistance);
+		GJKSimplex::Vertex vertex = calcSupportVertex(unitDirection);
+
+		// Stop once the support point can't get us meaningfully closer to the origin than we already are.
+		if (squareDistance - closestPoint.Dot(vertex.point) <= THEBE_SMALL_EPS * squareDistance)
+			break;
+
+		if (simplex.HasVertex(vertex.point, THEBE_SMALL_EPS))
+			break;
+
+		simplex.AddVertex(vertex);
 	}
 
-	// Note that we only partially expand the tetrahedron to fill the entire Minkowski space.
-	// We don't have to fill the entire space before we know what the penetration delta is.
-	if (!epa.Expand(&pointSupplier, &triangleFactory))
+	if (cachedSimplex)
+		*cachedSimplex = simplex;
+
+	if (intersectionOccurs)
+		return false;
+
+	simplex.CalcWitnessPoints(closestA, closestB);
+
+	double coreDistance = closestPoint.Length();
+	distance = coreDistance - marginA - marginB;
+	if (distance <= 0.0)
+	{
+		distance = 0.0;
 		return false;
+	}
 
-	separationDelta = pointSupplier.GetSeparationDelta();
+	Vector3 unitNormal = closestPoint / coreDistance;
+	closestA += unitNormal * marginA;
+	closestB -= unitNormal * marginB;
 	return true;
 }
 
-void GJKShape::SetObjectToWorld(const Transform& objectToWorld)
+/*virtual*/ void GJKShape::SetObjectToWorld(const Transform& objectToWorld)
 {
 	this->objectToWorld = objectToWorld;
 }
@@ -185,64 +269,6 @@ const Transform& GJKShape::GetObjectToWorld() const
 	return this->ContainsObjectPoint(worldToObject.TransformPoint(point), cache);
 }
 
-//------------------------------------- GJKPointSupplierForEPA -------------------------------------
-
-GJKPointSupplierForEPA::GJKPointSupplierForEPA(const GJKShape* shapeA, const GJKShape* shapeB, ExpandingPolytopeAlgorithm* epa)
-{
-	this->shapeA = shapeA;
-	this->shapeB = shapeB;
-	this->epa = epa;
-	this->smallestDistance = std::numeric_limits<double>::max();
-}
-
-/*virtual*/ GJKPointSupplierForEPA::~GJKPointSupplierForEPA()
-{
-}
-
-/*virtual*/ bool GJKPointSupplierForEPA::GetNextPoint(Vector3& point)
-{
-	for (std::list<ExpandingPolytopeAlgorithm::Triangle*>::iterator iter = this->epa->triangleList.begin(); iter != this->epa->triangleList.end(); ++iter)
-	{
-		auto triangle = (GJKTriangleForEPA*)*iter;
-		if (triangle->status != GJKTriangleForEPA::Status::UNCONSIDERED)
-			continue;
-
-		Plane trianglePlane = triangle->MakePlane(this->epa->vertexArray);
-		Vector3 planePoint = trianglePlane.ClosestPointTo(Vector3::Zero());
-		double distance = planePoint.Length();
-		if (distance > this->smallestDistance)
-		{
-			// This triangle may or may not be on the Minkowski hull boundary, but it doesn't matter,
-			// because anything at or beyond this triangle is further from the origin than an already
-			// known part of the Minkowski hull boundary.
-			triangle->status = GJKTriangleForEPA::Status::CAN_BE_IGNORED;
-			continue;
-		}
-
-		Vector3 supportPoint = GJKSimplex::CalcSupportPoint(this->shapeA, this->shapeB, trianglePlane.unitNormal);
-		if (trianglePlane.GetSide(supportPoint, this->epa->planeThickness) == Plane::Side::FRONT)
-		{
-			triangle->status = GJKTriangleForEPA::Status::CAN_BE_IGNORED;
-			point = supportPoint;
-			return true;
-		}
-
-		triangle->status = GJKTriangleForEPA::Status::CONFIRMED_ON_HULL_BOUNDARY;
-		if (distance < this->smallestDistance)
-		{
-			this->smallestDistance = distance;
-			this->separationDelta = planePoint;
-		}
-	}
-
-	return false;
-}
-
-const Vector3& GJKPointSupplierForEPA::GetSeparationDelta() const
-{
-	return this->separationDelta;
-}
-
 //------------------------------------- GJKSphere -------------------------------------
 
 GJKSphere::GJKSphere()
@@ -323,6 +349,7 @@ GJKSphere::GJKSphere()
 
 GJKConvexHull::GJKConvexHull()
 {
+	this->warmStartVertex = 0;
 }
 
 /*virtual*/ GJKConvexHull::~GJKConvexHull()
@@ -331,23 +358,102 @@ GJKConvexHull::GJKConvexHull()
 
 /*virtual*/ Vector3 GJKConvexHull::FurthestPoint(const Vector3& unitDirection) const
 {
-	double largestDistance = -std::numeric_limits<double>::max();
-	Vector3 chosenVertex(0.0, 0.0, 0.0);
+	// Rather than take every vertex into world space, take the direction into object space just once.
+	// Treating the direction as a row vector here is the same as multiplying by the transpose.
+	Vector3 objectDirection = unitDirection * this->objectToWorld.matrix;
 
-	for (const Vector3& objectVertex : this->hull.GetVertexArray())
+	int i = this->FindSupportVertex(objectDirection);
+	if (i < 0)
+		return this->objectToWorld.translation;
+
+	return this->objectToWorld.TransformPoint(this->hull.GetVertex(i));
+}
+
+int GJKConvexHull::FindSupportVertex(const Vector3& objectDirection) const
+{
+	const std::vector<Vector3>& vertexArray = this->hull.GetVertexArray();
+	int numVertices = (int)vertexArray.size();
+	if (numVertices == 0)
+		return -1;
+
+	// For small hulls, it's hard to beat just checking every vertex.
+	constexpr int minVerticesForHillClimbing = 32;
+	if (numVertices < minVerticesForHillClimbing || (int)this->adjacencyOffsetArray.size() != numVertices + 1)
 	{
-		Vector3 worldVertex = this->objectToWorld.TransformPoint(objectVertex);
-		double distance = worldVertex.Dot(unitDirection);
-		if (distance > largestDistance)
+		int chosenVertex = 0;
+		double largestDistance = vertexArray[0].Dot(objectDirection);
+		for (int i = 1; i < numVertices; i++)
 		{
-			largestDistance = distance;
-			chosenVertex = worldVertex;
+			double distance = vertexArray[i].Dot(objectDirection);
+			if (distance > largestDistance)
+			{
+				largestDistance = distance;
+				chosenVertex = i;
+			}
+		}
+
+		return chosenVertex;
+	}
+
+	// Since the hull is convex, any vertex with no better neighbor is as good as it gets.
+	// Note that the warm-start vertex is just a hint, so it's okay if other threads race us for it.
+	int chosenVertex = this->warmStartVertex.load(std::memory_order_relaxed);
+	if (chosenVertex < 0 || chosenVertex >= numVertices)
+		chosenVertex = 0;
+
+	double largestDistance = vertexArray[chosenVertex].Dot(objectDirection);
+	bool improved = true;
+	while (improved)
+	{
+		improved = false;
+		int start = this->adjacencyOffsetArray[chosenVertex];
+		int end = this->adjacencyOffsetArray[chosenVertex + 1];
+		for (int j = start; j < end; j++)
+		{
+			int i = this->adjacencyArray[j];
+			double distance = vertexArray[i].Dot(objectDirection);
+			if (distance > largestDistance)
+			{
+				largestDistance = distance;
+				chosenVertex = i;
+				improved = true;
+			}
 		}
 	}
 
+	this->warmStartVertex.store(chosenVertex, std::memory_order_relaxed);
 	return chosenVertex;
 }
 
+void GJKConvexHull::GenerateAdjacency()
+{
+	std::set<Graph::UnorderedEdge, Graph::UnorderedEdge> edgeSet;
+	this->GenerateEdgeSet(edgeSet);
+
+	int numVertices = this->hull.GetNumVertices();
+
+	this->adjacencyOffsetArray.clear();
+	this->adjacencyOffsetArray.resize(numVertices + 1, 0);
+	for (const Graph::UnorderedEdge& edge : edgeSet)
+	{
+		this->adjacencyOffsetArray[edge.i + 1]++;
+		this->adjacencyOffsetArray[edge.j + 1]++;
+	}
+
+	for (int i = 0; i < numVertices; i++)
+		this->adjacencyOffsetArray[i + 1] += this->adjacencyOffsetArray[i];
+
+	std::vector<int> countArray(this->adjacencyOffsetArray.begin(), this->adjacencyOffsetArray.end() - 1);
+	this->adjacencyArray.resize(this->adjacencyOffsetArray[numVertices]);
+	for (const Graph::UnorderedEdge& edge : edgeSet)
+	{
+		this->adjacencyArray[countArray[edge.i]++] = edge.j;
+		this->adjacencyArray[countArray[edge.j]++] = edge.i;
+	}
+
+	this->warmStartVertex = 0;
+}
+
 /*virtual*/ AxisAlignedBoundingBox GJKConvexHull::GetObjectBoundingBox() const
 {
 	AxisAlignedBoundingBox objectBoundingBox;
@@ -375,11 +481,28 @@ GJKConvexHull::GJKConvexHull()
 
 /*virtual*/ bool GJKConvexHull::RayCast(const Ray& ray, double& alpha, Vector3& unitSurfaceNormal) const
 {
-	PolygonMesh worldHull(this->hull);
-	for (Vector3& vertex : worldHull.GetVertexArray())
-		vertex = this->objectToWorld.TransformPoint(vertex);
+	// Rather than move the whole hull into world space, move the ray into object space.  The matrix
+	// need not be orthonormal, so the object-space direction is renormalized, and the hit scaled back.
+	Transform worldToObject;
+	if (!worldToObject.Invert(this->objectToWorld))
+		return false;
+
+	Ray objectRay;
+	objectRay.origin = worldToObject.TransformPoint(ray.origin);
+	objectRay.unitDirection = worldToObject.TransformVector(ray.unitDirection);
+	double directionLength = 0.0;
+	if (!objectRay.unitDirection.Normalize(&directionLength))
+		return false;
+
+	double objectAlpha = 0.0;
+	Vector3 objectNormal;
+	if (!this->hull.RayCast(objectRay, objectAlpha, objectNormal))
+		return false;
 
-	return worldHull.RayCast(ray, alpha, unitSurfaceNormal);
+	// Normals go back to world space by the inverse-transpose.
+	alpha = objectAlpha / directionLength;
+	unitSurfaceNormal = (objectNormal * worldToObject.matrix).Normalized();
+	return true;
 }
 
 /*virtual*/ void GJKConvexHull::Shift(const Vector3& translation)
@@ -457,286 +580,926 @@ Vector3 GJKConvexHull::GetWorldVertex(int i) const
 	return true;
 }
 
-//------------------------------------- GJKSimplex -------------------------------------
+//------------------------------------- GJKTriangle -------------------------------------
 
-GJKSimplex::GJKSimplex()
+GJKTriangle::GJKTriangle()
 {
 }
 
-/*virtual*/ GJKSimplex::~GJKSimplex()
+/*virtual*/ GJKTriangle::~GJKTriangle()
 {
 }
 
-/*static*/ Vector3 GJKSimplex::CalcSupportPoint(const GJKShape* shapeA, const GJKShape* shapeB, const Vector3& unitDirection)
+/*virtual*/ Vector3 GJKTriangle::FurthestPoint(const Vector3& unitDirection) const
 {
-	return shapeB->FurthestPoint(unitDirection) - shapeA->FurthestPoint(-unitDirection);
+	Vector3 objectDirection = unitDirection * this->objectToWorld.matrix;
+
+	int j = 0;
+	double largestDistance = this->vertex[0].Dot(objectDirection);
+	for (int i = 1; i < 3; i++)
+	{
+		double distance = this->vertex[i].Dot(objectDirection);
+		if (distance > largestDistance)
+		{
+			largestDistance = distance;
+			j = i;
+		}
+	}
+
+	return this->objectToWorld.TransformPoint(this->vertex[j]);
 }
 
-/*virtual*/ GJKSimplex* GJKSimplex::FindFacetNearestOrigin() const
+/*virtual*/ AxisAlignedBoundingBox GJKTriangle::GetObjectBoundingBox() const
 {
-	return nullptr;
+	AxisAlignedBoundingBox objectBoundingBox;
+	objectBoundingBox.MakeReadyForExpansion();
+
+	for (int i = 0; i < 3; i++)
+		objectBoundingBox.Expand(this->vertex[i]);
+
+	return objectBoundingBox;
 }
 
-/*virtual*/ Vector3 GJKSimplex::CalcFacetNorm() const
+/*virtual*/ AxisAlignedBoundingBox GJKTriangle::GetWorldBoundingBox() const
 {
-	return Vector3::Zero();
+	AxisAlignedBoundingBox worldBoundingBox;
+	worldBoundingBox.MakeReadyForExpansion();
+
+	for (int i = 0; i < 3; i++)
+		worldBoundingBox.Expand(this->objectToWorld.TransformPoint(this->vertex[i]));
+
+	return worldBoundingBox;
 }
 
-/*virtual*/ GJKSimplex* GJKSimplex::ExtendSimplexWithPoint(const Vector3& supportPoint) const
+/*virtual*/ bool GJKTriangle::RayCast(const Ray& ray, double& alpha, Vector3& unitSurfaceNormal) const
 {
-	return nullptr;
+	Vector3 worldVertex[3];
+	for (int i = 0; i < 3; i++)
+		worldVertex[i] = this->objectToWorld.TransformPoint(this->vertex[i]);
+
+	if (!RayCastTriangle(ray, worldVertex[0], worldVertex[1], worldVertex[2], alpha))
+		return false;
+
+	unitSurfaceNormal = (worldVertex[1] - worldVertex[0]).Cross(worldVertex[2] - worldVertex[0]).Normalized();
+	if (unitSurfaceNormal.Dot(ray.unitDirection) > 0.0)
+		unitSurfaceNormal = -unitSurfaceNormal;
+
+	return true;
 }
 
-//------------------------------------- GJKPointSimplex -------------------------------------
+/*virtual*/ Vector3 GJKTriangle::CalcGeometricCenter() const
+{
+	return (this->vertex[0] + this->vertex[1] + this->vertex[2]) / 3.0;
+}
 
-GJKPointSimplex::GJKPointSimplex()
+/*virtual*/ void GJKTriangle::Shift(const Vector3& translation)
 {
+	for (int i = 0; i < 3; i++)
+		this->vertex[i] += translation;
 }
 
-/*virtual*/ GJKPointSimplex::~GJKPointSimplex()
+Plane GJKTriangle::GetWorldPlane() const
 {
+	return Plane(
+		this->objectToWorld.TransformPoint(this->vertex[0]),
+		this->objectToWorld.TransformPoint(this->vertex[1]),
+		this->objectToWorld.TransformPoint(this->vertex[2]));
 }
 
-/*virtual*/ bool GJKPointSimplex::ContainsOrigin(double epsilon) const
+/*static*/ bool GJKTriangle::RayCastTriangle(const Ray& ray, const Vector3& vertexA, const Vector3& vertexB, const Vector3& vertexC, double& alpha)
 {
-	double squareLength = this->point.SquareLength();
-	return squareLength <= epsilon * epsilon;
+	// This is the Moller-Trumbore algorithm, which solves for the ray distance and barycentric coordinates all at once.
+	Vector3 edgeAB = vertexB - vertexA;
+	Vector3 edgeAC = vertexC - vertexA;
+	Vector3 vectorP = ray.unitDirection.Cross(edgeAC);
+	double determinant = edgeAB.Dot(vectorP);
+	if (::fabs(determinant) < THEBE_SMALL_EPS)
+		return false;
+
+	double inverseDeterminant = 1.0 / determinant;
+	Vector3 vectorT = ray.origin - vertexA;
+	double u = vectorT.Dot(vectorP) * inverseDeterminant;
+	if (u < 0.0 || u > 1.0)
+		return false;
+
+	Vector3 vectorQ = vectorT.Cross(edgeAB);
+	double v = ray.unitDirection.Dot(vectorQ) * inverseDeterminant;
+	if (v < 0.0 || u + v > 1.0)
+		return false;
+
+	double t = edgeAC.Dot(vectorQ) * inverseDeterminant;
+	if (t < 0.0)
+		return false;
+
+	alpha = t;
+	return true;
 }
 
-/*virtual*/ uint32_t GJKPointSimplex::GetDimension() const
+//------------------------------------- GJKTransformedShape -------------------------------------
+
+GJKTransformedShape::GJKTransformedShape()
 {
-	return 0;
+	this->shape = nullptr;
 }
 
-/*virtual*/ Vector3 GJKPointSimplex::CalcFacetNorm() const
+/*virtual*/ GJKTransformedShape::~GJKTransformedShape()
 {
-	return -this->point.Normalized();
 }
 
-/*virtual*/ GJKSimplex* GJKPointSimplex::ExtendSimplexWithPoint(const Vector3& supportPoint) const
+void GJKTransformedShape::SetShape(const GJKShape* shape, const Transform& shapeToObject)
 {
-	auto line = new GJKLineSimplex();
-	line->lineSegment.point[0] = this->point;
-	line->lineSegment.point[1] = supportPoint;
-	return line;
+	this->shape = shape;
+	this->shapeToObject = shapeToObject;
+	this->UpdateRelativeTransform();
 }
 
-#if defined GJK_RENDER_DEBUG
-/*virtual*/ void GJKPointSimplex::DebugDraw(DebugRenderClient* client, int simplexNumber)
+const GJKShape* GJKTransformedShape::GetShape() const
 {
-	client->AddLine(std::format("simplex{}", simplexNumber), this->point - Vector3::XAxis() * 0.1, this->point + Vector3::XAxis() * 0.1, Vector3(1.0, 0.0, 0.0));
-	client->AddLine(std::format("simplex{}", simplexNumber), this->point - Vector3::YAxis() * 0.1, this->point + Vector3::YAxis() * 0.1, Vector3(0.0, 1.0, 0.0));
-	client->AddLine(std::format("simplex{}", simplexNumber), this->point - Vector3::ZAxis() * 0.1, this->point + Vector3::ZAxis() * 0.1, Vector3(0.0, 0.0, 1.0));
+	return this->shape;
 }
-#endif //GJK_RENDER_DEBUG
 
-//------------------------------------- GJKLineSimplex -------------------------------------
+/*virtual*/ void GJKTransformedShape::SetObjectToWorld(const Transform& objectToWorld)
+{
+	GJKShape::SetObjectToWorld(objectToWorld);
+	this->UpdateRelativeTransform();
+}
 
-GJKLineSimplex::GJKLineSimplex()
+void GJKTransformedShape::UpdateRelativeTransform()
 {
+	// The other shape only knows how to be where it is, so we go by way of there.
+	if (this->shape)
+		this->relativeTransform = this->objectToWorld * this->shapeToObject * this->shape->GetObjectToWorld().Inverted();
 }
 
-/*virtual*/ GJKLineSimplex::~GJKLineSimplex()
+/*virtual*/ Vector3 GJKTransformedShape::FurthestPoint(const Vector3& unitDirection) const
 {
+	THEBE_ASSERT(this->shape != nullptr);
+
+	// The support point of a transformed shape is the transformed support point in the transposed direction.
+	Vector3 shapeDirection = unitDirection * this->relativeTransform.matrix;
+	if (!shapeDirection.Normalize())
+		shapeDirection = unitDirection;
+
+	return this->relativeTransform.TransformPoint(this->shape->FurthestPoint(shapeDirection));
 }
 
-/*virtual*/ bool GJKLineSimplex::ContainsOrigin(double epsilon) const
+/*virtual*/ AxisAlignedBoundingBox GJKTransformedShape::GetObjectBoundingBox() const
 {
-	return this->lineSegment.ContainsPoint(Vector3::Zero(), nullptr, epsilon);
+	AxisAlignedBoundingBox shapeBoundingBox = this->shape->GetObjectBoundingBox();
+
+	AxisAlignedBoundingBox objectBoundingBox;
+	objectBoundingBox.MakeReadyForExpansion();
+
+	for (int i = 0; i < 8; i++)
+	{
+		Vector3 corner(
+			(i & 1) ? shapeBoundingBox.maxCorner.x : shapeBoundingBox.minCorner.x,
+			(i & 2) ? shapeBoundingBox.maxCorner.y : shapeBoundingBox.minCorner.y,
+			(i & 4) ? shapeBoundingBox.maxCorner.z : shapeBoundingBox.minCorner.z);
+		objectBoundingBox.Expand(this->shapeToObject.TransformPoint(corner));
+	}
+
+	return objectBoundingBox;
 }
 
-/*virtual*/ uint32_t GJKLineSimplex::GetDimension() const
+/*virtual*/ AxisAlignedBoundingBox GJKTransformedShape::GetWorldBoundingBox() const
 {
-	return 1;
+	// Being convex, the shape is bounded exactly by its support points along the axes.
+	AxisAlignedBoundingBox worldBoundingBox;
+	worldBoundingBox.minCorner.x = this->FurthestPoint(Vector3(-1.0, 0.0, 0.0)).x;
+	worldBoundingBox.minCorner.y = this->FurthestPoint(Vector3(0.0, -1.0, 0.0)).y;
+	worldBoundingBox.minCorner.z = this->FurthestPoint(Vector3(0.0, 0.0, -1.0)).z;
+	worldBoundingBox.maxCorner.x = this->FurthestPoint(Vector3(1.0, 0.0, 0.0)).x;
+	worldBoundingBox.maxCorner.y = this->FurthestPoint(Vector3(0.0, 1.0, 0.0)).y;
+	worldBoundingBox.maxCorner.z = this->FurthestPoint(Vector3(0.0, 0.0, 1.0)).z;
+	return worldBoundingBox;
 }
 
-/*virtual*/ Vector3 GJKLineSimplex::CalcFacetNorm() const
+/*virtual*/ bool GJKTransformedShape::RayCast(const Ray& ray, double& alpha, Vector3& unitSurfaceNormal) const
 {
-	Vector3 unitLineDirection = this->lineSegment.GetDelta().Normalized();
-	return (-lineSegment.point[0]).RejectedFrom(unitLineDirection).Normalized();
+	// Cast the ray at the other shape where it actually is, and then bring the hit back.
+	Transform inverseRelativeTransform;
+	if (!inverseRelativeTransform.Invert(this->relativeTransform))
+		return false;
+
+	Ray shapeRay;
+	shapeRay.origin = inverseRelativeTransform.TransformPoint(ray.origin);
+	shapeRay.unitDirection = inverseRelativeTransform.TransformVector(ray.unitDirection);
+	double directionLength = 0.0;
+	if (!shapeRay.unitDirection.Normalize(&directionLength))
+		return false;
+
+	double shapeAlpha = 0.0;
+	Vector3 shapeNormal;
+	if (!this->shape->RayCast(shapeRay, shapeAlpha, shapeNormal))
+		return false;
+
+	alpha = shapeAlpha / directionLength;
+	unitSurfaceNormal = (shapeNormal * inverseRelativeTransform.matrix).Normalized();
+	return true;
 }
 
-/*virtual*/ GJKSimplex* GJKLineSimplex::ExtendSimplexWithPoint(const Vector3& supportPoint) const
+/*virtual*/ Vector3 GJKTransformedShape::CalcGeometricCenter() const
 {
-	auto triangle = new GJKTriangleSimplex();
-	triangle->vertex[0] = this->lineSegment.point[0];
-	triangle->vertex[1] = this->lineSegment.point[1];
-	triangle->vertex[2] = supportPoint;
-	return triangle;
+	return this->shapeToObject.TransformPoint(this->shape->CalcGeometricCenter());
 }
 
-#if defined GJK_RENDER_DEBUG
-/*virtual*/ void GJKLineSimplex::DebugDraw(DebugRenderClient* client, int simplexNumber)
+/*virtual*/ void GJKTransformedShape::Shift(const Vector3& translation)
 {
-	client->AddLine(std::format("simplex{}", simplexNumber), this->lineSegment.point[0], this->lineSegment.point[1], Vector3(1.0, 0.0, 0.0));
+	// The other shape isn't ours to change, so move where we place it instead.
+	this->shapeToObject.translation += translation;
+	this->UpdateRelativeTransform();
 }
-#endif //GJK_RENDER_DEBUG
 
-//------------------------------------- GJKTriangleSimplex -------------------------------------
+//------------------------------------- GJKSimplex -------------------------------------
 
-GJKTriangleSimplex::GJKTriangleSimplex()
+GJKSimplex::GJKSimplex()
 {
+	this->Clear();
 }
 
-/*virtual*/ GJKTriangleSimplex::~GJKTriangleSimplex()
+void GJKSimplex::Clear()
 {
+	this->numVertices = 0;
+
+	for (int i = 0; i < 4; i++)
+		this->lambda[i] = 0.0;
 }
 
-/*virtual*/ bool GJKTriangleSimplex::ContainsOrigin(double epsilon) const
+void GJKSimplex::AddVertex(const Vertex& vertex)
 {
-	Plane plane(this->vertex[0], this->vertex[1], this->vertex[2]);
-	if (plane.GetSide(Vector3::Zero(), epsilon) != Plane::Side::NEITHER)
-		return false;
+	THEBE_ASSERT(this->numVertices < 4);
+	if (this->numVertices < 4)
+		this->vertex[this->numVertices++] = vertex;
+}
 
-	for (int i = 0; i < 3; i++)
+bool GJKSimplex::HasVertex(const Vector3& point, double epsilon) const
+{
+	for (int i = 0; i < this->numVertices; i++)
+		if ((this->vertex[i].point - point).SquareLength() <= epsilon * epsilon)
+			return true;
+
+	return false;
+}
+
+/*static*/ Vector3 GJKSimplex::CalcSupportPoint(const GJKShape* shapeA, const GJKShape* shapeB, const Vector3& unitDirection)
+{
+	return shapeB->FurthestPoint(unitDirection) - shapeA->FurthestPoint(-unitDirection);
+}
+
+/*static*/ GJKSimplex::Vertex GJKSimplex::CalcSupportVertex(const GJKShape* shapeA, const GJKShape* shapeB, const Vector3& unitDirection)
+{
+	Vertex vertex;
+	vertex.pointA = shapeA->FurthestPoint(-unitDirection);
+	vertex.pointB = shapeB->FurthestPoint(unitDirection);
+	vertex.point = vertex.pointB - vertex.pointA;
+	return vertex;
+}
+
+Vector3 GJKSimplex::ReduceToClosestPoint()
+{
+	Feature feature;
+
+	switch (this->numVertices)
 	{
-		Plane edgePlane(this->vertex[i], (this->vertex[(i + 1) % 3] - this->vertex[i]).Cross(plane.unitNormal).Normalized());
-		if (edgePlane.SignedDistanceTo(this->vertex[(i + 2) % 3]) > 0.0)
-			edgePlane.unitNormal = -edgePlane.unitNormal;
+		case 1:
+		{
+			this->lambda[0] = 1.0;
+			return this->vertex[0].point;
+		}
+		case 2:
+		{
+			this->ClosestFeatureOfSegment(0, 1, feature);
+			break;
+		}
+		case 3:
+		{
+			this->ClosestFeatureOfTriangle(0, 1, 2, feature);
+			break;
+		}
+		case 4:
+		{
+			// The last entry of each row here is the vertex opposite the face.
+			static const int faceArray[4][4] = { {1, 2, 3, 0}, {0, 2, 3, 1}, {0, 1, 3, 2}, {0, 1, 2, 3} };
+
+			// The closest point is found on one of the faces that the origin is in front of.
+			// If there are no such faces, then the origin is inside the tetrahedron.
+			bool foundFace = false;
+			double smallestSquareDistance = std::numeric_limits<double>::max();
+			for (int i = 0; i < 4; i++)
+			{
+				const Vector3& pointA = this->vertex[faceArray[i][0]].point;
+				const Vector3& pointB = this->vertex[faceArray[i][1]].point;
+				const Vector3& pointC = this->vertex[faceArray[i][2]].point;
+				const Vector3& pointD = this->vertex[faceArray[i][3]].point;
+
+				Vector3 normal = (pointB - pointA).Cross(pointC - pointA);
+				double originSide = (-pointA).Dot(normal);
+				double oppositeSide = (pointD - pointA).Dot(normal);
+
+				// Note that a flat tetrahedron has no inside, so we must check all its faces.
+				bool flat = ::fabs(oppositeSide) <= THEBE_SMALL_EPS;
+				if (!flat && originSide * oppositeSide >= 0.0)
+					continue;
+
+				Feature faceFeature;
+				this->ClosestFeatureOfTriangle(faceArray[i][0], faceArray[i][1], faceArray[i][2], faceFeature);
+				double squareDistance = faceFeature.point.SquareLength();
+				if (squareDistance < smallestSquareDistance)
+				{
+					smallestSquareDistance = squareDistance;
+					feature = faceFeature;
+					foundFace = true;
+				}
+			}
+
+			if (!foundFace)
+			{
+				auto signedVolume = [](const Vector3& pointA, const Vector3& pointB, const Vector3& pointC, const Vector3& pointD) -> double
+					{
+						return (pointB - pointA).Dot((pointC - pointA).Cross(pointD - pointA));
+					};
+
+				const Vector3& point0 = this->vertex[0].point;
+				const Vector3& point1 = this->vertex[1].point;
+				const Vector3& point2 = this->vertex[2].point;
+				const Vector3& point3 = this->vertex[3].point;
+				const Vector3& origin = Vector3::Zero();
+
+				double volume = signedVolume(point0, point1, point2, point3);
+				this->lambda[0] = signedVolume(origin, point1, point2, point3) / volume;
+				this->lambda[1] = signedVolume(point0, origin, point2, point3) / volume;
+				this->lambda[2] = signedVolume(point0, point1, origin, point3) / volume;
+				this->lambda[3] = signedVolume(point0, point1, point2, origin) / volume;
+				return Vector3::Zero();
+			}
 
-		if (edgePlane.GetSide(Vector3::Zero(), epsilon) == Plane::Side::FRONT)
-			return false;
+			break;
+		}
+		default:
+		{
+			return Vector3::Zero();
+		}
 	}
 
-	return true;
+	this->ReduceToFeature(feature);
+	return feature.point;
 }
 
-/*virtual*/ uint32_t GJKTriangleSimplex::GetDimension() const
+void GJKSimplex::ClosestFeatureOfSegment(int i, int j, Feature& feature) const
 {
-	return 2;
+	const Vector3& pointA = this->vertex[i].point;
+	const Vector3& pointB = this->vertex[j].point;
+
+	Vector3 edge = pointB - pointA;
+	double squareLength = edge.SquareLength();
+	double t = (squareLength > THEBE_SMALL_EPS) ? -pointA.Dot(edge) / squareLength : 0.0;
+
+	if (t <= 0.0)
+	{
+		feature.size = 1;
+		feature.index[0] = i;
+		feature.lambda[0] = 1.0;
+		feature.point = pointA;
+	}
+	else if (t >= 1.0)
+	{
+		feature.size = 1;
+		feature.index[0] = j;
+		feature.lambda[0] = 1.0;
+		feature.point = pointB;
+	}
+	else
+	{
+		feature.size = 2;
+		feature.index[0] = i;
+		feature.index[1] = j;
+		feature.lambda[0] = 1.0 - t;
+		feature.lambda[1] = t;
+		feature.point = pointA + edge * t;
+	}
 }
 
-/*virtual*/ Vector3 GJKTriangleSimplex::CalcFacetNorm() const
+void GJKSimplex::ClosestFeatureOfTriangle(int i, int j, int k, Feature& feature) const
 {
-	Plane plane(this->vertex[0], this->vertex[1], this->vertex[2]);
-	if (plane.center.Dot(plane.unitNormal) > 0.0)
-		return -plane.unitNormal;
-	return plane.unitNormal;
+	// This follows the treatment found in "Real-Time Collision Detection" by Christer Ericson,
+	// where each Voronoi region of the triangle is checked in turn for the origin.
+
+	const Vector3& pointA = this->vertex[i].point;
+	const Vector3& pointB = this->vertex[j].point;
+	const Vector3& pointC = this->vertex[k].point;
+
+	Vector3 edgeAB = pointB - pointA;
+	Vector3 edgeAC = pointC - pointA;
+
+	double d1 = edgeAB.Dot(-pointA);
+	double d2 = edgeAC.Dot(-pointA);
+	if (d1 <= 0.0 && d2 <= 0.0)
+	{
+		feature.size = 1;
+		feature.index[0] = i;
+		feature.lambda[0] = 1.0;
+		feature.point = pointA;
+		return;
+	}
+
+	double d3 = edgeAB.Dot(-pointB);
+	double d4 = edgeAC.Dot(-pointB);
+	if (d3 >= 0.0 && d4 <= d3)
+	{
+		feature.size = 1;
+		feature.index[0] = j;
+		feature.lambda[0] = 1.0;
+		feature.point = pointB;
+		return;
+	}
+
+	double vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+	{
+		double t = d1 / (d1 - d3);
+		feature.size = 2;
+		feature.index[0] = i;
+		feature.index[1] = j;
+		feature.lambda[0] = 1.0 - t;
+		feature.lambda[1] = t;
+		feature.point = pointA + edgeAB * t;
+		return;
+	}
+
+	double d5 = edgeAB.Dot(-pointC);
+	double d6 = edgeAC.Dot(-pointC);
+	if (d6 >= 0.0 && d5 <= d6)
+	{
+		feature.size = 1;
+		feature.index[0] = k;
+		feature.lambda[0] = 1.0;
+		feature.point = pointC;
+		return;
+	}
+
+	double vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+	{
+		double t = d2 / (d2 - d6);
+		feature.size = 2;
+		feature.index[0] = i;
+		feature.index[1] = k;
+		feature.lambda[0] = 1.0 - t;
+		feature.lambda[1] = t;
+		feature.point = pointA + edgeAC * t;
+		return;
+	}
+
+	double va = d3 * d6 - d5 * d4;
+	if (va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0)
+	{
+		double t = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		feature.size = 2;
+		feature.index[0] = j;
+		feature.index[1] = k;
+		feature.lambda[0] = 1.0 - t;
+		feature.lambda[1] = t;
+		feature.point = pointB + (pointC - pointB) * t;
+		return;
+	}
+
+	double denominator = va + vb + vc;
+	if (::fabs(denominator) <= THEBE_SMALL_EPS)
+	{
+		// The triangle is degenerate, so the answer must be found on one of its edges.
+		Feature edgeFeature;
+		this->ClosestFeatureOfSegment(i, j, feature);
+		this->ClosestFeatureOfSegment(i, k, edgeFeature);
+		if (edgeFeature.point.SquareLength() < feature.point.SquareLength())
+			feature = edgeFeature;
+		this->ClosestFeatureOfSegment(j, k, edgeFeature);
+		if (edgeFeature.point.SquareLength() < feature.point.SquareLength())
+			feature = edgeFeature;
+		return;
+	}
+
+	double v = vb / denominator;
+	double w = vc / denominator;
+	feature.size = 3;
+	feature.index[0] = i;
+	feature.index[1] = j;
+	feature.index[2] = k;
+	feature.lambda[0] = 1.0 - v - w;
+	feature.lambda[1] = v;
+	feature.lambda[2] = w;
+	feature.point = pointA + edgeAB * v + edgeAC * w;
 }
 
-/*virtual*/ GJKSimplex* GJKTriangleSimplex::ExtendSimplexWithPoint(const Vector3& supportPoint) const
+void GJKSimplex::ReduceToFeature(const Feature& feature)
 {
-	auto tetrahedron = new GJKTetrahedronSimplex();
-	tetrahedron->vertex[0] = this->vertex[0];
-	tetrahedron->vertex[1] = this->vertex[1];
-	tetrahedron->vertex[2] = this->vertex[2];
-	tetrahedron->vertex[3] = supportPoint;
-	return tetrahedron;
+	Vertex featureVertex[3];
+	for (int i = 0; i < feature.size; i++)
+		featureVertex[i] = this->vertex[feature.index[i]];
+
+	for (int i = 0; i < feature.size; i++)
+	{
+		this->vertex[i] = featureVertex[i];
+		this->lambda[i] = feature.lambda[i];
+	}
+
+	this->numVertices = feature.size;
 }
 
-#if defined GJK_RENDER_DEBUG
-/*virtual*/ void GJKTriangleSimplex::DebugDraw(DebugRenderClient* client, int simplexNumber)
+void GJKSimplex::CalcWitnessPoints(Vector3& pointA, Vector3& pointB) const
 {
-	for (int i = 0; i < 3; i++)
+	pointA.SetComponents(0.0, 0.0, 0.0);
+	pointB.SetComponents(0.0, 0.0, 0.0);
+
+	for (int i = 0; i < this->numVertices; i++)
 	{
-		int j = (i + 1) % 3;
-		client->AddLine(std::format("simplex{}", simplexNumber), this->vertex[i], this->vertex[j], Vector3(0.0, 1.0, 0.0));
+		pointA += this->vertex[i].pointA * this->lambda[i];
+		pointB += this->vertex[i].pointB * this->lambda[i];
 	}
 }
-#endif //GJK_RENDER_DEBUG
-
-//------------------------------------- GJKTetrahedronSimplex -------------------------------------
 
-GJKTetrahedronSimplex::GJKTetrahedronSimplex()
+Vector3 GJKSimplex::CalcClosestPoint() const
 {
+	Vector3 closestPoint(0.0, 0.0, 0.0);
+	for (int i = 0; i < this->numVertices; i++)
+		closestPoint += this->vertex[i].point * this->lambda[i];
+
+	return closestPoint;
 }
 
-/*virtual*/ GJKTetrahedronSimplex::~GJKTetrahedronSimplex()
+void GJKSimplex::Resample(const GJKShape* shapeA, const GJKShape* shapeB)
 {
+	int numOldVertices = this->numVertices;
+	Vector3 oldPointArray[4];
+	for (int i = 0; i < numOldVertices; i++)
+		oldPointArray[i] = this->vertex[i].point;
+
+	this->Clear();
+
+	for (int i = 0; i < numOldVertices; i++)
+	{
+		if (oldPointArray[i].SquareLength() <= THEBE_SMALL_EPS)
+			continue;
+
+		Vertex vertex = CalcSupportVertex(shapeA, shapeB, oldPointArray[i].Normalized());
+		if (!this->HasVertex(vertex.point, THEBE_SMALL_EPS))
+			this->AddVertex(vertex);
+	}
 }
 
-/*virtual*/ bool GJKTetrahedronSimplex::ContainsOrigin(double epsilon) const
+bool GJKSimplex::ExpandToTetrahedron(const GJKShape* shapeA, const GJKShape* shapeB)
 {
-	for (int i = 0; i < 4; i++)
+	static const Vector3 axisArray[6] =
+	{
+		Vector3(1.0, 0.0, 0.0),
+		Vector3(-1.0, 0.0, 0.0),
+		Vector3(0.0, 1.0, 0.0),
+		Vector3(0.0, -1.0, 0.0),
+		Vector3(0.0, 0.0, 1.0),
+		Vector3(0.0, 0.0, -1.0)
+	};
+
+	if (this->numVertices == 0)
+		this->AddVertex(CalcSupportVertex(shapeA, shapeB, axisArray[0]));
+
+	// Drop vertices that don't contribute any more dimension to the simplex.
+	if (this->numVertices >= 2 && (this->vertex[1].point - this->vertex[0].point).SquareLength() <= THEBE_MEDIUM_EPS * THEBE_MEDIUM_EPS)
 	{
-		FacetData& facetData = this->facetDataArray[i];
+		this->vertex[1] = this->vertex[this->numVertices - 1];
+		this->numVertices--;
+	}
 
-		int k = 0;
-		for (int j = 0; j < 4; j++)
-			if (j != i)
-				facetData.vertex[k++] = j;
+	if (this->numVertices == 1)
+	{
+		for (int i = 0; i < 6 && this->numVertices == 1; i++)
+		{
+			Vertex vertex = CalcSupportVertex(shapeA, shapeB, axisArray[i]);
+			if ((vertex.point - this->vertex[0].point).SquareLength() > THEBE_MEDIUM_EPS * THEBE_MEDIUM_EPS)
+				this->AddVertex(vertex);
+		}
 
-		facetData.plane = Plane(
-			this->vertex[facetData.vertex[0]],
-			this->vertex[facetData.vertex[1]],
-			this->vertex[facetData.vertex[2]]);
+		if (this->numVertices == 1)
+			return false;
+	}
 
-		if (facetData.plane.SignedDistanceTo(this->vertex[i]) > 0.0)
-			facetData.plane.unitNormal = -facetData.plane.unitNormal;
+	if (this->numVertices >= 3)
+	{
+		Vector3 normal = (this->vertex[1].point - this->vertex[0].point).Cross(this->vertex[2].point - this->vertex[0].point);
+		if (normal.SquareLength() <= THEBE_SMALL_EPS)
+			this->numVertices = 2;
 	}
 
-	for (int i = 0; i < 4; i++)
+	if (this->numVertices == 2)
 	{
-		const FacetData& facetData = this->facetDataArray[i];
-		double distance = facetData.plane.SignedDistanceTo(Vector3::Zero());
-		if (distance > epsilon)
+		Vector3 unitLineDirection = (this->vertex[1].point - this->vertex[0].point).Normalized();
+
+		Vector3 axis = axisArray[0];
+		if (::fabs(unitLineDirection.y) < ::fabs(unitLineDirection.x) && ::fabs(unitLineDirection.y) < ::fabs(unitLineDirection.z))
+			axis = axisArray[2];
+		else if (::fabs(unitLineDirection.z) < ::fabs(unitLineDirection.x))
+			axis = axisArray[4];
+
+		Vector3 unitPerpA = unitLineDirection.Cross(axis).Normalized();
+		Vector3 unitPerpB = unitLineDirection.Cross(unitPerpA).Normalized();
+		Vector3 directionArray[4] = { unitPerpA, -unitPerpA, unitPerpB, -unitPerpB };
+
+		for (int i = 0; i < 4 && this->numVertices == 2; i++)
+		{
+			Vertex vertex = CalcSupportVertex(shapeA, shapeB, directionArray[i]);
+			if ((vertex.point - this->vertex[0].point).Cross(unitLineDirection).SquareLength() > THEBE_MEDIUM_EPS * THEBE_MEDIUM_EPS)
+				this->AddVertex(vertex);
+		}
+
+		if (this->numVertices == 2)
+			return false;
+	}
+
+	if (this->numVertices == 4)
+	{
+		Vector3 normal = (this->vertex[1].point - this->vertex[0].point).Cross(this->vertex[2].point - this->vertex[0].point).Normalized();
+		if (::fabs((this->vertex[3].point - this->vertex[0].point).Dot(normal)) <= THEBE_MEDIUM_EPS)
+			this->numVertices = 3;
+	}
+
+	if (this->numVertices == 3)
+	{
+		Vector3 unitNormal = (this->vertex[1].point - this->vertex[0].point).Cross(this->vertex[2].point - this->vertex[0].point).Normalized();
+
+		for (int i = 0; i < 2 && this->numVertices == 3; i++)
+		{
+			Vertex vertex = CalcSupportVertex(shapeA, shapeB, (i == 0) ? unitNormal : -unitNormal);
+			if (::fabs((vertex.point - this->vertex[0].point).Dot(unitNormal)) > THEBE_MEDIUM_EPS)
+				this->AddVertex(vertex);
+		}
+
+		if (this->numVertices == 3)
 			return false;
 	}
 
 	return true;
 }
 
-/*virtual*/ uint32_t GJKTetrahedronSimplex::GetDimension() const
+#if defined GJK_RENDER_DEBUG
+void GJKSimplex::DebugDraw(DebugRenderClient* client, int simplexNumber) const
+{
+	if (this->numVertices == 1)
+	{
+		const Vector3& point = this->vertex[0].point;
+		client->AddLine(std::format("simplex{}", simplexNumber), point - Vector3::XAxis() * 0.1, point + Vector3::XAxis() * 0.1, Vector3(1.0, 0.0, 0.0));
+		client->AddLine(std::format("simplex{}", simplexNumber), point - Vector3::YAxis() * 0.1, point + Vector3::YAxis() * 0.1, Vector3(0.0, 1.0, 0.0));
+		client->AddLine(std::format("simplex{}", simplexNumber), point - Vector3::ZAxis() * 0.1, point + Vector3::ZAxis() * 0.1, Vector3(0.0, 0.0, 1.0));
+		return;
+	}
+
+	Vector3 color(1.0, 0.0, 0.0);
+	if (this->numVertices == 3)
+		color.SetComponents(0.0, 1.0, 0.0);
+	else if (this->numVertices == 4)
+		color.SetComponents(0.0, 0.0, 1.0);
+
+	for (int i = 0; i < this->numVertices; i++)
+		for (int j = i + 1; j < this->numVertices; j++)
+			client->AddLine(std::format("simplex{}", simplexNumber), this->vertex[i].point, this->vertex[j].point, color);
+}
+#endif //GJK_RENDER_DEBUG
+
+//------------------------------------- GJKExpandingPolytope -------------------------------------
+
+GJKExpandingPolytope::GJKExpandingPolytope()
 {
-	return 3;
+	this->numVertices = 0;
+	this->numFaces = 0;
+	this->heapSize = 0;
+	this->horizonSize = 0;
+	this->closestFaceIndex = -1;
 }
 
-/*virtual*/ GJKSimplex* GJKTetrahedronSimplex::FindFacetNearestOrigin() const
+bool GJKExpandingPolytope::Initialize(const GJKSimplex& tetrahedron)
 {
-	// I have no proof that the GJK algorithm will always converge.
-	// Based on intuition, this is the best I can do...
+	this->numVertices = 0;
+	this->numFaces = 0;
+	this->heapSize = 0;
+	this->horizonSize = 0;
+	this->closestFaceIndex = -1;
 
-	std::vector<std::unique_ptr<GJKTriangleSimplex>> triangleArray(3);
-	std::vector<double> cosAngleArray(3);
+	if (tetrahedron.numVertices != 4)
+		return false;
 
-	int candidateCount = 0;
 	for (int i = 0; i < 4; i++)
-	{
-		const FacetData& facet = this->facetDataArray[i];
-		if (facet.plane.SignedDistanceTo(Vector3::Zero()) <= 0.0)
-			continue;
+		this->vertexArray[this->numVertices++] = tetrahedron.vertex[i];
 
-		THEBE_ASSERT(candidateCount < (int)triangleArray.size());
+	// Make sure the tetrahedron is positively oriented so that the faces below all wind outward.
+	const Vector3& point0 = this->vertexArray[0].point;
+	double volume = (this->vertexArray[1].point - point0).Dot((this->vertexArray[2].point - point0).Cross(this->vertexArray[3].point - point0));
+	if (::fabs(volume) <= THEBE_SMALL_EPS)
+		return false;
 
-		auto triangle = new GJKTriangleSimplex();
-		triangle->vertex[0] = this->vertex[facet.vertex[0]];
-		triangle->vertex[1] = this->vertex[facet.vertex[1]];
-		triangle->vertex[2] = this->vertex[facet.vertex[2]];
+	if (volume < 0.0)
+		std::swap(this->vertexArray[1], this->vertexArray[2]);
 
-		Vector3 center = (
-			triangle->vertex[0] +
-			triangle->vertex[1] +
-			triangle->vertex[2]) / 3.0;
+	static const int faceVertexArray[4][3] = { {0, 2, 1}, {0, 1, 3}, {1, 2, 3}, {0, 3, 2} };
+	for (int i = 0; i < 4; i++)
+		if (this->AddFace(faceVertexArray[i][0], faceVertexArray[i][1], faceVertexArray[i][2]) < 0)
+			return false;
 
-		double cosAngle = (-center.Normalized()).Dot(facet.plane.unitNormal);
-		
-		triangleArray[candidateCount].reset(triangle);
-		cosAngleArray[candidateCount] = cosAngle;
-		candidateCount++;
+	// Every half-edge of the tetrahedron has its twin in one of the other faces.
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = i + 1; j < 4; j++)
+		{
+			for (int a = 0; a < 3; a++)
+			{
+				for (int b = 0; b < 3; b++)
+				{
+					const Face& faceA = this->faceArray[i];
+					const Face& faceB = this->faceArray[j];
+					if (faceA.vertex[a] == faceB.vertex[(b + 1) % 3] && faceA.vertex[(a + 1) % 3] == faceB.vertex[b])
+						this->LinkEdges(i, a, j, b);
+				}
+			}
+		}
 	}
 
-	int chosenTriangle = -1;
-	double largestCosAngle = -2.0;
-	for (int i = 0; i < candidateCount; i++)
+	return true;
+}
+
+bool GJKExpandingPolytope::Expand(const GJKShape* shapeA, const GJKShape* shapeB)
+{
+	this->closestFaceIndex = -1;
+
+	int faceIndex = -1;
+	while (this->PopClosestFace(faceIndex))
 	{
-		double cosAngle = cosAngleArray[i];
-		if (cosAngle > largestCosAngle)
+		this->closestFaceIndex = faceIndex;
+		Face& face = this->faceArray[faceIndex];
+
+		// If the support point doesn't get us any further than this face, then this face is on the boundary of the Minkowski difference.
+		GJKSimplex::Vertex vertex = GJKSimplex::CalcSupportVertex(shapeA, shapeB, face.unitNormal);
+		if (vertex.point.Dot(face.unitNormal) - face.distance <= THEBE_MEDIUM_EPS)
+			return true;
+
+		if (this->numVertices == maxVertices)
+			return true;
+
+		int newVertexIndex = this->numVertices++;
+		this->vertexArray[newVertexIndex] = vertex;
+
+		// Remove the region of faces visible from the new point, keeping track of its boundary.
+		face.obsolete = true;
+		this->horizonSize = 0;
+		for (int i = 0; i < 3; i++)
+			if (!this->FindHorizon(face.adjacentFace[i], face.adjacentEdge[i], vertex.point))
+				return true;
+
+		if (this->numFaces + this->horizonSize > maxFaces)
+			return true;
+
+		// Now fill the hole with a fan of faces, each joining an edge of the horizon to the new point.
+		int firstNewFaceIndex = this->numFaces;
+		for (int i = 0; i < this->horizonSize; i++)
 		{
-			largestCosAngle = cosAngle;
-			chosenTriangle = i;
+			const HalfEdge& halfEdge = this->horizonArray[i];
+			const Face& horizonFace = this->faceArray[halfEdge.faceIndex];
+			int newFaceIndex = this->AddFace(horizonFace.vertex[(halfEdge.edgeIndex + 1) % 3], horizonFace.vertex[halfEdge.edgeIndex], newVertexIndex);
+			if (newFaceIndex < 0)
+				return true;
+
+			this->LinkEdges(newFaceIndex, 0, halfEdge.faceIndex, halfEdge.edgeIndex);
 		}
+
+		for (int i = firstNewFaceIndex; i < this->numFaces; i++)
+			for (int j = firstNewFaceIndex; j < this->numFaces; j++)
+				if (this->faceArray[i].vertex[1] == this->faceArray[j].vertex[0])
+					this->LinkEdges(i, 1, j, 2);
+
+		// The horizon should always be a simple loop, but numerical trouble could make it otherwise.
+		for (int i = firstNewFaceIndex; i < this->numFaces; i++)
+			if (this->faceArray[i].adjacentFace[1] < 0 || this->faceArray[i].adjacentFace[2] < 0)
+				return true;
 	}
 
-	THEBE_ASSERT(chosenTriangle != -1);
+	return this->closestFaceIndex >= 0;
+}
+
+bool GJKExpandingPolytope::FindHorizon(int faceIndex, int edgeIndex, const Vector3& point)
+{
+	// We come into the given face across the given edge from a face that is visible from the given point.
+	Face& face = this->faceArray[faceIndex];
+	if (face.obsolete)
+		return true;
+
+	if (face.unitNormal.Dot(point) - face.distance <= THEBE_SMALL_EPS)
+	{
+		if (this->horizonSize == maxFaces)
+			return false;
+
+		HalfEdge& halfEdge = this->horizonArray[this->horizonSize++];
+		halfEdge.faceIndex = faceIndex;
+		halfEdge.edgeIndex = edgeIndex;
+		return true;
+	}
+
+	face.obsolete = true;
+
+	for (int i = 1; i <= 2; i++)
+	{
+		int j = (edgeIndex + i) % 3;
+		if (!this->FindHorizon(face.adjacentFace[j], face.adjacentEdge[j], point))
+			return false;
+	}
 
-	return triangleArray[chosenTriangle].release();
+	return true;
 }
 
-#if defined GJK_RENDER_DEBUG
-/*virtual*/ void GJKTetrahedronSimplex::DebugDraw(DebugRenderClient* client, int simplexNumber)
+int GJKExpandingPolytope::AddFace(int i, int j, int k)
 {
-	for (int i = 0; i < 4; i++)
-		for (int j = i + 1; j < 4; j++)
-			client->AddLine(std::format("simplex{}", simplexNumber), this->vertex[i], this->vertex[j], Vector3(0.0, 0.0, 1.0));
+	if (this->numFaces == maxFaces)
+		return -1;
+
+	const Vector3& pointA = this->vertexArray[i].point;
+	const Vector3& pointB = this->vertexArray[j].point;
+	const Vector3& pointC = this->vertexArray[k].point;
+
+	Vector3 normal = (pointB - pointA).Cross(pointC - pointA);
+	double length = normal.Length();
+	if (length <= THEBE_SMALL_EPS)
+		return -1;
+
+	int faceIndex = this->numFaces++;
+	Face& face = this->faceArray[faceIndex];
+	face.vertex[0] = i;
+	face.vertex[1] = j;
+	face.vertex[2] = k;
+	for (int e = 0; e < 3; e++)
+	{
+		face.adjacentFace[e] = -1;
+		face.adjacentEdge[e] = -1;
+	}
+	face.unitNormal = normal / length;
+	face.distance = face.unitNormal.Dot(pointA);
+	face.obsolete = false;
+
+	HeapEntry& entry = this->heapArray[this->heapSize++];
+	entry.distance = face.distance;
+	entry.faceIndex = faceIndex;
+	std::push_heap(this->heapArray, this->heapArray + this->heapSize, [](const HeapEntry& entryA, const HeapEntry& entryB) { return entryA.distance > entryB.distance; });
+
+	return faceIndex;
+}
+
+void GJKExpandingPolytope::LinkEdges(int faceIndexA, int edgeIndexA, int faceIndexB, int edgeIndexB)
+{
+	Face& faceA = this->faceArray[faceIndexA];
+	Face& faceB = this->faceArray[faceIndexB];
+
+	faceA.adjacentFace[edgeIndexA] = faceIndexB;
+	faceA.adjacentEdge[edgeIndexA] = edgeIndexB;
+	faceB.adjacentFace[edgeIndexB] = faceIndexA;
+	faceB.adjacentEdge[edgeIndexB] = edgeIndexA;
+}
+
+bool GJKExpandingPolytope::PopClosestFace(int& faceIndex)
+{
+	// Faces are never removed from the heap when they're cut out of the polytope, so skip those here.
+	while (this->heapSize > 0)
+	{
+		std::pop_heap(this->heapArray, this->heapArray + this->heapSize, [](const HeapEntry& entryA, const HeapEntry& entryB) { return entryA.distance > entryB.distance; });
+		faceIndex = this->heapArray[--this->heapSize].faceIndex;
+		if (!this->faceArray[faceIndex].obsolete)
+			return true;
+	}
+
+	return false;
+}
+
+const Vector3& GJKExpandingPolytope::GetUnitNormal() const
+{
+	THEBE_ASSERT(this->closestFaceIndex >= 0);
+	return this->faceArray[this->closestFaceIndex].unitNormal;
+}
+
+double GJKExpandingPolytope::GetDistance() const
+{
+	THEBE_ASSERT(this->closestFaceIndex >= 0);
+	return this->faceArray[this->closestFaceIndex].distance;
+}
+
+void GJKExpandingPolytope::CalcWitnessPoints(Vector3& pointA, Vector3& pointB) const
+{
+	THEBE_ASSERT(this->closestFaceIndex >= 0);
+	const Face& face = this->faceArray[this->closestFaceIndex];
+
+	const GJKSimplex::Vertex& vertexA = this->vertexArray[face.vertex[0]];
+	const GJKSimplex::Vertex& vertexB = this->vertexArray[face.vertex[1]];
+	const GJKSimplex::Vertex& vertexC = this->vertexArray[face.vertex[2]];
+
+	// Find the barycentric coordinates of the origin projected onto the face.
+	Vector3 point = face.unitNormal * face.distance;
+	double areaA = (vertexB.point - point).Cross(vertexC.point - point).Dot(face.unitNormal);
+	double areaB = (vertexC.point - point).Cross(vertexA.point - point).Dot(face.unitNormal);
+	double areaC = (vertexA.point - point).Cross(vertexB.point - point).Dot(face.unitNormal);
+	double totalArea = areaA + areaB + areaC;
+
+	pointA = (vertexA.pointA * areaA + vertexB.pointA * areaB + vertexC.pointA * areaC) / totalArea;
+	pointB = (vertexA.pointB * areaA + vertexB.pointB * areaB + vertexC.pointB * areaC) / totalArea;
 }
-#endif //GJK_RENDER_DEBUG
\ No newline at end of file
@@ -10,7 +10,7 @@
 #include "Thebe/Math/Matrix3x3.h"
 #include "Thebe/Math/Graph.h"
 #include "Thebe/Math/LineSegment.h"
-#include "Thebe/Math/ExpandingPolytopeAlgorithm.h"
+#include <atomic>
 
 #define GJK_RENDER_DEBUG
 
@@ -21,7 +21,6 @@
 namespace Thebe
 {
 	class GJKSimplex;
-	class GJKTetrahedronSimplex;
 
 	/**
 	 * Such shapes lend themselves to the GJK algorithm, as well as
@@ -99,73 +98,47 @@ namespace Thebe
 		virtual bool ContainsWorldPoint(const Vector3& point, void* cache = nullptr) const;
 
 		/**
-		 * Tell the caller if the two given shapes interesect.
+		 * Tell the caller if the two given shapes interesect.  No heap allocations are made here.
 		 * 
-		 * @param[out] finalSimplex If given, the final simplex of the algorithm is placed here in the case of intersection.
+		 * @param[in,out] cachedSimplex If given and non-empty, this is used to warm-start the algorithm (e.g., with the simplex from the previous frame), and then the final simplex is placed here.
 		 * @return True is returned if and only if the two given shapes share at least one point in common.
 		 */
-		static bool Intersect(const GJKShape* shapeA, const GJKShape* shapeB, std::unique_ptr<GJKSimplex>* finalSimplex = nullptr);
+		static bool Intersect(const GJKShape* shapeA, const GJKShape* shapeB, GJKSimplex* cachedSimplex = nullptr);
 
 		/**
-		 * Use the extended polytop algorithm (EPA) to calculate the penetration depth and direction
-		 * of the two given shapes.  It's assumed here that it has already been determined that these
+		 * Use the expanding polytope algorithm (EPA) to calculate the penetration depth and direction
+		 * of the two given shapes.  See @ref GJKExpandingPolytope.  It's assumed here that it has already been determined that these
 		 * shapes intersect using the @ref GJKShape::Intersect function.
 		 * 
 		 * @param[in] simplex This just needs to be the simplex returned from @ref GJKShape::Intersect, called with the same shapes.
 		 * @param[out] separationDelta This is the vector that, if added to shapeA (or subtracted from shapeB) cause both shapes to share a set of points only on their boundary.
 		 * @return True is returned on success; false, otherwise.
 		 */
-		static bool Penetration(const GJKShape* shapeA, const GJKShape* shapeB, std::unique_ptr<GJKSimplex>& simplex, Vector3& separationDelta);
+		static bool Penetration(const GJKShape* shapeA, const GJKShape* shapeB, const GJKSimplex& simplex, Vector3& separationDelta);
+
+		/**
+		 * Calculate the distance between the two given shapes, along with a closest point on each.
+		 * No heap allocations are made here.
+		 * 
+		 * @param[out] closestA This gets set to a point of shapeA closest to shapeB.
+		 * @param[out] closestB This gets set to a point of shapeB closest to shapeA.
+		 * @param[out] distance This gets set to the distance between the two closest points, or zero if the shapes intersect.
+		 * @param[in,out] cachedSimplex If given and non-empty, this is used to warm-start the algorithm (e.g., with the simplex from the previous frame), and then the final simplex is placed here.
+		 * @return True is returned if and only if the shapes are disjoint.  If false is returned, the closest points are not meaningful.
+		 */
+		static bool Distance(const GJKShape* shapeA, const GJKShape* shapeB, Vector3& closestA, Vector3& closestB, double& distance, GJKSimplex* cachedSimplex = nullptr);
+
+		/**
+		 * Place this shape in world space.  Shapes made of other shapes override this to place their parts too.
+		 */
+		virtual void SetObjectToWorld(const Transform& objectToWorld);
 
-		void SetObjectToWorld(const Transform& objectToWorld);
 		const Transform& GetObjectToWorld() const;
 
 	protected:
 		Transform objectToWorld;		///< All shapes should represent themselves in object-space and then require this in order to be realized in world space.
 	};
 
-	/**
-	 * 
-	 */
-	class THEBE_API GJKTriangleForEPA : public ExpandingPolytopeAlgorithm::Triangle
-	{
-	public:
-		enum Status
-		{
-			UNCONSIDERED,
-			CONFIRMED_ON_HULL_BOUNDARY,
-			CAN_BE_IGNORED
-		};
-
-		GJKTriangleForEPA()
-		{
-			this->status = Status::UNCONSIDERED;
-		}
-
-		Status status;
-	};
-
-	/**
-	 * 
-	 */
-	class THEBE_API GJKPointSupplierForEPA : public ExpandingPolytopeAlgorithm::PointSupplier
-	{
-	public:
-		GJKPointSupplierForEPA(const GJKShape* shapeA, const GJKShape* shapeB, ExpandingPolytopeAlgorithm* epa);
-		virtual ~GJKPointSupplierForEPA();
-
-		virtual bool GetNextPoint(Vector3& point) override;
-
-		const Vector3& GetSeparationDelta() const;
-
-	private:
-		const GJKShape* shapeA;
-		const GJKShape* shapeB;
-		ExpandingPolytopeAlgorithm* epa;
-		Vector3 separationDelta;
-		double smallestDistance;
-	};
-
 	/**
 	 * 
 	 */
@@ -214,42 +187,161 @@ namespace Thebe
 		void GenerateObjectSpacePlaneArray(std::vector<Plane>& objectSpacePlaneArray) const;
 		Vector3 GetWorldVertex(int i) const;
 
+		/**
+		 * Build the vertex adjacency of the hull so that support points can be found by hill-climbing
+		 * from one vertex to a better neighbor, rather than by visiting every vertex.  This must be
+		 * called again if the topology of the hull changes.  (Just moving vertices is fine, as long as
+		 * the hull stays convex.)  Until this is called, support points are found by brute force.
+		 */
+		void GenerateAdjacency();
+
+		/**
+		 * Return the index of a hull vertex furthest in the given object-space direction, or -1 if the hull is empty.
+		 * The direction here need not be unit-length.
+		 */
+		int FindSupportVertex(const Vector3& objectDirection) const;
+
 		PolygonMesh hull;
+
+	private:
+		std::vector<int> adjacencyOffsetArray;		///< The neighbors of vertex i are found in the adjacency array at [offset[i], offset[i+1]).
+		std::vector<int> adjacencyArray;
+		mutable std::atomic<int> warmStartVertex;	///< The hill-climb starts from the last support vertex found, since successive queries tend to be in similar directions.
+	};
+
+	/**
+	 * This is a single triangle.  It's convex, but flat, so it has no volume.  It's mainly
+	 * used to run the GJK algorithm against one triangle of a @ref TriangleMeshShape at a time.
+	 */
+	class THEBE_API GJKTriangle : public GJKShape
+	{
+	public:
+		GJKTriangle();
+		virtual ~GJKTriangle();
+
+		virtual Vector3 FurthestPoint(const Vector3& unitDirection) const override;
+		virtual AxisAlignedBoundingBox GetObjectBoundingBox() const override;
+		virtual AxisAlignedBoundingBox GetWorldBoundingBox() const override;
+		virtual bool RayCast(const Ray& ray, double& alpha, Vector3& unitSurfaceNormal) const override;
+		virtual Vector3 CalcGeometricCenter() const override;
+		virtual void Shift(const Vector3& translation) override;
+
+		/**
+		 * Return the plane containing this triangle in world space.  Its normal faces the side from which the vertices wind CCW.
+		 */
+		Plane GetWorldPlane() const;
+
+		/**
+		 * Cast the given ray against the triangle with the given vertices, all in the same space.
+		 * The triangle can be hit from either side.  No normal is calculated here.
+		 */
+		static bool RayCastTriangle(const Ray& ray, const Vector3& vertexA, const Vector3& vertexB, const Vector3& vertexC, double& alpha);
+
+		Vector3 vertex[3];
+	};
+
+	/**
+	 * This stands in for another convex shape, placed somewhere other than where that shape is,
+	 * without touching that shape.  It lets a shape be tested somewhere else while other threads
+	 * read it, and lets any number of threads do so at once, each with a stand-in of its own.
+	 * The other shape is placed at the given transform within the object space of this one,
+	 * so that the parts of a @ref GJKCompoundShape can each stand in for themselves while the
+	 * stand-ins are all placed as a whole.  The other shape must not move while this refers to it.
+	 */
+	class THEBE_API GJKTransformedShape : public GJKShape
+	{
+	public:
+		GJKTransformedShape();
+		virtual ~GJKTransformedShape();
+
+		virtual Vector3 FurthestPoint(const Vector3& unitDirection) const override;
+		virtual AxisAlignedBoundingBox GetObjectBoundingBox() const override;
+		virtual AxisAlignedBoundingBox GetWorldBoundingBox() const override;
+		virtual bool RayCast(const Ray& ray, double& alpha, Vector3& unitSurfaceNormal) const override;
+		virtual Vector3 CalcGeometricCenter() const override;
+		virtual void Shift(const Vector3& translation) override;
+		virtual void SetObjectToWorld(const Transform& objectToWorld) override;
+
+		/**
+		 * Stand in for the given shape, placed within our object space by the given transform.
+		 */
+		void SetShape(const GJKShape* shape, const Transform& shapeToObject);
+		const GJKShape* GetShape() const;
+
+	private:
+		void UpdateRelativeTransform();
+
+		const GJKShape* shape;
+		Transform shapeToObject;
+		Transform relativeTransform;		///< This takes the other shape from where it actually is to where we place it.
 	};
 
 	/**
-	 *
+	 * This is the simplex used by the GJK algorithm.  It is a plain value type of
+	 * fixed size, so that it can live on the stack and be copied around (e.g., cached
+	 * from one frame to the next) without ever touching the heap.  Depending on the
+	 * number of vertices, it is a point, line-segment, triangle or tetrahedron in the
+	 * Minkowski difference of two shapes.  Each vertex remembers the points on each of
+	 * the two shapes that made it, so that we can recover witness points.
 	 */
 	class THEBE_API GJKSimplex
 	{
 	public:
 		GJKSimplex();
-		virtual ~GJKSimplex();
+
+		struct Vertex
+		{
+			Vector3 point;		///< This is a point on the boundary of the Minkowski difference, B - A.
+			Vector3 pointA;		///< This is the point of shape A that contributed to the point of the Minkowski difference.
+			Vector3 pointB;		///< This is the point of shape B that contributed to the point of the Minkowski difference.
+		};
 
 		/**
-		 * 
+		 * Make this the empty simplex.
 		 */
-		virtual bool ContainsOrigin(double epsilon) const = 0;
+		void Clear();
 
 		/**
-		 *
+		 * Append the given vertex to this simplex.  Nothing happens if this simplex is already a tetrahedron.
 		 */
-		virtual uint32_t GetDimension() const = 0;
+		void AddVertex(const Vertex& vertex);
 
 		/**
-		 *
+		 * Tell the caller if the given point is already a vertex of this simplex, within the given tolerance.
 		 */
-		virtual GJKSimplex* FindFacetNearestOrigin() const;
+		bool HasVertex(const Vector3& point, double epsilon) const;
 
 		/**
-		 * 
+		 * Find the point of this simplex closest to the origin and reduce this simplex to the smallest
+		 * sub-simplex (face, edge or vertex) containing that point.  The barycentric coordinates of the
+		 * closest point with respect to the remaining vertices are stored in @ref lambda.  If the origin
+		 * is inside this simplex (which must then be a tetrahedron), it is left alone and the origin is
+		 * returned.  This is the sub-algorithm of Johnson, done using the Voronoi regions of each feature.
 		 */
-		virtual Vector3 CalcFacetNorm() const;
+		Vector3 ReduceToClosestPoint();
 
 		/**
-		 * 
+		 * Calculate the points on each of the two shapes corresponding to the closest point
+		 * most recently calculated by @ref ReduceToClosestPoint.
+		 */
+		void CalcWitnessPoints(Vector3& pointA, Vector3& pointB) const;
+
+		/**
+		 * Calculate the point of this simplex described by the weights found by @ref ReduceToClosestPoint.
+		 */
+		Vector3 CalcClosestPoint() const;
+
+		/**
+		 * Replace each vertex of this simplex with the support point of the given shapes in the direction of that vertex.
+		 * The shapes have typically moved since this simplex was made, but the old directions are still a good place to start.
 		 */
-		virtual GJKSimplex* ExtendSimplexWithPoint(const Vector3& supportPoint) const;
+		void Resample(const GJKShape* shapeA, const GJKShape* shapeB);
+
+		/**
+		 * Grow this simplex into a tetrahedron of non-zero volume using support points of the given shapes.
+		 * The vertices this simplex already has are kept, if possible.  This is needed to seed the EPA.
+		 */
+		bool ExpandToTetrahedron(const GJKShape* shapeA, const GJKShape* shapeB);
 
 		/**
 		 * Provide this as a consistent way to calculate points in the Minkowski difference of the two given shapes.
@@ -257,98 +349,122 @@ namespace Thebe
 		 */
 		static Vector3 CalcSupportPoint(const GJKShape* shapeA, const GJKShape* shapeB, const Vector3& unitDirection);
 
+		/**
+		 * This is the same as @ref CalcSupportPoint, but we also hang on to the points of each shape.
+		 */
+		static Vertex CalcSupportVertex(const GJKShape* shapeA, const GJKShape* shapeB, const Vector3& unitDirection);
+
 #if defined GJK_RENDER_DEBUG
-		virtual void DebugDraw(DebugRenderClient* client, int simplexNumber) = 0;
+		void DebugDraw(DebugRenderClient* client, int simplexNumber) const;
 #endif //GJK_RENDER_DEBUG
-	};
 
-	/**
-	 * This is the 0-dimensional simplex.
-	 */
-	class THEBE_API GJKPointSimplex : public GJKSimplex
-	{
-	public:
-		GJKPointSimplex();
-		virtual ~GJKPointSimplex();
+		Vertex vertex[4];
+		double lambda[4];
+		int numVertices;
 
-		virtual bool ContainsOrigin(double epsilon) const override;
-		virtual uint32_t GetDimension() const override;
-		virtual Vector3 CalcFacetNorm() const override;
-		virtual GJKSimplex* ExtendSimplexWithPoint(const Vector3& supportPoint) const override;
+	private:
 
-#if defined GJK_RENDER_DEBUG
-		virtual void DebugDraw(DebugRenderClient* client, int simplexNumber) override;
-#endif //GJK_RENDER_DEBUG
+		/**
+		 * This is a vertex, edge or face of the simplex, along with the point on it closest to the origin.
+		 */
+		struct Feature
+		{
+			int size;
+			int index[3];
+			double lambda[3];
+			Vector3 point;
+		};
 
-		Vector3 point;
+		void ClosestFeatureOfSegment(int i, int j, Feature& feature) const;
+		void ClosestFeatureOfTriangle(int i, int j, int k, Feature& feature) const;
+		void ReduceToFeature(const Feature& feature);
 	};
 
 	/**
-	 * This is the 1-dimensional simplex.
+	 * This is the expanding polytope algorithm (EPA), used to find the penetration depth and direction
+	 * of two intersecting GJK shapes.  Starting from a tetrahedron in the Minkowski difference, B - A,
+	 * that contains the origin, the face closest to the origin is repeatedly pushed out to the support
+	 * point in the direction of its normal until no more progress can be made.
+	 * 
+	 * The polytope is a triangle mesh stored as half-edges.  Edge e of a face runs from its vertex e
+	 * to its vertex e+1 (mod 3), and the twin of that half-edge is edge adjacentEdge[e] of the face
+	 * adjacentFace[e].  When a new point is added, we walk across twins from the face being expanded
+	 * to find all faces visible from the point, and the boundary of that region (the horizon) is then
+	 * joined to the new point by a fan of new faces.  Faces wait to be expanded in a min-heap keyed by
+	 * distance to the origin.  Everything lives in fixed-capacity pools, so no heap allocations are made.
+	 * If a pool runs out, or if the polytope degenerates, the best answer found so far is kept.
 	 */
-	class THEBE_API GJKLineSimplex : public GJKSimplex
+	class THEBE_API GJKExpandingPolytope
 	{
 	public:
-		GJKLineSimplex();
-		virtual ~GJKLineSimplex();
-
-		virtual bool ContainsOrigin(double epsilon) const override;
-		virtual uint32_t GetDimension() const override;
-		virtual Vector3 CalcFacetNorm() const override;
-		virtual GJKSimplex* ExtendSimplexWithPoint(const Vector3& supportPoint) const override;
+		GJKExpandingPolytope();
 
-#if defined GJK_RENDER_DEBUG
-		virtual void DebugDraw(DebugRenderClient* client, int simplexNumber) override;
-#endif //GJK_RENDER_DEBUG
+		/**
+		 * Reset the polytope to the given tetrahedron, which must have non-zero volume and contain the origin.
+		 */
+		bool Initialize(const GJKSimplex& tetrahedron);
 
-		LineSegment lineSegment;
-	};
+		/**
+		 * Expand the polytope against the Minkowski difference of the given shapes until the face closest to the origin is found.
+		 */
+		bool Expand(const GJKShape* shapeA, const GJKShape* shapeB);
 
-	/**
-	 * This is the 2-dimensional simplex.
-	 */
-	class THEBE_API GJKTriangleSimplex : public GJKSimplex
-	{
-	public:
-		GJKTriangleSimplex();
-		virtual ~GJKTriangleSimplex();
+		/**
+		 * Return the unit normal of the face found closest to the origin by @ref Expand.  This points from shape B toward shape A;
+		 * it's the direction in which shape A must move to separate from shape B.
+		 */
+		const Vector3& GetUnitNormal() const;
 
-		virtual bool ContainsOrigin(double epsilon) const override;
-		virtual uint32_t GetDimension() const override;
-		virtual Vector3 CalcFacetNorm() const override;
-		virtual GJKSimplex* ExtendSimplexWithPoint(const Vector3& supportPoint) const override;
+		/**
+		 * Return the distance of the face found by @ref Expand from the origin.  This is the penetration depth.
+		 */
+		double GetDistance() const;
 
-#if defined GJK_RENDER_DEBUG
-		virtual void DebugDraw(DebugRenderClient* client, int simplexNumber) override;
-#endif //GJK_RENDER_DEBUG
+		/**
+		 * Calculate the points on each of the two shapes corresponding to the point of the closest face nearest the origin.
+		 */
+		void CalcWitnessPoints(Vector3& pointA, Vector3& pointB) const;
 
-		Vector3 vertex[3];
-	};
+	private:
 
-	/**
-	 * This is the 3-dimensional simplex.
-	 */
-	class THEBE_API GJKTetrahedronSimplex : public GJKSimplex
-	{
-	public:
-		GJKTetrahedronSimplex();
-		virtual ~GJKTetrahedronSimplex();
+		static constexpr int maxVertices = 256;
+		static constexpr int maxFaces = 512;
 
-		virtual bool ContainsOrigin(double epsilon) const override;
-		virtual uint32_t GetDimension() const override;
-		virtual GJKSimplex* FindFacetNearestOrigin() const override;
+		struct Face
+		{
+			int vertex[3];
+			int adjacentFace[3];
+			int adjacentEdge[3];
+			Vector3 unitNormal;
+			double distance;
+			bool obsolete;
+		};
 
-#if defined GJK_RENDER_DEBUG
-		virtual void DebugDraw(DebugRenderClient* client, int simplexNumber) override;
-#endif //GJK_RENDER_DEBUG
+		struct HeapEntry
+		{
+			double distance;
+			int faceIndex;
+		};
 
-		struct FacetData
+		struct HalfEdge
 		{
-			Plane plane;
-			int vertex[3];
+			int faceIndex;
+			int edgeIndex;
 		};
 
-		Vector3 vertex[4];
-		mutable FacetData facetDataArray[4];
+		int AddFace(int i, int j, int k);
+		void LinkEdges(int faceIndexA, int edgeIndexA, int faceIndexB, int edgeIndexB);
+		bool FindHorizon(int faceIndex, int edgeIndex, const Vector3& point);
+		bool PopClosestFace(int& faceIndex);
+
+		GJKSimplex::Vertex vertexArray[maxVertices];
+		Face faceArray[maxFaces];
+		HeapEntry heapArray[maxFaces];
+		HalfEdge horizonArray[maxFaces];
+		int numVertices;
+		int numFaces;
+		int heapSize;
+		int horizonSize;
+		int closestFaceIndex;
 	};
 }
\ No newline at end of file
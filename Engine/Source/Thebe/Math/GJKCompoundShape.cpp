@@ -0,0 +1,385 @@
+#include "Thebe/Math/GJKCompoundShape.h"
+#include "Thebe/Math/TriangleMeshShape.h"
+#include "Thebe/Log.h"
+#include <algorithm>
+#include <numeric>
+
+using namespace Thebe;
+
+//------------------------------------- GJKCompoundShape -------------------------------------
+
+GJKCompoundShape::GJKCompoundShape()
+{
+}
+
+/*virtual*/ GJKCompoundShape::~GJKCompoundShape()
+{
+	this->Clear();
+}
+
+bool GJKCompoundShape::AddChild(GJKShape* shape, const Transform& childToObject)
+{
+	if (!shape)
+		return false;
+
+	if (dynamic_cast<GJKCompoundShape*>(shape) || dynamic_cast<TriangleMeshShape*>(shape))
+	{
+		THEBE_LOG("Children of a compound shape must be convex.");
+		delete shape;
+		return false;
+	}
+
+	Child child;
+	child.shape = shape;
+	child.childToObject = childToObject;
+	if (!child.objectToChild.Invert(childToObject))
+	{
+		THEBE_LOG("Child-to-object transform of compound shape child is not invertible.");
+		delete shape;
+		return false;
+	}
+
+	// These are what the contact calculators want to know about hulls, so work them out just once, here.
+	auto convexHull = dynamic_cast<const GJKConvexHull*>(shape);
+	if (convexHull)
+	{
+		convexHull->GenerateEdgeSet(child.edgeSet);
+		convexHull->GenerateObjectSpacePlaneArray(child.childSpacePlaneArray);
+	}
+
+	this->UpdateChildToWorld(child);
+	this->childArray.push_back(child);
+	this->RebuildTree();
+	return true;
+}
+
+void GJKCompoundShape::Clear()
+{
+	for (Child& child : this->childArray)
+		delete child.shape;
+
+	this->childArray.clear();
+	this->nodeArray.clear();
+}
+
+int GJKCompoundShape::GetNumChildren() const
+{
+	return (int)this->childArray.size();
+}
+
+const GJKCompoundShape::Child& GJKCompoundShape::GetChild(int i) const
+{
+	THEBE_ASSERT(0 <= i && i < (int)this->childArray.size());
+	return this->childArray[i];
+}
+
+void GJKCompoundShape::UpdateChildToWorld(Child& child)
+{
+	child.shape->SetObjectToWorld(this->objectToWorld * child.childToObject);
+}
+
+void GJKCompoundShape::RebuildTree()
+{
+	this->nodeArray.clear();
+
+	int numChildren = (int)this->childArray.size();
+	if (numChildren == 0)
+		return;
+
+	std::vector<AxisAlignedBoundingBox> boxArray;
+	boxArray.reserve(numChildren);
+	for (const Child& child : this->childArray)
+	{
+		AxisAlignedBoundingBox childBox = child.shape->GetObjectBoundingBox();
+		AxisAlignedBoundingBox objectBox;
+		objectBox.MakeReadyForExpansion();
+		for (int i = 0; i < 8; i++)
+		{
+			Vector3 corner(
+				(i & 1) ? childBox.maxCorner.x : childBox.minCorner.x,
+				(i & 2) ? childBox.maxCorner.y : childBox.minCorner.y,
+				(i & 4) ? childBox.maxCorner.z : childBox.minCorner.z);
+			objectBox.Expand(child.childToObject.TransformPoint(corner));
+		}
+
+		boxArray.push_back(objectBox);
+	}
+
+	std::vector<int> orderArray(numChildren);
+	std::iota(orderArray.begin(), orderArray.end(), 0);
+
+	this->nodeArray.reserve(2 * numChildren);
+	this->BuildNode(0, numChildren, orderArray, boxArray);
+}
+
+void GJKCompoundShape::BuildNode(int first, int count, std::vector<int>& orderArray, const std::vector<AxisAlignedBoundingBox>& boxArray)
+{
+	int nodeIndex = (int)this->nodeArray.size();
+	this->nodeArray.push_back(Node{});
+
+	AxisAlignedBoundingBox box, centerBox;
+	box.MakeReadyForExpansion();
+	centerBox.MakeReadyForExpansion();
+	for (int i = first; i < first + count; i++)
+	{
+		box.Expand(boxArray[orderArray[i]]);
+		centerBox.Expand(boxArray[orderArray[i]].GetCenter());
+	}
+
+	Node& node = this->nodeArray[nodeIndex];
+	node.minCorner[0] = box.minCorner.x;
+	node.minCorner[1] = box.minCorner.y;
+	node.minCorner[2] = box.minCorner.z;
+	node.maxCorner[0] = box.maxCorner.x;
+	node.maxCorner[1] = box.maxCorner.y;
+	node.maxCorner[2] = box.maxCorner.z;
+	node.secondChildIndex = -1;
+	node.shapeIndex = (count == 1) ? orderArray[first] : -1;
+
+	if (count == 1)
+		return;
+
+	double xSize = 0.0, ySize = 0.0, zSize = 0.0;
+	centerBox.GetDimensions(xSize, ySize, zSize);
+	int axis = (xSize >= ySize && xSize >= zSize) ? 0 : ((ySize >= zSize) ? 1 : 2);
+	auto component = [axis](const Vector3& vector) -> double
+		{
+			return (axis == 0) ? vector.x : ((axis == 1) ? vector.y : vector.z);
+		};
+
+	int firstCount = count / 2;
+	std::nth_element(
+		orderArray.begin() + first,
+		orderArray.begin() + first + firstCount,
+		orderArray.begin() + first + count,
+		[&boxArray, &component](int i, int j) { return component(boxArray[i].GetCenter()) < component(boxArray[j].GetCenter()); });
+
+	// Note that the node array may grow here, so we can't hang on to a reference into it.
+	this->BuildNode(first, firstCount, orderArray, boxArray);
+	this->nodeArray[nodeIndex].secondChildIndex = (int)this->nodeArray.size();
+	this->BuildNode(first + firstCount, count - firstCount, orderArray, boxArray);
+}
+
+/*static*/ bool GJKCompoundShape::Overlaps(const Node& node, const AxisAlignedBoundingBox& box)
+{
+	if (node.maxCorner[0] < box.minCorner.x || box.maxCorner.x < node.minCorner[0])
+		return false;
+
+	if (node.maxCorner[1] < box.minCorner.y || box.maxCorner.y < node.minCorner[1])
+		return false;
+
+	if (node.maxCorner[2] < box.minCorner.z || box.maxCorner.z < node.minCorner[2])
+		return false;
+
+	return true;
+}
+
+void GJKCompoundShape::FindChildren(const AxisAlignedBoundingBox& worldBox, std::vector<int>& childArray) const
+{
+	childArray.clear();
+
+	if (this->nodeArray.size() == 0)
+		return;
+
+	// Rather than take the tree into world space, take the box into object space.
+	Transform worldToObject;
+	worldToObject.Invert(this->objectToWorld);
+	AxisAlignedBoundingBox objectBox;
+	objectBox.MakeReadyForExpansion();
+	for (int i = 0; i < 8; i++)
+	{
+		Vector3 corner(
+			(i & 1) ? worldBox.maxCorner.x : worldBox.minCorner.x,
+			(i & 2) ? worldBox.maxCorner.y : worldBox.minCorner.y,
+			(i & 4) ? worldBox.maxCorner.z : worldBox.minCorner.z);
+		objectBox.Expand(worldToObject.TransformPoint(corner));
+	}
+
+	int nodeStack[maxStackDepth];
+	int stackSize = 0;
+	nodeStack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		int nodeIndex = nodeStack[--stackSize];
+		const Node& node = this->nodeArray[nodeIndex];
+		if (!Overlaps(node, objectBox))
+			continue;
+
+		if (node.secondChildIndex >= 0)
+		{
+			THEBE_ASSERT(stackSize + 2 <= maxStackDepth);
+			nodeStack[stackSize++] = node.secondChildIndex;
+			nodeStack[stackSize++] = nodeIndex + 1;
+			continue;
+		}
+
+		// The child's own world box is usually tighter than its node's box taken into world space.
+		AxisAlignedBoundingBox childWorldBox = this->childArray[node.shapeIndex].shape->GetWorldBoundingBox();
+		AxisAlignedBoundingBox intersection;
+		if (intersection.Intersect(childWorldBox, worldBox))
+			childArray.push_back(node.shapeIndex);
+	}
+}
+
+/*virtual*/ void GJKCompoundShape::SetObjectToWorld(const Transform& objectToWorld)
+{
+	GJKShape::SetObjectToWorld(objectToWorld);
+
+	for (Child& child : this->childArray)
+		this->UpdateChildToWorld(child);
+}
+
+/*virtual*/ Vector3 GJKCompoundShape::FurthestPoint(const Vector3& unitDirection) const
+{
+	if (this->childArray.size() == 0)
+		return this->objectToWorld.translation;
+
+	Vector3 furthestPoint = this->childArray[0].shape->FurthestPoint(unitDirection);
+	double largestDistance = furthestPoint.Dot(unitDirection);
+	for (int i = 1; i < (int)this->childArray.size(); i++)
+	{
+		Vector3 point = this->childArray[i].shape->FurthestPoint(unitDirection);
+		double distance = point.Dot(unitDirection);
+		if (distance > largestDistance)
+		{
+			largestDistance = distance;
+			furthestPoint = point;
+		}
+	}
+
+	return furthestPoint;
+}
+
+/*virtual*/ AxisAlignedBoundingBox GJKCompoundShape::GetObjectBoundingBox() const
+{
+	AxisAlignedBoundingBox objectBoundingBox;
+	objectBoundingBox.MakeReadyForExpansion();
+
+	if (this->nodeArray.size() > 0)
+	{
+		const Node& rootNode = this->nodeArray[0];
+		objectBoundingBox.minCorner.SetComponents(rootNode.minCorner[0], rootNode.minCorner[1], rootNode.minCorner[2]);
+		objectBoundingBox.maxCorner.SetComponents(rootNode.maxCorner[0], rootNode.maxCorner[1], rootNode.maxCorner[2]);
+	}
+
+	return objectBoundingBox;
+}
+
+/*virtual*/ AxisAlignedBoundingBox GJKCompoundShape::GetWorldBoundingBox() const
+{
+	AxisAlignedBoundingBox worldBoundingBox;
+	worldBoundingBox.MakeReadyForExpansion();
+
+	for (const Child& child : this->childArray)
+		worldBoundingBox.Expand(child.shape->GetWorldBoundingBox());
+
+	return worldBoundingBox;
+}
+
+/*virtual*/ bool GJKCompoundShape::RayCast(const Ray& ray, double& alpha, Vector3& unitSurfaceNormal) const
+{
+	if (this->nodeArray.size() == 0)
+		return false;
+
+	Transform worldToObject;
+	worldToObject.Invert(this->objectToWorld);
+	Ray objectRay = worldToObject.TransformRay(ray);
+
+	int nodeStack[maxStackDepth];
+	int stackSize = 0;
+	nodeStack[stackSize++] = 0;
+
+	bool hitFound = false;
+
+	while (stackSize > 0)
+	{
+		int nodeIndex = nodeStack[--stackSize];
+		const Node& node = this->nodeArray[nodeIndex];
+
+		AxisAlignedBoundingBox nodeBox;
+		nodeBox.minCorner.SetComponents(node.minCorner[0], node.minCorner[1], node.minCorner[2]);
+		nodeBox.maxCorner.SetComponents(node.maxCorner[0], node.maxCorner[1], node.maxCorner[2]);
+
+		Interval interval;
+		if (!objectRay.CastAgainst(nodeBox, interval))
+			continue;
+
+		if (node.secondChildIndex >= 0)
+		{
+			THEBE_ASSERT(stackSize + 2 <= maxStackDepth);
+			nodeStack[stackSize++] = node.secondChildIndex;
+			nodeStack[stackSize++] = nodeIndex + 1;
+			continue;
+		}
+
+		// The children are cast against in world space, so their hits are directly comparable.
+		double childAlpha = 0.0;
+		Vector3 childSurfaceNormal;
+		if (this->childArray[node.shapeIndex].shape->RayCast(ray, childAlpha, childSurfaceNormal) && (!hitFound || childAlpha < alpha))
+		{
+			alpha = childAlpha;
+			unitSurfaceNormal = childSurfaceNormal;
+			hitFound = true;
+		}
+	}
+
+	return hitFound;
+}
+
+/*virtual*/ Vector3 GJKCompoundShape::CalcGeometricCenter() const
+{
+	Vector3 center(0.0, 0.0, 0.0);
+	if (this->childArray.size() == 0)
+		return center;
+
+	for (const Child& child : this->childArray)
+		center += child.childToObject.TransformPoint(child.shape->CalcGeometricCenter());
+
+	center /= double(this->childArray.size());
+	return center;
+}
+
+/*virtual*/ void GJKCompoundShape::Shift(const Vector3& translation)
+{
+	// The children keep their own object spaces; they're just placed differently in ours.
+	for (Child& child : this->childArray)
+	{
+		child.childToObject.translation += translation;
+		child.objectToChild.Invert(child.childToObject);
+		this->UpdateChildToWorld(child);
+	}
+
+	for (Node& node : this->nodeArray)
+	{
+		node.minCorner[0] += translation.x;
+		node.minCorner[1] += translation.y;
+		node.minCorner[2] += translation.z;
+		node.maxCorner[0] += translation.x;
+		node.maxCorner[1] += translation.y;
+		node.maxCorner[2] += translation.z;
+	}
+}
+
+/*virtual*/ bool GJKCompoundShape::ContainsObjectPoint(const Vector3& point, void* cache /*= nullptr*/) const
+{
+	THEBE_ASSERT(cache != nullptr);
+	if (!cache)
+		return false;
+
+	auto pointContainmentCache = static_cast<PointContainmentCache*>(cache);
+	if (pointContainmentCache->childCacheArray.size() != this->childArray.size())
+	{
+		pointContainmentCache->childCacheArray.clear();
+		pointContainmentCache->childCacheArray.resize(this->childArray.size());
+	}
+
+	for (int i = 0; i < (int)this->childArray.size(); i++)
+	{
+		const Child& child = this->childArray[i];
+		if (child.shape->ContainsObjectPoint(child.objectToChild.TransformPoint(point), &pointContainmentCache->childCacheArray[i]))
+			return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Thebe/Math/GJKAlgorithm.h"
+
+namespace Thebe
+{
+	/**
+	 * This is a shape made of any number of convex child shapes, each placed in the object space
+	 * of the compound by a transform of its own.  It lets a body made of several hulls be a single
+	 * collision object and a single rigid body, rather than several glued together by the game.
+	 * The compound appears just once in the broad phase, and the children are organized by a small
+	 * bounding volume hierarchy of their own, so that the narrow phase only ever looks at the children
+	 * whose boxes overlap whatever the compound is up against.
+	 *
+	 * Like @ref TriangleMeshShape, this shape need not be convex, so its support function is that
+	 * of the convex hull of all its children, which is only good for bounding.  The collision system
+	 * knows to collide compounds one child at a time.  Children may not themselves be compounds or meshes.
+	 */
+	class THEBE_API GJKCompoundShape : public GJKShape
+	{
+	public:
+		GJKCompoundShape();
+		virtual ~GJKCompoundShape();
+
+		virtual Vector3 FurthestPoint(const Vector3& unitDirection) const override;
+		virtual AxisAlignedBoundingBox GetObjectBoundingBox() const override;
+		virtual AxisAlignedBoundingBox GetWorldBoundingBox() const override;
+		virtual bool RayCast(const Ray& ray, double& alpha, Vector3& unitSurfaceNormal) const override;
+		virtual Vector3 CalcGeometricCenter() const override;
+		virtual void Shift(const Vector3& translation) override;
+		virtual bool ContainsObjectPoint(const Vector3& point, void* cache = nullptr) const override;
+		virtual void SetObjectToWorld(const Transform& objectToWorld) override;
+
+		/**
+		 * This is the cache to give to @ref ContainsObjectPoint.  It just holds one cache per child.
+		 */
+		struct PointContainmentCache
+		{
+			std::vector<GJKConvexHull::PointContainmentCache> childCacheArray;
+		};
+
+		struct Child
+		{
+			GJKShape* shape;												///< This is owned by the compound.
+			Transform childToObject;
+			Transform objectToChild;
+			std::vector<Plane> childSpacePlaneArray;						///< For hulls, these are the face planes in child space, one per polygon of the hull, in order.
+			std::set<Graph::UnorderedEdge, Graph::UnorderedEdge> edgeSet;	///< For hulls, these are the edges of the hull.
+		};
+
+		/**
+		 * Add the given shape as a child of this compound, placed in the object space of the compound
+		 * by the given transform.  The compound takes ownership of the shape, even if false is returned.
+		 * The tree of children is rebuilt here, so it's best to add all the children at load time.
+		 */
+		bool AddChild(GJKShape* shape, const Transform& childToObject);
+
+		/**
+		 * Delete all the children of this compound.
+		 */
+		void Clear();
+
+		int GetNumChildren() const;
+		const Child& GetChild(int i) const;
+
+		/**
+		 * Find all children whose world bounding boxes overlap the given world-space box.  This doesn't
+		 * change anything, so it may be called from any number of threads at once.
+		 *
+		 * @param[out] childArray This is cleared and then populated with the indices of the children found.
+		 */
+		void FindChildren(const AxisAlignedBoundingBox& worldBox, std::vector<int>& childArray) const;
+
+	private:
+
+		/**
+		 * The nodes are stored depth-first, so the first child of a node immediately follows it in the
+		 * array, and only the second child's index is stored.  Each leaf holds exactly one child shape.
+		 */
+		struct Node
+		{
+			double minCorner[3];
+			double maxCorner[3];
+			int secondChildIndex;		///< This is -1 for leaves.
+			int shapeIndex;				///< For leaves, this is the index of the child shape in the child array; -1, otherwise.
+		};
+
+		static constexpr int maxStackDepth = 64;
+
+		void RebuildTree();
+		void BuildNode(int first, int count, std::vector<int>& orderArray, const std::vector<AxisAlignedBoundingBox>& boxArray);
+		void UpdateChildToWorld(Child& child);
+		static bool Overlaps(const Node& node, const AxisAlignedBoundingBox& box);
+
+		std::vector<Child> childArray;
+		std::vector<Node> nodeArray;
+	};
+}
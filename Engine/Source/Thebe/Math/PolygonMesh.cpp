@@ -1,7 +1,7 @@
 #include "Thebe/Math/PolygonMesh.h"
 #include "Thebe/Math/Polygon.h"
 #include "Thebe/Math/Graph.h"
-#include "Thebe/Math/ExpandingPolytopeAlgorithm.h"
+#include "Thebe/Math/QuickHull.h"
 #include "Thebe/Utilities/JsonHelper.h"
 
 using namespace Thebe;
@@ -79,102 +79,15 @@ void PolygonMesh::Clear()
 	this->polygonArray.clear();
 }
 
-bool PolygonMesh::GenerateConvexHull(const std::vector<Vector3>& pointArray)
+bool PolygonMesh::GenerateConvexHull(const std::vector<Vector3>& pointArray, bool mergeCoplanarFaces /*= true*/, double epsilon /*= 1e-6*/)
 {
 	this->Clear();
 
-	ExpandingPolytopeAlgorithm epa;
-	ExpandingPolytopeAlgorithm::TypedTriangleFactory<ExpandingPolytopeAlgorithm::Triangle> triangleFactory(1024);
-
-	auto findInitialTetrahedron = [&pointArray, &epa, &triangleFactory, this]() -> bool
-	{
-		// Is there a better approach to this problem?  This looks really
-		// slow, but we only loop until we find a non-negative determinant.
-		for (int i = 0; i < (signed)pointArray.size(); i++)
-		{
-			const Vector3& vertexA = pointArray[i];
-
-			for (int j = 0; j < (signed)pointArray.size(); j++)
-			{
-				if (j == i)
-					continue;
-
-				const Vector3& vertexB = pointArray[j];
-
-				for (int k = 0; k < (signed)pointArray.size(); k++)
-				{
-					if (k == i || k == j)
-						continue;
-
-					const Vector3& vertexC = pointArray[k];
-
-					for (int l = 0; l < (signed)pointArray.size(); l++)
-					{
-						if (l == i || l == j || l == k)
-							continue;
-
-						const Vector3& vertexD = pointArray[l];
-
-						Vector3 xAxis = vertexB - vertexA;
-						Vector3 yAxis = vertexC - vertexA;
-						Vector3 zAxis = vertexD - vertexA;
-
-						double det = xAxis.Cross(yAxis).Dot(zAxis);
-
-						if (det != 0.0)
-						{
-							epa.vertexArray.push_back(vertexA);
-							epa.vertexArray.push_back(vertexB);
-							epa.vertexArray.push_back(vertexC);
-							epa.vertexArray.push_back(vertexD);
-						}
-
-						if (det < 0.0)
-						{
-							epa.triangleList.push_back(triangleFactory.AllocTriangle(0, 1, 2));
-							epa.triangleList.push_back(triangleFactory.AllocTriangle(0, 2, 3));
-							epa.triangleList.push_back(triangleFactory.AllocTriangle(0, 3, 1));
-							epa.triangleList.push_back(triangleFactory.AllocTriangle(1, 3, 2));
-
-							return true;
-						}
-						else if (det > 0.0)
-						{
-							epa.triangleList.push_back(triangleFactory.AllocTriangle(0, 2, 1));
-							epa.triangleList.push_back(triangleFactory.AllocTriangle(0, 3, 2));
-							epa.triangleList.push_back(triangleFactory.AllocTriangle(0, 1, 3));
-							epa.triangleList.push_back(triangleFactory.AllocTriangle(1, 2, 3));
-
-							return true;
-						}
-					}
-				}
-			}
-		}
-
-		return false;
-	};
-
-	if (!findInitialTetrahedron())
+	QuickHull quickHull;
+	if (!quickHull.Generate(pointArray))
 		return false;
 
-	ExpandingPolytopeAlgorithm::PointListSupplier pointSupplier;
-	for (const Vector3& point : pointArray)
-		pointSupplier.pointList.push_back(point);
-
-	epa.Expand(&pointSupplier, &triangleFactory);
-
-	this->vertexArray = epa.vertexArray;
-
-	for (const ExpandingPolytopeAlgorithm::Triangle* triangle : epa.triangleList)
-	{
-		Polygon polygon;
-		for (int i = 0; i < 3; i++)
-			polygon.vertexArray.push_back(triangle->vertex[i]);
-
-		this->polygonArray.push_back(polygon);
-	}
-
+	quickHull.ToPolygonMesh(*this, mergeCoplanarFaces, epsilon);
 	return true;
 }
 
@@ -59,8 +59,12 @@ namespace Thebe
 
 		/**
 		 * Generate a mesh that fits the given point-cloud as tightly as possible.
+		 * Only those points on the hull become vertices of the mesh.
+		 * 
+		 * @param[in] mergeCoplanarFaces If true, faces in the same plane are merged into a single polygon; otherwise, all polygons are triangles.
+		 * @param[in] epsilon This is how far a point can be from the plane of a face and still be merged into it, as a fraction of the largest absolute coordinate of the given points, so that it suits hulls of any size.
 		 */
-		bool GenerateConvexHull(const std::vector<Vector3>& pointArray);
+		bool GenerateConvexHull(const std::vector<Vector3>& pointArray, bool mergeCoplanarFaces = true, double epsilon = 1e-6);
 
 		/**
 		 * Uniformly delete edges from the mesh in order to reduce the overal detail and
@@ -0,0 +1,526 @@
+#include "Thebe/Math/QuickHull.h"
+#include <unordered_map>
+#include <cfloat>
+
+using namespace Thebe;
+
+//--------------------------- QuickHull ---------------------------
+
+QuickHull::QuickHull()
+{
+	this->tolerance = THEBE_SMALL_EPS;
+	this->maxAbsCoordinate = 0.0;
+	this->visitNumber = 0;
+}
+
+/*virtual*/ QuickHull::~QuickHull()
+{
+}
+
+void QuickHull::Clear()
+{
+	this->pointArray.clear();
+	this->faceArray.clear();
+	this->freeFaceArray.clear();
+	this->pendingFaceArray.clear();
+	this->visitNumber = 0;
+}
+
+bool QuickHull::Generate(const std::vector<Vector3>& pointArray)
+{
+	this->Clear();
+
+	if (pointArray.size() < 4)
+		return false;
+
+	this->pointArray = pointArray;
+
+	// Our tolerance for deciding which side of a face a point is on must scale with the coordinates involved.
+	double maxX = 0.0, maxY = 0.0, maxZ = 0.0;
+	for (const Vector3& point : this->pointArray)
+	{
+		maxX = THEBE_MAX(maxX, ::fabs(point.x));
+		maxY = THEBE_MAX(maxY, ::fabs(point.y));
+		maxZ = THEBE_MAX(maxZ, ::fabs(point.z));
+	}
+
+	this->tolerance = THEBE_MAX(3.0 * DBL_EPSILON * (maxX + maxY + maxZ), THEBE_SMALL_EPS);
+	this->maxAbsCoordinate = THEBE_MAX(THEBE_MAX(maxX, maxY), maxZ);
+
+	int pointIndex[4];
+	if (!this->FindInitialTetrahedron(pointIndex))
+		return false;
+
+	static const int faceVertexArray[4][3] = { {0, 2, 1}, {0, 1, 3}, {1, 2, 3}, {0, 3, 2} };
+	for (int i = 0; i < 4; i++)
+		this->AddFace(pointIndex[faceVertexArray[i][0]], pointIndex[faceVertexArray[i][1]], pointIndex[faceVertexArray[i][2]]);
+
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = i + 1; j < 4; j++)
+		{
+			for (int a = 0; a < 3; a++)
+			{
+				for (int b = 0; b < 3; b++)
+				{
+					const Face& faceA = this->faceArray[i];
+					const Face& faceB = this->faceArray[j];
+					if (faceA.vertex[a] == faceB.vertex[(b + 1) % 3] && faceA.vertex[(a + 1) % 3] == faceB.vertex[b])
+						this->LinkEdges(i, a, j, b);
+				}
+			}
+		}
+	}
+
+	// Each point outside the tetrahedron goes into the conflict list of the face it is furthest above.
+	for (int i = 0; i < (int)this->pointArray.size(); i++)
+	{
+		if (i == pointIndex[0] || i == pointIndex[1] || i == pointIndex[2] || i == pointIndex[3])
+			continue;
+
+		int bestFaceIndex = -1;
+		double largestDistance = this->tolerance;
+		for (int j = 0; j < 4; j++)
+		{
+			double distance = this->SignedDistance(this->faceArray[j], i);
+			if (distance > largestDistance)
+			{
+				largestDistance = distance;
+				bestFaceIndex = j;
+			}
+		}
+
+		if (bestFaceIndex >= 0)
+			this->faceArray[bestFaceIndex].conflictArray.push_back(i);
+	}
+
+	for (int i = 0; i < 4; i++)
+		if (this->faceArray[i].conflictArray.size() > 0)
+			this->pendingFaceArray.push_back(i);
+
+	while (this->pendingFaceArray.size() > 0)
+	{
+		int faceIndex = this->pendingFaceArray.back();
+		this->pendingFaceArray.pop_back();
+
+		const Face& face = this->faceArray[faceIndex];
+		if (face.deleted || face.conflictArray.size() == 0)
+			continue;
+
+		this->AddPointToHull(faceIndex);
+	}
+
+	return true;
+}
+
+bool QuickHull::FindInitialTetrahedron(int* pointIndex)
+{
+	// Start with the two extreme points (along the coordinate axes) that are furthest apart.
+	int extremeArray[6] = { 0, 0, 0, 0, 0, 0 };
+	for (int i = 1; i < (int)this->pointArray.size(); i++)
+	{
+		const Vector3& point = this->pointArray[i];
+
+		if (point.x < this->pointArray[extremeArray[0]].x)
+			extremeArray[0] = i;
+		if (point.x > this->pointArray[extremeArray[1]].x)
+			extremeArray[1] = i;
+		if (point.y < this->pointArray[extremeArray[2]].y)
+			extremeArray[2] = i;
+		if (point.y > this->pointArray[extremeArray[3]].y)
+			extremeArray[3] = i;
+		if (point.z < this->pointArray[extremeArray[4]].z)
+			extremeArray[4] = i;
+		if (point.z > this->pointArray[extremeArray[5]].z)
+			extremeArray[5] = i;
+	}
+
+	double largestSquareDistance = 0.0;
+	for (int i = 0; i < 6; i++)
+	{
+		for (int j = i + 1; j < 6; j++)
+		{
+			double squareDistance = (this->pointArray[extremeArray[i]] - this->pointArray[extremeArray[j]]).SquareLength();
+			if (squareDistance > largestSquareDistance)
+			{
+				largestSquareDistance = squareDistance;
+				pointIndex[0] = extremeArray[i];
+				pointIndex[1] = extremeArray[j];
+			}
+		}
+	}
+
+	if (largestSquareDistance <= this->tolerance * this->tolerance)
+		return false;
+
+	// Next, take the point furthest from the line through those two points.
+	const Vector3& point0 = this->pointArray[pointIndex[0]];
+	Vector3 unitLineDirection = (this->pointArray[pointIndex[1]] - point0).Normalized();
+	largestSquareDistance = 0.0;
+	for (int i = 0; i < (int)this->pointArray.size(); i++)
+	{
+		double squareDistance = (this->pointArray[i] - point0).Cross(unitLineDirection).SquareLength();
+		if (squareDistance > largestSquareDistance)
+		{
+			largestSquareDistance = squareDistance;
+			pointIndex[2] = i;
+		}
+	}
+
+	if (largestSquareDistance <= this->tolerance * this->tolerance)
+		return false;
+
+	// Lastly, take the point furthest from the plane through those three points.
+	Vector3 unitNormal = (this->pointArray[pointIndex[1]] - point0).Cross(this->pointArray[pointIndex[2]] - point0).Normalized();
+	double largestDistance = 0.0;
+	double signedDistance = 0.0;
+	for (int i = 0; i < (int)this->pointArray.size(); i++)
+	{
+		double distance = (this->pointArray[i] - point0).Dot(unitNormal);
+		if (::fabs(distance) > largestDistance)
+		{
+			largestDistance = ::fabs(distance);
+			signedDistance = distance;
+			pointIndex[3] = i;
+		}
+	}
+
+	if (largestDistance <= this->tolerance)
+		return false;
+
+	// Make sure the tetrahedron is positively oriented so that its faces all wind outward.
+	if (signedDistance < 0.0)
+		std::swap(pointIndex[1], pointIndex[2]);
+
+	return true;
+}
+
+void QuickHull::AddPointToHull(int faceIndex)
+{
+	// Add the conflict point furthest from the face.  This is certainly on the hull.
+	int eyePointIndex = -1;
+	double largestDistance = -std::numeric_limits<double>::max();
+	for (int i : this->faceArray[faceIndex].conflictArray)
+	{
+		double distance = this->SignedDistance(this->faceArray[faceIndex], i);
+		if (distance > largestDistance)
+		{
+			largestDistance = distance;
+			eyePointIndex = i;
+		}
+	}
+
+	// Find all faces visible from the eye point, and the boundary of that region.
+	this->visitNumber++;
+	this->visibleFaceArray.clear();
+	this->horizonArray.clear();
+	this->faceArray[faceIndex].visitNumber = this->visitNumber;
+	this->faceArray[faceIndex].visible = true;
+	this->faceStackArray.clear();
+	this->faceStackArray.push_back(faceIndex);
+	while (this->faceStackArray.size() > 0)
+	{
+		int visibleFaceIndex = this->faceStackArray.back();
+		this->faceStackArray.pop_back();
+		this->visibleFaceArray.push_back(visibleFaceIndex);
+
+		for (int e = 0; e < 3; e++)
+		{
+			const Face& visibleFace = this->faceArray[visibleFaceIndex];
+			int adjacentFaceIndex = visibleFace.adjacentFace[e];
+			Face& adjacentFace = this->faceArray[adjacentFaceIndex];
+
+			if (adjacentFace.visitNumber != this->visitNumber)
+			{
+				adjacentFace.visitNumber = this->visitNumber;
+				adjacentFace.visible = this->SignedDistance(adjacentFace, eyePointIndex) > this->tolerance;
+				if (adjacentFace.visible)
+				{
+					this->faceStackArray.push_back(adjacentFaceIndex);
+					continue;
+				}
+			}
+
+			if (!adjacentFace.visible)
+				this->horizonArray.push_back(HalfEdge{ adjacentFaceIndex, visibleFace.adjacentEdge[e] });
+		}
+	}
+
+	// The visible faces go away, but the points in their conflict lists will need new homes.
+	this->orphanPointArray.clear();
+	for (int visibleFaceIndex : this->visibleFaceArray)
+	{
+		for (int i : this->faceArray[visibleFaceIndex].conflictArray)
+			if (i != eyePointIndex)
+				this->orphanPointArray.push_back(i);
+
+		this->DeleteFace(visibleFaceIndex);
+	}
+
+	// Fill the hole with a fan of faces, each joining an edge of the horizon to the eye point.
+	this->newFaceArray.clear();
+	for (const HalfEdge& halfEdge : this->horizonArray)
+	{
+		int i = this->faceArray[halfEdge.faceIndex].vertex[(halfEdge.edgeIndex + 1) % 3];
+		int j = this->faceArray[halfEdge.faceIndex].vertex[halfEdge.edgeIndex];
+		int newFaceIndex = this->AddFace(i, j, eyePointIndex);
+		this->LinkEdges(newFaceIndex, 0, halfEdge.faceIndex, halfEdge.edgeIndex);
+		this->newFaceArray.push_back(newFaceIndex);
+	}
+
+	// Neighboring faces of the fan are found by the horizon vertex they share.
+	if (this->fanFaceArray.size() < this->pointArray.size())
+		this->fanFaceArray.resize(this->pointArray.size(), -1);
+
+	for (int newFaceIndex : this->newFaceArray)
+		this->fanFaceArray[this->faceArray[newFaceIndex].vertex[0]] = newFaceIndex;
+
+	for (int newFaceIndex : this->newFaceArray)
+	{
+		int nextFaceIndex = this->fanFaceArray[this->faceArray[newFaceIndex].vertex[1]];
+		THEBE_ASSERT(nextFaceIndex >= 0);
+		if (nextFaceIndex >= 0)
+			this->LinkEdges(newFaceIndex, 1, nextFaceIndex, 2);
+	}
+
+	for (int newFaceIndex : this->newFaceArray)
+		this->fanFaceArray[this->faceArray[newFaceIndex].vertex[0]] = -1;
+
+	// Points that aren't above any of the new faces are now inside the hull and can be forgotten.
+	for (int i : this->orphanPointArray)
+	{
+		int bestFaceIndex = -1;
+		double largestDistance = this->tolerance;
+		for (int newFaceIndex : this->newFaceArray)
+		{
+			double distance = this->SignedDistance(this->faceArray[newFaceIndex], i);
+			if (distance > largestDistance)
+			{
+				largestDistance = distance;
+				bestFaceIndex = newFaceIndex;
+			}
+		}
+
+		if (bestFaceIndex >= 0)
+			this->faceArray[bestFaceIndex].conflictArray.push_back(i);
+	}
+
+	for (int newFaceIndex : this->newFaceArray)
+		if (this->faceArray[newFaceIndex].conflictArray.size() > 0)
+			this->pendingFaceArray.push_back(newFaceIndex);
+}
+
+int QuickHull::AddFace(int i, int j, int k)
+{
+	int faceIndex = -1;
+	if (this->freeFaceArray.size() > 0)
+	{
+		faceIndex = this->freeFaceArray.back();
+		this->freeFaceArray.pop_back();
+	}
+	else
+	{
+		faceIndex = (int)this->faceArray.size();
+		this->faceArray.push_back(Face());
+	}
+
+	Face& face = this->faceArray[faceIndex];
+	face.vertex[0] = i;
+	face.vertex[1] = j;
+	face.vertex[2] = k;
+	for (int e = 0; e < 3; e++)
+	{
+		face.adjacentFace[e] = -1;
+		face.adjacentEdge[e] = -1;
+	}
+
+	const Vector3& pointA = this->pointArray[i];
+	const Vector3& pointB = this->pointArray[j];
+	const Vector3& pointC = this->pointArray[k];
+	face.unitNormal = (pointB - pointA).Cross(pointC - pointA).Normalized();
+	face.distance = face.unitNormal.Dot(pointA);
+	face.conflictArray.clear();
+	face.visitNumber = 0;
+	face.visible = false;
+	face.deleted = false;
+
+	return faceIndex;
+}
+
+void QuickHull::DeleteFace(int faceIndex)
+{
+	Face& face = this->faceArray[faceIndex];
+	face.deleted = true;
+	face.conflictArray.clear();
+	this->freeFaceArray.push_back(faceIndex);
+}
+
+void QuickHull::LinkEdges(int faceIndexA, int edgeIndexA, int faceIndexB, int edgeIndexB)
+{
+	Face& faceA = this->faceArray[faceIndexA];
+	Face& faceB = this->faceArray[faceIndexB];
+
+	faceA.adjacentFace[edgeIndexA] = faceIndexB;
+	faceA.adjacentEdge[edgeIndexA] = edgeIndexB;
+	faceB.adjacentFace[edgeIndexB] = faceIndexA;
+	faceB.adjacentEdge[edgeIndexB] = edgeIndexA;
+}
+
+double QuickHull::SignedDistance(const Face& face, int pointIndex) const
+{
+	return face.unitNormal.Dot(this->pointArray[pointIndex]) - face.distance;
+}
+
+int QuickHull::FindRoot(std::vector<int>& parentArray, int i) const
+{
+	while (parentArray[i] != i)
+	{
+		parentArray[i] = parentArray[parentArray[i]];
+		i = parentArray[i];
+	}
+
+	return i;
+}
+
+void QuickHull::ToPolygonMesh(PolygonMesh& polygonMesh, bool mergeCoplanarFaces, double epsilon /*= 1e-6*/) const
+{
+	polygonMesh.Clear();
+
+	std::vector<int> vertexMap(this->pointArray.size(), -1);
+	auto mapVertex = [&vertexMap, &polygonMesh, this](int i) -> int
+		{
+			if (vertexMap[i] < 0)
+				vertexMap[i] = polygonMesh.AddVertex(this->pointArray[i]);
+			return vertexMap[i];
+		};
+
+	auto addTriangle = [&polygonMesh, &mapVertex](const Face& face)
+		{
+			PolygonMesh::Polygon polygon;
+			for (int i = 0; i < 3; i++)
+				polygon.vertexArray.push_back(mapVertex(face.vertex[i]));
+			polygonMesh.AddPolygon(polygon);
+		};
+
+	if (!mergeCoplanarFaces)
+	{
+		for (const Face& face : this->faceArray)
+			if (!face.deleted)
+				addTriangle(face);
+
+		return;
+	}
+
+	// Group together neighboring faces that lie in each other's planes.  What counts as in the plane depends on the size of the coordinates.
+	double coplanarTolerance = THEBE_MAX(epsilon * this->maxAbsCoordinate, this->tolerance);
+	std::vector<int> parentArray(this->faceArray.size());
+	for (int i = 0; i < (int)parentArray.size(); i++)
+		parentArray[i] = i;
+
+	for (int i = 0; i < (int)this->faceArray.size(); i++)
+	{
+		const Face& face = this->faceArray[i];
+		if (face.deleted)
+			continue;
+
+		for (int e = 0; e < 3; e++)
+		{
+			int j = face.adjacentFace[e];
+			if (j < i)
+				continue;
+
+			const Face& adjacentFace = this->faceArray[j];
+			int apex = face.vertex[(e + 2) % 3];
+			int adjacentApex = adjacentFace.vertex[(face.adjacentEdge[e] + 2) % 3];
+			if (::fabs(this->SignedDistance(face, adjacentApex)) <= coplanarTolerance && ::fabs(this->SignedDistance(adjacentFace, apex)) <= coplanarTolerance)
+			{
+				int rootA = this->FindRoot(parentArray, i);
+				int rootB = this->FindRoot(parentArray, j);
+				if (rootA != rootB)
+					parentArray[rootA] = rootB;
+			}
+		}
+	}
+
+	// Each group becomes a single polygon bounded by the edges that leave the group.
+	std::unordered_map<int, std::vector<int>> groupMap;
+	std::vector<int> groupRootArray;
+	for (int i = 0; i < (int)this->faceArray.size(); i++)
+	{
+		if (this->faceArray[i].deleted)
+			continue;
+
+		int root = this->FindRoot(parentArray, i);
+		auto pair = groupMap.find(root);
+		if (pair == groupMap.end())
+		{
+			groupRootArray.push_back(root);
+			groupMap.insert(std::pair(root, std::vector<int>{ i }));
+		}
+		else
+			pair->second.push_back(i);
+	}
+
+	std::unordered_map<int, int> nextVertexMap;
+	for (int root : groupRootArray)
+	{
+		const std::vector<int>& groupArray = groupMap[root];
+		if (groupArray.size() == 1)
+		{
+			addTriangle(this->faceArray[groupArray[0]]);
+			continue;
+		}
+
+		nextVertexMap.clear();
+		bool simpleLoop = true;
+		int numBoundaryEdges = 0;
+		for (int i : groupArray)
+		{
+			const Face& face = this->faceArray[i];
+			for (int e = 0; e < 3; e++)
+			{
+				if (this->FindRoot(parentArray, face.adjacentFace[e]) == root)
+					continue;
+
+				numBoundaryEdges++;
+				if (!nextVertexMap.insert(std::pair(face.vertex[e], face.vertex[(e + 1) % 3])).second)
+					simpleLoop = false;
+			}
+		}
+
+		PolygonMesh::Polygon polygon;
+		if (simpleLoop && numBoundaryEdges > 0)
+		{
+			int firstVertex = nextVertexMap.begin()->first;
+			int vertex = firstVertex;
+			do
+			{
+				polygon.vertexArray.push_back(vertex);
+				auto pair = nextVertexMap.find(vertex);
+				if (pair == nextVertexMap.end())
+				{
+					simpleLoop = false;
+					break;
+				}
+				vertex = pair->second;
+			} while (vertex != firstVertex && (int)polygon.vertexArray.size() <= numBoundaryEdges);
+
+			if ((int)polygon.vertexArray.size() != numBoundaryEdges)
+				simpleLoop = false;
+		}
+
+		// If tolerances got the better of us, just keep the triangles of the group.
+		if (!simpleLoop || numBoundaryEdges == 0)
+		{
+			for (int i : groupArray)
+				addTriangle(this->faceArray[i]);
+
+			continue;
+		}
+
+		for (int& vertex : polygon.vertexArray)
+			vertex = mapVertex(vertex);
+
+		polygonMesh.AddPolygon(polygon);
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Thebe/Math/Vector3.h"
+#include "Thebe/Math/PolygonMesh.h"
+#include <vector>
+
+namespace Thebe
+{
+	/**
+	 * This is an implementation of the Quickhull algorithm for finding the convex hull of a set of points in 3D.
+	 *
+	 * We start with a tetrahedron made from extreme points of the set.  Every remaining point is put into
+	 * the conflict list of a face it is above, or thrown away if it's inside the tetrahedron.  Then, as long as
+	 * some face has a non-empty conflict list, the point of that list furthest from the face is added to the hull.
+	 * This is done by walking across neighboring faces to find all those visible from the new point, and then
+	 * replacing them with a fan of faces joining the new point to the horizon of the visible region.  Only the
+	 * conflict lists of the replaced faces need to be redistributed, and so points deep inside the hull are
+	 * quickly thrown out.  The expected running time is O(n log n).
+	 *
+	 * The hull is made of triangles whose edges know the edges they're glued to in neighboring faces.  Edge e
+	 * of a face runs from its vertex e to its vertex e+1 (mod 3), and faces are wound counter-clockwise when
+	 * viewed from outside the hull.
+	 */
+	class THEBE_API QuickHull
+	{
+	public:
+		QuickHull();
+		virtual ~QuickHull();
+
+		/**
+		 * Calculate the convex hull of the given point-cloud.
+		 *
+		 * @return False is returned if the points don't span all three dimensions; true, otherwise.
+		 */
+		bool Generate(const std::vector<Vector3>& pointArray);
+
+		/**
+		 * Write the hull found by @ref Generate into the given mesh.  Only points on the hull become vertices of the mesh.
+		 *
+		 * @param[out] polygonMesh This is cleared and then populated with the hull.
+		 * @param[in] mergeCoplanarFaces If true, neighboring triangles in the same plane are merged into a single polygon.  Otherwise, all polygons are triangles.
+		 * @param[in] epsilon This is how far a vertex can be from the plane of a face and still be considered in that plane, as a fraction of the largest absolute coordinate of the points given to @ref Generate.
+		 */
+		void ToPolygonMesh(PolygonMesh& polygonMesh, bool mergeCoplanarFaces, double epsilon = 1e-6) const;
+
+		/**
+		 * Discard any hull we may have already generated.
+		 */
+		void Clear();
+
+	private:
+
+		struct Face
+		{
+			int vertex[3];
+			int adjacentFace[3];
+			int adjacentEdge[3];
+			Vector3 unitNormal;
+			double distance;
+			std::vector<int> conflictArray;
+			int visitNumber;
+			bool visible;
+			bool deleted;
+		};
+
+		struct HalfEdge
+		{
+			int faceIndex;
+			int edgeIndex;
+		};
+
+		bool FindInitialTetrahedron(int* pointIndex);
+		int AddFace(int i, int j, int k);
+		void DeleteFace(int faceIndex);
+		void LinkEdges(int faceIndexA, int edgeIndexA, int faceIndexB, int edgeIndexB);
+		double SignedDistance(const Face& face, int pointIndex) const;
+		void AddPointToHull(int faceIndex);
+		int FindRoot(std::vector<int>& parentArray, int i) const;
+
+		std::vector<Vector3> pointArray;
+		std::vector<Face> faceArray;
+		std::vector<int> freeFaceArray;
+		std::vector<int> pendingFaceArray;
+		std::vector<int> faceStackArray;
+		std::vector<int> visibleFaceArray;
+		std::vector<int> newFaceArray;
+		std::vector<int> orphanPointArray;
+		std::vector<int> fanFaceArray;
+		std::vector<HalfEdge> horizonArray;
+		double tolerance;
+		double maxAbsCoordinate;
+		int visitNumber;
+	};
+}
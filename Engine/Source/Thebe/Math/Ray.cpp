@@ -76,31 +76,43 @@ bool Ray::CastAgainst(const Plane& plane, double& alpha) const
 
 bool Ray::CastAgainst(const AxisAlignedBoundingBox& box, Interval& interval, double borderThickness /*= 0.0*/) const
 {
-	std::vector<Plane> sidePlaneArray;
-	box.GetSidePlanes(sidePlaneArray);
-	if (sidePlaneArray.size() == 0)
-		return false;
+	// This is the slab method.  Note that we don't cast against the side planes and then ask if
+	// the hit points are on the box, because round-off can put a hit point just off the face it's on.
+	double minCorner[3] = { box.minCorner.x, box.minCorner.y, box.minCorner.z };
+	double maxCorner[3] = { box.maxCorner.x, box.maxCorner.y, box.maxCorner.z };
+	double origin[3] = { this->origin.x, this->origin.y, this->origin.z };
+	double direction[3] = { this->unitDirection.x, this->unitDirection.y, this->unitDirection.z };
 
-	interval.A = std::numeric_limits<double>::max();
-	interval.B = -std::numeric_limits<double>::max();
+	interval.A = 0.0;
+	interval.B = std::numeric_limits<double>::max();
 
-	for (const Plane& sidePlane : sidePlaneArray)
+	for (int i = 0; i < 3; i++)
 	{
-		double alpha = 0.0;
-		if (this->CastAgainst(sidePlane, alpha))
+		double slabMin = minCorner[i] - borderThickness / 2.0;
+		double slabMax = maxCorner[i] + borderThickness / 2.0;
+		if (!(slabMin <= slabMax))
+			return false;
+
+		if (direction[i] == 0.0)
 		{
-			Vector3 hitPoint = this->CalculatePoint(alpha);
-			if (box.ContainsPoint(hitPoint, borderThickness))
-			{
-				interval.Expand(alpha);
-			}
+			if (origin[i] < slabMin || origin[i] > slabMax)
+				return false;
+
+			continue;
 		}
-	}
 
-	if (box.ContainsPoint(this->origin))
-		interval.Expand(0.0);
+		double alphaA = (slabMin - origin[i]) / direction[i];
+		double alphaB = (slabMax - origin[i]) / direction[i];
+		if (alphaA > alphaB)
+			std::swap(alphaA, alphaB);
 
-	return interval.MakesSense();
+		interval.A = THEBE_MAX(interval.A, alphaA);
+		interval.B = THEBE_MIN(interval.B, alphaB);
+		if (interval.A > interval.B)
+			return false;
+	}
+
+	return true;
 }
 
 void Ray::ToLineSegment(LineSegment& lineSegment, double alpha) const
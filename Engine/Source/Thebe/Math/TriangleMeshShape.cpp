@@ -0,0 +1,414 @@
+#include "Thebe/Math/TriangleMeshShape.h"
+#include "Thebe/Log.h"
+#include <algorithm>
+#include <numeric>
+
+using namespace Thebe;
+
+//------------------------------------- TriangleMeshShape -------------------------------------
+
+TriangleMeshShape::TriangleMeshShape()
+{
+}
+
+/*virtual*/ TriangleMeshShape::~TriangleMeshShape()
+{
+}
+
+bool TriangleMeshShape::SetFromPolygonMesh(const PolygonMesh& polygonMesh)
+{
+	this->polygonMesh = polygonMesh;
+	this->vertexArray = polygonMesh.GetVertexArray();
+	this->triangleArray.clear();
+	this->nodeArray.clear();
+
+	for (const PolygonMesh::Polygon& polygon : polygonMesh.GetPolygonArray())
+	{
+		int numVertices = (int)polygon.vertexArray.size();
+		if (numVertices < 3)
+			continue;
+
+		// Polygons are taken to be convex, as they are elsewhere in the engine, so a fan about the first vertex will do.
+		for (int i = 1; i < numVertices - 1; i++)
+			this->triangleArray.push_back(Triangle{ { polygon.vertexArray[0], polygon.vertexArray[i], polygon.vertexArray[i + 1] } });
+	}
+
+	int numTriangles = (int)this->triangleArray.size();
+	if (numTriangles == 0)
+	{
+		THEBE_LOG("The mesh has no triangles.");
+		return false;
+	}
+
+	std::vector<Vector3> centerArray;
+	centerArray.reserve(numTriangles);
+	for (const Triangle& triangle : this->triangleArray)
+		centerArray.push_back((this->vertexArray[triangle.vertex[0]] + this->vertexArray[triangle.vertex[1]] + this->vertexArray[triangle.vertex[2]]) / 3.0);
+
+	std::vector<int> orderArray(numTriangles);
+	std::iota(orderArray.begin(), orderArray.end(), 0);
+
+	this->nodeArray.reserve(2 * (numTriangles / maxTrianglesPerLeaf + 1));
+	int treeDepth = this->BuildNode(0, numTriangles, orderArray, centerArray);
+	if (treeDepth + 1 > maxStackDepth)
+	{
+		THEBE_LOG("The tree of triangles is %d deep, which is too deep to traverse.", treeDepth);
+		this->triangleArray.clear();
+		this->nodeArray.clear();
+		return false;
+	}
+
+	// Put the triangles in the order the tree wants them, so that those of each leaf are contiguous.
+	std::vector<Triangle> orderedTriangleArray;
+	orderedTriangleArray.reserve(numTriangles);
+	for (int i : orderArray)
+		orderedTriangleArray.push_back(this->triangleArray[i]);
+
+	this->triangleArray.swap(orderedTriangleArray);
+	return true;
+}
+
+int TriangleMeshShape::BuildNode(int firstTriangle, int numTriangles, std::vector<int>& orderArray, const std::vector<Vector3>& centerArray)
+{
+	int nodeIndex = (int)this->nodeArray.size();
+	this->nodeArray.push_back(Node{});
+
+	AxisAlignedBoundingBox box, centerBox;
+	box.MakeReadyForExpansion();
+	centerBox.MakeReadyForExpansion();
+	for (int i = firstTriangle; i < firstTriangle + numTriangles; i++)
+	{
+		const Triangle& triangle = this->triangleArray[orderArray[i]];
+		for (int j = 0; j < 3; j++)
+			box.Expand(this->vertexArray[triangle.vertex[j]]);
+
+		centerBox.Expand(centerArray[orderArray[i]]);
+	}
+
+	Node& node = this->nodeArray[nodeIndex];
+	node.minCorner[0] = box.minCorner.x;
+	node.minCorner[1] = box.minCorner.y;
+	node.minCorner[2] = box.minCorner.z;
+	node.maxCorner[0] = box.maxCorner.x;
+	node.maxCorner[1] = box.maxCorner.y;
+	node.maxCorner[2] = box.maxCorner.z;
+	node.secondChildIndex = -1;
+	node.firstTriangle = firstTriangle;
+	node.numTriangles = numTriangles;
+
+	if (numTriangles <= maxTrianglesPerLeaf)
+		return 0;
+
+	node.numTriangles = 0;
+
+	// Splitting at the median keeps the tree balanced, so its depth is logarithmic in the number of triangles.
+	double xSize = 0.0, ySize = 0.0, zSize = 0.0;
+	centerBox.GetDimensions(xSize, ySize, zSize);
+	int axis = (xSize >= ySize && xSize >= zSize) ? 0 : ((ySize >= zSize) ? 1 : 2);
+	auto component = [axis](const Vector3& vector) -> double
+		{
+			return (axis == 0) ? vector.x : ((axis == 1) ? vector.y : vector.z);
+		};
+
+	int numFirstTriangles = numTriangles / 2;
+	std::nth_element(
+		orderArray.begin() + firstTriangle,
+		orderArray.begin() + firstTriangle + numFirstTriangles,
+		orderArray.begin() + firstTriangle + numTriangles,
+		[&centerArray, &component](int i, int j) { return component(centerArray[i]) < component(centerArray[j]); });
+
+	// Note that the node array may grow here, so we can't hang on to a reference into it.
+	int firstDepth = this->BuildNode(firstTriangle, numFirstTriangles, orderArray, centerArray);
+	this->nodeArray[nodeIndex].secondChildIndex = (int)this->nodeArray.size();
+	int secondDepth = this->BuildNode(firstTriangle + numFirstTriangles, numTriangles - numFirstTriangles, orderArray, centerArray);
+	return 1 + THEBE_MAX(firstDepth, secondDepth);
+}
+
+/*static*/ bool TriangleMeshShape::Overlaps(const Node& node, const AxisAlignedBoundingBox& box)
+{
+	if (node.maxCorner[0] < box.minCorner.x || box.maxCorner.x < node.minCorner[0])
+		return false;
+
+	if (node.maxCorner[1] < box.minCorner.y || box.maxCorner.y < node.minCorner[1])
+		return false;
+
+	if (node.maxCorner[2] < box.minCorner.z || box.maxCorner.z < node.minCorner[2])
+		return false;
+
+	return true;
+}
+
+/*static*/ double TriangleMeshShape::FurthestDistance(const Node& node, const Vector3& direction)
+{
+	return
+		((direction.x > 0.0) ? node.maxCorner[0] : node.minCorner[0]) * direction.x +
+		((direction.y > 0.0) ? node.maxCorner[1] : node.minCorner[1]) * direction.y +
+		((direction.z > 0.0) ? node.maxCorner[2] : node.minCorner[2]) * direction.z;
+}
+
+const PolygonMesh& TriangleMeshShape::GetPolygonMesh() const
+{
+	return this->polygonMesh;
+}
+
+void TriangleMeshShape::FindTriangles(const AxisAlignedBoundingBox& worldBox, std::vector<int>& triangleArray) const
+{
+	triangleArray.clear();
+
+	if (this->nodeArray.size() == 0)
+		return;
+
+	// Rather than take the tree into world space, take the box into object space.
+	Transform worldToObject;
+	worldToObject.Invert(this->objectToWorld);
+	AxisAlignedBoundingBox objectBox;
+	objectBox.MakeReadyForExpansion();
+	for (int i = 0; i < 8; i++)
+	{
+		Vector3 corner(
+			(i & 1) ? worldBox.maxCorner.x : worldBox.minCorner.x,
+			(i & 2) ? worldBox.maxCorner.y : worldBox.minCorner.y,
+			(i & 4) ? worldBox.maxCorner.z : worldBox.minCorner.z);
+		objectBox.Expand(worldToObject.TransformPoint(corner));
+	}
+
+	int nodeStack[maxStackDepth];
+	int stackSize = 0;
+	nodeStack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		int nodeIndex = nodeStack[--stackSize];
+		const Node& node = this->nodeArray[nodeIndex];
+		if (!Overlaps(node, objectBox))
+			continue;
+
+		if (node.secondChildIndex >= 0)
+		{
+			THEBE_ASSERT(stackSize + 2 <= maxStackDepth);
+			nodeStack[stackSize++] = node.secondChildIndex;
+			nodeStack[stackSize++] = nodeIndex + 1;
+			continue;
+		}
+
+		// A leaf has only a few triangles, so it's worth checking the box of each.
+		for (int i = node.firstTriangle; i < node.firstTriangle + node.numTriangles; i++)
+		{
+			const Triangle& triangle = this->triangleArray[i];
+			Node triangleNode;
+			const Vector3& vertex = this->vertexArray[triangle.vertex[0]];
+			triangleNode.minCorner[0] = triangleNode.maxCorner[0] = vertex.x;
+			triangleNode.minCorner[1] = triangleNode.maxCorner[1] = vertex.y;
+			triangleNode.minCorner[2] = triangleNode.maxCorner[2] = vertex.z;
+			for (int j = 1; j < 3; j++)
+			{
+				const Vector3& otherVertex = this->vertexArray[triangle.vertex[j]];
+				triangleNode.minCorner[0] = THEBE_MIN(triangleNode.minCorner[0], otherVertex.x);
+				triangleNode.minCorner[1] = THEBE_MIN(triangleNode.minCorner[1], otherVertex.y);
+				triangleNode.minCorner[2] = THEBE_MIN(triangleNode.minCorner[2], otherVertex.z);
+				triangleNode.maxCorner[0] = THEBE_MAX(triangleNode.maxCorner[0], otherVertex.x);
+				triangleNode.maxCorner[1] = THEBE_MAX(triangleNode.maxCorner[1], otherVertex.y);
+				triangleNode.maxCorner[2] = THEBE_MAX(triangleNode.maxCorner[2], otherVertex.z);
+			}
+
+			if (Overlaps(triangleNode, objectBox))
+				triangleArray.push_back(i);
+		}
+	}
+}
+
+void TriangleMeshShape::GetTriangle(int i, GJKTriangle& triangle) const
+{
+	const Triangle& meshTriangle = this->triangleArray[i];
+	for (int j = 0; j < 3; j++)
+		triangle.vertex[j] = this->vertexArray[meshTriangle.vertex[j]];
+
+	triangle.SetObjectToWorld(this->objectToWorld);
+}
+
+int TriangleMeshShape::GetNumTriangles() const
+{
+	return (int)this->triangleArray.size();
+}
+
+int TriangleMeshShape::GetNumNodes() const
+{
+	return (int)this->nodeArray.size();
+}
+
+/*virtual*/ Vector3 TriangleMeshShape::FurthestPoint(const Vector3& unitDirection) const
+{
+	if (this->nodeArray.size() == 0)
+		return this->objectToWorld.translation;
+
+	Vector3 objectDirection = unitDirection * this->objectToWorld.matrix;
+
+	// Rather than look at every vertex, search the tree, skipping any node whose box can't beat what we've found so far.
+	// Visiting the more promising child first finds a good vertex early, so that most of the tree gets skipped.
+	int nodeStack[maxStackDepth];
+	int stackSize = 0;
+	nodeStack[stackSize++] = 0;
+
+	int chosenVertex = -1;
+	double largestDistance = -std::numeric_limits<double>::max();
+
+	while (stackSize > 0)
+	{
+		int nodeIndex = nodeStack[--stackSize];
+		const Node& node = this->nodeArray[nodeIndex];
+		if (chosenVertex >= 0 && FurthestDistance(node, objectDirection) <= largestDistance)
+			continue;
+
+		if (node.secondChildIndex >= 0)
+		{
+			THEBE_ASSERT(stackSize + 2 <= maxStackDepth);
+			int firstChildIndex = nodeIndex + 1;
+			if (FurthestDistance(this->nodeArray[firstChildIndex], objectDirection) >= FurthestDistance(this->nodeArray[node.secondChildIndex], objectDirection))
+			{
+				nodeStack[stackSize++] = node.secondChildIndex;
+				nodeStack[stackSize++] = firstChildIndex;
+			}
+			else
+			{
+				nodeStack[stackSize++] = firstChildIndex;
+				nodeStack[stackSize++] = node.secondChildIndex;
+			}
+
+			continue;
+		}
+
+		for (int i = node.firstTriangle; i < node.firstTriangle + node.numTriangles; i++)
+		{
+			const Triangle& triangle = this->triangleArray[i];
+			for (int j = 0; j < 3; j++)
+			{
+				double distance = this->vertexArray[triangle.vertex[j]].Dot(objectDirection);
+				if (chosenVertex < 0 || distance > largestDistance)
+				{
+					largestDistance = distance;
+					chosenVertex = triangle.vertex[j];
+				}
+			}
+		}
+	}
+
+	return this->objectToWorld.TransformPoint(this->vertexArray[chosenVertex]);
+}
+
+/*virtual*/ AxisAlignedBoundingBox TriangleMeshShape::GetObjectBoundingBox() const
+{
+	AxisAlignedBoundingBox objectBoundingBox;
+	objectBoundingBox.MakeReadyForExpansion();
+
+	if (this->nodeArray.size() > 0)
+	{
+		const Node& rootNode = this->nodeArray[0];
+		objectBoundingBox.minCorner.SetComponents(rootNode.minCorner[0], rootNode.minCorner[1], rootNode.minCorner[2]);
+		objectBoundingBox.maxCorner.SetComponents(rootNode.maxCorner[0], rootNode.maxCorner[1], rootNode.maxCorner[2]);
+	}
+
+	return objectBoundingBox;
+}
+
+/*virtual*/ AxisAlignedBoundingBox TriangleMeshShape::GetWorldBoundingBox() const
+{
+	AxisAlignedBoundingBox worldBoundingBox;
+	worldBoundingBox.MakeReadyForExpansion();
+
+	for (const Vector3& objectVertex : this->vertexArray)
+		worldBoundingBox.Expand(this->objectToWorld.TransformPoint(objectVertex));
+
+	return worldBoundingBox;
+}
+
+/*virtual*/ bool TriangleMeshShape::RayCast(const Ray& ray, double& alpha, Vector3& unitSurfaceNormal) const
+{
+	if (this->nodeArray.size() == 0)
+		return false;
+
+	Transform worldToObject;
+	worldToObject.Invert(this->objectToWorld);
+	Ray objectRay = worldToObject.TransformRay(ray);
+
+	int nodeStack[maxStackDepth];
+	int stackSize = 0;
+	nodeStack[stackSize++] = 0;
+
+	int hitTriangle = -1;
+	double nearestAlpha = std::numeric_limits<double>::max();
+
+	while (stackSize > 0)
+	{
+		int nodeIndex = nodeStack[--stackSize];
+		const Node& node = this->nodeArray[nodeIndex];
+
+		AxisAlignedBoundingBox nodeBox;
+		nodeBox.minCorner.SetComponents(node.minCorner[0], node.minCorner[1], node.minCorner[2]);
+		nodeBox.maxCorner.SetComponents(node.maxCorner[0], node.maxCorner[1], node.maxCorner[2]);
+
+		Interval interval;
+		if (!objectRay.CastAgainst(nodeBox, interval) || interval.A > nearestAlpha)
+			continue;
+
+		if (node.secondChildIndex >= 0)
+		{
+			THEBE_ASSERT(stackSize + 2 <= maxStackDepth);
+			nodeStack[stackSize++] = node.secondChildIndex;
+			nodeStack[stackSize++] = nodeIndex + 1;
+			continue;
+		}
+
+		for (int i = node.firstTriangle; i < node.firstTriangle + node.numTriangles; i++)
+		{
+			const Triangle& triangle = this->triangleArray[i];
+			double triangleAlpha = 0.0;
+			if (GJKTriangle::RayCastTriangle(objectRay, this->vertexArray[triangle.vertex[0]], this->vertexArray[triangle.vertex[1]], this->vertexArray[triangle.vertex[2]], triangleAlpha) && triangleAlpha < nearestAlpha)
+			{
+				nearestAlpha = triangleAlpha;
+				hitTriangle = i;
+			}
+		}
+	}
+
+	if (hitTriangle < 0)
+		return false;
+
+	// The transform may scale, so measure the distance to the hit in world space.
+	Vector3 worldHitPoint = this->objectToWorld.TransformPoint(objectRay.CalculatePoint(nearestAlpha));
+	alpha = (worldHitPoint - ray.origin).Dot(ray.unitDirection);
+
+	const Triangle& triangle = this->triangleArray[hitTriangle];
+	const Vector3& vertexA = this->vertexArray[triangle.vertex[0]];
+	const Vector3& vertexB = this->vertexArray[triangle.vertex[1]];
+	const Vector3& vertexC = this->vertexArray[triangle.vertex[2]];
+	// Normals go back to world space by the inverse-transpose, since the transform need not be orthonormal.
+	unitSurfaceNormal = ((vertexB - vertexA).Cross(vertexC - vertexA) * worldToObject.matrix).Normalized();
+	if (unitSurfaceNormal.Dot(ray.unitDirection) > 0.0)
+		unitSurfaceNormal = -unitSurfaceNormal;
+
+	return true;
+}
+
+/*virtual*/ Vector3 TriangleMeshShape::CalcGeometricCenter() const
+{
+	return this->polygonMesh.CalcVertexAverage();
+}
+
+/*virtual*/ void TriangleMeshShape::Shift(const Vector3& translation)
+{
+	for (Vector3& vertex : this->vertexArray)
+		vertex += translation;
+
+	for (int i = 0; i < this->polygonMesh.GetNumVertices(); i++)
+		this->polygonMesh.SetVertex(i, this->polygonMesh.GetVertex(i) + translation);
+
+	for (Node& node : this->nodeArray)
+	{
+		node.minCorner[0] += translation.x;
+		node.minCorner[1] += translation.y;
+		node.minCorner[2] += translation.z;
+		node.maxCorner[0] += translation.x;
+		node.maxCorner[1] += translation.y;
+		node.maxCorner[2] += translation.z;
+	}
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Thebe/Math/GJKAlgorithm.h"
+
+namespace Thebe
+{
+	/**
+	 * This is a shape made of any number of triangles, concave or not, meant for static level
+	 * geometry, such as a whole game board, that would otherwise have to be approximated by, or
+	 * split by hand into, convex hulls.  The triangles are organized by a bounding volume hierarchy
+	 * of their own, built once up front, so that only the few triangles near whatever touches the
+	 * mesh ever need to be looked at.
+	 *
+	 * Note that this shape is not convex, so it doesn't really support the GJK algorithm.  The
+	 * support function here is that of the convex hull of the mesh, which is only good for bounding.
+	 * The collision system knows to collide convex shapes against this shape one triangle at a time
+	 * (see @ref GJKTriangle).  Triangles are one-sided: their fronts face the side from which they
+	 * wind CCW, and things touching them are only ever pushed out their fronts.  This shape should
+	 * only ever be given to a stationary body.
+	 */
+	class THEBE_API TriangleMeshShape : public GJKShape
+	{
+	public:
+		TriangleMeshShape();
+		virtual ~TriangleMeshShape();
+
+		virtual Vector3 FurthestPoint(const Vector3& unitDirection) const override;
+		virtual AxisAlignedBoundingBox GetObjectBoundingBox() const override;
+		virtual AxisAlignedBoundingBox GetWorldBoundingBox() const override;
+		virtual bool RayCast(const Ray& ray, double& alpha, Vector3& unitSurfaceNormal) const override;
+		virtual Vector3 CalcGeometricCenter() const override;
+		virtual void Shift(const Vector3& translation) override;
+
+		/**
+		 * Build this shape from the given mesh.  Polygons with more than three vertices are split into fans of triangles, so they should be convex.
+		 * This is where the tree of triangles is built, so do it once, at load time.
+		 */
+		bool SetFromPolygonMesh(const PolygonMesh& polygonMesh);
+
+		/**
+		 * Get the mesh this shape was built from.
+		 */
+		const PolygonMesh& GetPolygonMesh() const;
+
+		/**
+		 * Find all triangles whose bounding boxes overlap the given world-space box.  This doesn't
+		 * change anything, so it may be called from any number of threads at once.
+		 *
+		 * @param[out] triangleArray This is cleared and then populated with the indices of the triangles found.
+		 */
+		void FindTriangles(const AxisAlignedBoundingBox& worldBox, std::vector<int>& triangleArray) const;
+
+		/**
+		 * Set up the given shape as the given triangle of this mesh, in the same place as this mesh,
+		 * so that it can be given to the GJK algorithm.
+		 */
+		void GetTriangle(int i, GJKTriangle& triangle) const;
+
+		int GetNumTriangles() const;
+		int GetNumNodes() const;
+
+	private:
+
+		struct Triangle
+		{
+			int vertex[3];
+		};
+
+		/**
+		 * The nodes are stored depth-first, so the first child of a node immediately follows it
+		 * in the array, and only the second child's index is stored.  The triangles of a leaf are
+		 * contiguous in the triangle array.
+		 */
+		struct Node
+		{
+			double minCorner[3];
+			double maxCorner[3];
+			int secondChildIndex;		///< This is -1 for leaves.
+			int firstTriangle;			///< For leaves, this is the index of the first triangle of the leaf in the triangle array.
+			int numTriangles;			///< For leaves, this is the number of triangles in the leaf; zero, otherwise.
+		};
+
+		static constexpr int maxTrianglesPerLeaf = 4;
+
+		/**
+		 * Traversals of the tree push both children of a node at once, so they never need more room
+		 * on their stacks than one more than the depth of the tree.  The tree is split at the median,
+		 * so its depth is at most logarithmic in the number of triangles, but we refuse to build
+		 * a tree too deep for this anyway, rather than trust that.
+		 */
+		static constexpr int maxStackDepth = 64;
+
+		/**
+		 * Build the subtree for the given range of triangles, returning its depth, where a leaf has depth zero.
+		 */
+		int BuildNode(int firstTriangle, int numTriangles, std::vector<int>& orderArray, const std::vector<Vector3>& centerArray);
+		static bool Overlaps(const Node& node, const AxisAlignedBoundingBox& box);
+
+		/**
+		 * This is the most that any point of the given node's box goes in the given direction.
+		 */
+		static double FurthestDistance(const Node& node, const Vector3& direction);
+
+		PolygonMesh polygonMesh;
+		std::vector<Vector3> vertexArray;
+		std::vector<Triangle> triangleArray;
+		std::vector<Node> nodeArray;
+	};
+}
@@ -5,23 +5,46 @@
 #include "Thebe/EngineParts/FloppyBody.h"
 #include "Thebe/Math/Graph.h"
 #include "Thebe/Math/LineSegment.h"
+#include "Thebe/Math/TriangleMeshShape.h"
+#include "Thebe/Math/GJKCompoundShape.h"
+#include "Thebe/Utilities/WorkerPool.h"
 #include "Thebe/Log.h"
 #include "Thebe/Profiler.h"
+#include <thread>
+#include <algorithm>
 
 using namespace Thebe;
 
 //------------------------------ PhysicsSystem ------------------------------
 
-PhysicsSystem::PhysicsSystem()
+PhysicsSystem::PhysicsSystem(CollisionSystem* collisionSystem)
 {
+	this->collisionSystem = collisionSystem;
 	this->contactCalculatorArray.push_back(new ContactCalculator<GJKConvexHull, GJKConvexHull>());
-	this->contactResolverArray.push_back(new ContactResolver<RigidBody, RigidBody>());
+	this->contactCalculatorArray.push_back(new ContactCalculator<GJKConvexHull, TriangleMeshShape>());
 	this->contactResolverArray.push_back(new ContactResolver<RigidBody, FloppyBody>());
 	this->contactResolverArray.push_back(new ContactResolver<FloppyBody, FloppyBody>());
 	
 	this->accelerationDueToGravity.SetComponents(0.0, -9.8, 0.0);
 	this->separationDampingFactor = 0.5;
 	this->coeficientOfRestitution = 0.5;
+	this->coeficientOfFriction = 0.5;
+	this->restitutionSpeedThreshold = 1.0;
+	this->contactMatchDistance = 0.05;
+	this->contactBiasFactor = 0.2;
+	this->contactSlop = 0.005;
+	this->contactSolverIterations = 30;
+	::memset(&this->contactSolverStats, 0, sizeof(ContactSolverStats));
+	this->sleepEnabled = true;
+	this->sleepEnergyThreshold = 0.002;
+	this->sleepStepCount = 30;
+	this->nextSleepingIslandNumber = 1;
+	::memset(&this->islandStats, 0, sizeof(IslandStats));
+	this->fixedTimeStepSeconds = 0.0;
+	this->maxStepsPerFrame = 4;
+	this->timeAccumulatorSeconds = 0.0;
+	this->numStepsLastFrame = 0;
+	this->threadCountChosen = false;
 
 	this->physicsWindowCookie = 0;
 }
@@ -38,6 +61,10 @@ PhysicsSystem::PhysicsSystem()
 void PhysicsSystem::Initialize(EventSystem* eventSystem)
 {
 	eventSystem->RegisterEventHandler("collision_object", [=](const Event* event) { this->HandleCollisionObjectEvent(event); });
+
+	// Unless we were told otherwise beforehand, use every core of the machine.
+	if (!this->threadCountChosen)
+		this->SetThreadCount(THEBE_MAX(int(std::thread::hardware_concurrency()), 1));
 }
 
 void PhysicsSystem::DebugDraw(DynamicLineRenderer* lineRenderer) const
@@ -63,6 +90,28 @@ void PhysicsSystem::HandleCollisionObjectEvent(const Event* event)
 	}
 }
 
+void PhysicsSystem::SetFixedTimeStep(double fixedTimeStepSeconds, int maxStepsPerFrame /*= 4*/)
+{
+	this->fixedTimeStepSeconds = THEBE_MAX(fixedTimeStepSeconds, 0.0);
+	this->maxStepsPerFrame = THEBE_MAX(maxStepsPerFrame, 1);
+	this->timeAccumulatorSeconds = 0.0;
+}
+
+double PhysicsSystem::GetFixedTimeStep() const
+{
+	return this->fixedTimeStepSeconds;
+}
+
+int PhysicsSystem::GetMaxStepsPerFrame() const
+{
+	return this->maxStepsPerFrame;
+}
+
+int PhysicsSystem::GetNumStepsLastFrame() const
+{
+	return this->numStepsLastFrame;
+}
+
 void PhysicsSystem::SetGravity(const Vector3& accelerationDueToGravity)
 {
 	this->accelerationDueToGravity = accelerationDueToGravity;
@@ -78,6 +127,149 @@ double PhysicsSystem::GetCoeficientOfRestituation() const
 	return this->coeficientOfRestitution;
 }
 
+void PhysicsSystem::SetCoeficientOfFriction(double coeficientOfFriction)
+{
+	this->coeficientOfFriction = THEBE_MAX(coeficientOfFriction, 0.0);
+}
+
+double PhysicsSystem::GetCoeficientOfFriction() const
+{
+	return this->coeficientOfFriction;
+}
+
+void PhysicsSystem::SetContactSolverIterations(int contactSolverIterations)
+{
+	this->contactSolverIterations = THEBE_MAX(contactSolverIterations, 1);
+}
+
+int PhysicsSystem::GetContactSolverIterations() const
+{
+	return this->contactSolverIterations;
+}
+
+const PhysicsSystem::ContactSolverStats& PhysicsSystem::GetContactSolverStats() const
+{
+	return this->contactSolverStats;
+}
+
+void PhysicsSystem::SetSleepThresholds(double sleepEnergyThreshold, int sleepStepCount)
+{
+	this->sleepEnergyThreshold = THEBE_MAX(sleepEnergyThreshold, 0.0);
+	this->sleepStepCount = THEBE_MAX(sleepStepCount, 1);
+}
+
+void PhysicsSystem::GetSleepThresholds(double& sleepEnergyThreshold, int& sleepStepCount) const
+{
+	sleepEnergyThreshold = this->sleepEnergyThreshold;
+	sleepStepCount = this->sleepStepCount;
+}
+
+void PhysicsSystem::SetSleepEnabled(bool sleepEnabled)
+{
+	this->sleepEnabled = sleepEnabled;
+
+	if (!sleepEnabled)
+		this->WakeAllObjects();
+}
+
+bool PhysicsSystem::GetSleepEnabled() const
+{
+	return this->sleepEnabled;
+}
+
+void PhysicsSystem::WakeObject(PhysicsObject* physicsObject)
+{
+	if (!physicsObject || !physicsObject->asleep)
+		return;
+
+	auto pair = this->sleepingIslandMap.find(physicsObject->sleepingIslandNumber);
+	this->HandleObjectWoken(physicsObject);
+	if (pair == this->sleepingIslandMap.end())
+		return;
+
+	// Objects of the island may have gone away while it slept, so they're kept by handle.
+	std::vector<RefHandle> handleArray = std::move(pair->second);
+	this->sleepingIslandMap.erase(pair);
+
+	for (RefHandle handle : handleArray)
+	{
+		Reference<PhysicsObject> islandObject;
+		if (HandleManager::Get()->GetObjectFromHandle(handle, islandObject) && islandObject->asleep)
+			this->HandleObjectWoken(islandObject.Get());
+	}
+}
+
+void PhysicsSystem::HandleObjectWoken(PhysicsObject* physicsObject)
+{
+	physicsObject->asleep = false;
+	physicsObject->calmStepCount = 0;
+	physicsObject->sleepingIslandNumber = 0;
+	physicsObject->UpdateAtRest();
+
+	// Objects woken part-way through a step, after the awake ones were gathered, join them here, so that they're
+	// separated from what they touch, and rendered, like the rest.  They start with nothing to separate them by,
+	// and they come from where they are.  Whatever is gathered here before a step is gathered again at its start.
+	physicsObject->SetSeparationResolved(physicsObject->IsStationary());
+	physicsObject->SetTotalSeparation(Vector3(0.0, 0.0, 0.0));
+	physicsObject->previousObjectToWorld = physicsObject->GetObjectToWorld();
+	this->awakeObjectArray.push_back(physicsObject);
+
+	this->islandStats.numSleepingObjects--;
+	if (!physicsObject->IsStationary() && !physicsObject->IsFrozen())
+		this->islandStats.numAwakeObjects++;
+}
+
+void PhysicsSystem::WakeAllObjects()
+{
+	for (auto& pair : this->physicsObjectMap)
+	{
+		PhysicsObject* physicsObject = pair.second.Get();
+		if (physicsObject->asleep)
+			this->HandleObjectWoken(physicsObject);
+	}
+
+	this->sleepingIslandMap.clear();
+	this->islandStats.numSleepingIslands = 0;
+}
+
+const PhysicsSystem::IslandStats& PhysicsSystem::GetIslandStats() const
+{
+	return this->islandStats;
+}
+
+bool PhysicsSystem::SetThreadCount(int threadCount)
+{
+	if (threadCount < 1)
+	{
+		THEBE_LOG("Physics thread count must be at least one, not %d.", threadCount);
+		return false;
+	}
+
+	this->threadCountChosen = true;
+
+	if (!this->collisionSystem->SetNarrowphaseThreadCount(threadCount))
+	{
+		THEBE_LOG("Failed to run physics on %d threads.", threadCount);
+		return false;
+	}
+
+	return true;
+}
+
+int PhysicsSystem::GetThreadCount() const
+{
+	return this->collisionSystem->GetNarrowphaseThreadCount();
+}
+
+void PhysicsSystem::ParallelFor(int count, int batchSize, std::function<void(int beginIndex, int endIndex, int threadIndex)> rangeFunction)
+{
+	WorkerPool* workerPool = this->collisionSystem->GetWorkerPool();
+	if (workerPool && count > batchSize)
+		workerPool->ParallelFor(count, batchSize, rangeFunction);
+	else
+		rangeFunction(0, count, 0);
+}
+
 bool PhysicsSystem::TrackObject(PhysicsObject* physicsObject)
 {
 	if (!physicsObject)
@@ -90,6 +282,10 @@ bool PhysicsSystem::TrackObject(PhysicsObject* physicsObject)
 	}
 
 	this->physicsObjectMap.insert(std::pair(physicsObject->GetHandle(), physicsObject));
+
+	// Until it takes part in a step of the simulation, the object is drawn where it is.
+	physicsObject->previousObjectToWorld = physicsObject->GetObjectToWorld();
+	physicsObject->renderObjectToWorld = physicsObject->previousObjectToWorld;
 	return true;
 }
 
@@ -106,167 +302,274 @@ bool PhysicsSystem::UntrackObject(PhysicsObject* physicsObject)
 	}
 
 	this->physicsObjectMap.erase(pair);
+
+	// Don't keep the object alive just to warm-start contacts it will never have, but do keep everyone else's.
+	this->previousManifoldArray.erase(std::remove_if(this->previousManifoldArray.begin(), this->previousManifoldArray.end(), [physicsObject](const ContactManifold& manifold) {
+		for (int i = 0; i < manifold.numContacts; i++)
+			if (manifold.contactArray[i].objectA.Get() == physicsObject || manifold.contactArray[i].objectB.Get() == physicsObject)
+				return true;
+		return false;
+	}), this->previousManifoldArray.end());
+
+	// The objects of the last step are kept to interpolate between steps, but not by reference.
+	this->awakeObjectArray.erase(std::remove(this->awakeObjectArray.begin(), this->awakeObjectArray.end(), physicsObject), this->awakeObjectArray.end());
 	return true;
 }
 
 void PhysicsSystem::UntrackAllObjects()
 {
 	this->physicsObjectMap.clear();
+	this->sleepingIslandMap.clear();
+	this->awakeObjectArray.clear();
+	this->previousManifoldArray.clear();
+	this->manifoldArray.clear();
 }
 
 void PhysicsSystem::StepSimulation(double deltaTimeSeconds, CollisionSystem* collisionSystem)
 {
 	THEBE_PROFILE_BLOCK(StepSimulation);
 
-	// If the given time delta is larger than what is reasonable for
-	// an animated system, then bail here.  This is one way we can
-	// account for being stopped in the debugger, for example.
-	if (deltaTimeSeconds >= 1.0)
+	if (this->fixedTimeStepSeconds == 0.0)
+	{
+		// If the given time delta is larger than what is reasonable for
+		// an animated system, then bail here.  This is one way we can
+		// account for being stopped in the debugger, for example.
+		if (deltaTimeSeconds >= 1.0)
+			return;
+
+		// Step the simulation forward until the given delta-time has been consumed.
+		this->numStepsLastFrame = 0;
+		while (deltaTimeSeconds > 0.0)
+		{
+			double timeStepSeconds = THEBE_MIN(deltaTimeSeconds, THEBE_MAX_PHYSICS_TIME_STEP);
+			deltaTimeSeconds -= timeStepSeconds;
+			this->SimulateStep(timeStepSeconds, collisionSystem);
+			this->numStepsLastFrame++;
+		}
+
+		this->InterpolateRenderTransforms(1.0);
 		return;
+	}
+
+	// Take as many whole steps as there's time for, including any left over from the last frame, but no more than
+	// our limit.  Time beyond that is dropped, rather than caught up on later, since trying to catch up after a slow
+	// frame only makes the next frame slower still.  Stopping in the debugger, for example, just loses the time.
+	this->timeAccumulatorSeconds += THEBE_MAX(deltaTimeSeconds, 0.0);
+	this->numStepsLastFrame = 0;
+	while (this->timeAccumulatorSeconds >= this->fixedTimeStepSeconds && this->numStepsLastFrame < this->maxStepsPerFrame)
+	{
+		this->SimulateStep(this->fixedTimeStepSeconds, collisionSystem);
+		this->timeAccumulatorSeconds -= this->fixedTimeStepSeconds;
+		this->numStepsLastFrame++;
+	}
 
-	// Step the simulation forward until the given delta-time has been consumed.
-	while (deltaTimeSeconds > 0.0)
+	if (this->timeAccumulatorSeconds >= this->fixedTimeStepSeconds)
+		this->timeAccumulatorSeconds = ::fmod(this->timeAccumulatorSeconds, this->fixedTimeStepSeconds);
+
+	// What's rendered lags the simulation by the time left over, which is less than a step.
 	{
-		double timeStepSeconds = THEBE_MIN(deltaTimeSeconds, THEBE_MAX_PHYSICS_TIME_STEP);
-		deltaTimeSeconds -= timeStepSeconds;
+		THEBE_PROFILE_BLOCK(InterpolateTransforms);
+
+		this->InterpolateRenderTransforms(this->timeAccumulatorSeconds / this->fixedTimeStepSeconds);
+	}
+}
 
-		// Determine the net force and torque acting on each object.
+void PhysicsSystem::SimulateStep(double timeStepSeconds, CollisionSystem* collisionSystem)
+{
+	// Sleeping objects sit out the step entirely.  If nothing that can move is awake, there's nothing to do.
+	this->awakeObjectArray.clear();
+	this->islandStats.numAwakeObjects = 0;
+	this->islandStats.numSleepingObjects = 0;
+	for (auto& pair : this->physicsObjectMap)
+	{
+		PhysicsObject* physicsObject = pair.second.Get();
+		if (physicsObject->IsAsleep())
+			this->islandStats.numSleepingObjects++;
+		else
 		{
-			THEBE_PROFILE_BLOCK(AccumulateForces);
+			this->awakeObjectArray.push_back(physicsObject);
+			if (!physicsObject->IsStationary() && !physicsObject->IsFrozen())
+				this->islandStats.numAwakeObjects++;
 
-			for (auto& pair : this->physicsObjectMap)
-			{
-				PhysicsObject* physicsObject = pair.second.Get();
-				if (!physicsObject->IsFrozen())
-					physicsObject->AccumulateForcesAndTorques(this);
-			}
+			// Remember where everything starts out, so that what's rendered can be placed between here and where it ends up.
+			if (this->fixedTimeStepSeconds > 0.0)
+				physicsObject->previousObjectToWorld = physicsObject->GetObjectToWorld();
 		}
+	}
 
-		// Numerically integreate the equations of motion or whatever ODEs are applicable.
-		{
-			THEBE_PROFILE_BLOCK(IntegrateMotion);
+	this->islandStats.numSleepingIslands = (int)this->sleepingIslandMap.size();
 
-			for (auto& pair : this->physicsObjectMap)
+	if (this->islandStats.numAwakeObjects == 0)
+	{
+		this->islandStats.numIslands = 0;
+		return;
+	}
+
+	// Determine the net force and torque acting on each object.  Each object only looks at itself for this, so it's done across threads.
+	// Note that the profiler isn't thread-safe, so nothing called from any of our parallel loops may use it.
+	{
+		THEBE_PROFILE_BLOCK(AccumulateForces);
+
+		this->ParallelFor((int)this->awakeObjectArray.size(), 64, [this](int beginIndex, int endIndex, int threadIndex)
 			{
-				PhysicsObject* physicsObject = pair.second.Get();
-				if (!physicsObject->IsFrozen())
-					physicsObject->IntegrateMotionUnconstrained(timeStepSeconds);
-			}
-		}
+				for (int i = beginIndex; i < endIndex; i++)
+				{
+					PhysicsObject* physicsObject = this->awakeObjectArray[i];
+					if (!physicsObject->IsFrozen())
+						physicsObject->AccumulateForcesAndTorques(this);
+				}
+			});
+	}
+
+	// Numerically integreate the equations of motion or whatever ODEs are applicable.
+	{
+		THEBE_PROFILE_BLOCK(IntegrateMotion);
 
-		// Detect and gather all collision pairs.
+		// Bodies using continuous collision detection go last so that they're swept against where everything else ends up.
+		this->continuousBodyArray.clear();
+		this->integrationBodyArray.clear();
+		for (PhysicsObject* physicsObject : this->awakeObjectArray)
 		{
-			THEBE_PROFILE_BLOCK(DetectCollisionPairs);
+			if (physicsObject->IsFrozen())
+				continue;
+
+			auto rigidBody = dynamic_cast<RigidBody*>(physicsObject);
+			if (rigidBody && rigidBody->GetContinuousCollisionDetection() && !rigidBody->IsStationary())
+				this->continuousBodyArray.push_back(rigidBody);
+			else if (rigidBody && rigidBody->GetTotalMass() != 0.0)
+				this->integrationBodyArray.push_back(rigidBody);
+			else
+				physicsObject->IntegrateMotionUnconstrained(timeStepSeconds);
+		}
 
-			this->collisionMap.clear();
-			for (auto& pair : this->physicsObjectMap)
+		// Rigid bodies are packed into contiguous arrays and integrated several at a time, a batch per thread.  Each batch
+		// is packed, integrated and unpacked in one go, while it's still in cache.  Moving a body updates the collision
+		// system, which isn't thread-safe, so the bodies are all moved afterward, here, and always in the same order.
+		int numIntegrationBodies = (int)this->integrationBodyArray.size();
+		this->integrationTransformArray.resize(numIntegrationBodies);
+		this->rigidBodyWorld.SetNumBodies(numIntegrationBodies);
+		this->ParallelFor(numIntegrationBodies, 64, [this, timeStepSeconds](int beginIndex, int endIndex, int threadIndex)
 			{
-				PhysicsObject* physicsObject = pair.second.Get();
-				if (physicsObject->IsStationary() || physicsObject->IsFrozen())
-					continue;
+				for (int i = beginIndex; i < endIndex; i++)
+					this->rigidBodyWorld.PackBody(i, this->integrationBodyArray[i]);
 
-				this->collisionArray.clear();
-				collisionSystem->FindAllCollisions(physicsObject->GetCollisionObject(), this->collisionArray);
-				for (auto& collision : this->collisionArray)
-					if (this->collisionMap.find(collision->GetHandle()) == this->collisionMap.end())
-						this->collisionMap.insert(std::pair(collision->GetHandle(), collision));
-			}
-		}
+				this->rigidBodyWorld.Integrate(beginIndex, endIndex, timeStepSeconds);
+
+				for (int i = beginIndex; i < endIndex; i++)
+					this->rigidBodyWorld.UnpackBody(i, this->integrationBodyArray[i], this->integrationTransformArray[i]);
+			});
+
+		for (int i = 0; i < numIntegrationBodies; i++)
+			this->integrationBodyArray[i]->GetCollisionObject()->SetObjectToWorld(this->integrationTransformArray[i]);
+
+		for (RigidBody* rigidBody : this->continuousBodyArray)
+			this->IntegrateMotionContinuous(rigidBody, timeStepSeconds, collisionSystem);
+	}
 
-		// Generate all collision contacts.
+	// Detect and gather all collision pairs.
+	{
+		THEBE_PROFILE_BLOCK(DetectCollisionPairs);
+
+		// Pairs in which neither object can move, or in which neither object is awake, are of no interest to us.  The broad
+		// phase skips those, since we keep it told which objects are at rest, so all we filter out here are pairs involving
+		// collision objects that aren't ours.  Anything awake found touching a sleeping island wakes it, and then we look
+		// again, so that the contacts of the newly woken objects, among themselves and with whatever else they rest on,
+		// are found this step too.
+		constexpr int maxPassCount = 4;
+		for (int i = 0; i < maxPassCount; i++)
 		{
-			THEBE_PROFILE_BLOCK(GenerateContacts);
+			collisionSystem->FindAllOverlappingPairs(this->collisionArray, [](const CollisionObject* collisionObjectA, const CollisionObject* collisionObjectB) -> bool
+				{
+					return collisionObjectA->GetPhysicsData() != 0 && collisionObjectB->GetPhysicsData() != 0;
+				});
 
-			this->contactList.clear();
-			for (auto& pair : this->collisionMap)
-			{
-				const auto& collision = pair.second;
-				this->GenerateContacts(collision.Get());
-			}
+			if (!this->WakeTouchedIslands())
+				break;
 		}
+	}
 
-		// Apply friction for all the contacts.
-		for (Contact& contact : this->contactList)
-			this->ApplyFriction(contact);
+	// Generate all collision contacts.
+	{
+		THEBE_PROFILE_BLOCK(GenerateContacts);
+
+		// The manifolds of the last step are kept so that the contact solver can warm-start from them.
+		std::swap(this->manifoldArray, this->previousManifoldArray);
+		this->manifoldArray.clear();
+		this->separationCollisionArray.clear();
+		for (auto& collision : this->collisionArray)
+			if (!this->GenerateContacts(collision.Get()))
+				this->separationCollisionArray.push_back(collision.Get());
+	}
 
-		// Go process all collision contacts.
-		{
-			THEBE_PROFILE_BLOCK(ResolveContacts);
+	// Split the objects that can move into islands of objects in contact.  Nothing in one island can affect anything in another this step.
+	{
+		THEBE_PROFILE_BLOCK(BuildIslands);
 
-			uint32_t resolutionCount = 0;
-			uint32_t iterationCount = 0;
-			constexpr uint32_t maxIterationCount = 8;
-			do
-			{
-				if (++iterationCount >= maxIterationCount)
-					break;
+		this->BuildIslands();
+	}
 
-				// Note that Baraff says a more advanced technique involves handling
-				// multiple contact points for a single object simultaneously.
-				resolutionCount = 0;
-				for (Contact& contact : this->contactList)
-					if (this->ResolveContact(contact))
-						resolutionCount++;
+	// Go process all collision contacts.
+	{
+		THEBE_PROFILE_BLOCK(ResolveContacts);
 
-			} while (resolutionCount > 0);
-		}
+		// Contacts between rigid bodies are all solved together, by sequential impulses.
+		this->contactSolverClock.GetCurrentTimeMilliseconds(true);
+		this->PrepareContactSolver(timeStepSeconds);
+		this->contactSolverStats.prepareTimeMilliseconds = this->contactSolverClock.GetCurrentTimeMilliseconds(true);
 
-		// Go Separate all the bodies the best we can.
 		{
-			THEBE_PROFILE_BLOCK(SeparateBodies);
+			THEBE_PROFILE_BLOCK(SolveContacts);
 
-			for (auto& pair : this->physicsObjectMap)
-			{
-				PhysicsObject* physicsObject = pair.second.Get();
-				physicsObject->SetSeparationResolved(physicsObject->IsStationary());
-				physicsObject->SetTotalSeparation(Vector3(0.0, 0.0, 0.0));
-			}
+			// Each island is solved start to finish by a single thread, in the same order, whichever thread that is, so the results don't depend on the threads.
+			int numConstraintIslands = (int)this->islandConstraintOffsetArray.size() - 1;
+			this->ParallelFor(numConstraintIslands, 1, [this](int beginIndex, int endIndex, int threadIndex)
+				{
+					for (int i = beginIndex; i < endIndex; i++)
+						this->SolveIsland(i);
+				});
+		}
 
-			while (true)
-			{
-				int numSeparationsPerformed = 0;
+		this->contactSolverStats.numIterations = this->contactSolverIterations;
+		this->contactSolverStats.solveTimeMilliseconds = this->contactSolverClock.GetCurrentTimeMilliseconds(true);
+		this->FinishContactSolver();
 
-				for (auto& pair : this->collisionMap)
-				{
-					auto& collision = pair.second;
-					Vector3 separationDelta = collision->separationDelta * this->separationDampingFactor;
+		// Any other contacts are resolved one at a time, by whichever resolver knows how.
+		uint32_t resolutionCount = 0;
+		uint32_t iterationCount = 0;
+		constexpr uint32_t maxIterationCount = 8;
+		do
+		{
+			if (++iterationCount >= maxIterationCount)
+				break;
 
-					RefHandle handleA = (RefHandle)collision->objectA->GetPhysicsData();
-					RefHandle handleB = (RefHandle)collision->objectB->GetPhysicsData();
+			resolutionCount = 0;
+			for (Contact* contact : this->resolverContactArray)
+				if (this->ResolveContact(*contact))
+					resolutionCount++;
 
-					Reference<PhysicsObject> objectA, objectB;
+		} while (resolutionCount > 0);
+	}
 
-					if (HandleManager::Get()->GetObjectFromHandle(handleA, objectA) && HandleManager::Get()->GetObjectFromHandle(handleB, objectB))
-					{
-						if (objectA->GetSeparationResolved() && !objectB->GetSeparationResolved())
-						{
-							Transform objectToWorld = objectB->GetObjectToWorld();
-							objectB->SetTotalSeparation(-separationDelta + objectA->GetTotalSeparation());
-							objectToWorld.translation += objectB->GetTotalSeparation();
-							objectB->SetObjectToWorld(objectToWorld);
-							objectB->SetSeparationResolved(true);
-							numSeparationsPerformed++;
-						}
-						else if (!objectA->GetSeparationResolved() && objectB->GetSeparationResolved())
-						{
-							Transform objectToWorld = objectA->GetObjectToWorld();
-							objectA->SetTotalSeparation(separationDelta + objectB->GetTotalSeparation());
-							objectToWorld.translation += objectA->GetTotalSeparation();
-							objectA->SetObjectToWorld(objectToWorld);
-							objectA->SetSeparationResolved(true);
-							numSeparationsPerformed++;
-						}
-					}
-				}
+	// Go separate all the bodies the best we can.  Rigid bodies in contact were already pushed apart at their contact points by the
+	// contact solver, which does a better job of it than moving them bodily, so this is only for everything else.
+	{
+		THEBE_PROFILE_BLOCK(SeparateBodies);
 
-				if (numSeparationsPerformed == 0)
-					break;
-			}
+		// Note that sleeping objects were marked resolved when they went to sleep, so they stay put.
+		// Objects woken during this step were added to the awake array as they were woken.
+		for (PhysicsObject* physicsObject : this->awakeObjectArray)
+		{
+			physicsObject->SetSeparationResolved(physicsObject->IsStationary());
+			physicsObject->SetTotalSeparation(Vector3(0.0, 0.0, 0.0));
+		}
+
+		while (true)
+		{
+			int numSeparationsPerformed = 0;
 
-			for (auto& pair : this->collisionMap)
+			for (CollisionSystem::Collision* collision : this->separationCollisionArray)
 			{
-				auto& collision = pair.second;
-				const Vector3& separationDelta = collision->separationDelta;
+				Vector3 separationDelta = collision->separationDelta * this->separationDampingFactor;
 
 				RefHandle handleA = (RefHandle)collision->objectA->GetPhysicsData();
 				RefHandle handleB = (RefHandle)collision->objectB->GetPhysicsData();
@@ -275,17 +578,82 @@ void PhysicsSystem::StepSimulation(double deltaTimeSeconds, CollisionSystem* col
 
 				if (HandleManager::Get()->GetObjectFromHandle(handleA, objectA) && HandleManager::Get()->GetObjectFromHandle(handleB, objectB))
 				{
-					if (!objectA->GetSeparationResolved() && !objectB->GetSeparationResolved())
+					if (objectA->GetSeparationResolved() && !objectB->GetSeparationResolved())
+					{
+						Transform objectToWorld = objectB->GetObjectToWorld();
+						objectB->SetTotalSeparation(-separationDelta + objectA->GetTotalSeparation());
+						objectToWorld.translation += objectB->GetTotalSeparation();
+						objectB->SetObjectToWorld(objectToWorld);
+						objectB->SetSeparationResolved(true);
+						numSeparationsPerformed++;
+					}
+					else if (!objectA->GetSeparationResolved() && objectB->GetSeparationResolved())
 					{
 						Transform objectToWorld = objectA->GetObjectToWorld();
-						objectToWorld.translation += separationDelta / 2.0;
+						objectA->SetTotalSeparation(separationDelta + objectB->GetTotalSeparation());
+						objectToWorld.translation += objectA->GetTotalSeparation();
 						objectA->SetObjectToWorld(objectToWorld);
-						objectToWorld = objectB->GetObjectToWorld();
-						objectToWorld.translation -= separationDelta / 2.0;
-						objectB->SetObjectToWorld(objectToWorld);
+						objectA->SetSeparationResolved(true);
+						numSeparationsPerformed++;
 					}
 				}
 			}
+
+			if (numSeparationsPerformed == 0)
+				break;
+		}
+
+		for (CollisionSystem::Collision* collision : this->separationCollisionArray)
+		{
+			const Vector3& separationDelta = collision->separationDelta;
+
+			RefHandle handleA = (RefHandle)collision->objectA->GetPhysicsData();
+			RefHandle handleB = (RefHandle)collision->objectB->GetPhysicsData();
+
+			Reference<PhysicsObject> objectA, objectB;
+
+			if (HandleManager::Get()->GetObjectFromHandle(handleA, objectA) && HandleManager::Get()->GetObjectFromHandle(handleB, objectB))
+			{
+				if (!objectA->GetSeparationResolved() && !objectB->GetSeparationResolved())
+				{
+					Transform objectToWorld = objectA->GetObjectToWorld();
+					objectToWorld.translation += separationDelta / 2.0;
+					objectA->SetObjectToWorld(objectToWorld);
+					objectToWorld = objectB->GetObjectToWorld();
+					objectToWorld.translation -= separationDelta / 2.0;
+					objectB->SetObjectToWorld(objectToWorld);
+				}
+			}
+		}
+	}
+
+	// Put to sleep whatever has come to rest.
+	{
+		THEBE_PROFILE_BLOCK(SleepIslands);
+
+		this->PutRestingIslandsToSleep();
+	}
+}
+
+void PhysicsSystem::InterpolateRenderTransforms(double alpha)
+{
+	// The objects that took part in the last step are the only ones that can have moved.  Any put to sleep on that step stopped where they are.
+	for (PhysicsObject* physicsObject : this->awakeObjectArray)
+	{
+		Transform objectToWorld = physicsObject->GetObjectToWorld();
+
+		if (alpha >= 1.0 || physicsObject->IsAsleep())
+			physicsObject->renderObjectToWorld = objectToWorld;
+		else
+		{
+			const Transform& previousObjectToWorld = physicsObject->previousObjectToWorld;
+			physicsObject->renderObjectToWorld.translation.Lerp(previousObjectToWorld.translation, objectToWorld.translation, alpha);
+			physicsObject->renderObjectToWorld.matrix.InterpolateOrientations(previousObjectToWorld.matrix, objectToWorld.matrix, alpha);
+
+			// Note that moving the object already put its target space where the object is.
+			CollisionObject* collisionObject = physicsObject->GetCollisionObject();
+			if (collisionObject)
+				collisionObject->UpdateTargetSpace(physicsObject->renderObjectToWorld);
 		}
 	}
 }
@@ -300,11 +668,51 @@ bool PhysicsSystem::GenerateContacts(const CollisionSystem::Collision* collision
 	if (!HandleManager::Get()->GetObjectFromHandle(handleA, objectA) || !HandleManager::Get()->GetObjectFromHandle(handleB, objectB))
 		return false;
 
+	int numManifolds = (int)this->manifoldArray.size();
+
+	if (collision->childCollisionArray.size() == 0)
+		this->GenerateManifold(objectA, objectB, collision->objectA->GetShape(), collision->objectB->GetShape(), collision->separationDelta);
+	else
+	{
+		// Each pair of parts gets a manifold of its own, so that the contacts of one pair don't crowd out those of another.
+		for (const CollisionSystem::Collision::ChildCollision& childCollision : collision->childCollisionArray)
+			this->GenerateManifold(objectA, objectB, childCollision.shapeA, childCollision.shapeB, childCollision.separationDelta);
+	}
+
+	if ((int)this->manifoldArray.size() == numManifolds)
+		return false;
+
+	return dynamic_cast<RigidBody*>(objectA.Get()) && dynamic_cast<RigidBody*>(objectB.Get());
+}
+
+void PhysicsSystem::GenerateManifold(const PhysicsObject* objectA, const PhysicsObject* objectB, const GJKShape* shapeA, const GJKShape* shapeB, const Vector3& separationDelta)
+{
+	// The separation delta found by the narrow-phase points from B to A, and its length is the penetration depth.
+	double penetrationDepth = separationDelta.Length();
+	Vector3 unitNormal;
+	if (penetrationDepth > THEBE_SMALL_EPS)
+		unitNormal = separationDelta / penetrationDepth;
+	else
+	{
+		// The parts are just touching, so fall back on the direction between their centers.
+		unitNormal = shapeA->GetObjectToWorld().TransformPoint(shapeA->CalcGeometricCenter()) - shapeB->GetObjectToWorld().TransformPoint(shapeB->CalcGeometricCenter());
+		if (!unitNormal.Normalize())
+			return;
+	}
+
+	ContactManifold manifold;
+	manifold.shapeA = shapeA;
+	manifold.shapeB = shapeB;
 	for (auto calculator : this->contactCalculatorArray)
-		if (calculator->CalculateContacts(objectA, objectB, this->contactList))
-			return true;
+	{
+		if (calculator->CalculateContacts(objectA, objectB, shapeA, shapeB, unitNormal, penetrationDepth, manifold))
+		{
+			if (manifold.numContacts > 0)
+				this->manifoldArray.push_back(manifold);
 
-	return true;
+			return;
+		}
+	}
 }
 
 bool PhysicsSystem::ResolveContact(Contact& contact)
@@ -316,125 +724,657 @@ bool PhysicsSystem::ResolveContact(Contact& contact)
 	return false;
 }
 
-void PhysicsSystem::ApplyFriction(Contact& contact)
+void PhysicsSystem::IntegrateMotionContinuous(RigidBody* rigidBody, double timeStepSeconds, CollisionSystem* collisionSystem)
 {
-	// This sort-of works, but there also has to be some logic for resisting rotation too, but it's not obvious to me.
-	// For one thing, the contact information I'm generating is probably not sufficient for our needs.
-	// Hmmm...mabye if there are multiple points of contact for the same object, then we would resist rotation central to those points or something; I don't know.
-#if 0
-	auto rigidBodyA = dynamic_cast<RigidBody*>(contact.objectA.Get());
-	auto rigidBodyB = dynamic_cast<RigidBody*>(contact.objectB.Get());
-	if (!(rigidBodyA && rigidBodyB))
+	CollisionObject* collisionObject = rigidBody->GetCollisionObject();
+	GJKShape* shape = collisionObject->GetShape();
+
+	CollisionSystem::SweptMotion motion;
+	motion.startObjectToWorld = collisionObject->GetObjectToWorld();
+	motion.linearDelta = rigidBody->GetLinearVelocity() * timeStepSeconds;
+	Vector3 angularVelocity = rigidBody->GetAngularVelocity();
+	double angularSpeed = 0.0;
+	if (!angularVelocity.Normalize(&angularSpeed))
+	{
+		angularSpeed = 0.0;
+		motion.unitRotationAxis.SetComponents(0.0, 1.0, 0.0);
+	}
+	else
+		motion.unitRotationAxis = angularVelocity;
+	motion.rotationAngle = angularSpeed * timeStepSeconds;
+
+	// Only the part of a surface point's velocity due to rotation that is normal to the surface can bring it closer to anything.
+	// For a body that is nearly round about its center of mass, like a marble, this is nearly zero, however fast it spins.
+	double boundingRadius = rigidBody->GetBoundingRadius();
+	double inscribedRadius = rigidBody->GetInscribedRadius();
+	motion.rotationalRadius = ::sqrt(THEBE_MAX(boundingRadius * boundingRadius - inscribedRadius * inscribedRadius, 0.0));
+	motion.tolerance = (inscribedRadius > 0.0) ? (0.05 * inscribedRadius) : (0.01 * boundingRadius);
+
+	// Note that this also takes care of momentum, whether or not we end up clamping the motion.
+	rigidBody->IntegrateMotionUnconstrained(timeStepSeconds);
+
+	// A body that moves less than half its own thickness in a step can't pass through anything without being caught by the discrete pipeline.
+	double linearDistance = motion.linearDelta.Length();
+	if (linearDistance + motion.rotationAngle * motion.rotationalRadius < 0.5 * THEBE_MAX(inscribedRadius, motion.tolerance))
 		return;
 
-	static double frictionFactor = 50.0;
+	THEBE_PROFILE_BLOCK(ContinuousCollisionDetection);
 
-	if (!rigidBodyA->IsStationary())
-	{
-		Vector3 contactVectorA = contact.surfacePoint - rigidBodyA->GetCenterOfMass();
-		Vector3 velocityA = rigidBodyA->GetLinearVelocity() + rigidBodyA->GetAngularVelocity().Cross(contactVectorA);
-		Vector3 frictionForceA = (-velocityA).RejectedFrom(contact.unitNormal) * frictionFactor;
-		rigidBodyA->AddTransientForce(frictionForceA);
-	}
+	// Only what the body would collide with can stop it.
+	collisionSystem->FindObjectsInBox(motion.CalcSweptBox(boundingRadius), this->sweptObjectArray, CollisionSystem::QueryFilter(collisionObject));
 
-	if (!rigidBodyB->IsStationary())
+	// The shape is moved along the motion while we look for impacts, so put it back the way we found it when we're done.
+	Transform endObjectToWorld = shape->GetObjectToWorld();
+	double firstTimeOfImpact = 1.0;
+	bool impactFound = false;
+	for (CollisionObject* obstacle : this->sweptObjectArray)
 	{
-		//...call function here, same as above...
+		double timeOfImpact = 0.0;
+		Vector3 unitSurfaceNormal;
+		if (CollisionSystem::CalculateTimeOfImpact(shape, motion, obstacle->GetShape(), timeOfImpact, unitSurfaceNormal) && timeOfImpact < firstTimeOfImpact)
+		{
+			firstTimeOfImpact = timeOfImpact;
+			impactFound = true;
+		}
 	}
-#endif
-}
 
-void PhysicsSystem::RegisterWithImGuiManager()
-{
-	ImGuiManager::Get()->RegisterGuiCallback([this]() { this->ShowImGuiPhysicsWindow(); }, this->physicsWindowCookie);
-}
+	shape->SetObjectToWorld(endObjectToWorld);
 
-void PhysicsSystem::EnablePhysicsImGuiWindow(bool enable)
-{
-	ImGuiManager::Get()->EnableGuiCallback(this->physicsWindowCookie, enable);
+	if (!impactFound)
+		return;
+
+	// Carry the body just a little past the point of contact so that the discrete pipeline sees the overlap and resolves it this step.
+	// The rest of the step's motion is simply forfeit; the body will be heading somewhere else once the contact is resolved anyway.
+	double overshoot = (linearDistance > 0.0) ? (2.0 * motion.tolerance / linearDistance) : 0.0;
+	double alpha = THEBE_MIN(firstTimeOfImpact + overshoot, 1.0);
+	collisionObject->SetObjectToWorld(motion.Evaluate(alpha));
 }
 
-bool PhysicsSystem::ShowingPhysicsImGuiWindow()
+/*static*/ uint64_t PhysicsSystem::MakeManifoldKey(const GJKShape* shapeA, const GJKShape* shapeB)
 {
-	return ImGuiManager::Get()->IsGuiCallbackEnabled(this->physicsWindowCookie);
+	// The key doesn't depend on the order of the parts, since the broad-phase may give us the pair either way around from one step to the next.
+	uint64_t keyA = (uint64_t)shapeA;
+	uint64_t keyB = (uint64_t)shapeB;
+	if (keyA > keyB)
+		std::swap(keyA, keyB);
+
+	return (keyA * 0x9E3779B97F4A7C15ull) ^ keyB;
 }
 
-void PhysicsSystem::ShowImGuiPhysicsWindow()
+int PhysicsSystem::GetSolverBody(RigidBody* rigidBody)
 {
-	ImGui::SetNextWindowSize(ImVec2(600, 200), ImGuiCond_FirstUseEver);
-
-	if (ImGui::Begin("Physics Parameters"))
-	{
-		static double gravityMin = -50.0;
-		static double gravityMax = 0.0;
-		ImGui::SliderScalarN("Gravity", ImGuiDataType_Double, &this->accelerationDueToGravity.x, 3, &gravityMin, &gravityMax);
+	auto pair = this->solverBodyMap.find(rigidBody);
+	if (pair != this->solverBodyMap.end())
+		return pair->second;
 
-		static double minSepDampFactor = 0.01;
-		static double maxSepDampFactor = 1.0;
-		ImGui::SliderScalarN("Sep. Damp. Factor", ImGuiDataType_Double, &this->separationDampingFactor, 1, &minSepDampFactor, &maxSepDampFactor);
+	SolverBody solverBody;
+	solverBody.rigidBody = rigidBody;
+	solverBody.linearImpulse.SetComponents(0.0, 0.0, 0.0);
+	solverBody.angularImpulse.SetComponents(0.0, 0.0, 0.0);
 
-		static double minCoefRest = 0.0;
-		static double maxCoefRest = 1.0;
-		ImGui::SliderScalarN("Coef. Rest.", ImGuiDataType_Double, &this->coeficientOfRestitution, 1, &minCoefRest, &maxCoefRest);
+	// A sleeping body can only be here if waking bodies on contact gave up early.  It belongs to no island, so it must not be written.
+	if (rigidBody->IsStationary() || rigidBody->IsFrozen() || rigidBody->IsAsleep() || rigidBody->GetTotalMass() == 0.0)
+	{
+		solverBody.linearVelocity.SetComponents(0.0, 0.0, 0.0);
+		solverBody.angularVelocity.SetComponents(0.0, 0.0, 0.0);
+		solverBody.inverseMass = 0.0;
+		solverBody.worldSpaceInertiaTensorInverse.SetUniformScale(0.0);
+	}
+	else
+	{
+		solverBody.linearVelocity = rigidBody->GetLinearVelocity();
+		solverBody.angularVelocity = rigidBody->GetAngularVelocity();
+		solverBody.inverseMass = 1.0 / rigidBody->GetTotalMass();
+		rigidBody->GetWorldSpaceInertiaTensorInverse(solverBody.worldSpaceInertiaTensorInverse);
 	}
 
-	ImGui::End();
+	int i = (int)this->solverBodyArray.size();
+	this->solverBodyArray.push_back(solverBody);
+	this->solverBodyMap.insert(std::pair(rigidBody, i));
+	return i;
 }
 
-//------------------------------ PhysicsSystem::ContactResolver<RigidBody, RigidBody> ------------------------------
-
-/*virtual*/ bool PhysicsSystem::ContactResolver<RigidBody, RigidBody>::ResolveContact(Contact& contact, PhysicsSystem* physicsSystem)
+int PhysicsSystem::WarmStartManifold(ContactManifold& manifold)
 {
-	auto rigidBodyA = dynamic_cast<RigidBody*>(contact.objectA.Get());
-	auto rigidBodyB = dynamic_cast<RigidBody*>(contact.objectB.Get());
-	if (!(rigidBodyA && rigidBodyB))
-		return false;
-	
-	Vector3 contactVectorA = contact.surfacePoint - rigidBodyA->GetCenterOfMass();
-	Vector3 contactVectorB = contact.surfacePoint - rigidBodyB->GetCenterOfMass();
+	auto pair = this->previousManifoldMap.find(MakeManifoldKey(manifold.shapeA, manifold.shapeB));
+	if (pair == this->previousManifoldMap.end())
+		return 0;
 
-	Vector3 velocityA = rigidBodyA->GetLinearVelocity() + rigidBodyA->GetAngularVelocity().Cross(contactVectorA);
-	Vector3 velocityB = rigidBodyB->GetLinearVelocity() + rigidBodyB->GetAngularVelocity().Cross(contactVectorB);
+	const ContactManifold& previousManifold = this->previousManifoldArray[pair->second];
 
-	double relativeVelocity = contact.unitNormal.Dot(velocityA - velocityB);
-	if (relativeVelocity >= 0.0)
-		return false;
+	// The impulses we keep are those applied to object A, so they change sign if the objects have swapped places.
+	double sign = 0.0;
+	if (previousManifold.shapeA == manifold.shapeA && previousManifold.shapeB == manifold.shapeB)
+		sign = 1.0;
+	else if (previousManifold.shapeA == manifold.shapeB && previousManifold.shapeB == manifold.shapeA)
+		sign = -1.0;
+	else
+		return 0;	// The keys of two different pairs of parts happened to collide.
 
-	Matrix3x3 worldSpaceInertiaTensorInverseA, worldSpaceInertiaTensorInverseB;
+	int numWarmStarted = 0;
+	double matchDistanceSquared = this->contactMatchDistance * this->contactMatchDistance;
 
-	rigidBodyA->GetWorldSpaceInertiaTensorInverse(worldSpaceInertiaTensorInverseA);
-	rigidBodyB->GetWorldSpaceInertiaTensorInverse(worldSpaceInertiaTensorInverseB);
+	for (int i = 0; i < manifold.numContacts; i++)
+	{
+		Contact& contact = manifold.contactArray[i];
 
-	double denomPartA = 0.0;
-	double denomPartB = 0.0;
+		const Contact* nearestContact = nullptr;
+		double nearestDistanceSquared = matchDistanceSquared;
+		for (int j = 0; j < previousManifold.numContacts; j++)
+		{
+			const Contact& previousContact = previousManifold.contactArray[j];
+			double distanceSquared = (contact.surfacePoint - previousContact.surfacePoint).SquareLength();
+			if (distanceSquared < nearestDistanceSquared)
+			{
+				nearestDistanceSquared = distanceSquared;
+				nearestContact = &previousContact;
+			}
+		}
 
-	if (!rigidBodyA->IsStationary())
-		denomPartA = (worldSpaceInertiaTensorInverseA * contactVectorA.Cross(contact.unitNormal)).Cross(contactVectorA).Dot(contact.unitNormal) + 1.0 / rigidBodyA->GetTotalMass();
+		if (nearestContact)
+		{
+			contact.normalImpulse = nearestContact->normalImpulse;
+			contact.tangentImpulse = nearestContact->tangentImpulse * sign;
+			numWarmStarted++;
+		}
+	}
 
-	if (!rigidBodyB->IsStationary())
-		denomPartB = (worldSpaceInertiaTensorInverseB * contactVectorB.Cross(contact.unitNormal)).Cross(contactVectorB).Dot(contact.unitNormal) + 1.0 / rigidBodyB->GetTotalMass();
+	return numWarmStarted;
+}
 
-	double denominator = denomPartA + denomPartB;
-	THEBE_ASSERT(denominator != 0.0);
+void PhysicsSystem::PrepareContactSolver(double timeStepSeconds)
+{
+	this->solverBodyArray.clear();
+	this->solverBodyMap.clear();
+	this->unsortedConstraintArray.clear();
+	this->resolverContactArray.clear();
 
-	double coeficientOfRestitution = physicsSystem->GetCoeficientOfRestituation();
-	double impulseMagnitude = -(1.0 + coeficientOfRestitution) * relativeVelocity / denominator;
+	this->previousManifoldMap.clear();
+	for (int i = 0; i < (int)this->previousManifoldArray.size(); i++)
+		this->previousManifoldMap.insert(std::pair(MakeManifoldKey(this->previousManifoldArray[i].shapeA, this->previousManifoldArray[i].shapeB), i));
 
-	Vector3 impulse = impulseMagnitude * contact.unitNormal;
+	this->contactSolverStats.numWarmStarted = 0;
 
-	Vector3 impulseForceA = impulse;
-	Vector3 impulseForceB = -impulse;
+	// Constraints between bodies that can't move go in an extra island at the end.  They're of no consequence, but they're harmless.
+	int numIslands = this->islandStats.numIslands;
+	this->islandConstraintOffsetArray.assign(numIslands + 2, 0);
 
-	rigidBodyA->SetLinearMomentum(rigidBodyA->GetLinearMomentum() + impulseForceA);
-	rigidBodyB->SetLinearMomentum(rigidBodyB->GetLinearMomentum() + impulseForceB);
+	for (ContactManifold& manifold : this->manifoldArray)
+	{
+		if (manifold.numContacts == 0)
+			continue;
 
-	Vector3 impulseTorqueA = (contact.surfacePoint - rigidBodyA->GetCenterOfMass()).Cross(impulseForceA);
-	Vector3 impulseTorqueB = (contact.surfacePoint - rigidBodyB->GetCenterOfMass()).Cross(impulseForceB);
+		auto rigidBodyA = dynamic_cast<RigidBody*>(manifold.contactArray[0].objectA.Get());
+		auto rigidBodyB = dynamic_cast<RigidBody*>(manifold.contactArray[0].objectB.Get());
+		if (!(rigidBodyA && rigidBodyB))
+		{
+			for (int i = 0; i < manifold.numContacts; i++)
+				if (manifold.contactArray[i].penetrationDepth >= 0.0)
+					this->resolverContactArray.push_back(&manifold.contactArray[i]);
 
-	rigidBodyA->SetAngularMomentum(rigidBodyA->GetAngularMomentum() + impulseTorqueA);
-	rigidBodyB->SetAngularMomentum(rigidBodyB->GetAngularMomentum() + impulseTorqueB);
+			continue;
+		}
 
-	return true;
+		this->contactSolverStats.numWarmStarted += this->WarmStartManifold(manifold);
+
+		int bodyA = this->GetSolverBody(rigidBodyA);
+		int bodyB = this->GetSolverBody(rigidBodyB);
+
+		int island = this->GetObjectIsland(rigidBodyA);
+		if (island < 0)
+			island = this->GetObjectIsland(rigidBodyB);
+		if (island < 0)
+			island = numIslands;
+
+		for (int i = 0; i < manifold.numContacts; i++)
+		{
+			ContactConstraint constraint;
+			constraint.contact = &manifold.contactArray[i];
+			constraint.bodyA = bodyA;
+			constraint.bodyB = bodyB;
+			constraint.island = island;
+			this->unsortedConstraintArray.push_back(constraint);
+		}
+
+		this->islandConstraintOffsetArray[island + 1] += manifold.numContacts;
+	}
+
+	// Sort the constraints by island, keeping them in the order they were made within each island, so that each island's constraints are contiguous.
+	for (int i = 0; i <= numIslands; i++)
+		this->islandConstraintOffsetArray[i + 1] += this->islandConstraintOffsetArray[i];
+
+	this->contactConstraintArray.resize(this->unsortedConstraintArray.size());
+	this->islandConstraintCursorArray.assign(this->islandConstraintOffsetArray.begin(), this->islandConstraintOffsetArray.end() - 1);
+	for (const ContactConstraint& constraint : this->unsortedConstraintArray)
+		this->contactConstraintArray[this->islandConstraintCursorArray[constraint.island]++] = constraint;
+
+	// The rest of the work for each constraint only depends on the constraint, so it's done across threads.
+	this->ParallelFor((int)this->contactConstraintArray.size(), 64, [this, timeStepSeconds](int beginIndex, int endIndex, int threadIndex)
+		{
+			for (int i = beginIndex; i < endIndex; i++)
+				this->PrepareContactConstraint(this->contactConstraintArray[i], timeStepSeconds);
+		});
+
+	this->contactSolverStats.numBodies = (int)this->solverBodyArray.size();
+	this->contactSolverStats.numConstraints = (int)this->contactConstraintArray.size();
+	this->contactSolverStats.numIslands = 0;
+	for (int i = 0; i <= numIslands; i++)
+		if (this->islandConstraintOffsetArray[i + 1] > this->islandConstraintOffsetArray[i])
+			this->contactSolverStats.numIslands++;
+}
+
+void PhysicsSystem::PrepareContactConstraint(ContactConstraint& constraint, double timeStepSeconds) const
+{
+	const Contact& contact = *constraint.contact;
+	const SolverBody& solverBodyA = this->solverBodyArray[constraint.bodyA];
+	const SolverBody& solverBodyB = this->solverBodyArray[constraint.bodyB];
+
+	constraint.contactVectorA = contact.surfacePoint - solverBodyA.rigidBody->GetCenterOfMass();
+	constraint.contactVectorB = contact.surfacePoint - solverBodyB.rigidBody->GetCenterOfMass();
+	constraint.frictionCoeficient = this->coeficientOfFriction;
+
+	// This is the change in the relative velocity at the contact point due to a unit impulse in the given direction.
+	auto calcVelocityChange = [&solverBodyA, &solverBodyB, &constraint](const Vector3& unitDirection) -> Vector3
+		{
+			Vector3 angularA = (solverBodyA.worldSpaceInertiaTensorInverse * constraint.contactVectorA.Cross(unitDirection)).Cross(constraint.contactVectorA);
+			Vector3 angularB = (solverBodyB.worldSpaceInertiaTensorInverse * constraint.contactVectorB.Cross(unitDirection)).Cross(constraint.contactVectorB);
+			return unitDirection * (solverBodyA.inverseMass + solverBodyB.inverseMass) + angularA + angularB;
+		};
+
+	// The tangent basis only depends on the normal, so that it's the same from one step to the next for a resting contact.
+	constraint.unitTangent[0].SetAsOrthogonalTo(contact.unitNormal);
+	constraint.unitTangent[0].Normalize();
+	constraint.unitTangent[1] = contact.unitNormal.Cross(constraint.unitTangent[0]);
+
+	double inverseNormalMass = contact.unitNormal.Dot(calcVelocityChange(contact.unitNormal));
+	constraint.normalMass = (inverseNormalMass > 0.0) ? (1.0 / inverseNormalMass) : 0.0;
+
+	Matrix2x2 inverseTangentMass;
+	for (int j = 0; j < 2; j++)
+	{
+		Vector3 velocityChange = calcVelocityChange(constraint.unitTangent[j]);
+		for (int k = 0; k < 2; k++)
+			inverseTangentMass.ele[k][j] = constraint.unitTangent[k].Dot(velocityChange);
+	}
+
+	if (!constraint.tangentMass.Invert(inverseTangentMass))
+		constraint.tangentMass *= 0.0;
+
+	// Bounce only off of contacts that are approaching fast enough.  Bouncing off of resting contacts would keep stacks from ever settling.
+	Vector3 velocityA = solverBodyA.linearVelocity + solverBodyA.angularVelocity.Cross(constraint.contactVectorA);
+	Vector3 velocityB = solverBodyB.linearVelocity + solverBodyB.angularVelocity.Cross(constraint.contactVectorB);
+	double normalSpeed = contact.unitNormal.Dot(velocityA - velocityB);
+	constraint.velocityBias = (normalSpeed < -this->restitutionSpeedThreshold) ? (-this->coeficientOfRestitution * normalSpeed) : 0.0;
+
+	// Also push the bodies apart a little at each point in proportion to how deep it is.  The separation pass moves whole bodies,
+	// so it can't straighten out a body that has tipped into another, but this can, since it pushes harder where the overlap is deeper.
+	// A point that isn't touching yet may close the gap, but no more, within the step.
+	if (contact.penetrationDepth < 0.0)
+		constraint.velocityBias = contact.penetrationDepth / timeStepSeconds;
+	else
+		constraint.velocityBias = THEBE_MAX(constraint.velocityBias, this->contactBiasFactor * THEBE_MAX(contact.penetrationDepth - this->contactSlop, 0.0) / timeStepSeconds);
+
+	constraint.normalImpulse = contact.normalImpulse;
+	constraint.tangentImpulse.SetComponents(contact.tangentImpulse.Dot(constraint.unitTangent[0]), contact.tangentImpulse.Dot(constraint.unitTangent[1]));
+}
+
+/*static*/ void PhysicsSystem::ApplySolverImpulse(SolverBody& solverBody, const Vector3& impulse, const Vector3& contactVector)
+{
+	// Bodies that can't move are shared between islands, so they mustn't be written, even with no change.
+	if (solverBody.inverseMass == 0.0)
+		return;
+
+	Vector3 angularImpulse = contactVector.Cross(impulse);
+
+	solverBody.linearVelocity += impulse * solverBody.inverseMass;
+	solverBody.angularVelocity += solverBody.worldSpaceInertiaTensorInverse * angularImpulse;
+	solverBody.linearImpulse += impulse;
+	solverBody.angularImpulse += angularImpulse;
+}
+
+void PhysicsSystem::WarmStartContactSolver(int beginIndex, int endIndex)
+{
+	for (int i = beginIndex; i < endIndex; i++)
+	{
+		const ContactConstraint& constraint = this->contactConstraintArray[i];
+
+		Vector3 impulse =
+			constraint.contact->unitNormal * constraint.normalImpulse +
+			constraint.unitTangent[0] * constraint.tangentImpulse.x +
+			constraint.unitTangent[1] * constraint.tangentImpulse.y;
+
+		ApplySolverImpulse(this->solverBodyArray[constraint.bodyA], impulse, constraint.contactVectorA);
+		ApplySolverImpulse(this->solverBodyArray[constraint.bodyB], -impulse, constraint.contactVectorB);
+	}
+}
+
+void PhysicsSystem::SolveContactVelocities(int beginIndex, int endIndex, bool backward)
+{
+	for (int j = beginIndex; j < endIndex; j++)
+	{
+		ContactConstraint& constraint = this->contactConstraintArray[backward ? (beginIndex + endIndex - 1 - j) : j];
+		SolverBody& solverBodyA = this->solverBodyArray[constraint.bodyA];
+		SolverBody& solverBodyB = this->solverBodyArray[constraint.bodyB];
+		const Vector3& unitNormal = constraint.contact->unitNormal;
+
+		// Friction goes first, because its bound depends on the normal impulse, and the normal constraint matters more, so it should have the last word.
+		Vector3 relativeVelocity =
+			(solverBodyA.linearVelocity + solverBodyA.angularVelocity.Cross(constraint.contactVectorA)) -
+			(solverBodyB.linearVelocity + solverBodyB.angularVelocity.Cross(constraint.contactVectorB));
+
+		Vector2 tangentSpeed(relativeVelocity.Dot(constraint.unitTangent[0]), relativeVelocity.Dot(constraint.unitTangent[1]));
+		Vector2 oldTangentImpulse = constraint.tangentImpulse;
+		constraint.tangentImpulse -= constraint.tangentMass * tangentSpeed;
+
+		// Clamp the total friction impulse to the cone, rather than each direction to a box, so that friction doesn't depend on how the tangents happen to lie.
+		double maxTangentImpulse = constraint.frictionCoeficient * constraint.normalImpulse;
+		double tangentImpulseSquared = constraint.tangentImpulse.Dot(constraint.tangentImpulse);
+		if (tangentImpulseSquared > maxTangentImpulse * maxTangentImpulse)
+			constraint.tangentImpulse *= maxTangentImpulse / ::sqrt(tangentImpulseSquared);
+
+		Vector2 tangentImpulseDelta = constraint.tangentImpulse - oldTangentImpulse;
+		Vector3 impulse = constraint.unitTangent[0] * tangentImpulseDelta.x + constraint.unitTangent[1] * tangentImpulseDelta.y;
+
+		relativeVelocity =
+			(solverBodyA.linearVelocity + solverBodyA.angularVelocity.Cross(constraint.contactVectorA)) -
+			(solverBodyB.linearVelocity + solverBodyB.angularVelocity.Cross(constraint.contactVectorB));
+
+		// Account for the friction impulse in the relative velocity without applying it twice.
+		relativeVelocity += impulse * (solverBodyA.inverseMass + solverBodyB.inverseMass) +
+			(solverBodyA.worldSpaceInertiaTensorInverse * constraint.contactVectorA.Cross(impulse)).Cross(constraint.contactVectorA) +
+			(solverBodyB.worldSpaceInertiaTensorInverse * constraint.contactVectorB.Cross(impulse)).Cross(constraint.contactVectorB);
+
+		// The total normal impulse may only ever push the bodies apart, so it's clamped at zero, but a single pass may still take some of it back.
+		double oldNormalImpulse = constraint.normalImpulse;
+		double normalSpeed = unitNormal.Dot(relativeVelocity);
+		constraint.normalImpulse = THEBE_MAX(oldNormalImpulse - constraint.normalMass * (normalSpeed - constraint.velocityBias), 0.0);
+		impulse += unitNormal * (constraint.normalImpulse - oldNormalImpulse);
+
+		ApplySolverImpulse(solverBodyA, impulse, constraint.contactVectorA);
+		ApplySolverImpulse(solverBodyB, -impulse, constraint.contactVectorB);
+	}
+}
+
+void PhysicsSystem::SolveIsland(int island)
+{
+	int beginIndex = this->islandConstraintOffsetArray[island];
+	int endIndex = this->islandConstraintOffsetArray[island + 1];
+	if (beginIndex == endIndex)
+		return;
+
+	this->WarmStartContactSolver(beginIndex, endIndex);
+
+	// Sweeping back and forth, rather than always the same way, keeps the order of the contacts from favoring one side of a pile over another.
+	for (int i = 0; i < this->contactSolverIterations; i++)
+		this->SolveContactVelocities(beginIndex, endIndex, i % 2 == 1);
+}
+
+void PhysicsSystem::FinishContactSolver()
+{
+	// Each solver body is a different rigid body, so the momenta can be updated across threads.
+	this->ParallelFor((int)this->solverBodyArray.size(), 64, [this](int beginIndex, int endIndex, int threadIndex)
+		{
+			for (int i = beginIndex; i < endIndex; i++)
+			{
+				const SolverBody& solverBody = this->solverBodyArray[i];
+				if (solverBody.inverseMass == 0.0)
+					continue;
+
+				solverBody.rigidBody->SetLinearMomentum(solverBody.rigidBody->GetLinearMomentum() + solverBody.linearImpulse);
+				solverBody.rigidBody->SetAngularMomentum(solverBody.rigidBody->GetAngularMomentum() + solverBody.angularImpulse);
+			}
+		});
+
+	for (const ContactConstraint& constraint : this->contactConstraintArray)
+	{
+		constraint.contact->normalImpulse = constraint.normalImpulse;
+		constraint.contact->tangentImpulse = constraint.unitTangent[0] * constraint.tangentImpulse.x + constraint.unitTangent[1] * constraint.tangentImpulse.y;
+	}
+}
+
+bool PhysicsSystem::WakeTouchedIslands()
+{
+	bool wokeSomething = false;
+
+	for (auto& collision : this->collisionArray)
+	{
+		RefHandle handleA = (RefHandle)collision->objectA->GetPhysicsData();
+		RefHandle handleB = (RefHandle)collision->objectB->GetPhysicsData();
+
+		Reference<PhysicsObject> objectA, objectB;
+		if (!HandleManager::Get()->GetObjectFromHandle(handleA, objectA) || !HandleManager::Get()->GetObjectFromHandle(handleB, objectB))
+			continue;
+
+		// The broad phase only gives us pairs with at least one awake object that can move.
+		if (objectA->IsAsleep() && !objectA->IsStationary() && !objectA->IsFrozen())
+		{
+			this->WakeObject(objectA);
+			wokeSomething = true;
+		}
+		else if (objectB->IsAsleep() && !objectB->IsStationary() && !objectB->IsFrozen())
+		{
+			this->WakeObject(objectB);
+			wokeSomething = true;
+		}
+	}
+
+	return wokeSomething;
+}
+
+int PhysicsSystem::FindIslandRoot(int i)
+{
+	while (this->islandParentArray[i] != i)
+	{
+		this->islandParentArray[i] = this->islandParentArray[this->islandParentArray[i]];
+		i = this->islandParentArray[i];
+	}
+
+	return i;
+}
+
+void PhysicsSystem::BuildIslands()
+{
+	// Each awake object that can move starts out in an island of its own.  This includes objects woken up
+	// part-way through this step, since they were added to the awake array as they were woken.
+	this->islandIndexMap.clear();
+	this->islandObjectArray.clear();
+	this->islandParentArray.clear();
+
+	auto addObject = [this](PhysicsObject* physicsObject) -> int
+	{
+		if (physicsObject->IsStationary() || physicsObject->IsFrozen() || physicsObject->IsAsleep())
+			return -1;
+
+		auto pair = this->islandIndexMap.find(physicsObject);
+		if (pair != this->islandIndexMap.end())
+			return pair->second;
+
+		int i = (int)this->islandParentArray.size();
+		this->islandParentArray.push_back(i);
+		this->islandObjectArray.push_back(physicsObject);
+		this->islandIndexMap.insert(std::pair(physicsObject, i));
+		return i;
+	};
+
+	for (PhysicsObject* physicsObject : this->awakeObjectArray)
+		addObject(physicsObject);
+
+	// Objects in contact are in the same island.  Stationary objects don't join islands together,
+	// or everything resting on the ground would be one big island.  Unions always keep the lesser
+	// root, so that the islands come out the same from one run to the next.
+	for (auto& collision : this->collisionArray)
+	{
+		RefHandle handleA = (RefHandle)collision->objectA->GetPhysicsData();
+		RefHandle handleB = (RefHandle)collision->objectB->GetPhysicsData();
+
+		Reference<PhysicsObject> objectA, objectB;
+		if (!HandleManager::Get()->GetObjectFromHandle(handleA, objectA) || !HandleManager::Get()->GetObjectFromHandle(handleB, objectB))
+			continue;
+
+		int i = addObject(objectA);
+		int j = addObject(objectB);
+		if (i < 0 || j < 0)
+			continue;
+
+		int rootA = this->FindIslandRoot(i);
+		int rootB = this->FindIslandRoot(j);
+		if (rootA < rootB)
+			this->islandParentArray[rootB] = rootA;
+		else if (rootB < rootA)
+			this->islandParentArray[rootA] = rootB;
+	}
+
+	// The root of each island is its lowest-numbered object, so numbering the islands as their roots come up numbers them in that order.
+	int numObjects = (int)this->islandParentArray.size();
+	this->objectIslandArray.resize(numObjects);
+	this->islandStats.numIslands = 0;
+	for (int i = 0; i < numObjects; i++)
+	{
+		int root = this->FindIslandRoot(i);
+		if (root == i)
+			this->objectIslandArray[i] = this->islandStats.numIslands++;
+		else
+			this->objectIslandArray[i] = this->objectIslandArray[root];
+	}
+}
+
+int PhysicsSystem::GetObjectIsland(PhysicsObject* physicsObject) const
+{
+	auto pair = this->islandIndexMap.find(physicsObject);
+	if (pair == this->islandIndexMap.end())
+		return -1;
+
+	return this->objectIslandArray[pair->second];
+}
+
+void PhysicsSystem::PutRestingIslandsToSleep()
+{
+	int numObjects = (int)this->islandObjectArray.size();
+	int numIslands = this->islandStats.numIslands;
+
+	this->islandEnergyArray.assign(numIslands, 0.0);
+	this->islandMassArray.assign(numIslands, 0.0);
+	this->islandCalmStepCountArray.assign(numIslands, INT_MAX);
+	this->islandNumberArray.assign(numIslands, 0);
+
+	for (int i = 0; i < numObjects; i++)
+	{
+		int island = this->objectIslandArray[i];
+		this->islandEnergyArray[island] += this->islandObjectArray[i]->GetKineticEnergy();
+		this->islandMassArray[island] += this->islandObjectArray[i]->GetTotalMass();
+	}
+
+	// An island is at rest when its kinetic energy per unit of mass is small enough.  That measure
+	// doesn't care how big or heavy the objects are, just how fast they're going.  It takes the whole
+	// island being at rest for a while for any of it to sleep, lest we freeze a box mid-topple.
+	for (int i = 0; i < numObjects; i++)
+	{
+		PhysicsObject* physicsObject = this->islandObjectArray[i];
+		int island = this->objectIslandArray[i];
+
+		if (this->islandEnergyArray[island] <= this->sleepEnergyThreshold * this->islandMassArray[island])
+			physicsObject->calmStepCount++;
+		else
+			physicsObject->calmStepCount = 0;
+
+		this->islandCalmStepCountArray[island] = THEBE_MIN(this->islandCalmStepCountArray[island], physicsObject->calmStepCount);
+	}
+
+	if (!this->sleepEnabled)
+		return;
+
+	for (int i = 0; i < numObjects; i++)
+	{
+		int island = this->objectIslandArray[i];
+		if (this->islandCalmStepCountArray[island] < this->sleepStepCount)
+			continue;
+
+		uint32_t& islandNumber = this->islandNumberArray[island];
+		if (islandNumber == 0)
+		{
+			islandNumber = this->nextSleepingIslandNumber++;
+			if (this->nextSleepingIslandNumber == 0)
+				this->nextSleepingIslandNumber = 1;
+		}
+
+		PhysicsObject* physicsObject = this->islandObjectArray[i];
+		physicsObject->ZeroMomentum();
+		physicsObject->asleep = true;
+		physicsObject->calmStepCount = 0;
+		physicsObject->sleepingIslandNumber = islandNumber;
+		physicsObject->SetSeparationResolved(true);
+		physicsObject->UpdateAtRest();
+		this->sleepingIslandMap[islandNumber].push_back(physicsObject->GetHandle());
+
+		this->islandStats.numAwakeObjects--;
+		this->islandStats.numSleepingObjects++;
+	}
+
+	this->islandStats.numSleepingIslands = (int)this->sleepingIslandMap.size();
+}
+
+void PhysicsSystem::RegisterWithImGuiManager()
+{
+	ImGuiManager::Get()->RegisterGuiCallback([this]() { this->ShowImGuiPhysicsWindow(); }, this->physicsWindowCookie);
+}
+
+void PhysicsSystem::EnablePhysicsImGuiWindow(bool enable)
+{
+	ImGuiManager::Get()->EnableGuiCallback(this->physicsWindowCookie, enable);
+}
+
+bool PhysicsSystem::ShowingPhysicsImGuiWindow()
+{
+	return ImGuiManager::Get()->IsGuiCallbackEnabled(this->physicsWindowCookie);
+}
+
+void PhysicsSystem::ShowImGuiPhysicsWindow()
+{
+	ImGui::SetNextWindowSize(ImVec2(600, 320), ImGuiCond_FirstUseEver);
+
+	if (ImGui::Begin("Physics Parameters"))
+	{
+		static double gravityMin = -50.0;
+		static double gravityMax = 0.0;
+		ImGui::SliderScalarN("Gravity", ImGuiDataType_Double, &this->accelerationDueToGravity.x, 3, &gravityMin, &gravityMax);
+
+		static double minSepDampFactor = 0.01;
+		static double maxSepDampFactor = 1.0;
+		ImGui::SliderScalarN("Sep. Damp. Factor", ImGuiDataType_Double, &this->separationDampingFactor, 1, &minSepDampFactor, &maxSepDampFactor);
+
+		static double minCoefRest = 0.0;
+		static double maxCoefRest = 1.0;
+		ImGui::SliderScalarN("Coef. Rest.", ImGuiDataType_Double, &this->coeficientOfRestitution, 1, &minCoefRest, &maxCoefRest);
+
+		static double minCoefFriction = 0.0;
+		static double maxCoefFriction = 2.0;
+		ImGui::SliderScalarN("Coef. Friction", ImGuiDataType_Double, &this->coeficientOfFriction, 1, &minCoefFriction, &maxCoefFriction);
+
+		ImGui::SliderInt("Solver Iterations", &this->contactSolverIterations, 1, 64);
+
+		int threadCount = this->GetThreadCount();
+		if (ImGui::SliderInt("Threads", &threadCount, 1, THEBE_MAX(int(std::thread::hardware_concurrency()), 1)))
+			this->SetThreadCount(threadCount);
+
+		const ContactSolverStats& stats = this->contactSolverStats;
+		double iterationTimeMicroseconds = (stats.numIterations > 0) ? (1000.0 * stats.solveTimeMilliseconds / double(stats.numIterations)) : 0.0;
+		ImGui::Text("Solver: %d bodies, %d contacts (%d warm-started) in %d islands on %d threads", stats.numBodies, stats.numConstraints, stats.numWarmStarted, stats.numIslands, this->GetThreadCount());
+		ImGui::Text("Solver: %.3f ms to prepare, %.2f us per iteration", stats.prepareTimeMilliseconds, iterationTimeMicroseconds);
+
+		bool sleepEnabled = this->sleepEnabled;
+		if (ImGui::Checkbox("Sleep", &sleepEnabled))
+			this->SetSleepEnabled(sleepEnabled);
+
+		const IslandStats& islandStats = this->islandStats;
+		ImGui::Text("Islands: %d awake objects in %d islands, %d sleeping objects in %d islands", islandStats.numAwakeObjects, islandStats.numIslands, islandStats.numSleepingObjects, islandStats.numSleepingIslands);
+
+		if (this->fixedTimeStepSeconds > 0.0)
+			ImGui::Text("Fixed step: %.2f ms, %d steps last frame, %.2f of a step left over", this->fixedTimeStepSeconds * 1000.0, this->numStepsLastFrame, this->timeAccumulatorSeconds / this->fixedTimeStepSeconds);
+		else
+			ImGui::Text("Variable step: %d steps last frame", this->numStepsLastFrame);
+	}
+
+	ImGui::End();
 }
 
 //------------------------------ PhysicsSystem::ContactResolver<RigidBody, FloppyBody> ------------------------------
@@ -491,12 +1431,49 @@ void PhysicsSystem::ShowImGuiPhysicsWindow()
 	return false;
 }
 
+//------------------------------ PhysicsSystem::Contact ------------------------------
+
+PhysicsSystem::Contact::Contact()
+{
+	this->penetrationDepth = 0.0;
+	this->normalImpulse = 0.0;
+}
+
+//------------------------------ PhysicsSystem::ContactManifold ------------------------------
+
+PhysicsSystem::ContactManifold::ContactManifold()
+{
+	this->numContacts = 0;
+	this->shapeA = nullptr;
+	this->shapeB = nullptr;
+}
+
+void PhysicsSystem::ContactManifold::Clear()
+{
+	for (int i = 0; i < this->numContacts; i++)
+	{
+		this->contactArray[i].objectA.Reset();
+		this->contactArray[i].objectB.Reset();
+	}
+
+	this->numContacts = 0;
+}
+
+bool PhysicsSystem::ContactManifold::AddContact(const Contact& contact)
+{
+	if (this->numContacts >= THEBE_MAX_MANIFOLD_CONTACTS)
+		return false;
+
+	this->contactArray[this->numContacts++] = contact;
+	return true;
+}
+
 //------------------------------ PhysicsSystem::ContactCalculatorInterface ------------------------------
 
-/*static*/ void PhysicsSystem::ContactCalculatorInterface::FlipContactNormals(std::list<Contact>& contactList)
+/*static*/ void PhysicsSystem::ContactCalculatorInterface::FlipContactNormals(ContactManifold& manifold)
 {
-	for (auto& contact : contactList)
-		contact.unitNormal = -contact.unitNormal;
+	for (int i = 0; i < manifold.numContacts; i++)
+		manifold.contactArray[i].unitNormal = -manifold.contactArray[i].unitNormal;
 }
 
 //------------------------------ PhysicsSystem::ContactCalculator<GJKConvexHull, GJKConvexHull> ------------------------------
@@ -504,104 +1481,461 @@ void PhysicsSystem::ShowImGuiPhysicsWindow()
 /*virtual*/ bool PhysicsSystem::ContactCalculator<GJKConvexHull, GJKConvexHull>::CalculateContacts(
 												const PhysicsObject* objectA,
 												const PhysicsObject* objectB,
-												std::list<Contact>& contactList)
+												const GJKShape* shapeA,
+												const GJKShape* shapeB,
+												const Vector3& unitNormal,
+												double penetrationDepth,
+												ContactManifold& manifold)
 {
-	// Note that here we have the advantage of knowing that the shapes in question
-	// already intersect one another by the GJK algorithm.  Our job here is just to
-	// determine all the vertex/face and edge/edge contacts.
+	thread_local WorldHull hullA, hullB;
+	if (!MakeWorldHull(objectA->GetCollisionObject(), shapeA, hullA) || !MakeWorldHull(objectB->GetCollisionObject(), shapeB, hullB))
+		return false;
+
+	manifold.Clear();
+
+	Contact contact;
+	contact.objectA = const_cast<PhysicsObject*>(objectA);
+	contact.objectB = const_cast<PhysicsObject*>(objectB);
+
+	// The face of B best facing A and the face of A best facing B are our two candidates for the reference face.
+	Plane worldPlaneA, worldPlaneB;
+	double dotA = 0.0, dotB = 0.0;
+	int faceA = FindFaceMostAlignedWith(hullA, -unitNormal, worldPlaneA, dotA);
+	int faceB = FindFaceMostAlignedWith(hullB, unitNormal, worldPlaneB, dotB);
+	if (faceA < 0 || faceB < 0)
+		return true;
+
+	// If neither face is well aligned with the normal, then the hulls must be meeting edge-to-edge.
+	constexpr double minFaceAlignment = 0.95;
+	if (THEBE_MAX(dotA, dotB) < minFaceAlignment)
+	{
+		LineSegment supportEdgeA, supportEdgeB, shortestConnector;
+		if (!FindSupportEdge(hullA, -unitNormal, supportEdgeA) ||
+			!FindSupportEdge(hullB, unitNormal, supportEdgeB))
+		{
+			return true;
+		}
+
+		if (shortestConnector.SetAsShortestConnector(supportEdgeA, supportEdgeB))
+			contact.surfacePoint = shortestConnector.Lerp(0.5);
+		else
+			contact.surfacePoint = (supportEdgeA.Lerp(0.5) + supportEdgeB.Lerp(0.5)) / 2.0;
+
+		contact.unitNormal = unitNormal;
+		contact.penetrationDepth = penetrationDepth;
+		manifold.AddContact(contact);
+		return true;
+	}
+
+	// Favor B for the reference face, so that we don't flip-flop between the two from one step to the next when they're nearly parallel.
+	constexpr double referenceFaceTolerance = 1e-3;
+	bool referenceIsB = (dotB + referenceFaceTolerance >= dotA);
+
+	const WorldHull& referenceHull = referenceIsB ? hullB : hullA;
+	const WorldHull& incidentHull = referenceIsB ? hullA : hullB;
+	const Plane& referencePlane = referenceIsB ? worldPlaneB : worldPlaneA;
+	int referenceFace = referenceIsB ? faceB : faceA;
+
+	// The incident face is the one most opposed to the reference face.
+	Plane incidentPlane;
+	double incidentDot = 0.0;
+	int incidentFace = FindFaceMostAlignedWith(incidentHull, -referencePlane.unitNormal, incidentPlane, incidentDot);
+	if (incidentFace < 0)
+		return true;
+
+	thread_local std::vector<Vector3> referencePolygon, clipPolygon, clipPolygonScratch;
+	thread_local std::vector<ClipPoint> clipPointArray;
+
+	GetWorldPolygon(referenceHull, referenceFace, referencePolygon);
+	GetWorldPolygon(incidentHull, incidentFace, clipPolygon);
 
-	const CollisionObject* collisionObjectA = objectA->GetCollisionObject();
-	const CollisionObject* collisionObjectB = objectB->GetCollisionObject();
+	// Clip the incident face against the side planes of the reference face.  The reference
+	// face is wound CCW about its normal, so each edge crossed with the normal points out of the face.
+	for (int i = 0; i < (int)referencePolygon.size() && clipPolygon.size() > 0; i++)
+	{
+		const Vector3& vertexA = referencePolygon[i];
+		const Vector3& vertexB = referencePolygon[(i + 1) % referencePolygon.size()];
+		Vector3 sideNormal = (vertexB - vertexA).Cross(referencePlane.unitNormal);
+		if (!sideNormal.Normalize())
+			continue;
+
+		ClipPolygonAgainstPlane(clipPolygon, Plane(vertexA, sideNormal), clipPolygonScratch);
+		clipPolygon.swap(clipPolygonScratch);
+	}
+
+	// Whatever is left behind, or just in front of, the reference face is in contact.  The points just in front
+	// keep a face resting on a face from rocking from one edge to the other as first one side and then the other lifts.
+	clipPointArray.clear();
+	for (const Vector3& point : clipPolygon)
+	{
+		double depth = -referencePlane.SignedDistanceTo(point);
+		if (depth >= -THEBE_SPECULATIVE_CONTACT_MARGIN)
+			clipPointArray.push_back(ClipPoint{ point, depth });
+	}
+
+	if (clipPointArray.size() > THEBE_MAX_MANIFOLD_CONTACTS)
+		ReduceContactPoints(clipPointArray, referencePlane.unitNormal);
+
+	contact.unitNormal = referenceIsB ? referencePlane.unitNormal : -referencePlane.unitNormal;
+
+	// Each contact point is put half-way between the incident point and its projection onto the reference face.
+	for (const ClipPoint& clipPoint : clipPointArray)
+	{
+		contact.surfacePoint = clipPoint.point + referencePlane.unitNormal * (clipPoint.depth / 2.0);
+		contact.penetrationDepth = clipPoint.depth;
+		manifold.AddContact(contact);
+	}
 
-	auto hullA = dynamic_cast<const GJKConvexHull*>(collisionObjectA->GetShape());
-	auto hullB = dynamic_cast<const GJKConvexHull*>(collisionObjectB->GetShape());
+	return true;
+}
+
+/*static*/ bool PhysicsSystem::ContactCalculator<GJKConvexHull, GJKConvexHull>::MakeWorldHull(const CollisionObject* collisionObject, const GJKShape* shape, WorldHull& worldHull)
+{
+	worldHull.hull = dynamic_cast<const GJKConvexHull*>(shape);
+	if (!worldHull.hull)
+		return false;
 
-	if (!hullA || !hullB)
+	if (shape == collisionObject->GetShape())
+	{
+		worldHull.worldVertexArray = &collisionObject->GetWorldVertexArray();
+		worldHull.worldPlaneArray = &collisionObject->GetWorldPlaneArray();
+		worldHull.edgeSet = &collisionObject->GetEdgeSet();
+		return true;
+	}
+
+	auto compoundShape = dynamic_cast<const GJKCompoundShape*>(collisionObject->GetShape());
+	if (!compoundShape)
 		return false;
 
-	std::vector<Vector3> worldVerticesA;
-	worldVerticesA.resize(hullA->hull.GetNumVertices());
-	for (int i = 0; i < (int)worldVerticesA.size(); i++)
-		worldVerticesA[i] = hullA->GetWorldVertex(i);
+	for (int i = 0; i < compoundShape->GetNumChildren(); i++)
+	{
+		const GJKCompoundShape::Child& child = compoundShape->GetChild(i);
+		if (child.shape != shape)
+			continue;
+
+		// The child is already placed in world space by the compound, so its own transform is all we need.
+		const Transform& childToWorld = shape->GetObjectToWorld();
 
-	std::vector<Vector3> worldVerticesB;
-	worldVerticesB.resize(hullB->hull.GetNumVertices());
-	for (int i = 0; i < (int)worldVerticesB.size(); i++)
-		worldVerticesB[i] = hullB->GetWorldVertex(i);
+		worldHull.worldVertexStorage.clear();
+		for (const Vector3& vertex : worldHull.hull->hull.GetVertexArray())
+			worldHull.worldVertexStorage.push_back(childToWorld.TransformPoint(vertex));
 
-	// Look for vertex/face contacts.
+		worldHull.worldPlaneStorage.clear();
+		for (const Plane& plane : child.childSpacePlaneArray)
+			worldHull.worldPlaneStorage.push_back(childToWorld.TransformPlane(plane));
 
-	for (int i = 0; i < hullA->hull.GetNumVertices(); i++)
+		worldHull.worldVertexArray = &worldHull.worldVertexStorage;
+		worldHull.worldPlaneArray = &worldHull.worldPlaneStorage;
+		worldHull.edgeSet = &child.edgeSet;
+		return true;
+	}
+
+	return false;
+}
+
+/*static*/ int PhysicsSystem::ContactCalculator<GJKConvexHull, GJKConvexHull>::FindFaceMostAlignedWith(const WorldHull& worldHull, const Vector3& unitDirection, Plane& worldPlane, double& dot)
+{
+	int faceIndex = -1;
+	dot = -std::numeric_limits<double>::max();
+
+	const std::vector<Plane>& worldPlaneArray = *worldHull.worldPlaneArray;
+	for (int i = 0; i < (int)worldPlaneArray.size(); i++)
 	{
-		const Vector3& vertexA = worldVerticesA[i];
-		if (collisionObjectB->PointOnOrBehindAllWorldPlanes(vertexA))
+		const Plane& plane = worldPlaneArray[i];
+		double planeDot = plane.unitNormal.Dot(unitDirection);
+		if (planeDot > dot)
 		{
-			Plane planeB;
-			bool found = collisionObjectB->FindWorldPlaneNearestToPoint(vertexA, planeB);
-			THEBE_ASSERT(found);
-			Contact contact;
-			contact.objectA = const_cast<PhysicsObject*>(objectA);
-			contact.objectB = const_cast<PhysicsObject*>(objectB);
-			contact.unitNormal = planeB.unitNormal;		// Always point from object B to A.
-			contact.surfacePoint = planeB.ClosestPointTo(vertexA);
-			contactList.push_back(contact);
+			dot = planeDot;
+			worldPlane = plane;
+			faceIndex = i;
 		}
 	}
 
-	for (int i = 0; i < hullB->hull.GetNumVertices(); i++)
+	return faceIndex;
+}
+
+/*static*/ void PhysicsSystem::ContactCalculator<GJKConvexHull, GJKConvexHull>::GetWorldPolygon(const WorldHull& worldHull, int polygonIndex, std::vector<Vector3>& worldPolygon)
+{
+	// Note that the plane array of the world hull was generated one plane per polygon of the hull, in order.
+	THEBE_ASSERT(0 <= polygonIndex && polygonIndex < worldHull.hull->hull.GetNumPolygons());
+	const PolygonMesh::Polygon& polygon = worldHull.hull->hull.GetPolygon(polygonIndex);
+
+	const std::vector<Vector3>& worldVertexArray = *worldHull.worldVertexArray;
+	worldPolygon.clear();
+	for (int i : polygon.vertexArray)
+		worldPolygon.push_back(worldVertexArray[i]);
+}
+
+/*static*/ void PhysicsSystem::ContactCalculator<GJKConvexHull, GJKConvexHull>::ClipPolygonAgainstPlane(const std::vector<Vector3>& inputPolygon, const Plane& plane, std::vector<Vector3>& outputPolygon)
+{
+	// This is one stage of the Sutherland-Hodgman algorithm.  We keep what is behind the plane.
+	outputPolygon.clear();
+
+	for (int i = 0; i < (int)inputPolygon.size(); i++)
 	{
-		const Vector3& vertexB = worldVerticesB[i];
-		if (collisionObjectA->PointOnOrBehindAllWorldPlanes(vertexB))
+		const Vector3& pointA = inputPolygon[i];
+		const Vector3& pointB = inputPolygon[(i + 1) % inputPolygon.size()];
+
+		double distanceA = plane.SignedDistanceTo(pointA);
+		double distanceB = plane.SignedDistanceTo(pointB);
+
+		if (distanceA <= 0.0)
+			outputPolygon.push_back(pointA);
+
+		if ((distanceA < 0.0 && distanceB > 0.0) || (distanceA > 0.0 && distanceB < 0.0))
 		{
-			Plane planeA;
-			bool found = collisionObjectA->FindWorldPlaneNearestToPoint(vertexB, planeA);
-			THEBE_ASSERT(found);
-			Contact contact;
-			contact.objectA = const_cast<PhysicsObject*>(objectA);
-			contact.objectB = const_cast<PhysicsObject*>(objectB);
-			contact.unitNormal = -planeA.unitNormal;		// Always point from object B to A.
-			contact.surfacePoint = planeA.ClosestPointTo(vertexB);
-			contactList.push_back(contact);
+			double alpha = distanceA / (distanceA - distanceB);
+			outputPolygon.push_back(pointA + (pointB - pointA) * alpha);
 		}
 	}
+}
+
+/*static*/ void PhysicsSystem::ContactCalculator<GJKConvexHull, GJKConvexHull>::ReduceContactPoints(std::vector<ClipPoint>& clipPointArray, const Vector3& unitNormal)
+{
+	// Keep the deepest point, then the point furthest from it, then the point making the
+	// biggest triangle with those two, and finally the point adding the most area to that triangle.
+	// This keeps the contact region about as big as it was, which is what matters for stability.
+	THEBE_ASSERT(clipPointArray.size() > THEBE_MAX_MANIFOLD_CONTACTS);
+
+	int keepArray[THEBE_MAX_MANIFOLD_CONTACTS];
+	int numKept = 0;
 
-	// Look for edge/edge contacts.
+	int i, j;
+	double best;
 
-	for (const Graph::UnorderedEdge& edgeA : collisionObjectA->GetEdgeSet())
+	best = -std::numeric_limits<double>::max();
+	for (i = j = 0; i < (int)clipPointArray.size(); i++)
 	{
-		LineSegment lineSegA;
-		lineSegA.point[0] = worldVerticesA[edgeA.i];
-		lineSegA.point[1] = worldVerticesA[edgeA.j];
+		if (clipPointArray[i].depth > best)
+		{
+			best = clipPointArray[i].depth;
+			j = i;
+		}
+	}
+	keepArray[numKept++] = j;
 
-		for (const Graph::UnorderedEdge& edgeB : collisionObjectB->GetEdgeSet())
+	const Vector3& pointA = clipPointArray[keepArray[0]].point;
+	best = -1.0;
+	for (i = j = 0; i < (int)clipPointArray.size(); i++)
+	{
+		double squareDistance = (clipPointArray[i].point - pointA).SquareLength();
+		if (squareDistance > best)
 		{
-			LineSegment lineSegB;
-			lineSegB.point[0] = worldVerticesB[edgeB.i];
-			lineSegB.point[1] = worldVerticesB[edgeB.j];
+			best = squareDistance;
+			j = i;
+		}
+	}
+	keepArray[numKept++] = j;
 
-			LineSegment shortestConnector;
-			if (shortestConnector.SetAsShortestConnector(lineSegA, lineSegB))
-			{
-				const Vector3& pointA = shortestConnector.point[0];
-				const Vector3& pointB = shortestConnector.point[1];
+	const Vector3& pointB = clipPointArray[keepArray[1]].point;
+	best = 0.0;
+	for (i = 0, j = -1; i < (int)clipPointArray.size(); i++)
+	{
+		double signedArea = (pointB - pointA).Cross(clipPointArray[i].point - pointA).Dot(unitNormal);
+		if (::fabs(signedArea) > best)
+		{
+			best = ::fabs(signedArea);
+			j = i;
+		}
+	}
 
-				if (collisionObjectA->PointOnOrBehindAllWorldPlanes(pointB) && collisionObjectB->PointOnOrBehindAllWorldPlanes(pointA))
-				{
-					Contact contact;
-					contact.objectA = const_cast<PhysicsObject*>(objectA);
-					contact.objectB = const_cast<PhysicsObject*>(objectB);
-					contact.surfacePoint = shortestConnector.Lerp(0.5);
-					contact.unitNormal = lineSegA.GetDelta().Cross(lineSegB.GetDelta()).Normalized();
+	if (j >= 0)
+	{
+		keepArray[numKept++] = j;
 
-					double dot = (contact.surfacePoint - collisionObjectB->GetWorldGeometricCenter()).Dot(contact.unitNormal);
-					if (dot < 0.0)
-						contact.unitNormal = -contact.unitNormal;
+		// Orient the triangle CCW about the normal so that points outside it have a negative area with one of its edges.
+		if ((pointB - pointA).Cross(clipPointArray[j].point - pointA).Dot(unitNormal) < 0.0)
+			std::swap(keepArray[0], keepArray[1]);
 
-					contactList.push_back(contact);
+		const Vector3* trianglePoint[3] = { &clipPointArray[keepArray[0]].point, &clipPointArray[keepArray[1]].point, &clipPointArray[keepArray[2]].point };
+		best = 0.0;
+		for (i = 0, j = -1; i < (int)clipPointArray.size(); i++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				const Vector3& edgeA = *trianglePoint[k];
+				const Vector3& edgeB = *trianglePoint[(k + 1) % 3];
+				double addedArea = -(edgeB - edgeA).Cross(clipPointArray[i].point - edgeA).Dot(unitNormal);
+				if (addedArea > best)
+				{
+					best = addedArea;
+					j = i;
 				}
 			}
 		}
+
+		if (j >= 0)
+			keepArray[numKept++] = j;
+	}
+
+	ClipPoint keptPointArray[THEBE_MAX_MANIFOLD_CONTACTS];
+	for (i = 0; i < numKept; i++)
+		keptPointArray[i] = clipPointArray[keepArray[i]];
+
+	clipPointArray.clear();
+	for (i = 0; i < numKept; i++)
+		clipPointArray.push_back(keptPointArray[i]);
+}
+
+/*static*/ bool PhysicsSystem::ContactCalculator<GJKConvexHull, GJKConvexHull>::FindSupportEdge(const WorldHull& worldHull, const Vector3& unitDirection, LineSegment& supportEdge)
+{
+	// Of all the edges touching the support vertex, the support edge is the one most perpendicular to the given direction.
+	const GJKConvexHull* hull = worldHull.hull;
+	const Transform& objectToWorld = hull->GetObjectToWorld();
+	int supportVertex = hull->FindSupportVertex(unitDirection * objectToWorld.matrix);
+	if (supportVertex < 0)
+		return false;
+
+	const Vector3& vertex = hull->hull.GetVertex(supportVertex);
+	Vector3 objectDirection = (unitDirection * objectToWorld.matrix).Normalized();
+	double smallestDot = std::numeric_limits<double>::max();
+	int otherVertex = -1;
+
+	for (const Graph::UnorderedEdge& edge : *worldHull.edgeSet)
+	{
+		if (edge.i != supportVertex && edge.j != supportVertex)
+			continue;
+
+		int j = (edge.i == supportVertex) ? edge.j : edge.i;
+		Vector3 edgeDirection = (hull->hull.GetVertex(j) - vertex).Normalized();
+		double dot = ::fabs(edgeDirection.Dot(objectDirection));
+		if (dot < smallestDot)
+		{
+			smallestDot = dot;
+			otherVertex = j;
+		}
+	}
+
+	if (otherVertex < 0)
+		return false;
+
+	const std::vector<Vector3>& worldVertexArray = *worldHull.worldVertexArray;
+	supportEdge.point[0] = worldVertexArray[supportVertex];
+	supportEdge.point[1] = worldVertexArray[otherVertex];
+	return true;
+}
+
+//------------------------------ PhysicsSystem::ContactCalculator<GJKConvexHull, TriangleMeshShape> ------------------------------
+
+/*virtual*/ bool PhysicsSystem::ContactCalculator<GJKConvexHull, TriangleMeshShape>::CalculateContacts(
+												const PhysicsObject* objectA,
+												const PhysicsObject* objectB,
+												const GJKShape* shapeA,
+												const GJKShape* shapeB,
+												const Vector3& unitNormal,
+												double penetrationDepth,
+												ContactManifold& manifold)
+{
+	// We work out the contacts as if the hull were object A, and then flip them at the end if it wasn't.
+	thread_local WorldHull worldHull;
+	bool hullIsA = true;
+	auto meshShape = dynamic_cast<const TriangleMeshShape*>(shapeB);
+	if (!meshShape || !MakeWorldHull(objectA->GetCollisionObject(), shapeA, worldHull))
+	{
+		meshShape = dynamic_cast<const TriangleMeshShape*>(shapeA);
+		if (!meshShape || !MakeWorldHull(objectB->GetCollisionObject(), shapeB, worldHull))
+			return false;
+
+		hullIsA = false;
+	}
+
+	const GJKConvexHull* hull = worldHull.hull;
+
+	manifold.Clear();
+
+	Contact contact;
+	contact.objectA = const_cast<PhysicsObject*>(objectA);
+	contact.objectB = const_cast<PhysicsObject*>(objectB);
+
+	thread_local std::vector<int> triangleArray;
+	thread_local std::vector<Vector3> referencePolygon, clipPolygon, clipPolygonScratch;
+	thread_local std::vector<ClipPoint> clipPointArray;
+
+	meshShape->FindTriangles(hull->GetWorldBoundingBox(), triangleArray);
+	clipPointArray.clear();
+
+	constexpr double minFaceAlignment = 0.95;
+	Vector3 hullCenter = hull->GetObjectToWorld().TransformPoint(hull->CalcGeometricCenter());
+	GJKTriangle triangle;
+	for (int i : triangleArray)
+	{
+		meshShape->GetTriangle(i, triangle);
+
+		// Triangles are one-sided, so the hull is never pushed through the back of one.
+		Plane referencePlane = triangle.GetWorldPlane();
+		if (!referencePlane.IsValid() || referencePlane.SignedDistanceTo(hullCenter) < 0.0)
+			continue;
+
+		if (!GJKShape::Intersect(hull, &triangle))
+			continue;
+
+		Plane incidentPlane;
+		double incidentDot = 0.0;
+		int incidentFace = FindFaceMostAlignedWith(worldHull, -referencePlane.unitNormal, incidentPlane, incidentDot);
+		if (incidentFace < 0)
+			continue;
+
+		if (incidentDot < minFaceAlignment)
+		{
+			Vector3 point = hull->FurthestPoint(-referencePlane.unitNormal);
+			double depth = -referencePlane.SignedDistanceTo(point);
+			if (depth >= -THEBE_SPECULATIVE_CONTACT_MARGIN)
+				clipPointArray.push_back(ClipPoint{ point, depth, referencePlane.unitNormal });
+
+			continue;
+		}
+
+		referencePolygon.clear();
+		for (int j = 0; j < 3; j++)
+			referencePolygon.push_back(triangle.GetObjectToWorld().TransformPoint(triangle.vertex[j]));
+
+		GetWorldPolygon(worldHull, incidentFace, clipPolygon);
+
+		// The triangle winds CCW about its normal, so each edge crossed with the normal points out of the triangle.
+		for (int j = 0; j < 3 && clipPolygon.size() > 0; j++)
+		{
+			const Vector3& vertexA = referencePolygon[j];
+			const Vector3& vertexB = referencePolygon[(j + 1) % 3];
+			Vector3 sideNormal = (vertexB - vertexA).Cross(referencePlane.unitNormal);
+			if (!sideNormal.Normalize())
+				continue;
+
+			ClipPolygonAgainstPlane(clipPolygon, Plane(vertexA, sideNormal), clipPolygonScratch);
+			clipPolygon.swap(clipPolygonScratch);
+		}
+
+		for (const Vector3& point : clipPolygon)
+		{
+			double depth = -referencePlane.SignedDistanceTo(point);
+			if (depth >= -THEBE_SPECULATIVE_CONTACT_MARGIN)
+				clipPointArray.push_back(ClipPoint{ point, depth, referencePlane.unitNormal });
+		}
 	}
 
+	if (clipPointArray.size() > THEBE_MAX_MANIFOLD_CONTACTS)
+	{
+		// The points may have come from triangles facing different ways, so reduce them about their average normal.
+		Vector3 averageNormal(0.0, 0.0, 0.0);
+		for (const ClipPoint& clipPoint : clipPointArray)
+			averageNormal += clipPoint.unitNormal;
+
+		if (!averageNormal.Normalize())
+			averageNormal = clipPointArray[0].unitNormal;
+
+		ReduceContactPoints(clipPointArray, averageNormal);
+	}
+
+	// Each contact point is put half-way between the hull point and its projection onto the triangle.
+	for (const ClipPoint& clipPoint : clipPointArray)
+	{
+		contact.unitNormal = clipPoint.unitNormal;
+		contact.surfacePoint = clipPoint.point + clipPoint.unitNormal * (clipPoint.depth / 2.0);
+		contact.penetrationDepth = clipPoint.depth;
+		manifold.AddContact(contact);
+	}
+
+	if (!hullIsA)
+		FlipContactNormals(manifold);
+
 	return true;
-}
\ No newline at end of file
+}
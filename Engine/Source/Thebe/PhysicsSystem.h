@@ -3,12 +3,19 @@
 #include "Thebe/Common.h"
 #include "Thebe/Reference.h"
 #include "Thebe/Math/Vector3.h"
+#include "Thebe/Math/Matrix3x3.h"
+#include "Thebe/Math/Matrix2x2.h"
+#include "Thebe/Math/Vector2.h"
 #include "Thebe/Math/GJKAlgorithm.h"
 #include "Thebe/CollisionSystem.h"
+#include "Thebe/RigidBodyWorld.h"
 #include "Thebe/ImGuiManager.h"
+#include "Thebe/Utilities/Clock.h"
 #include <unordered_map>
 
 #define THEBE_MAX_PHYSICS_TIME_STEP		0.05
+#define THEBE_MAX_MANIFOLD_CONTACTS		4
+#define THEBE_SPECULATIVE_CONTACT_MARGIN	0.02
 
 namespace Thebe
 {
@@ -19,56 +26,152 @@ namespace Thebe
 	class DynamicLineRenderer;
 	class RigidBody;
 	class FloppyBody;
+	class TriangleMeshShape;
 
 	/**
 	 * This is my attempt to do some basic rigid and floppy body simulations.
 	 * 
 	 * I used David Baraff's paper "An Introduction to Physically Based Modeling: Rigid Body Simulation I/II".
+	 * Contacts between rigid bodies are resolved all together by a sequential impulse (projected Gauss-Seidel)
+	 * solver, as described by Erin Catto, with friction and warm starting.  The solver only deals in velocities;
+	 * any overlap between rigid bodies is worked out of them over a few steps by a small bias velocity.
 	 */
 	class THEBE_API PhysicsSystem
 	{
 	public:
-		PhysicsSystem();
+		PhysicsSystem(CollisionSystem* collisionSystem);
 		virtual ~PhysicsSystem();
 
 		void Initialize(EventSystem* eventSystem);
 		bool TrackObject(PhysicsObject* physicsObject);
 		bool UntrackObject(PhysicsObject* physicsObject);
 		void UntrackAllObjects();
+		/**
+		 * Advance the simulation by the given amount of time, which is typically the time taken by the last frame.
+		 * How the time is split into steps depends on whether there's a fixed time step; see @ref SetFixedTimeStep.
+		 */
 		void StepSimulation(double deltaTimeSeconds, CollisionSystem* collisionSystem);
 		void DebugDraw(DynamicLineRenderer* lineRenderer) const;
 
 		struct THEBE_API Contact
 		{
+			Contact();
+
 			Reference<PhysicsObject> objectA;
 			Reference<PhysicsObject> objectB;
 			Vector3 surfacePoint;		///< This is the point of contact shared between the two rigid bodies.
 			Vector3 unitNormal;			///< This is the contact normal, always pointing from object B to object A by convention.
+			double penetrationDepth;	///< This is how far the bodies overlap along the contact normal at the contact point.  It's negative for points not quite touching yet (see @ref THEBE_SPECULATIVE_CONTACT_MARGIN.)
+			double normalImpulse;		///< This is the total impulse the contact solver applied along the normal, kept so that the next step can start from it.
+			Vector3 tangentImpulse;		///< This is the total friction impulse the contact solver applied to object A, kept for the same reason.
+		};
+
+		/**
+		 * These are all the contacts between a single pair of bodies.  The storage is fixed-size
+		 * so that generating contacts each step never touches the heap.  A face-face contact is
+		 * reduced to the few points that best approximate the contact area, which is enough to
+		 * keep a resting body from rocking; vertex-face and edge-edge contacts have fewer.
+		 */
+		struct THEBE_API ContactManifold
+		{
+			ContactManifold();
+
+			void Clear();
+			bool AddContact(const Contact& contact);
+
+			Contact contactArray[THEBE_MAX_MANIFOLD_CONTACTS];
+			int numContacts;
+			const GJKShape* shapeA;		///< This is the part of object A in contact; see @ref ContactCalculatorInterface::CalculateContacts.
+			const GJKShape* shapeB;		///< This is the part of object B in contact.
 		};
 
 		class THEBE_API ContactCalculatorInterface
 		{
 		public:
-			virtual bool CalculateContacts(const PhysicsObject* objectA, const PhysicsObject* objectB, std::list<Contact>& contactList) = 0;
+			/**
+			 * Fill in the given manifold with the contacts between the given, colliding objects.
+			 *
+			 * @param[in] shapeA This is the part of object A in contact, which is its whole shape, or a child of it if it's a @ref GJKCompoundShape.
+			 * @param[in] shapeB This is the part of object B in contact, just as for object A.
+			 * @param[in] unitNormal This is the direction, pointing from object B to object A, along which the objects are least penetrating (e.g., as found by EPA.)
+			 * @param[in] penetrationDepth This is how far the objects must be moved apart along the given normal to separate them.
+			 * @return False is returned if this calculator doesn't handle the given objects; true, otherwise.
+			 */
+			virtual bool CalculateContacts(const PhysicsObject* objectA, const PhysicsObject* objectB, const GJKShape* shapeA, const GJKShape* shapeB, const Vector3& unitNormal, double penetrationDepth, ContactManifold& manifold) = 0;
 
-			static void FlipContactNormals(std::list<Contact>& contactList);
+			static void FlipContactNormals(ContactManifold& manifold);
 		};
 
 		template<typename ShapeTypeA, typename ShapeTypeB>
 		class THEBE_API ContactCalculator : public ContactCalculatorInterface
 		{
 		public:
-			virtual bool CalculateContacts(const PhysicsObject* objectA, const PhysicsObject* objectB, std::list<Contact>& contactList) override
+			virtual bool CalculateContacts(const PhysicsObject* objectA, const PhysicsObject* objectB, const GJKShape* shapeA, const GJKShape* shapeB, const Vector3& unitNormal, double penetrationDepth, ContactManifold& manifold) override
 			{
 				return false;
 			}
 		};
 
+		/**
+		 * Contacts between two convex hulls are found by clipping.  Of the two hulls, the face best aligned with
+		 * the collision normal is the reference face, and the face of the other hull most opposed to it is the
+		 * incident face.  The incident face is clipped (Sutherland-Hodgman) against the side planes of the reference
+		 * face, and whatever is left behind the reference face makes the contacts.  If neither hull presents a face
+		 * to the normal, the contact is edge-edge, and a single contact is made between the two support edges.
+		 */
 		template<>
 		class THEBE_API ContactCalculator<GJKConvexHull, GJKConvexHull> : public ContactCalculatorInterface
 		{
 		public:
-			virtual bool CalculateContacts(const PhysicsObject* objectA, const PhysicsObject* objectB, std::list<Contact>& contactList) override;
+			virtual bool CalculateContacts(const PhysicsObject* objectA, const PhysicsObject* objectB, const GJKShape* shapeA, const GJKShape* shapeB, const Vector3& unitNormal, double penetrationDepth, ContactManifold& manifold) override;
+
+		protected:
+			struct ClipPoint
+			{
+				Vector3 point;
+				double depth;
+				Vector3 unitNormal;		///< This is only needed when the points are clipped against more than one reference face.
+			};
+
+			/**
+			 * This is what the clipping needs to know about a hull in world space.  For the whole shape
+			 * of a collision object, it comes from the world caches of the object.  For a child of a
+			 * compound shape, it's worked out on the spot, into the storage here.
+			 */
+			struct WorldHull
+			{
+				const GJKConvexHull* hull;
+				const std::vector<Vector3>* worldVertexArray;
+				const std::vector<Plane>* worldPlaneArray;
+				const std::set<Graph::UnorderedEdge, Graph::UnorderedEdge>* edgeSet;
+				std::vector<Vector3> worldVertexStorage;
+				std::vector<Plane> worldPlaneStorage;
+			};
+
+			/**
+			 * Set up the given world hull for the given part of the given collision object.  False is returned if the part isn't a hull.
+			 */
+			static bool MakeWorldHull(const CollisionObject* collisionObject, const GJKShape* shape, WorldHull& worldHull);
+
+			static int FindFaceMostAlignedWith(const WorldHull& worldHull, const Vector3& unitDirection, Plane& worldPlane, double& dot);
+			static void GetWorldPolygon(const WorldHull& worldHull, int polygonIndex, std::vector<Vector3>& worldPolygon);
+			static void ClipPolygonAgainstPlane(const std::vector<Vector3>& inputPolygon, const Plane& plane, std::vector<Vector3>& outputPolygon);
+			static void ReduceContactPoints(std::vector<ClipPoint>& clipPointArray, const Vector3& unitNormal);
+			static bool FindSupportEdge(const WorldHull& worldHull, const Vector3& unitDirection, LineSegment& supportEdge);
+		};
+
+		/**
+		 * Contacts between a convex hull and a triangle mesh are found one triangle at a time, and only for the triangles
+		 * that the hull's box overlaps.  Each triangle that the hull overlaps, and is in front of, is a reference face against
+		 * which the incident face of the hull is clipped, just as for two hulls.  Where the hull presents no face to the
+		 * triangle, its deepest vertex makes the contact.  The contacts from all the triangles are then reduced together.
+		 * Either object may be the hull.
+		 */
+		template<>
+		class THEBE_API ContactCalculator<GJKConvexHull, TriangleMeshShape> : public ContactCalculator<GJKConvexHull, GJKConvexHull>
+		{
+		public:
+			virtual bool CalculateContacts(const PhysicsObject* objectA, const PhysicsObject* objectB, const GJKShape* shapeA, const GJKShape* shapeB, const Vector3& unitNormal, double penetrationDepth, ContactManifold& manifold) override;
 		};
 
 		class THEBE_API ContactResolverInterface
@@ -87,13 +190,6 @@ namespace Thebe
 			}
 		};
 
-		template<>
-		class THEBE_API ContactResolver<RigidBody, RigidBody> : public ContactResolverInterface
-		{
-		public:
-			virtual bool ResolveContact(Contact& contact, PhysicsSystem* physicsSystem) override;
-		};
-
 		template<>
 		class THEBE_API ContactResolver<RigidBody, FloppyBody> : public ContactResolverInterface
 		{
@@ -108,11 +204,114 @@ namespace Thebe
 			virtual bool ResolveContact(Contact& contact, PhysicsSystem* physicsSystem) override;
 		};
 
+		/**
+		 * Have @ref StepSimulation advance the simulation in steps of exactly the given length, whatever the frame rate, so that
+		 * the results don't depend on it.  Time left over at the end of a frame is carried into the next.  At most the given
+		 * number of steps are taken per frame, which bounds the cost of a frame, and any time beyond that is dropped.  Objects
+		 * are then drawn part way between where they were at the start and end of the last step, by the fraction of a step left
+		 * over, so that motion looks smooth even with fewer steps than frames.  See @ref PhysicsObject::GetRenderObjectToWorld.
+		 *
+		 * Pass zero for the step length to go back to the default, which is to take one step of whatever time the frame took,
+		 * split into steps no longer than @ref THEBE_MAX_PHYSICS_TIME_STEP, and to draw objects where they are.
+		 */
+		void SetFixedTimeStep(double fixedTimeStepSeconds, int maxStepsPerFrame = 4);
+		double GetFixedTimeStep() const;
+		int GetMaxStepsPerFrame() const;
+
+		/**
+		 * Return the number of steps taken by the last call to @ref StepSimulation.
+		 */
+		int GetNumStepsLastFrame() const;
+
 		void SetGravity(const Vector3& accelerationDueToGravity);
 		const Vector3& GetGravity() const;
 
 		double GetCoeficientOfRestituation() const;
 
+		void SetCoeficientOfFriction(double coeficientOfFriction);
+		double GetCoeficientOfFriction() const;
+
+		/**
+		 * Set the number of passes the contact solver makes over all the contacts between rigid bodies
+		 * each step.  The cost of a step grows linearly with this, and the solver doesn't stop early,
+		 * so the cost is predictable.  Tall stacks need more passes to come to rest; the default of 30
+		 * holds a stack of 20 boxes.
+		 */
+		void SetContactSolverIterations(int contactSolverIterations);
+		int GetContactSolverIterations() const;
+
+		/**
+		 * These are measurements of the contact solver's work in the last step of the simulation.
+		 */
+		struct ContactSolverStats
+		{
+			int numBodies;
+			int numConstraints;
+			int numIterations;
+			int numWarmStarted;					///< This is how many of the contacts were matched with a contact of the step before.
+			int numIslands;						///< This is how many islands the contacts were split into, each solved by a single thread.
+			double prepareTimeMilliseconds;
+			double solveTimeMilliseconds;		///< This is the time taken by all the passes together, not counting the time to prepare.
+		};
+
+		const ContactSolverStats& GetContactSolverStats() const;
+
+		/**
+		 * Each step, the objects that can move are split into islands, each a set of objects that touch one
+		 * another, directly or through other objects of the island.  An island whose kinetic energy per unit of
+		 * mass stays at or below the given threshold for the given number of steps in a row is put to sleep.
+		 * Sleeping objects are not moved, and pairs of them are skipped by the broad phase, so a scene
+		 * at rest costs next to nothing to simulate.  An island is woken up when something awake touches
+		 * it, when a force is applied to or momentum given to any of its objects, or by @ref WakeObject.
+		 */
+		void SetSleepThresholds(double sleepEnergyThreshold, int sleepStepCount);
+		void GetSleepThresholds(double& sleepEnergyThreshold, int& sleepStepCount) const;
+
+		/**
+		 * Turning sleep off wakes everything up.
+		 */
+		void SetSleepEnabled(bool sleepEnabled);
+		bool GetSleepEnabled() const;
+
+		/**
+		 * Wake the given object, if it's asleep, along with the rest of the island it was put to sleep with.
+		 */
+		void WakeObject(PhysicsObject* physicsObject);
+
+		/**
+		 * Wake every object that's asleep.
+		 */
+		void WakeAllObjects();
+
+		/**
+		 * These are counts of objects and islands as of the last step of the simulation.
+		 */
+		struct IslandStats
+		{
+			int numIslands;				///< This is the number of islands of awake objects.
+			int numAwakeObjects;		///< This doesn't count stationary or frozen objects.
+			int numSleepingObjects;
+			int numSleepingIslands;
+		};
+
+		const IslandStats& GetIslandStats() const;
+
+		/**
+		 * Set the number of threads, including the calling thread, across which the work of each step is split.
+		 * Objects are integrated in batches, and islands of objects in contact are solved one to a thread, since
+		 * no two islands share anything that moves.  The results of a step therefore do not depend on this number;
+		 * only how long they take to produce does.  This may be called at any time.  If it hasn't been called by
+		 * the time the system is initialized, the system uses one thread per core of the machine from then on.
+		 * The threads are those of the collision system's narrow phase, so this sets its thread count too, and
+		 * collision detection is split across the same number of threads without any more being started.
+		 */
+		bool SetThreadCount(int threadCount);
+
+		/**
+		 * Get the number of threads across which the work of each step is split.
+		 */
+		int GetThreadCount() const;
+
 		void RegisterWithImGuiManager();
 		void EnablePhysicsImGuiWindow(bool enable);
 		bool ShowingPhysicsImGuiWindow();
@@ -121,19 +320,167 @@ namespace Thebe
 		void HandleCollisionObjectEvent(const Event* event);
 
 		/**
-		 * Add one or more collision contacts to the contacts list as a function of the given collision.
+		 * Advance the simulation by a single step of the given length.
+		 */
+		void SimulateStep(double timeStepSeconds, CollisionSystem* collisionSystem);
+
+		/**
+		 * Place what's rendered of each object that took part in the last step the given fraction of the way from where
+		 * it was at the start of the step to where it is now.
+		 */
+		void InterpolateRenderTransforms(double alpha);
+
+		/**
+		 * Add a contact manifold for the given collision to our array of manifolds.  If either
+		 * object is a compound, one manifold is added per pair of parts in collision.  True is
+		 * returned if the contact solver takes care of the collision, in which case the bodies
+		 * don't need to be separated afterward; false, otherwise.
 		 */
 		bool GenerateContacts(const CollisionSystem::Collision* collision);
 
+		/**
+		 * Add a contact manifold for the given parts of the given objects, separated by the given delta, to our array of manifolds.
+		 */
+		void GenerateManifold(const PhysicsObject* objectA, const PhysicsObject* objectB, const GJKShape* shapeA, const GJKShape* shapeB, const Vector3& separationDelta);
+
 		/**
 		 * True is returned here if and only if an impulse was applied to prevent interpenetration.
 		 */
 		bool ResolveContact(Contact& contact);
 
 		/**
-		 * 
+		 * This is a rigid body as the contact solver sees it.  The solver works on velocities, but
+		 * our bodies store momenta, so the impulses applied are also summed up here to be added to
+		 * the momenta of the body once the solver is done.  Bodies that can't move have no inverse
+		 * mass, so that impulses do nothing to them.
+		 */
+		struct SolverBody
+		{
+			RigidBody* rigidBody;
+			Vector3 linearVelocity;
+			Vector3 angularVelocity;
+			double inverseMass;
+			Matrix3x3 worldSpaceInertiaTensorInverse;
+			Vector3 linearImpulse;
+			Vector3 angularImpulse;
+		};
+
+		/**
+		 * This is what the contact solver needs to know about a single contact, worked out once per step.
+		 */
+		struct ContactConstraint
+		{
+			Contact* contact;
+			int bodyA;
+			int bodyB;
+			Vector3 contactVectorA;
+			Vector3 contactVectorB;
+			Vector3 unitTangent[2];
+			double normalMass;
+			Matrix2x2 tangentMass;		///< The two directions of friction are coupled by rotation, so they're solved together, with this inverse of their 2x2 block of the effective mass matrix.
+			double frictionCoeficient;
+			double velocityBias;
+			double normalImpulse;
+			Vector2 tangentImpulse;
+			int island;					///< This is the island of whichever body can move.  Constraints between bodies that can't move get an island of their own.
+		};
+
+		/**
+		 * Find the solver body for the given rigid body, adding it if need be.
+		 */
+		int GetSolverBody(RigidBody* rigidBody);
+
+		/**
+		 * Make a constraint for each contact between two rigid bodies, and seed its impulses with those of the matching
+		 * contact of the last step, if any.  Manifolds between anything else are set aside for the contact resolvers.
+		 * The constraints are sorted by island, so that each island's constraints are contiguous.
+		 */
+		void PrepareContactSolver(double timeStepSeconds);
+
+		/**
+		 * Work out the effective masses and bias of the given constraint.  This only writes to the constraint, so it's safe to call on many threads at once.
+		 */
+		void PrepareContactConstraint(ContactConstraint& constraint, double timeStepSeconds) const;
+
+		/**
+		 * Find the manifold of the last step between the same parts as the given manifold, and copy the impulses of its
+		 * contacts into the nearest contacts of the given manifold.  The number of contacts warm-started is returned.
+		 */
+		int WarmStartManifold(ContactManifold& manifold);
+
+		/**
+		 * Apply the impulses the given range of constraints start with.  Resting contacts then start out already nearly solved.
+		 */
+		void WarmStartContactSolver(int beginIndex, int endIndex);
+
+		/**
+		 * Make one projected Gauss-Seidel pass over the given range of constraints, in the given direction.  For each, the impulse along the normal
+		 * that stops the bodies approaching is found, and added to the total so far, which is then clamped to never pull.
+		 * The friction impulse is found likewise, and its total is clamped to the friction cone of the normal impulse.
+		 */
+		void SolveContactVelocities(int beginIndex, int endIndex, bool backward);
+
+		/**
+		 * Warm-start the constraints of the given island, and then make all the solver's passes over them.  The only solver bodies
+		 * written are those that can move, and each of those belongs to just one island, so different islands may be solved at once.
+		 */
+		void SolveIsland(int island);
+
+		/**
+		 * Apply the given impulse at the given point (relative to the center of mass) to the given body, unless it can't move.
+		 */
+		static void ApplySolverImpulse(SolverBody& solverBody, const Vector3& impulse, const Vector3& contactVector);
+
+		/**
+		 * Add the summed impulses to the momenta of the bodies, and store the total impulses in the contacts for the next step.
+		 */
+		void FinishContactSolver();
+
+		static uint64_t MakeManifoldKey(const GJKShape* shapeA, const GJKShape* shapeB);
+
+		/**
+		 * Wake up any sleeping object found in collision with an awake object that can move.
+		 * True is returned if anything was woken up.
+		 */
+		bool WakeTouchedIslands();
+
+		/**
+		 * Mark the given sleeping object awake, and have it take part in the rest of the current step, if any, as though it had been awake all along.
+		 */
+		void HandleObjectWoken(PhysicsObject* physicsObject);
+
+		/**
+		 * Find the islands of awake objects in contact, using union-find over the collisions found this step.
+		 * Islands are numbered in order of their lowest-numbered object, so the numbering is the same from
+		 * one run to the next.
+		 */
+		void BuildIslands();
+
+		/**
+		 * Return the island of the given object, or -1 if it's in none, as it is if it can't move.
+		 */
+		int GetObjectIsland(PhysicsObject* physicsObject) const;
+
+		/**
+		 * Put to sleep the islands that have been at rest for long enough.
+		 */
+		void PutRestingIslandsToSleep();
+
+		/**
+		 * Return the index of the root of the set containing the given index, halving the path to it along the way.
+		 */
+		int FindIslandRoot(int i);
+
+		/**
+		 * Run the given loop across our worker threads, if we have any, or on this thread, if not.
+		 */
+		void ParallelFor(int count, int batchSize, std::function<void(int beginIndex, int endIndex, int threadIndex)> rangeFunction);
+
+		/**
+		 * Integrate the motion of the given body, but stop it at the first time of impact with
+		 * anything in its way, if any.  See @ref RigidBody::SetContinuousCollisionDetection.
 		 */
-		void ApplyFriction(Contact& contact);
+		void IntegrateMotionContinuous(RigidBody* rigidBody, double timeStepSeconds, CollisionSystem* collisionSystem);
 
 		void ShowImGuiPhysicsWindow();
 
@@ -144,13 +491,56 @@ namespace Thebe
 		// These could be declared locally within the StepSimulation function, but
 		// we declare them here so that we don't thrash the allocators for each
 		// container type.  Rather, we want to re-use that storage each step.
-		std::unordered_map<RefHandle, Reference<CollisionSystem::Collision>> collisionMap;
 		std::vector<Reference<CollisionSystem::Collision>> collisionArray;
-		std::list<Contact> contactList;
+		std::vector<ContactManifold> manifoldArray;
+		std::vector<ContactManifold> previousManifoldArray;
+		std::unordered_map<uint64_t, int> previousManifoldMap;
+		std::vector<SolverBody> solverBodyArray;
+		std::unordered_map<RigidBody*, int> solverBodyMap;
+		std::vector<ContactConstraint> contactConstraintArray;
+		std::vector<ContactConstraint> unsortedConstraintArray;
+		std::vector<int> islandConstraintOffsetArray;
+		std::vector<int> islandConstraintCursorArray;
+		std::vector<Contact*> resolverContactArray;
+		std::vector<CollisionSystem::Collision*> separationCollisionArray;
+		std::vector<RigidBody*> continuousBodyArray;
+		std::vector<CollisionObject*> sweptObjectArray;
+		std::vector<PhysicsObject*> awakeObjectArray;
+		std::vector<RigidBody*> integrationBodyArray;
+		std::vector<Transform> integrationTransformArray;
+		RigidBodyWorld rigidBodyWorld;
+		std::unordered_map<PhysicsObject*, int> islandIndexMap;
+		std::vector<PhysicsObject*> islandObjectArray;
+		std::vector<int> islandParentArray;
+		std::vector<int> objectIslandArray;
+		std::vector<double> islandEnergyArray;
+		std::vector<double> islandMassArray;
+		std::vector<int> islandCalmStepCountArray;
+		std::vector<uint32_t> islandNumberArray;
+		std::unordered_map<uint32_t, std::vector<RefHandle>> sleepingIslandMap;
 
 		Vector3 accelerationDueToGravity;
 		double separationDampingFactor;
 		double coeficientOfRestitution;
+		double coeficientOfFriction;
+		double restitutionSpeedThreshold;
+		double contactMatchDistance;
+		double contactBiasFactor;
+		double contactSlop;
+		int contactSolverIterations;
+		ContactSolverStats contactSolverStats;
+		Clock contactSolverClock;
+		bool sleepEnabled;
+		double sleepEnergyThreshold;
+		int sleepStepCount;
+		uint32_t nextSleepingIslandNumber;
+		IslandStats islandStats;
+		double fixedTimeStepSeconds;
+		int maxStepsPerFrame;
+		double timeAccumulatorSeconds;
+		int numStepsLastFrame;
+		CollisionSystem* collisionSystem;	///< This is the collision system whose worker pool we share.
+		bool threadCountChosen;			///< This is set once the thread count is given to us, so that initializing doesn't override it.
 
 		int physicsWindowCookie;
 	};
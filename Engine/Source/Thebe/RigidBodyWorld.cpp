@@ -0,0 +1,240 @@
+#include "Thebe/RigidBodyWorld.h"
+#include "Thebe/EngineParts/RigidBody.h"
+#include "Thebe/EngineParts/CollisionObject.h"
+#include <immintrin.h>
+
+using namespace Thebe;
+
+// These wrap whichever instructions we have so that the integrator below need only be written once.
+namespace
+{
+#if defined(__AVX__)
+	typedef __m256d Lanes;
+
+	inline Lanes LoadLanes(const double* source) { return _mm256_loadu_pd(source); }
+	inline void StoreLanes(double* destination, Lanes lanes) { _mm256_storeu_pd(destination, lanes); }
+	inline Lanes SplatLanes(double scalar) { return _mm256_set1_pd(scalar); }
+	inline Lanes AddLanes(Lanes lanesA, Lanes lanesB) { return _mm256_add_pd(lanesA, lanesB); }
+	inline Lanes SubLanes(Lanes lanesA, Lanes lanesB) { return _mm256_sub_pd(lanesA, lanesB); }
+	inline Lanes MulLanes(Lanes lanesA, Lanes lanesB) { return _mm256_mul_pd(lanesA, lanesB); }
+	inline Lanes DivLanes(Lanes lanesA, Lanes lanesB) { return _mm256_div_pd(lanesA, lanesB); }
+	inline Lanes SqrtLanes(Lanes lanes) { return _mm256_sqrt_pd(lanes); }
+#else
+	typedef __m128d Lanes;
+
+	inline Lanes LoadLanes(const double* source) { return _mm_loadu_pd(source); }
+	inline void StoreLanes(double* destination, Lanes lanes) { _mm_storeu_pd(destination, lanes); }
+	inline Lanes SplatLanes(double scalar) { return _mm_set1_pd(scalar); }
+	inline Lanes AddLanes(Lanes lanesA, Lanes lanesB) { return _mm_add_pd(lanesA, lanesB); }
+	inline Lanes SubLanes(Lanes lanesA, Lanes lanesB) { return _mm_sub_pd(lanesA, lanesB); }
+	inline Lanes MulLanes(Lanes lanesA, Lanes lanesB) { return _mm_mul_pd(lanesA, lanesB); }
+	inline Lanes DivLanes(Lanes lanesA, Lanes lanesB) { return _mm_div_pd(lanesA, lanesB); }
+	inline Lanes SqrtLanes(Lanes lanes) { return _mm_sqrt_pd(lanes); }
+#endif
+
+	inline Lanes DotLanes(const Lanes* vectorA, const Lanes* vectorB)
+	{
+		return AddLanes(AddLanes(MulLanes(vectorA[0], vectorB[0]), MulLanes(vectorA[1], vectorB[1])), MulLanes(vectorA[2], vectorB[2]));
+	}
+
+	inline void NormalizeLanes(Lanes* vector)
+	{
+		Lanes scale = DivLanes(SplatLanes(1.0), SqrtLanes(DotLanes(vector, vector)));
+		for (int k = 0; k < 3; k++)
+			vector[k] = MulLanes(vector[k], scale);
+	}
+
+	inline void RejectLanes(Lanes* vector, const Lanes* unitVector)
+	{
+		Lanes dot = DotLanes(vector, unitVector);
+		for (int k = 0; k < 3; k++)
+			vector[k] = SubLanes(vector[k], MulLanes(unitVector[k], dot));
+	}
+}
+
+#if defined(__AVX__)
+/*static*/ const int RigidBodyWorld::laneCount = 4;
+#else
+/*static*/ const int RigidBodyWorld::laneCount = 2;
+#endif
+
+RigidBodyWorld::RigidBodyWorld()
+{
+	this->numBodies = 0;
+}
+
+/*virtual*/ RigidBodyWorld::~RigidBodyWorld()
+{
+}
+
+void RigidBodyWorld::SetNumBodies(int numBodies)
+{
+	this->numBodies = THEBE_MAX(numBodies, 0);
+
+	int numSlots = ((this->numBodies + laneCount - 1) / laneCount) * laneCount;
+
+	for (int k = 0; k < 3; k++)
+	{
+		this->position[k].resize(numSlots);
+		this->linearMomentum[k].resize(numSlots);
+		this->angularMomentum[k].resize(numSlots);
+		this->totalForce[k].resize(numSlots);
+		this->totalTorque[k].resize(numSlots);
+
+		for (int j = 0; j < 3; j++)
+		{
+			this->orientation[k][j].resize(numSlots);
+			this->objectSpaceInertiaTensorInverse[k][j].resize(numSlots);
+		}
+	}
+
+	this->inverseMass.resize(numSlots);
+
+	for (int i = this->numBodies; i < numSlots; i++)
+		this->ClearBody(i);
+}
+
+int RigidBodyWorld::GetNumBodies() const
+{
+	return this->numBodies;
+}
+
+void RigidBodyWorld::ClearBody(int i)
+{
+	for (int k = 0; k < 3; k++)
+	{
+		this->position[k][i] = 0.0;
+		this->linearMomentum[k][i] = 0.0;
+		this->angularMomentum[k][i] = 0.0;
+		this->totalForce[k][i] = 0.0;
+		this->totalTorque[k][i] = 0.0;
+
+		// An identity orientation keeps the orthonormalization of padding lanes from dividing by zero.
+		for (int j = 0; j < 3; j++)
+		{
+			this->orientation[k][j][i] = (k == j) ? 1.0 : 0.0;
+			this->objectSpaceInertiaTensorInverse[k][j][i] = 0.0;
+		}
+	}
+
+	this->inverseMass[i] = 0.0;
+}
+
+void RigidBodyWorld::PackBody(int i, const RigidBody* rigidBody)
+{
+	const Transform& objectToWorld = rigidBody->GetCollisionObject()->GetObjectToWorld();
+
+	this->position[0][i] = objectToWorld.translation.x;
+	this->position[1][i] = objectToWorld.translation.y;
+	this->position[2][i] = objectToWorld.translation.z;
+
+	this->linearMomentum[0][i] = rigidBody->linearMomentum.x;
+	this->linearMomentum[1][i] = rigidBody->linearMomentum.y;
+	this->linearMomentum[2][i] = rigidBody->linearMomentum.z;
+
+	this->angularMomentum[0][i] = rigidBody->angularMomentum.x;
+	this->angularMomentum[1][i] = rigidBody->angularMomentum.y;
+	this->angularMomentum[2][i] = rigidBody->angularMomentum.z;
+
+	this->totalForce[0][i] = rigidBody->totalForce.x;
+	this->totalForce[1][i] = rigidBody->totalForce.y;
+	this->totalForce[2][i] = rigidBody->totalForce.z;
+
+	this->totalTorque[0][i] = rigidBody->totalTorque.x;
+	this->totalTorque[1][i] = rigidBody->totalTorque.y;
+	this->totalTorque[2][i] = rigidBody->totalTorque.z;
+
+	bool movable = !rigidBody->IsStationary() && rigidBody->totalMass != 0.0;
+
+	for (int k = 0; k < 3; k++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			this->orientation[k][j][i] = objectToWorld.matrix.ele[k][j];
+			this->objectSpaceInertiaTensorInverse[k][j][i] = movable ? rigidBody->objectSpaceInertiaTensorInverse.ele[k][j] : 0.0;
+		}
+	}
+
+	this->inverseMass[i] = movable ? 1.0 / rigidBody->totalMass : 0.0;
+}
+
+void RigidBodyWorld::UnpackBody(int i, RigidBody* rigidBody, Transform& objectToWorld) const
+{
+	objectToWorld.translation.SetComponents(this->position[0][i], this->position[1][i], this->position[2][i]);
+
+	for (int k = 0; k < 3; k++)
+		for (int j = 0; j < 3; j++)
+			objectToWorld.matrix.ele[k][j] = this->orientation[k][j][i];
+
+	rigidBody->linearMomentum.SetComponents(this->linearMomentum[0][i], this->linearMomentum[1][i], this->linearMomentum[2][i]);
+	rigidBody->angularMomentum.SetComponents(this->angularMomentum[0][i], this->angularMomentum[1][i], this->angularMomentum[2][i]);
+}
+
+void RigidBodyWorld::Integrate(int beginIndex, int endIndex, double timeStepSeconds)
+{
+	THEBE_ASSERT(beginIndex % laneCount == 0);
+
+	Lanes timeStep = SplatLanes(timeStepSeconds);
+
+	// Note that the last group of lanes may run into the padding, which is harmless.
+	for (int i = beginIndex; i < endIndex; i += laneCount)
+	{
+		Lanes rotation[3][3], inertiaInverse[3][3];
+		for (int k = 0; k < 3; k++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				rotation[k][j] = LoadLanes(&this->orientation[k][j][i]);
+				inertiaInverse[k][j] = LoadLanes(&this->objectSpaceInertiaTensorInverse[k][j][i]);
+			}
+		}
+
+		Lanes angularMomentum[3];
+		for (int k = 0; k < 3; k++)
+			angularMomentum[k] = LoadLanes(&this->angularMomentum[k][i]);
+
+		// The world-space inertia tensor inverse is R*I^{-1}*R^T, but we only need it applied to the angular momentum,
+		// so rather than form it, we apply each of its three factors in turn, which takes far fewer multiplies.
+		Lanes objectSpaceAngularMomentum[3], objectSpaceAngularVelocity[3], angularVelocity[3];
+		for (int k = 0; k < 3; k++)
+			objectSpaceAngularMomentum[k] = AddLanes(AddLanes(MulLanes(rotation[0][k], angularMomentum[0]), MulLanes(rotation[1][k], angularMomentum[1])), MulLanes(rotation[2][k], angularMomentum[2]));
+		for (int k = 0; k < 3; k++)
+			objectSpaceAngularVelocity[k] = AddLanes(AddLanes(MulLanes(inertiaInverse[k][0], objectSpaceAngularMomentum[0]), MulLanes(inertiaInverse[k][1], objectSpaceAngularMomentum[1])), MulLanes(inertiaInverse[k][2], objectSpaceAngularMomentum[2]));
+		for (int k = 0; k < 3; k++)
+			angularVelocity[k] = AddLanes(AddLanes(MulLanes(rotation[k][0], objectSpaceAngularVelocity[0]), MulLanes(rotation[k][1], objectSpaceAngularVelocity[1])), MulLanes(rotation[k][2], objectSpaceAngularVelocity[2]));
+
+		// Numerically integrate...
+		Lanes inverseMass = LoadLanes(&this->inverseMass[i]);
+		for (int k = 0; k < 3; k++)
+		{
+			Lanes linearMomentum = LoadLanes(&this->linearMomentum[k][i]);
+			Lanes linearVelocity = MulLanes(linearMomentum, inverseMass);
+			StoreLanes(&this->position[k][i], AddLanes(LoadLanes(&this->position[k][i]), MulLanes(linearVelocity, timeStep)));
+			StoreLanes(&this->linearMomentum[k][i], AddLanes(linearMomentum, MulLanes(LoadLanes(&this->totalForce[k][i]), timeStep)));
+			StoreLanes(&this->angularMomentum[k][i], AddLanes(angularMomentum[k], MulLanes(LoadLanes(&this->totalTorque[k][i]), timeStep)));
+		}
+
+		// Each column of the orientation matrix moves by the cross product of the angular velocity with that column.
+		Lanes axis[3][3];
+		for (int j = 0; j < 3; j++)
+		{
+			const Lanes column[3] = { rotation[0][j], rotation[1][j], rotation[2][j] };
+			axis[j][0] = AddLanes(column[0], MulLanes(SubLanes(MulLanes(angularVelocity[1], column[2]), MulLanes(angularVelocity[2], column[1])), timeStep));
+			axis[j][1] = AddLanes(column[1], MulLanes(SubLanes(MulLanes(angularVelocity[2], column[0]), MulLanes(angularVelocity[0], column[2])), timeStep));
+			axis[j][2] = AddLanes(column[2], MulLanes(SubLanes(MulLanes(angularVelocity[0], column[1]), MulLanes(angularVelocity[1], column[0])), timeStep));
+		}
+
+		// Don't let numerical round-off error cause our orientation matrix to become non-orthonormal.
+		// This anchors the X axis, just as the scalar integrator does.
+		NormalizeLanes(axis[0]);
+		RejectLanes(axis[1], axis[0]);
+		NormalizeLanes(axis[1]);
+		RejectLanes(axis[2], axis[0]);
+		RejectLanes(axis[2], axis[1]);
+		NormalizeLanes(axis[2]);
+
+		for (int k = 0; k < 3; k++)
+			for (int j = 0; j < 3; j++)
+				StoreLanes(&this->orientation[k][j][i], axis[j][k]);
+	}
+}
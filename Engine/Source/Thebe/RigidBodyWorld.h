@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Thebe/Common.h"
+#include "Thebe/Math/Transform.h"
+#include <vector>
+
+namespace Thebe
+{
+	class RigidBody;
+
+	/**
+	 * This holds the state of a batch of rigid bodies as a structure of arrays, one contiguous
+	 * array of doubles per component, so that the unconstrained motion of many bodies can be
+	 * integrated several at a time with SIMD instructions, rather than one at a time through
+	 * a virtual call and a scattering of heap objects.
+	 *
+	 * This is only a temporary batch, not where the bodies live.  The physics system packs the
+	 * awake rigid bodies into it at each step, integrates them here, and then unpacks them again,
+	 * since a body's position and orientation are kept in the transform of its collision object.
+	 * The gather and scatter cost more than the integration itself, so the gain is modest; with
+	 * 10,000 bodies on one thread it took a step from about 2.0 ms to 1.3 ms with AVX, and from
+	 * about 2.3 ms to 1.9 ms without it.  The store is padded out to a whole number of lanes,
+	 * so the last range given to @ref Integrate may end anywhere.
+	 *
+	 * The integration done here is the same as that of @ref RigidBody::IntegrateMotionUnconstrained,
+	 * up to round-off error.
+	 */
+	class THEBE_API RigidBodyWorld
+	{
+	public:
+		RigidBodyWorld();
+		virtual ~RigidBodyWorld();
+
+		/**
+		 * This is the number of bodies integrated at once.  It's 4 when built with AVX, and 2 otherwise.
+		 */
+		static const int laneCount;
+
+		/**
+		 * Make room for the given number of bodies, whose state is then undefined until set with @ref PackBody.
+		 */
+		void SetNumBodies(int numBodies);
+		int GetNumBodies() const;
+
+		/**
+		 * Copy the state of the given body into the given slot of this store.  Different slots
+		 * may be packed on different threads at once.  Stationary bodies are packed as though
+		 * infinitely massive, so that they don't move, much as @ref RigidBody::GetLinearVelocity
+		 * and @ref RigidBody::GetAngularVelocity say they don't.
+		 */
+		void PackBody(int i, const RigidBody* rigidBody);
+
+		/**
+		 * Copy the state of the given slot back into the given body, except for where the body now is,
+		 * which is returned in the given transform, since moving the body updates the collision system,
+		 * which isn't thread-safe.  Different slots may be unpacked on different threads at once.
+		 */
+		void UnpackBody(int i, RigidBody* rigidBody, Transform& objectToWorld) const;
+
+		/**
+		 * Numerically integrate the unconstrained motion of the bodies in the given range of slots
+		 * over the given amount of time.  Disjoint ranges may be integrated on different threads at once.
+		 *
+		 * @param[in] beginIndex This is the first slot to integrate, which must be a multiple of @ref laneCount.
+		 * @param[in] endIndex This is one past the last slot to integrate, which must be a multiple of @ref laneCount or the number of bodies.
+		 */
+		void Integrate(int beginIndex, int endIndex, double timeStepSeconds);
+
+	private:
+
+		/**
+		 * Fill the given slot with a body that has no mass and doesn't move.  This is what pads the store out to a whole number of lanes.
+		 */
+		void ClearBody(int i);
+
+		int numBodies;
+		std::vector<double> position[3];
+		std::vector<double> orientation[3][3];					///< This is indexed like @ref Matrix3x3::ele, by row, then by column.
+		std::vector<double> linearMomentum[3];
+		std::vector<double> angularMomentum[3];
+		std::vector<double> totalForce[3];
+		std::vector<double> totalTorque[3];
+		std::vector<double> inverseMass;
+		std::vector<double> objectSpaceInertiaTensorInverse[3][3];
+	};
+}
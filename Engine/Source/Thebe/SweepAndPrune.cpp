@@ -0,0 +1,457 @@
+#include "Thebe/SweepAndPrune.h"
+#include "Thebe/Log.h"
+#include <limits>
+
+using namespace Thebe;
+
+//---------------------------------------- SweepAndPrune ----------------------------------------
+
+SweepAndPrune::SweepAndPrune()
+{
+	this->freeIndex = -1;
+	this->numProxies = 0;
+}
+
+/*virtual*/ SweepAndPrune::~SweepAndPrune()
+{
+	this->RemoveAllObjects();
+}
+
+/*virtual*/ bool SweepAndPrune::AddObject(BVHObject* object)
+{
+	if (!object)
+		return false;
+
+	if (object->IsInBVH())
+	{
+		THEBE_LOG("Given object is already in a tree.");
+		return false;
+	}
+
+	AxisAlignedBoundingBox box = object->GetWorldBoundingBox();
+	if (!this->worldBox.ContainsBox(box))
+		return false;
+
+	int proxyIndex = -1;
+	if (this->freeIndex == -1)
+	{
+		proxyIndex = (int)this->proxyArray.size();
+		this->proxyArray.push_back(Proxy());
+	}
+	else
+	{
+		proxyIndex = this->freeIndex;
+		this->freeIndex = this->proxyArray[proxyIndex].nextFreeIndex;
+		this->proxyArray[proxyIndex].nextFreeIndex = -1;
+	}
+
+	// The new end-points start out at the far end of each list, and then
+	// get sorted into place as if the object had moved in from infinity.
+	constexpr double infinity = std::numeric_limits<double>::max();
+	Proxy& proxy = this->proxyArray[proxyIndex];
+	proxy.object = object;
+	proxy.box.minCorner.SetComponents(infinity, infinity, infinity);
+	proxy.box.maxCorner.SetComponents(infinity, infinity, infinity);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		std::vector<EndPoint>& endPointArray = this->endPointArray[axis];
+		proxy.endPointIndex[axis][0] = (int)endPointArray.size();
+		endPointArray.push_back(EndPoint{ infinity, proxyIndex, false });
+		proxy.endPointIndex[axis][1] = (int)endPointArray.size();
+		endPointArray.push_back(EndPoint{ infinity, proxyIndex, true });
+	}
+
+	this->SetObjectTree(object, this);
+	object->proxyIndex = proxyIndex;
+	this->numProxies++;
+
+	this->SetBox(proxyIndex, box);
+	return true;
+}
+
+/*virtual*/ bool SweepAndPrune::RemoveObject(BVHObject* object)
+{
+	if (!object)
+		return false;
+
+	if (!this->OwnsObject(object))
+	{
+		THEBE_LOG("Given object is not in this tree.");
+		return false;
+	}
+
+	int proxyIndex = object->proxyIndex;
+
+	// Send the end-points off to infinity, which ends all of the object's pairs along the way.
+	// What's left is for the end-points to be popped off the far end of each list.
+	constexpr double infinity = std::numeric_limits<double>::max();
+	AxisAlignedBoundingBox box;
+	box.minCorner.SetComponents(infinity, infinity, infinity);
+	box.maxCorner.SetComponents(infinity, infinity, infinity);
+	this->SetBox(proxyIndex, box);
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		std::vector<EndPoint>& endPointArray = this->endPointArray[axis];
+		THEBE_ASSERT(endPointArray.size() >= 2 && endPointArray[endPointArray.size() - 1].proxyIndex == proxyIndex);
+		endPointArray.pop_back();
+		endPointArray.pop_back();
+	}
+
+	// End-points that tie in value are not swapped, so guard against such pairs lingering.
+	std::vector<int> lingeringPartnerArray = this->proxyArray[proxyIndex].partnerArray;
+	for (int partnerIndex : lingeringPartnerArray)
+		this->RemovePair(proxyIndex, partnerIndex);
+
+	Proxy& proxy = this->proxyArray[proxyIndex];
+	THEBE_ASSERT(proxy.partnerArray.size() == 0);
+	proxy.object = nullptr;
+	proxy.nextFreeIndex = this->freeIndex;
+	this->freeIndex = proxyIndex;
+	this->numProxies--;
+
+	this->SetObjectTree(object, nullptr);
+	object->proxyIndex = -1;
+
+	return true;
+}
+
+/*virtual*/ void SweepAndPrune::RemoveAllObjects()
+{
+	std::vector<std::pair<int, int>> pairArray;
+	for (auto& pair : this->pairMap)
+		pairArray.push_back(std::pair(int(pair.first >> 32), int(pair.first & 0xFFFFFFFF)));
+
+	for (auto& pair : pairArray)
+		this->RemovePair(pair.first, pair.second);
+
+	for (Proxy& proxy : this->proxyArray)
+	{
+		if (proxy.object.Get())
+		{
+			this->SetObjectTree(proxy.object, nullptr);
+			proxy.object->proxyIndex = -1;
+		}
+	}
+
+	this->proxyArray.clear();
+	for (int axis = 0; axis < 3; axis++)
+		this->endPointArray[axis].clear();
+	this->freeIndex = -1;
+	this->numProxies = 0;
+}
+
+/*virtual*/ bool SweepAndPrune::UpdateObject(BVHObject* object, bool /*allowCuts*/)
+{
+	if (!this->OwnsObject(object))
+		return false;
+
+	AxisAlignedBoundingBox box = object->GetWorldBoundingBox();
+	if (!this->worldBox.ContainsBox(box))
+	{
+		this->RemoveObject(object);
+		return false;
+	}
+
+	this->SetBox(object->proxyIndex, box);
+	return true;
+}
+
+/*virtual*/ void SweepAndPrune::FindObjects(const AxisAlignedBoundingBox& worldBox, std::list<BVHObject*>& objectList) const
+{
+	objectList.clear();
+
+	// Only objects starting at or before the end of the given box along the first axis can overlap it.
+	for (const EndPoint& endPoint : this->endPointArray[0])
+	{
+		if (endPoint.value > worldBox.maxCorner.x)
+			break;
+
+		if (endPoint.isMax)
+			continue;
+
+		const Proxy& proxy = this->proxyArray[endPoint.proxyIndex];
+		if (Overlaps(proxy.box, worldBox))
+			objectList.push_back(const_cast<BVHObject*>(proxy.object.Get()));
+	}
+}
+
+/*virtual*/ void SweepAndPrune::FindObjects(const AxisAlignedBoundingBox& worldBox, std::vector<BVHObject*>& objectArray, const ObjectFilter& objectFilter) const
+{
+	objectArray.clear();
+
+	for (const EndPoint& endPoint : this->endPointArray[0])
+	{
+		if (endPoint.value > worldBox.maxCorner.x)
+			break;
+
+		if (endPoint.isMax)
+			continue;
+
+		const Proxy& proxy = this->proxyArray[endPoint.proxyIndex];
+		if (Overlaps(proxy.box, worldBox) && (!objectFilter || objectFilter(proxy.object.Get())))
+			objectArray.push_back(const_cast<BVHObject*>(proxy.object.Get()));
+	}
+}
+
+/*virtual*/ void SweepAndPrune::FindObjectsHitByRay(const Ray& ray, std::vector<BVHObject*>& objectArray) const
+{
+	objectArray.clear();
+
+	for (const Proxy& proxy : this->proxyArray)
+	{
+		if (!proxy.object.Get())
+			continue;
+
+		Interval interval;
+		if (ray.CastAgainst(proxy.box, interval))
+			objectArray.push_back(const_cast<BVHObject*>(proxy.object.Get()));
+	}
+}
+
+/*virtual*/ BVHObject* SweepAndPrune::FindNearestObjectHitByRay(const Ray& ray, double& alpha, Vector3& unitSurfaceNormal)
+{
+	BVHObject* nearestHitObject = nullptr;
+	double nearestAlpha = std::numeric_limits<double>::max();
+
+	for (Proxy& proxy : this->proxyArray)
+	{
+		if (!proxy.object.Get())
+			continue;
+
+		Interval interval;
+		if (!ray.CastAgainst(proxy.box, interval) || interval.A > nearestAlpha)
+			continue;
+
+		double tentativeAlpha = 0.0;
+		Vector3 tentativeSurfaceNormal;
+		if (proxy.object->RayCast(ray, tentativeAlpha, tentativeSurfaceNormal) && tentativeAlpha < nearestAlpha)
+		{
+			nearestAlpha = tentativeAlpha;
+			nearestHitObject = proxy.object.Get();
+			unitSurfaceNormal = tentativeSurfaceNormal;
+		}
+	}
+
+	if (nearestHitObject)
+		alpha = nearestAlpha;
+
+	return nearestHitObject;
+}
+
+/*virtual*/ void SweepAndPrune::FindAllOverlappingPairs(std::vector<ObjectPair>& pairArray)
+{
+	pairArray.clear();
+	pairArray.reserve(this->pairMap.size());
+
+	// The pairs are kept whatever the objects' bits say, so that changing the bits takes effect right away.
+	for (auto& pair : this->pairMap)
+		if (this->ShouldPair(pair.second.objectA, pair.second.objectB))
+			pairArray.push_back(pair.second);
+}
+
+/*virtual*/ void SweepAndPrune::GatherStats(Stats& stats) const
+{
+	stats.numNodes = this->numProxies;
+	stats.numObjects = this->numProxies;
+	stats.maxDepth = (this->numProxies > 0) ? 1 : 0;
+}
+
+void SweepAndPrune::SetBox(int proxyIndex, const AxisAlignedBoundingBox& box)
+{
+	Proxy& proxy = this->proxyArray[proxyIndex];
+	AxisAlignedBoundingBox oldBox = proxy.box;
+
+	// Overlap tests done while sorting must see the new box.
+	proxy.box = box;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		std::vector<EndPoint>& endPointArray = this->endPointArray[axis];
+
+		double oldMin = GetComponent(oldBox.minCorner, axis);
+		double oldMax = GetComponent(oldBox.maxCorner, axis);
+		double newMin = GetComponent(box.minCorner, axis);
+		double newMax = GetComponent(box.maxCorner, axis);
+
+		endPointArray[proxy.endPointIndex[axis][0]].value = newMin;
+		endPointArray[proxy.endPointIndex[axis][1]].value = newMax;
+
+		// Grow the interval before shrinking it so that the minimum never passes the maximum.
+		if (newMin < oldMin)
+			this->SortDown(axis, proxy.endPointIndex[axis][0]);
+
+		if (newMax > oldMax)
+			this->SortUp(axis, proxy.endPointIndex[axis][1]);
+
+		if (newMin > oldMin)
+			this->SortUp(axis, proxy.endPointIndex[axis][0]);
+
+		if (newMax < oldMax)
+			this->SortDown(axis, proxy.endPointIndex[axis][1]);
+	}
+}
+
+void SweepAndPrune::SortDown(int axis, int i)
+{
+	std::vector<EndPoint>& endPointArray = this->endPointArray[axis];
+
+	while (i > 0 && endPointArray[i - 1].value > endPointArray[i].value)
+	{
+		const EndPoint& endPoint = endPointArray[i];
+		const EndPoint& prevEndPoint = endPointArray[i - 1];
+
+		if (endPoint.proxyIndex != prevEndPoint.proxyIndex)
+		{
+			if (!endPoint.isMax && prevEndPoint.isMax)
+			{
+				// A minimum moving below a maximum means the pair may now overlap.
+				if (Overlaps(this->proxyArray[endPoint.proxyIndex].box, this->proxyArray[prevEndPoint.proxyIndex].box))
+					this->AddPair(endPoint.proxyIndex, prevEndPoint.proxyIndex);
+			}
+			else if (endPoint.isMax && !prevEndPoint.isMax)
+			{
+				// A maximum moving below a minimum means the pair no longer overlaps.
+				this->RemovePair(endPoint.proxyIndex, prevEndPoint.proxyIndex);
+			}
+		}
+
+		this->Swap(axis, i - 1, i);
+		i--;
+	}
+}
+
+void SweepAndPrune::SortUp(int axis, int i)
+{
+	std::vector<EndPoint>& endPointArray = this->endPointArray[axis];
+	int lastIndex = int(endPointArray.size()) - 1;
+
+	while (i < lastIndex && endPointArray[i + 1].value < endPointArray[i].value)
+	{
+		const EndPoint& endPoint = endPointArray[i];
+		const EndPoint& nextEndPoint = endPointArray[i + 1];
+
+		if (endPoint.proxyIndex != nextEndPoint.proxyIndex)
+		{
+			if (endPoint.isMax && !nextEndPoint.isMax)
+			{
+				// A maximum moving above a minimum means the pair may now overlap.
+				if (Overlaps(this->proxyArray[endPoint.proxyIndex].box, this->proxyArray[nextEndPoint.proxyIndex].box))
+					this->AddPair(endPoint.proxyIndex, nextEndPoint.proxyIndex);
+			}
+			else if (!endPoint.isMax && nextEndPoint.isMax)
+			{
+				// A minimum moving above a maximum means the pair no longer overlaps.
+				this->RemovePair(endPoint.proxyIndex, nextEndPoint.proxyIndex);
+			}
+		}
+
+		this->Swap(axis, i, i + 1);
+		i++;
+	}
+}
+
+void SweepAndPrune::Swap(int axis, int i, int j)
+{
+	std::vector<EndPoint>& endPointArray = this->endPointArray[axis];
+
+	EndPoint endPoint = endPointArray[i];
+	endPointArray[i] = endPointArray[j];
+	endPointArray[j] = endPoint;
+
+	this->proxyArray[endPointArray[i].proxyIndex].endPointIndex[axis][endPointArray[i].isMax ? 1 : 0] = i;
+	this->proxyArray[endPointArray[j].proxyIndex].endPointIndex[axis][endPointArray[j].isMax ? 1 : 0] = j;
+}
+
+void SweepAndPrune::AddPair(int proxyIndexA, int proxyIndexB)
+{
+	uint64_t key = MakePairKey(proxyIndexA, proxyIndexB);
+	if (this->pairMap.find(key) != this->pairMap.end())
+		return;
+
+	ObjectPair pair;
+	pair.objectA = this->proxyArray[THEBE_MIN(proxyIndexA, proxyIndexB)].object.Get();
+	pair.objectB = this->proxyArray[THEBE_MAX(proxyIndexA, proxyIndexB)].object.Get();
+	this->pairMap.insert(std::pair(key, pair));
+	this->proxyArray[proxyIndexA].partnerArray.push_back(proxyIndexB);
+	this->proxyArray[proxyIndexB].partnerArray.push_back(proxyIndexA);
+
+	if (this->pairAddedCallback)
+		this->pairAddedCallback(pair.objectA, pair.objectB);
+}
+
+void SweepAndPrune::RemovePair(int proxyIndexA, int proxyIndexB)
+{
+	auto iter = this->pairMap.find(MakePairKey(proxyIndexA, proxyIndexB));
+	if (iter == this->pairMap.end())
+		return;
+
+	ObjectPair pair = iter->second;
+	this->pairMap.erase(iter);
+	this->RemovePartner(proxyIndexA, proxyIndexB);
+	this->RemovePartner(proxyIndexB, proxyIndexA);
+
+	if (this->pairRemovedCallback)
+		this->pairRemovedCallback(pair.objectA, pair.objectB);
+}
+
+void SweepAndPrune::RemovePartner(int proxyIndex, int partnerIndex)
+{
+	std::vector<int>& partnerArray = this->proxyArray[proxyIndex].partnerArray;
+	for (int i = 0; i < (int)partnerArray.size(); i++)
+	{
+		if (partnerArray[i] == partnerIndex)
+		{
+			partnerArray[i] = partnerArray.back();
+			partnerArray.pop_back();
+			return;
+		}
+	}
+}
+
+/*static*/ double SweepAndPrune::GetComponent(const Vector3& vector, int axis)
+{
+	switch (axis)
+	{
+	case 0:
+		return vector.x;
+	case 1:
+		return vector.y;
+	default:
+		return vector.z;
+	}
+}
+
+/*static*/ bool SweepAndPrune::Overlaps(const AxisAlignedBoundingBox& boxA, const AxisAlignedBoundingBox& boxB)
+{
+	if (boxA.maxCorner.x < boxB.minCorner.x || boxB.maxCorner.x < boxA.minCorner.x)
+		return false;
+
+	if (boxA.maxCorner.y < boxB.minCorner.y || boxB.maxCorner.y < boxA.minCorner.y)
+		return false;
+
+	if (boxA.maxCorner.z < boxB.minCorner.z || boxB.maxCorner.z < boxA.minCorner.z)
+		return false;
+
+	return true;
+}
+
+/*static*/ uint64_t SweepAndPrune::MakePairKey(int proxyIndexA, int proxyIndexB)
+{
+	uint64_t minIndex = (uint64_t)THEBE_MIN(proxyIndexA, proxyIndexB);
+	uint64_t maxIndex = (uint64_t)THEBE_MAX(proxyIndexA, proxyIndexB);
+	return (minIndex << 32) | maxIndex;
+}
+
+//---------------------------------------- SweepAndPrune::Proxy ----------------------------------------
+
+SweepAndPrune::Proxy::Proxy()
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		this->endPointIndex[axis][0] = -1;
+		this->endPointIndex[axis][1] = -1;
+	}
+
+	this->nextFreeIndex = -1;
+}
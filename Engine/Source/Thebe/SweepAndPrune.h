@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Thebe/BoundingVolumeHierarchy.h"
+#include <unordered_map>
+
+namespace Thebe
+{
+	/**
+	 * This is an incremental sweep-and-prune broad phase.  It is not a tree at all,
+	 * but it implements the @ref BVHTree interface so that it can be swapped in for one.
+	 *
+	 * The minimum and maximum of each object's bounding box along each of the three
+	 * axes are kept in three sorted lists of end-points.  When an object moves, its
+	 * end-points are moved into place using insertion sort.  Since objects typically
+	 * move very little from frame to frame, only a handful of swaps are needed per
+	 * move.  Each swap of a minimum past a maximum (or vice-versa) is the only way a
+	 * pair of objects can begin or end overlapping, and so a persistent set of overlapping
+	 * pairs is maintained as a side-effect of the sorting.  The pair callbacks (see
+	 * @ref BVHTree::SetPairCallbacks) are called as pairs enter and leave this set.
+	 *
+	 * Note that region and ray queries are done here by brute force, so prefer one
+	 * of the tree implementations if those are the main use-case.
+	 */
+	class THEBE_API SweepAndPrune : public BVHTree
+	{
+	public:
+		SweepAndPrune();
+		virtual ~SweepAndPrune();
+
+		virtual bool AddObject(BVHObject* object) override;
+		virtual bool RemoveObject(BVHObject* object) override;
+		virtual void RemoveAllObjects() override;
+		virtual bool UpdateObject(BVHObject* object, bool allowCuts) override;
+		virtual void FindObjects(const AxisAlignedBoundingBox& worldBox, std::list<BVHObject*>& objectList) const override;
+		virtual void FindObjects(const AxisAlignedBoundingBox& worldBox, std::vector<BVHObject*>& objectArray, const ObjectFilter& objectFilter) const override;
+		virtual void FindObjectsHitByRay(const Ray& ray, std::vector<BVHObject*>& objectArray) const override;
+		virtual BVHObject* FindNearestObjectHitByRay(const Ray& ray, double& alpha, Vector3& unitSurfaceNormal) override;
+		virtual void FindAllOverlappingPairs(std::vector<ObjectPair>& pairArray) override;
+		virtual void GatherStats(Stats& stats) const override;
+
+	private:
+
+		struct EndPoint
+		{
+			double value;
+			int proxyIndex;
+			bool isMax;
+		};
+
+		struct Proxy
+		{
+			Proxy();
+
+			Reference<BVHObject> object;
+			AxisAlignedBoundingBox box;
+			int endPointIndex[3][2];		///< This is indexed by axis, then by zero for minimum and one for maximum.
+			int nextFreeIndex;
+			std::vector<int> partnerArray;	///< These are the proxies whose pairs with this one are in the pair map, so that removal need only visit those pairs.
+		};
+
+		static double GetComponent(const Vector3& vector, int axis);
+		static bool Overlaps(const AxisAlignedBoundingBox& boxA, const AxisAlignedBoundingBox& boxB);
+		static uint64_t MakePairKey(int proxyIndexA, int proxyIndexB);
+
+		void SetBox(int proxyIndex, const AxisAlignedBoundingBox& box);
+		void SortDown(int axis, int i);
+		void SortUp(int axis, int i);
+		void Swap(int axis, int i, int j);
+		void AddPair(int proxyIndexA, int proxyIndexB);
+		void RemovePair(int proxyIndexA, int proxyIndexB);
+		void RemovePartner(int proxyIndex, int partnerIndex);
+
+		std::vector<Proxy> proxyArray;
+		std::vector<EndPoint> endPointArray[3];
+		std::unordered_map<uint64_t, ObjectPair> pairMap;
+		int freeIndex;
+		int numProxies;
+	};
+}
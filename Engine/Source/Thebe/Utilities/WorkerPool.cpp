@@ -0,0 +1,165 @@
+#include "Thebe/Utilities/WorkerPool.h"
+#include <format>
+
+using namespace Thebe;
+
+//---------------------------------------- WorkerPool ----------------------------------------
+
+WorkerPool::WorkerPool()
+{
+	this->nextIndex = 0;
+	this->count = 0;
+	this->batchSize = 1;
+	this->jobNumber = 0;
+	this->numBusyWorkers = 0;
+	this->shuttingDown = false;
+}
+
+/*virtual*/ WorkerPool::~WorkerPool()
+{
+	this->Shutdown();
+}
+
+bool WorkerPool::Startup(int numThreads)
+{
+	this->Shutdown();
+
+	if (numThreads < 1)
+		return false;
+
+	// Every worker starts out having seen job zero, so no job number may be left over from a previous run of the pool.
+	this->shuttingDown = false;
+	this->jobNumber = 0;
+	this->nextIndex = 0;
+	this->count = 0;
+	this->numBusyWorkers = 0;
+
+	for (int i = 1; i < numThreads; i++)
+	{
+		auto worker = new Worker(this, i);
+		this->workerArray.push_back(worker);
+		if (!worker->Split())
+		{
+			this->Shutdown();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void WorkerPool::Shutdown()
+{
+	if (this->workerArray.size() == 0)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->shuttingDown = true;
+	}
+
+	this->workAvailableCondition.notify_all();
+
+	for (Worker* worker : this->workerArray)
+	{
+		worker->Join();
+		delete worker;
+	}
+
+	this->workerArray.clear();
+}
+
+int WorkerPool::GetNumThreads() const
+{
+	return (int)this->workerArray.size() + 1;
+}
+
+void WorkerPool::ParallelFor(int count, int batchSize, RangeFunction rangeFunction)
+{
+	if (count <= 0)
+		return;
+
+	batchSize = THEBE_MAX(batchSize, 1);
+
+	// Don't bother waking anyone up if there's only enough work for one batch.
+	if (this->workerArray.size() == 0 || count <= batchSize)
+	{
+		rangeFunction(0, count, 0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->rangeFunction = rangeFunction;
+		this->count = count;
+		this->batchSize = batchSize;
+		this->nextIndex = 0;
+		this->numBusyWorkers = (int)this->workerArray.size();
+		this->jobNumber++;
+	}
+
+	this->workAvailableCondition.notify_all();
+
+	this->ProcessBatches(0);
+
+	std::unique_lock<std::mutex> lock(this->mutex);
+	this->workDoneCondition.wait(lock, [this]() { return this->numBusyWorkers == 0; });
+	this->rangeFunction = nullptr;
+}
+
+void WorkerPool::ProcessBatches(int threadIndex)
+{
+	while (true)
+	{
+		int beginIndex = this->nextIndex.fetch_add(this->batchSize);
+		if (beginIndex >= this->count)
+			break;
+
+		int endIndex = THEBE_MIN(beginIndex + this->batchSize, this->count);
+		this->rangeFunction(beginIndex, endIndex, threadIndex);
+	}
+}
+
+//---------------------------------------- WorkerPool::Worker ----------------------------------------
+
+WorkerPool::Worker::Worker(WorkerPool* workerPool, int threadIndex) : Thread(std::format("Worker Thread {}", threadIndex))
+{
+	this->workerPool = workerPool;
+	this->threadIndex = threadIndex;
+}
+
+/*virtual*/ WorkerPool::Worker::~Worker()
+{
+}
+
+/*virtual*/ void WorkerPool::Worker::Run()
+{
+	uint64_t lastJobNumber = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(this->workerPool->mutex);
+			this->workerPool->workAvailableCondition.wait(lock, [this, lastJobNumber]() {
+				return this->workerPool->shuttingDown || this->workerPool->jobNumber != lastJobNumber;
+			});
+
+			if (this->workerPool->shuttingDown)
+				break;
+
+			lastJobNumber = this->workerPool->jobNumber;
+		}
+
+		this->workerPool->ProcessBatches(this->threadIndex);
+
+		bool lastOneDone = false;
+		{
+			std::lock_guard<std::mutex> lock(this->workerPool->mutex);
+			THEBE_ASSERT(this->workerPool->numBusyWorkers > 0);
+			lastOneDone = (--this->workerPool->numBusyWorkers == 0);
+		}
+
+		if (lastOneDone)
+			this->workerPool->workDoneCondition.notify_one();
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Thebe/Utilities/Thread.h"
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <condition_variable>
+
+namespace Thebe
+{
+	/**
+	 * This is a fixed set of threads that sleep until handed a loop to run in parallel.
+	 * The thread calling @ref ParallelFor does its share of the work too, so a pool of
+	 * N threads has N-1 workers.  Work is handed out in batches of consecutive indices
+	 * on a first-come, first-served basis, so the assignment of indices to threads is
+	 * not deterministic.  If results must not depend on this, have each thread write
+	 * to its own buffer (indexed by the thread index given to the loop body), and then
+	 * merge the buffers in index order afterwards.
+	 */
+	class THEBE_API WorkerPool
+	{
+	public:
+		WorkerPool();
+		virtual ~WorkerPool();
+
+		/**
+		 * Spin up the worker threads.  If the pool is already running, it is first shut down.
+		 *
+		 * @param[in] numThreads This is the total number of threads that will run a loop, including the calling thread.
+		 */
+		bool Startup(int numThreads);
+
+		/**
+		 * Signal the worker threads to quit, and then wait for them to do so.
+		 */
+		void Shutdown();
+
+		/**
+		 * Return the total number of threads that run a loop, including the calling thread.
+		 * Thread indices given to loop bodies are always less than this.
+		 */
+		int GetNumThreads() const;
+
+		/**
+		 * This is called for the indices [beginIndex, endIndex) on the thread with the given index.
+		 */
+		typedef std::function<void(int beginIndex, int endIndex, int threadIndex)> RangeFunction;
+
+		/**
+		 * Call the given function for all indices in [0, count) across all threads of the pool,
+		 * and return once they're all done.  This must not be called from more than one thread at a time.
+		 */
+		void ParallelFor(int count, int batchSize, RangeFunction rangeFunction);
+
+	private:
+
+		class Worker : public Thread
+		{
+		public:
+			Worker(WorkerPool* workerPool, int threadIndex);
+			virtual ~Worker();
+
+		protected:
+			virtual void Run() override;
+
+			WorkerPool* workerPool;
+			int threadIndex;
+		};
+
+		void ProcessBatches(int threadIndex);
+
+		std::vector<Worker*> workerArray;
+		std::mutex mutex;
+		std::condition_variable workAvailableCondition;
+		std::condition_variable workDoneCondition;
+		RangeFunction rangeFunction;
+		std::atomic<int> nextIndex;
+		int count;
+		int batchSize;
+		uint64_t jobNumber;
+		int numBusyWorkers;
+		bool shuttingDown;
+	};
+}